@@ -100,6 +100,7 @@ CameraWindow::CameraWindow(wiGUI* gui) :GUI(gui)
 		if (proxy != nullptr)
 		{
 			proxy->name = args.sValue;
+			wiRenderer::GetScene().UpdateIndex(proxy);
 		}
 	});
 	cameraWindow->AddWidget(proxyNameField);
@@ -1,6 +1,1121 @@
 #include "stdafx.h"
 #include "Tests.h"
 
+#include <psapi.h>
+#include <deque>
+
+using namespace std;
+
+// CPU-only benchmark: cull a synthetic scene from multiple cameras, with an increasing number of job system threads
+static void RunCullingBenchmark()
+{
+	const int objectCount = 50000;
+	const int cameraCount = 16;
+	const int iterations = 20;
+
+	vector<Cullable> cullables(objectCount);
+	vector<Cullable*> collection(objectCount);
+	for (int i = 0; i < objectCount; ++i)
+	{
+		XMFLOAT3 pos = XMFLOAT3((float)wiRandom::getRandom(-1000, 1000), (float)wiRandom::getRandom(-100, 100), (float)wiRandom::getRandom(-1000, 1000));
+		float size = (float)wiRandom::getRandom(1, 5);
+		cullables[i].bounds = AABB(pos, XMFLOAT3(pos.x + size, pos.y + size, pos.z + size));
+		collection[i] = &cullables[i];
+	}
+	wiSPTree tree(collection);
+
+	vector<Frustum> frustums(cameraCount);
+	for (int i = 0; i < cameraCount; ++i)
+	{
+		const float angle = XM_2PI * i / cameraCount;
+		XMFLOAT4X4 view, projection;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0, 10, 0, 1), XMVectorSet(sinf(angle), 0, cosf(angle), 0), XMVectorSet(0, 1, 0, 0)));
+		XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 800.0f));
+		frustums[i].ConstructFrustum(800.0f, projection, view);
+	}
+	vector<CulledList> results(cameraCount);
+
+	stringstream ss("");
+	ss << "Culling Benchmark: " << objectCount << " objects, " << cameraCount << " cameras";
+	wiBackLog::post(ss.str().c_str());
+
+	const uint32_t maxThreadCount = wiJobSystem::GetThreadCount();
+	vector<uint32_t> threadCounts;
+	for (uint32_t threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+	{
+		threadCounts.push_back(threadCount);
+	}
+	threadCounts.push_back(maxThreadCount);
+
+	for (uint32_t threadCount : threadCounts)
+	{
+		wiJobSystem::SetActiveThreadCount(threadCount);
+
+		wiTimer timer;
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			wiJobSystem::context ctx;
+			wiJobSystem::Dispatch(ctx, cameraCount, 1, [&](wiJobSystem::JobArgs args) {
+				results[args.jobIndex].clear();
+				tree.getVisible(frustums[args.jobIndex], results[args.jobIndex], wiSPTree::SP_TREE_SORT_FRONT_TO_BACK);
+			});
+			wiJobSystem::Wait(ctx);
+		}
+		const double time = timer.elapsed() / iterations;
+
+		ss.str("");
+		ss << "\t" << threadCount << " threads: " << time << " ms";
+		wiBackLog::post(ss.str().c_str());
+	}
+	wiJobSystem::SetActiveThreadCount(maxThreadCount);
+}
+
+// CPU-only benchmark: overhead of distributing small tasks with wiTaskThread compared to the job system
+static void RunJobSystemBenchmark()
+{
+	const uint32_t taskCount = wiJobSystem::GetThreadCount();
+	const int rounds = 1000;
+	const uint32_t workSize = 1000;
+
+	vector<float> results(taskCount);
+	auto work = [&](uint32_t index) {
+		float sum = 0;
+		for (uint32_t i = 0; i < workSize; ++i)
+		{
+			sum += sqrtf((float)(i + index));
+		}
+		results[index] = sum;
+	};
+
+	stringstream ss("");
+	ss << "Job System Benchmark: " << taskCount << " tasks, " << rounds << " rounds";
+	wiBackLog::post(ss.str().c_str());
+
+	// wiTaskThread: one dedicated thread per task, woken up and waited for every round
+	{
+		vector<wiTaskThread*> threads;
+		for (uint32_t i = 0; i < taskCount; ++i)
+		{
+			threads.push_back(new wiTaskThread([&, i] { work(i); }));
+		}
+
+		wiTimer timer;
+		for (int round = 0; round < rounds; ++round)
+		{
+			for (auto thread : threads)
+			{
+				thread->wakeup();
+			}
+			for (auto thread : threads)
+			{
+				thread->wait();
+			}
+		}
+		const double time = timer.elapsed() * 1000.0 / rounds;
+
+		for (auto thread : threads)
+		{
+			delete thread;
+		}
+
+		ss.str("");
+		ss << "\twiTaskThread: " << time << " us / round";
+		wiBackLog::post(ss.str().c_str());
+	}
+
+	// wiJobSystem::Execute: one job per task
+	{
+		wiTimer timer;
+		for (int round = 0; round < rounds; ++round)
+		{
+			wiJobSystem::context ctx;
+			for (uint32_t i = 0; i < taskCount; ++i)
+			{
+				wiJobSystem::Execute(ctx, [&, i](wiJobSystem::JobArgs args) { work(i); });
+			}
+			wiJobSystem::Wait(ctx);
+		}
+		const double time = timer.elapsed() * 1000.0 / rounds;
+
+		ss.str("");
+		ss << "\twiJobSystem::Execute: " << time << " us / round";
+		wiBackLog::post(ss.str().c_str());
+	}
+
+	// wiJobSystem::Dispatch: the tasks are the jobs of a single dispatch
+	{
+		wiTimer timer;
+		for (int round = 0; round < rounds; ++round)
+		{
+			wiJobSystem::context ctx;
+			wiJobSystem::Dispatch(ctx, taskCount, 1, [&](wiJobSystem::JobArgs args) { work(args.jobIndex); });
+			wiJobSystem::Wait(ctx);
+		}
+		const double time = timer.elapsed() * 1000.0 / rounds;
+
+		ss.str("");
+		ss << "\twiJobSystem::Dispatch: " << time << " us / round";
+		wiBackLog::post(ss.str().c_str());
+	}
+}
+
+
+// Reference for the normals benchmark: the quadratic smooth normal computation that Mesh::ComputeNormals(true) used before it became linear.
+//	The face normals are weighted like in the current implementation (area weighted, normalized, no vertex skipped) and the search
+//	continues at the same index after a duplicate is erased, so that the welding and the duplicate removal of the two can be compared directly
+static void ComputeSmoothNormals_Reference(vector<Mesh::Vertex_FULL>& vertices, vector<uint32_t>& indices)
+{
+	// 1.) Zero normals, they will be averaged later
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		vertices[i].nor = XMFLOAT4(0, 0, 0, 0);
+	}
+
+	// 2.) Find identical vertices by POSITION, accumulate face normals
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		Mesh::Vertex_FULL& v_search = vertices[i];
+
+		XMVECTOR N = XMVectorZero();
+		for (size_t ind = 0; ind < indices.size() / 3; ++ind)
+		{
+			const Mesh::Vertex_FULL& v0 = vertices[indices[ind * 3 + 0]];
+			const Mesh::Vertex_FULL& v1 = vertices[indices[ind * 3 + 1]];
+			const Mesh::Vertex_FULL& v2 = vertices[indices[ind * 3 + 2]];
+
+			bool match_pos0 =
+				fabs(v_search.pos.x - v0.pos.x) < FLT_EPSILON &&
+				fabs(v_search.pos.y - v0.pos.y) < FLT_EPSILON &&
+				fabs(v_search.pos.z - v0.pos.z) < FLT_EPSILON;
+
+			bool match_pos1 =
+				fabs(v_search.pos.x - v1.pos.x) < FLT_EPSILON &&
+				fabs(v_search.pos.y - v1.pos.y) < FLT_EPSILON &&
+				fabs(v_search.pos.z - v1.pos.z) < FLT_EPSILON;
+
+			bool match_pos2 =
+				fabs(v_search.pos.x - v2.pos.x) < FLT_EPSILON &&
+				fabs(v_search.pos.y - v2.pos.y) < FLT_EPSILON &&
+				fabs(v_search.pos.z - v2.pos.z) < FLT_EPSILON;
+
+			if (match_pos0 || match_pos1 || match_pos2)
+			{
+				XMVECTOR U = XMLoadFloat4(&v2.pos) - XMLoadFloat4(&v0.pos);
+				XMVECTOR V = XMLoadFloat4(&v1.pos) - XMLoadFloat4(&v0.pos);
+				N += XMVector3Cross(U, V);
+			}
+		}
+
+		XMFLOAT3 normal;
+		XMStoreFloat3(&normal, XMVector3Normalize(N));
+		v_search.nor.x = normal.x;
+		v_search.nor.y = normal.y;
+		v_search.nor.z = normal.z;
+	}
+
+	// 3.) Find unique vertices by POSITION and TEXCOORD and MATERIAL and remove duplicates
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Mesh::Vertex_FULL& v0 = vertices[i];
+
+		for (size_t j = i + 1; j < vertices.size(); j++)
+		{
+			const Mesh::Vertex_FULL& v1 = vertices[j];
+
+			bool unique_pos =
+				fabs(v0.pos.x - v1.pos.x) < FLT_EPSILON &&
+				fabs(v0.pos.y - v1.pos.y) < FLT_EPSILON &&
+				fabs(v0.pos.z - v1.pos.z) < FLT_EPSILON;
+
+			bool unique_tex =
+				fabs(v0.tex.x - v1.tex.x) < FLT_EPSILON &&
+				fabs(v0.tex.y - v1.tex.y) < FLT_EPSILON &&
+				(int)v0.tex.z == (int)v1.tex.z;
+
+			if (unique_pos && unique_tex)
+			{
+				for (size_t ind = 0; ind < indices.size(); ++ind)
+				{
+					if (indices[ind] == j)
+					{
+						indices[ind] = static_cast<uint32_t>(i);
+					}
+					else if (indices[ind] > j && indices[ind] > 0)
+					{
+						indices[ind]--;
+					}
+				}
+
+				vertices.erase(vertices.begin() + j);
+				j--;
+			}
+		}
+	}
+}
+
+// Generate a terrain patch like an importer would: every quad has its own four vertices, so all inner positions are duplicated.
+//	The two halves use a different material, so the vertices along the seam must stay separate after welding
+static void GenerateNormalsBenchmarkMesh(Mesh& mesh, int quadsPerSide)
+{
+	mesh.vertices_FULL.clear();
+	mesh.indices.clear();
+	for (int y = 0; y < quadsPerSide; ++y)
+	{
+		for (int x = 0; x < quadsPerSide; ++x)
+		{
+			const uint32_t first = (uint32_t)mesh.vertices_FULL.size();
+			const int corners[4][2] = { { x, y },{ x + 1, y },{ x, y + 1 },{ x + 1, y + 1 } };
+			for (auto& corner : corners)
+			{
+				const float u = (float)corner[0] / quadsPerSide;
+				const float v = (float)corner[1] / quadsPerSide;
+				Mesh::Vertex_FULL vert(XMFLOAT3(u * 100.0f, sinf(u * 20.0f) * cosf(v * 13.0f) * 4.0f, v * 100.0f));
+				vert.tex = XMFLOAT4(u, v, (float)(x < quadsPerSide / 2 ? 0 : 1), 0);
+				mesh.vertices_FULL.push_back(vert);
+			}
+			const uint32_t quadIndices[] = { 0, 2, 1, 1, 2, 3 };
+			for (uint32_t index : quadIndices)
+			{
+				mesh.indices.push_back(first + index);
+			}
+		}
+	}
+}
+
+// Compute the smooth normals of a large mesh with Mesh::ComputeNormals(true) and with the old quadratic algorithm, compare the timings and the results
+static void RunNormalsBenchmark()
+{
+	const int quadsPerSide = 64;
+	const float epsilon = 0.001f;
+
+	Mesh mesh("normals_benchmark_mesh");
+	GenerateNormalsBenchmarkMesh(mesh, quadsPerSide);
+	vector<Mesh::Vertex_FULL> referenceVertices = mesh.vertices_FULL;
+	vector<uint32_t> referenceIndices = mesh.indices;
+
+	stringstream ss("");
+	ss << "Normals Benchmark: " << mesh.vertices_FULL.size() << " vertices, " << mesh.indices.size() / 3 << " triangles";
+	wiBackLog::post(ss.str().c_str());
+
+	wiTimer timer;
+	ComputeSmoothNormals_Reference(referenceVertices, referenceIndices);
+	const double referenceTime = timer.elapsed();
+
+	timer.record();
+	mesh.ComputeNormals(true);
+	const double time = timer.elapsed();
+
+	ss.str("");
+	ss << "\tquadratic reference: " << referenceTime << " ms";
+	wiBackLog::post(ss.str().c_str());
+	ss.str("");
+	ss << "\tMesh::ComputeNormals(smooth): " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	// The duplicate removal of both keeps the first vertex of every group in order, so the results must match one to one:
+	bool match = mesh.vertices_FULL.size() == referenceVertices.size() && mesh.indices == referenceIndices;
+	float maxError = 0;
+	for (size_t i = 0; match && i < mesh.vertices_FULL.size(); ++i)
+	{
+		const XMFLOAT4& a = mesh.vertices_FULL[i].nor;
+		const XMFLOAT4& b = referenceVertices[i].nor;
+		maxError = max(maxError, max(fabs(a.x - b.x), max(fabs(a.y - b.y), fabs(a.z - b.z))));
+	}
+	match = match && maxError < epsilon;
+	assert(match && "Mesh::ComputeNormals(smooth) doesn't match the reference!");
+
+	ss.str("");
+	ss << "\t" << mesh.vertices_FULL.size() << " welded vertices, max normal error: " << maxError << (match ? " (OK)" : " (FAILED)");
+	wiBackLog::post(ss.str().c_str());
+}
+
+// Serialize a large generated scene to disk, then measure the time and memory of loading it back
+static void RunArchiveBenchmark()
+{
+	const int meshCount = 32;
+	const int vertexCount = 250000;
+	const string fileName = "archive_benchmark.wimf";
+
+	{
+		Model* model = new Model;
+		for (int i = 0; i < meshCount; ++i)
+		{
+			stringstream name("");
+			name << "benchmark_mesh" << i;
+			Mesh* mesh = new Mesh(name.str());
+			mesh->vertices_FULL.resize(vertexCount);
+			for (int j = 0; j < vertexCount; ++j)
+			{
+				mesh->vertices_FULL[j].pos = XMFLOAT4((float)j, (float)i, 0, 0);
+			}
+			mesh->indices.resize(vertexCount * 3);
+			for (int j = 0; j < vertexCount * 3; ++j)
+			{
+				mesh->indices[j] = (uint32_t)wiRandom::getRandom(0, vertexCount - 1);
+			}
+			model->meshes.insert(make_pair(mesh->name, mesh));
+
+			Object* object = new Object(name.str());
+			object->meshName = mesh->name;
+			model->objects.insert(object);
+		}
+
+		wiTimer timer;
+		wiArchive archive(fileName, false);
+		model->Serialize(archive);
+		archive.Close();
+
+		stringstream ss("");
+		ss << "Archive Benchmark: " << meshCount << " meshes, " << vertexCount << " vertices per mesh";
+		wiBackLog::post(ss.str().c_str());
+		ss.str("");
+		ss << "\tsave: " << timer.elapsed() << " ms";
+		wiBackLog::post(ss.str().c_str());
+
+		delete model;
+	}
+
+	{
+		// Private memory is measured while both the loaded model and the archive are alive, which is the peak of loading:
+		PROCESS_MEMORY_COUNTERS_EX memoryBefore, memoryLoaded;
+		GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&memoryBefore, sizeof(memoryBefore));
+
+		wiTimer timer;
+		Model* model = new Model;
+		wiArchive archive(fileName, true);
+		model->Serialize(archive);
+		const double time = timer.elapsed();
+
+		GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&memoryLoaded, sizeof(memoryLoaded));
+		archive.Close();
+
+		stringstream ss("");
+		ss << "\tload: " << time << " ms, private memory: " << ((memoryLoaded.PrivateUsage - memoryBefore.PrivateUsage) >> 20) << " MB";
+		wiBackLog::post(ss.str().c_str());
+
+		delete model;
+	}
+
+	remove(fileName.c_str());
+}
+
+static Armature* CreateBenchmarkArmature(const string& name, int boneCount, int keyCount)
+{
+	Armature* armature = new Armature(name, "");
+	armature->actions.push_back(Action());
+	armature->actions.back().name = "benchmark_action";
+	armature->actions.back().frameCount = keyCount;
+	for (int i = 0; i < boneCount; ++i)
+	{
+		stringstream boneName("");
+		boneName << "benchmark_bone" << i;
+		Bone* bone = new Bone(boneName.str());
+		if (i % 16 != 0)
+		{
+			bone->parentName = armature->boneCollection.back()->name;
+		}
+		bone->actionFrames.push_back(ActionFrames());
+		ActionFrames& frames = bone->actionFrames.back();
+		for (int j = 1; j <= keyCount; ++j)
+		{
+			XMFLOAT4 rotation;
+			XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(j * 0.01f, i * 0.1f, 0));
+			frames.keyframesRot.push_back(KeyFrame(j, rotation.x, rotation.y, rotation.z, rotation.w));
+			frames.keyframesPos.push_back(KeyFrame(j, 0, (float)j, 0, 0));
+			frames.keyframesSca.push_back(KeyFrame(j, 1, 1, 1, 0));
+		}
+		armature->boneCollection.push_back(bone);
+	}
+	armature->CreateFamily();
+	armature->ChangeAction("benchmark_action");
+	return armature;
+}
+static void RunAnimationBenchmark()
+{
+	const int boneCount = 256;
+	const int keyCount = 10000;
+	const int frameCount = 1000;
+
+	Armature* armature = CreateBenchmarkArmature("benchmark_armature", boneCount, keyCount);
+
+	stringstream ss("");
+	ss << "Animation Benchmark: " << boneCount << " bones, " << keyCount << " keyframes per channel";
+	wiBackLog::post(ss.str().c_str());
+
+	wiTimer timer;
+	for (int i = 0; i < frameCount; ++i)
+	{
+		armature->UpdateArmature();
+		armature->UpdateTransform();
+	}
+	double time = timer.elapsed();
+	ss.str("");
+	ss << "\tarmature update: " << (int)((double)boneCount * frameCount / (time * 0.001)) << " bones/sec";
+	wiBackLog::post(ss.str().c_str());
+
+	// Compare the keyframe lookup alone with the linear search that was used before.
+	//	Samples advance in time like a playing animation, but with a stride, so every sample has to search:
+	const KeyFrameTrack& track = armature->boneCollection[0]->actionFrames.back().keyframesRot;
+	const int sampleCount = 100000;
+	uint32_t checksum = 0;
+	timer.record();
+	for (int i = 0; i < sampleCount; ++i)
+	{
+		float cf = 1.5f + (float)((i * 37) % (keyCount - 1));
+		for (uint32_t k = (uint32_t)track.size() - 1; k > 0; --k)
+		{
+			if (track.times[k] <= cf)
+			{
+				checksum += k;
+				break;
+			}
+		}
+	}
+	double timeLinear = timer.elapsed();
+	timer.record();
+	for (int i = 0; i < sampleCount; ++i)
+	{
+		float cf = 1.5f + (float)((i * 37) % (keyCount - 1));
+		checksum -= track.Find(cf);
+	}
+	double timeFind = timer.elapsed();
+	ss.str("");
+	ss << "\tkeyframe lookup: linear search " << timeLinear << " ms, KeyFrameTrack::Find " << timeFind << " ms" << (checksum == 0 ? "" : " (MISMATCH!)");
+	wiBackLog::post(ss.str().c_str());
+
+	delete armature;
+
+	// Crowd of armatures, animated serially, then in parallel on all threads:
+	const int armatureCount = 100;
+	const int crowdBoneCount = 64;
+	const int crowdKeyCount = 200;
+	vector<Armature*> crowd;
+	for (int i = 0; i < armatureCount; ++i)
+	{
+		stringstream name("");
+		name << "benchmark_armature" << i;
+		crowd.push_back(CreateBenchmarkArmature(name.str(), crowdBoneCount, crowdKeyCount));
+	}
+
+	ss.str("");
+	ss << "\tcrowd: " << armatureCount << " armatures, " << crowdBoneCount << " bones, " << crowdKeyCount << " keyframes per channel";
+	wiBackLog::post(ss.str().c_str());
+
+	const uint32_t threadCount = wiJobSystem::GetThreadCount();
+	for (uint32_t activeThreads : { 1u, threadCount })
+	{
+		wiJobSystem::SetActiveThreadCount(activeThreads);
+		timer.record();
+		for (int i = 0; i < 100; ++i)
+		{
+			for (Armature* x : crowd)
+			{
+				x->UpdateArmature();
+			}
+			Armature::AnimateArmatures(crowd);
+			for (Armature* x : crowd)
+			{
+				x->UpdateTransform();
+			}
+		}
+		time = timer.elapsed();
+		ss.str("");
+		ss << "\t\t" << activeThreads << " threads: " << (int)((double)armatureCount * crowdBoneCount * 100 / (time * 0.001)) << " bones/sec";
+		wiBackLog::post(ss.str().c_str());
+	}
+	wiJobSystem::SetActiveThreadCount(threadCount);
+
+	for (Armature* x : crowd)
+	{
+		delete x;
+	}
+}
+
+// CPU-only benchmark: transform hierarchy update of a mostly static scene, compared with the recursive update of the whole tree
+static void RunTransformBenchmark()
+{
+	const int rootCount = 1000;
+	const int childCount = 99;
+	const int movingCount = 10;
+	const int frameCount = 100;
+
+	Scene scene;
+	vector<Transform*> roots;
+	vector<Transform*> transforms;
+	for (int i = 0; i < rootCount; ++i)
+	{
+		Transform* root = new Transform;
+		root->translation_rest = XMFLOAT3((float)wiRandom::getRandom(-1000, 1000), 0, (float)wiRandom::getRandom(-1000, 1000));
+		root->attachTo(scene.GetWorldNode());
+		roots.push_back(root);
+		transforms.push_back(root);
+		for (int j = 0; j < childCount; ++j)
+		{
+			Transform* child = new Transform;
+			child->translation_rest = XMFLOAT3((float)wiRandom::getRandom(-10, 10), (float)wiRandom::getRandom(0, 10), (float)wiRandom::getRandom(-10, 10));
+			child->attachTo(root);
+			transforms.push_back(child);
+		}
+	}
+	scene.Update();
+
+	stringstream ss("");
+	ss << "Transform Benchmark: " << transforms.size() << " transforms";
+	wiBackLog::post(ss.str().c_str());
+
+	wiTimer timer;
+	for (int i = 0; i < frameCount; ++i)
+	{
+		scene.GetWorldNode()->UpdateTransform();
+	}
+	double time = timer.elapsed() / frameCount;
+	ss.str("");
+	ss << "\trecursive update: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	timer.record();
+	for (int i = 0; i < frameCount; ++i)
+	{
+		scene.Update();
+	}
+	time = timer.elapsed() / frameCount;
+	ss.str("");
+	ss << "\tnothing moving: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	timer.record();
+	for (int i = 0; i < frameCount; ++i)
+	{
+		for (int j = 0; j < movingCount; ++j)
+		{
+			roots[(i * movingCount + j) % rootCount]->translation_rest.y += 0.01f;
+		}
+		scene.Update();
+	}
+	time = timer.elapsed() / frameCount;
+	ss.str("");
+	ss << "\t" << movingCount << " subtrees moving: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	timer.record();
+	for (int i = 0; i < frameCount; ++i)
+	{
+		for (Transform* x : roots)
+		{
+			x->translation_rest.y += 0.01f;
+		}
+		scene.Update();
+	}
+	time = timer.elapsed() / frameCount;
+	ss.str("");
+	ss << "\teverything moving: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	for (Transform* x : transforms)
+	{
+		delete x;
+	}
+}
+
+// CPU-only benchmark: entity lookup by name and ID through the scene index, compared with linear scans over the model containers
+static void RunLookupBenchmark()
+{
+	const int objectCount = 10000;
+	const int lookupCount = 10000;
+
+	Scene scene;
+	Model* model = new Model;
+	vector<Object*> objects;
+	for (int i = 0; i < objectCount; ++i)
+	{
+		stringstream name("");
+		name << "benchmark_object" << i;
+		Object* object = new Object(name.str());
+		object->attachTo(model);
+		model->Add(object);
+		objects.push_back(object);
+	}
+	scene.AddModel(model);
+
+	vector<string> names;
+	for (int i = 0; i < lookupCount; ++i)
+	{
+		names.push_back(objects[(i * 7919) % objectCount]->name);
+	}
+
+	stringstream ss("");
+	ss << "Lookup Benchmark: " << objectCount << " objects, " << lookupCount << " lookups";
+	wiBackLog::post(ss.str().c_str());
+
+	uint32_t mismatches = 0;
+	wiTimer timer;
+	for (int i = 0; i < lookupCount; ++i)
+	{
+		Object* found = nullptr;
+		for (Model* x : scene.models)
+		{
+			for (Object* object : x->objects)
+			{
+				if (!object->name.compare(names[i]))
+				{
+					found = object;
+					break;
+				}
+			}
+			if (found != nullptr)
+			{
+				break;
+			}
+		}
+		mismatches += found == objects[(i * 7919) % objectCount] ? 0 : 1;
+	}
+	double time = timer.elapsed();
+	ss.str("");
+	ss << "\tby name, linear scan: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	timer.record();
+	for (int i = 0; i < lookupCount; ++i)
+	{
+		Object* found = scene.Find<Object>(wiHashString(names[i]));
+		mismatches += found == objects[(i * 7919) % objectCount] ? 0 : 1;
+	}
+	time = timer.elapsed();
+	ss.str("");
+	ss << "\tby name, index: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	timer.record();
+	for (int i = 0; i < lookupCount; ++i)
+	{
+		Object* object = objects[(i * 7919) % objectCount];
+		mismatches += scene.GetWorldNode()->find(object->GetID()) == object ? 0 : 1;
+	}
+	time = timer.elapsed();
+	ss.str("");
+	ss << "\tby ID, tree search: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	timer.record();
+	for (int i = 0; i < lookupCount; ++i)
+	{
+		Object* object = objects[(i * 7919) % objectCount];
+		mismatches += scene.FindTransform(object->GetID()) == object ? 0 : 1;
+	}
+	time = timer.elapsed();
+	ss.str("");
+	ss << "\tby ID, index: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	if (mismatches > 0)
+	{
+		ss.str("");
+		ss << "\t" << mismatches << " lookups returned the wrong entity!";
+		wiBackLog::post(ss.str().c_str());
+	}
+}
+
+// Frame benchmark: CPU cost of updating and rendering a scene for a number of frames.
+//	Start with the "nulldevice" argument to render with the null device, then the device also reports what the frames submitted,
+//	and the recorded counters are checked. Returns false if the checks failed.
+static bool RunFrameBenchmark(RenderableComponent* component)
+{
+	const int frameCount = 100;
+
+	wiRenderer::LoadModel("../models/Stormtrooper/Stormtrooper.wimf");
+
+	wiGraphicsTypes::GraphicsDevice_Null* nullDevice = dynamic_cast<wiGraphicsTypes::GraphicsDevice_Null*>(wiRenderer::GetDevice());
+
+	stringstream ss("");
+	ss << "Frame Benchmark: " << frameCount << " frames" << (nullDevice == nullptr ? " (start with nulldevice for the submission counters)" : " (null device)");
+	wiBackLog::post(ss.str().c_str());
+
+	// The profiler measures the time that the CPU spends on reading back GPU results:
+	wiProfiler& profiler = wiProfiler::GetInstance();
+	const bool profilerEnabled = profiler.ENABLED;
+	profiler.ENABLED = true;
+
+	wiGraphicsTypes::GraphicsDevice_Null::Counters counters;
+	wiTimer timer;
+	for (int i = 0; i < frameCount; ++i)
+	{
+		profiler.BeginFrame();
+		wiRenderer::UpdatePerFrameData(1.0f / 60.0f);
+		component->Render();
+		wiRenderer::Present([component] { component->Compose(); });
+		profiler.EndFrame();
+
+		if (nullDevice != nullptr)
+		{
+			counters += nullDevice->GetFrameCounters();
+		}
+	}
+	double time = timer.elapsed() / frameCount;
+	ss.str("");
+	ss << "\tCPU frame: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	const wiProfiler::RangeStats occlusionRead = profiler.GetRangeStats("Occlusion Culling Read");
+	ss.str("");
+	ss << "\tGPU readback stalls: occlusion read " << occlusionRead.avg << " ms avg, " << occlusionRead.max << " ms max, "
+		<< profiler.GetCounter("Occlusion results pending") << " of " << profiler.GetCounter("Occlusion queries") << " occlusion results pending (last frame), "
+		<< "profiler readback " << profiler.GetCounter("Profiler GPU readback (us)") << " us";
+	wiBackLog::post(ss.str().c_str());
+	profiler.ENABLED = profilerEnabled;
+
+	uint32_t meshDraws = 0, meshBindsSaved = 0;
+	for (int i = 0; i < SHADERTYPE_COUNT; ++i)
+	{
+		meshDraws += wiRenderer::GetDrawCallStats((SHADERTYPE)i).drawsIssued;
+		meshBindsSaved += wiRenderer::GetDrawCallStats((SHADERTYPE)i).bindsSaved;
+	}
+	ss.str("");
+	ss << "\tRenderMeshes (last frame): " << meshDraws << " draws, " << meshBindsSaved << " binds saved";
+	wiBackLog::post(ss.str().c_str());
+
+	const wiImage::DrawStats& imageStats = wiImage::GetDrawStats();
+	ss.str("");
+	ss << "\tImages (last frame): " << imageStats.images << " images, " << imageStats.drawCalls << " draws";
+	wiBackLog::post(ss.str().c_str());
+
+	if (nullDevice != nullptr)
+	{
+		ss.str("");
+		ss << "\tper frame: " << counters.drawCalls / frameCount << " draws, " << counters.dispatches / frameCount << " dispatches, "
+			<< counters.binds / frameCount << " binds, " << counters.stateChanges / frameCount << " state changes, "
+			<< counters.bytesUploaded / frameCount / 1024 << " KB uploaded, " << counters.commands / frameCount << " commands";
+		wiBackLog::post(ss.str().c_str());
+	}
+
+	bool passed = true;
+	if (nullDevice != nullptr)
+	{
+		// The frames must have rendered something, and the command stream of the last frame must agree with its counters:
+		const vector<wiGraphicsTypes::GraphicsDevice_Null::Command>& commands = nullDevice->GetFrameCommands();
+		const wiGraphicsTypes::GraphicsDevice_Null::Counters& lastCounters = nullDevice->GetFrameCounters();
+		uint32_t drawCommands = 0, dispatchCommands = 0;
+		for (auto& command : commands)
+		{
+			switch (command.type)
+			{
+			case wiGraphicsTypes::GraphicsDevice_Null::COMMAND_DRAW:
+			case wiGraphicsTypes::GraphicsDevice_Null::COMMAND_DRAW_INDIRECT:
+				drawCommands++;
+				break;
+			case wiGraphicsTypes::GraphicsDevice_Null::COMMAND_DISPATCH:
+			case wiGraphicsTypes::GraphicsDevice_Null::COMMAND_DISPATCH_INDIRECT:
+				dispatchCommands++;
+				break;
+			default:
+				break;
+			}
+		}
+		passed =
+			counters.drawCalls > 0 && counters.binds > 0 && counters.stateChanges > 0 && counters.bytesUploaded > 0 &&
+			lastCounters.commands == (uint32_t)commands.size() && lastCounters.drawCalls == drawCommands && lastCounters.dispatches == dispatchCommands;
+
+		ss.str("");
+		ss << "\tcounter checks: " << (passed ? "OK" : "FAILED");
+		wiBackLog::post(ss.str().c_str());
+	}
+	return passed;
+}
+
+// Decal atlas benchmark: decals with distinct textures keep appearing and disappearing in front of the camera,
+//	so the decal atlas has to insert, evict, grow and defragment while the frames are rendered.
+static void RunDecalAtlasBenchmark(RenderableComponent* component)
+{
+	const int frameCount = 200;
+	const int spawnPerFrame = 20;
+	const int maxAlive = 400;
+
+	wiGraphicsTypes::GraphicsDevice* device = wiRenderer::GetDevice();
+
+	stringstream ss("");
+	ss << "Decal Atlas Benchmark: " << frameCount * spawnPerFrame << " distinct decal textures over " << frameCount << " frames, " << maxAlive << " alive at once";
+	wiBackLog::post(ss.str().c_str());
+
+	deque<pair<Decal*, wiGraphicsTypes::Texture2D*>> alive;
+	uint32_t uploads = 0, evictions = 0, defragmentations = 0, resizes = 0;
+	double updateTime = 0, maxUpdateTime = 0;
+	uint64_t peakMemory = 0;
+
+	wiTimer timer;
+	for (int i = 0; i < frameCount; ++i)
+	{
+		for (int j = 0; j < spawnPerFrame; ++j)
+		{
+			const UINT size = 16u << wiRandom::getRandom(0, 3);
+			vector<uint32_t> pixels(size * size, 0xFF000000 | (uint32_t)wiRandom::getRandom(0, 0xFFFFFF));
+
+			wiGraphicsTypes::TextureDesc desc;
+			desc.Width = size;
+			desc.Height = size;
+			desc.MipLevels = 1;
+			desc.ArraySize = 1;
+			desc.Format = wiGraphicsTypes::FORMAT_B8G8R8A8_UNORM;
+			desc.SampleDesc.Count = 1;
+			desc.Usage = wiGraphicsTypes::USAGE_IMMUTABLE;
+			desc.BindFlags = wiGraphicsTypes::BIND_SHADER_RESOURCE;
+			wiGraphicsTypes::SubresourceData data;
+			data.pSysMem = pixels.data();
+			data.SysMemPitch = size * 4;
+			wiGraphicsTypes::Texture2D* texture = nullptr;
+			device->CreateTexture2D(&desc, &data, &texture);
+
+			Decal* decal = new Decal(XMFLOAT3(wiRandom::getRandom(-300, 300) * 0.01f, wiRandom::getRandom(0, 400) * 0.01f, 0), XMFLOAT3(0.5f, 0.5f, 2));
+			decal->texture = texture;
+			decal->UpdateWorld();
+			wiRenderer::PutDecal(decal);
+			alive.push_back(make_pair(decal, texture));
+		}
+		while ((int)alive.size() > maxAlive)
+		{
+			wiRenderer::Remove(alive.front().first);
+			delete alive.front().first;
+			delete alive.front().second;
+			alive.pop_front();
+		}
+
+		wiRenderer::UpdatePerFrameData(1.0f / 60.0f);
+		component->Render();
+		wiRenderer::Present([component] { component->Compose(); });
+
+		const wiRenderer::DecalAtlasStats& stats = wiRenderer::GetDecalAtlasStats();
+		uploads += stats.uploads;
+		evictions += stats.evictions;
+		defragmentations += stats.defragmentations;
+		resizes += stats.resizes;
+		updateTime += stats.updateMilliseconds;
+		maxUpdateTime = max(maxUpdateTime, (double)stats.updateMilliseconds);
+		peakMemory = max(peakMemory, stats.memoryBytes);
+	}
+	double time = timer.elapsed() / frameCount;
+
+	for (auto& x : alive)
+	{
+		wiRenderer::Remove(x.first);
+		delete x.first;
+		delete x.second;
+	}
+
+	ss.str("");
+	ss << "\tCPU frame: " << time << " ms, atlas update: " << updateTime / frameCount << " ms average, " << maxUpdateTime << " ms worst";
+	wiBackLog::post(ss.str().c_str());
+	ss.str("");
+	ss << "\t" << uploads << " uploads, " << evictions << " evictions, " << defragmentations << " defragmentations, " << resizes << " resizes";
+	wiBackLog::post(ss.str().c_str());
+	ss.str("");
+	ss << "\tatlas: " << wiRenderer::GetDecalAtlasStats().textures << " textures, " << peakMemory / 1024 / 1024 << " MB peak";
+	wiBackLog::post(ss.str().c_str());
+}
+
+// CPU-only benchmark: register many static objects that share a few meshes, with and without the cooked collision shapes
+static void RunShapeCacheBenchmark()
+{
+	const int meshCount = 4;
+	const int gridSize = 96;
+	const int objectCount = 400;
+	const string cacheFileName = "shapecache_benchmark.wishape";
+
+	vector<Mesh*> meshes;
+	for (int m = 0; m < meshCount; ++m)
+	{
+		// bumpy grid, so that the hull and the BVH have work to do:
+		Mesh* mesh = new Mesh;
+		mesh->vertices_POS.resize(gridSize * gridSize);
+		for (int y = 0; y < gridSize; ++y)
+		{
+			for (int x = 0; x < gridSize; ++x)
+			{
+				mesh->vertices_POS[x + y * gridSize].pos = XMFLOAT3((float)x, sinf(x * 0.3f + m) * cosf(y * 0.2f) * 3.0f, (float)y);
+			}
+		}
+		for (int y = 0; y < gridSize - 1; ++y)
+		{
+			for (int x = 0; x < gridSize - 1; ++x)
+			{
+				const uint32_t i = x + y * gridSize;
+				mesh->indices.push_back(i);
+				mesh->indices.push_back(i + gridSize);
+				mesh->indices.push_back(i + 1);
+				mesh->indices.push_back(i + 1);
+				mesh->indices.push_back(i + gridSize);
+				mesh->indices.push_back(i + gridSize + 1);
+			}
+		}
+		meshes.push_back(mesh);
+	}
+
+	vector<Object*> objects;
+	for (int i = 0; i < objectCount; ++i)
+	{
+		Object* object = new Object;
+		object->mesh = meshes[i % meshCount];
+		object->rigidBody = true;
+		object->mass = 0;
+		object->collisionShape = (i / meshCount) % 2 == 0 ? "MESH" : "CONVEX_HULL";
+		const float scale = (i / (meshCount * 2)) % 2 == 0 ? 1.0f : 2.0f;
+		object->scale = XMFLOAT3(scale, scale, scale);
+		object->translation = XMFLOAT3((float)(i % 20) * 100.0f, 0, (float)(i / 20) * 100.0f);
+		objects.push_back(object);
+	}
+
+	stringstream ss("");
+	ss << "Shape Cache Benchmark: " << objectCount << " objects, " << meshCount << " meshes with " << (gridSize - 1) * (gridSize - 1) * 2 << " triangles";
+	wiBackLog::post(ss.str().c_str());
+
+	auto registerAll = [&](wiBULLET& physics, const char* label) {
+		wiTimer timer;
+		for (Object* object : objects)
+		{
+			object->physicsObjectID = -1;
+			physics.registerObject(object);
+		}
+		const double time = timer.elapsed();
+		wiBULLET::ShapeCacheStats stats = physics.GetShapeCacheStats();
+
+		ss.str("");
+		ss << "\t" << label << ": " << time << " ms, " << stats.shapeCount << " shapes for " << stats.referenceCount << " bodies, "
+			<< stats.hits << " hits, " << stats.misses << " misses, " << stats.cooked << " cooked";
+		wiBackLog::post(ss.str().c_str());
+	};
+
+	{
+		wiBULLET physics;
+		registerAll(physics, "cold");
+		physics.SaveShapeCache(cacheFileName);
+	}
+	{
+		wiBULLET physics;
+		physics.LoadShapeCache(cacheFileName);
+		registerAll(physics, "from cooked data");
+	}
+
+	for (Object* object : objects)
+	{
+		object->mesh = nullptr;
+		delete object;
+	}
+	for (Mesh* mesh : meshes)
+	{
+		delete mesh;
+	}
+}
+
+// CPU-only benchmark: the vertex group passes of the soft body sample, compared with the std::map storage that the vertex groups used before
+static void RunVertexGroupBenchmark()
+{
+	const int iterations = 1000;
+
+	Model* model = wiRenderer::LoadModel("../models/SoftBody/flag.wimf");
+	Mesh* mesh = nullptr;
+	for (Object* object : model->objects)
+	{
+		if (object->mesh != nullptr && object->mesh->goalVG >= 0)
+		{
+			mesh = object->mesh;
+			break;
+		}
+	}
+	if (mesh == nullptr)
+	{
+		wiBackLog::post("Vertex Group Benchmark: the soft body sample has no goal vertex group!");
+		return;
+	}
+
+	const VertexGroup& group = mesh->vertexGroups[mesh->goalVG];
+	map<int, float> groupMap;
+	for (size_t i = 0; i < group.indices.size(); ++i)
+	{
+		groupMap.insert(make_pair(group.indices[i], group.weights[i]));
+	}
+	VertexGroup sparseGroup = group;
+	sparseGroup.denseWeights.clear();
+	VertexGroup denseGroup = group;
+	denseGroup.buildDenseWeights(mesh->vertices_FULL.size());
+
+	stringstream ss("");
+	ss << "Vertex Group Benchmark: " << mesh->vertices_FULL.size() << " vertices, " << mesh->indices.size() / 3 << " triangles, goal group of " << group.size() << " vertices, " << iterations << " iterations";
+	wiBackLog::post(ss.str().c_str());
+
+	// Soft body goal pass, like SynchronizeWithPhysicsEngine:
+	vector<XMFLOAT3> goalPositions(group.size());
+	wiTimer timer;
+	for (int iteration = 0; iteration < iterations; ++iteration)
+	{
+		size_t j = 0;
+		for (auto& x : groupMap)
+		{
+			Mesh::Vertex_FULL tvert = wiRenderer::TransformVertex(mesh, x.first);
+			goalPositions[j++] = XMFLOAT3(tvert.pos.x, tvert.pos.y, tvert.pos.z);
+		}
+	}
+	double time = timer.elapsed();
+	ss.str("");
+	ss << "\tgoal pass, std::map: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	timer.record();
+	for (int iteration = 0; iteration < iterations; ++iteration)
+	{
+		for (size_t j = 0; j < group.indices.size(); ++j)
+		{
+			Mesh::Vertex_FULL tvert = wiRenderer::TransformVertex(mesh, group.indices[j]);
+			goalPositions[j] = XMFLOAT3(tvert.pos.x, tvert.pos.y, tvert.pos.z);
+		}
+	}
+	time = timer.elapsed();
+	ss.str("");
+	ss << "\tgoal pass, sorted arrays: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	// Three lookups per triangle, like wiHairParticle::Generate:
+	float checksum[3] = {};
+	timer.record();
+	for (int iteration = 0; iteration < iterations; ++iteration)
+	{
+		for (size_t i = 0; i + 2 < mesh->indices.size(); i += 3)
+		{
+			for (int v = 0; v < 3; ++v)
+			{
+				auto found = groupMap.find((int)mesh->indices[i + v]);
+				checksum[0] += found != groupMap.end() ? found->second : 0;
+			}
+		}
+	}
+	time = timer.elapsed();
+	ss.str("");
+	ss << "\ttriangle lookups, std::map: " << time << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	const VertexGroup* lookupGroups[] = { &sparseGroup, &denseGroup };
+	const char* lookupNames[] = { "binary search", "dense weights" };
+	for (int g = 0; g < 2; ++g)
+	{
+		timer.record();
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			for (size_t i = 0; i + 2 < mesh->indices.size(); i += 3)
+			{
+				for (int v = 0; v < 3; ++v)
+				{
+					float weight;
+					checksum[g + 1] += lookupGroups[g]->findWeight((int)mesh->indices[i + v], weight) ? weight : 0;
+				}
+			}
+		}
+		time = timer.elapsed();
+		ss.str("");
+		ss << "\ttriangle lookups, " << lookupNames[g] << ": " << time << " ms";
+		wiBackLog::post(ss.str().c_str());
+	}
+
+	if (checksum[0] != checksum[1] || checksum[0] != checksum[2])
+	{
+		wiBackLog::post("\tthe lookups returned different weights!");
+	}
+}
 
 Tests::Tests()
 {
@@ -27,6 +1142,20 @@ void Tests::Initialize()
 
 	activateComponent(new TestsRenderer);
 }
+int Tests::RunHeadless()
+{
+	if (dynamic_cast<wiGraphicsTypes::GraphicsDevice_Null*>(wiRenderer::GetDevice()) == nullptr)
+	{
+		return 1;
+	}
+
+	const bool passed = RunFrameBenchmark(getActiveComponent());
+
+	ofstream file("headless_log.txt");
+	wiBackLog::save(file);
+
+	return passed ? 0 : 1;
+}
 
 
 TestsRenderer::TestsRenderer()
@@ -54,6 +1183,17 @@ TestsRenderer::TestsRenderer()
 	testSelector->AddItem("Lua Script");
 	testSelector->AddItem("Soft Body");
 	testSelector->AddItem("Emitter");
+	testSelector->AddItem("Culling Benchmark");
+	testSelector->AddItem("Job System Benchmark");
+	testSelector->AddItem("Normals Benchmark");
+	testSelector->AddItem("Archive Benchmark");
+	testSelector->AddItem("Animation Benchmark");
+	testSelector->AddItem("Transform Benchmark");
+	testSelector->AddItem("Lookup Benchmark");
+	testSelector->AddItem("Frame Benchmark");
+	testSelector->AddItem("Decal Atlas Benchmark");
+	testSelector->AddItem("Shape Cache Benchmark");
+	testSelector->AddItem("Vertex Group Benchmark");
 	testSelector->OnSelect([=](wiEventArgs args) {
 
 		wiRenderer::ClearWorld();
@@ -84,6 +1224,50 @@ TestsRenderer::TestsRenderer()
 		case 4:
 			wiRenderer::LoadModel("../models/Emitter/emitter.wimf")->Translate(XMFLOAT3(0, 2, 2));
 			break;
+		case 5:
+			RunCullingBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 6:
+			RunJobSystemBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 7:
+			RunNormalsBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 8:
+			RunArchiveBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 9:
+			RunAnimationBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 10:
+			RunTransformBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 11:
+			RunLookupBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 12:
+			RunFrameBenchmark(this);
+			wiBackLog::Toggle();
+			break;
+		case 13:
+			RunDecalAtlasBenchmark(this);
+			wiBackLog::Toggle();
+			break;
+		case 14:
+			RunShapeCacheBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 15:
+			RunVertexGroupBenchmark();
+			wiBackLog::Toggle();
+			break;
 		}
 
 	});
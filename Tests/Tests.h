@@ -8,6 +8,10 @@ public:
 	virtual ~Tests();
 
 	virtual void Initialize() override;
+
+	// Runs the frame benchmark on the null device without rendering to a window, and saves the backlog to headless_log.txt.
+	//	Returns the process exit code: 0 if the checks of the recorded counters passed, 1 otherwise
+	int RunHeadless();
 };
 
 
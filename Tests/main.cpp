@@ -34,6 +34,14 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 
 	wiStartupArguments::Parse(lpCmdLine); // if you wish to use command line arguments, here is a good place to parse them...
 
+	// Headless: no window is created, the frame benchmark runs on the null device and its checks give the exit code
+	if (wiStartupArguments::HasArgument("headless"))
+	{
+		wiRenderer::graphicsDevice = new wiGraphicsTypes::GraphicsDevice_Null();
+		tests.Initialize();
+		return tests.RunHeadless();
+	}
+
     // Initialize global strings
     LoadStringW(hInstance, IDS_APP_TITLE, szTitle, MAX_LOADSTRING);
     LoadStringW(hInstance, IDC_WICKEDENGINETESTS, szWindowClass, MAX_LOADSTRING);
@@ -7,6 +7,7 @@
 #include "wiSprite.h"
 #include "ResourceMapping.h"
 #include "wiProfiler.h"
+#include "wiJobSystem.h"
 
 using namespace wiGraphicsTypes;
 
@@ -85,15 +86,41 @@ void DeferredRenderableComponent::Render()
 {
 	if (getThreadingCount() > 1)
 	{
-		for (auto workerThread : workerThreads)
+		// Every command list is recorded by a separate job, the job system distributes them to the available threads:
+		wiJobSystem::context ctx;
+		wiJobSystem::Execute(ctx, [&](wiJobSystem::JobArgs args)
 		{
-			workerThread->wakeup();
-		}
-
-		for (auto workerThread : workerThreads)
+			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
+			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
+			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS);
+		});
+		wiJobSystem::Execute(ctx, [&](wiJobSystem::JobArgs args)
 		{
-			workerThread->wait();
-		}
+			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
+			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
+			RenderShadows(GRAPHICSTHREAD_SCENE);
+			RenderScene(GRAPHICSTHREAD_SCENE);
+			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
+		});
+		wiJobSystem::Execute(ctx, [&](wiJobSystem::JobArgs args)
+		{
+			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC1);
+			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC1);
+			wiRenderer::UpdateDepthBuffer(dtDepthCopy.GetTexture(), rtLinearDepth.GetTexture(), GRAPHICSTHREAD_MISC1);
+			wiRenderer::UpdateGBuffer(rtGBuffer.GetTexture(0), rtGBuffer.GetTexture(1), rtGBuffer.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC1);
+			RenderSecondaryScene(rtGBuffer, GetFinalRT(), GRAPHICSTHREAD_MISC1);
+			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC1);
+		});
+		wiJobSystem::Execute(ctx, [&](wiJobSystem::JobArgs args)
+		{
+			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC2);
+			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC2);
+			wiRenderer::UpdateDepthBuffer(dtDepthCopy.GetTexture(), rtLinearDepth.GetTexture(), GRAPHICSTHREAD_MISC2);
+			wiRenderer::UpdateGBuffer(rtGBuffer.GetTexture(0), rtGBuffer.GetTexture(1), rtGBuffer.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC2);
+			RenderComposition(GetFinalRT(), rtGBuffer, GRAPHICSTHREAD_MISC2);
+			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC2);
+		});
+		wiJobSystem::Wait(ctx);
 
 		wiRenderer::GetDevice()->ExecuteDeferredContexts();
 	}
@@ -294,97 +321,3 @@ wiDepthTarget* DeferredRenderableComponent::GetDepthBuffer()
 {
 	return rtGBuffer.depth;
 }
-
-void DeferredRenderableComponent::setPreferredThreadingCount(unsigned short value)
-{
-	Renderable3DComponent::setPreferredThreadingCount(value);
-
-	if (!wiRenderer::GetDevice()->CheckCapability(GraphicsDevice::GRAPHICSDEVICE_CAPABILITY_MULTITHREADED_RENDERING))
-	{
-		if (value > 1)
-			wiHelper::messageBox("Multithreaded rendering not supported by your hardware! Falling back to single threading!", "Caution");
-		return;
-	}
-
-	switch (value){
-	case 2:
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
-			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			RenderShadows(GRAPHICSTHREAD_SCENE);
-			RenderScene(GRAPHICSTHREAD_SCENE);
-			RenderSecondaryScene(rtGBuffer, GetFinalRT(), GRAPHICSTHREAD_SCENE);
-			RenderComposition(GetFinalRT(), rtGBuffer, GRAPHICSTHREAD_SCENE);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
-		}));
-		break;
-	case 3:
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
-			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS); 
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			RenderShadows(GRAPHICSTHREAD_SCENE);
-			RenderScene(GRAPHICSTHREAD_SCENE);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC1);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC1);
-			wiRenderer::UpdateDepthBuffer(dtDepthCopy.GetTexture(), rtLinearDepth.GetTexture(), GRAPHICSTHREAD_MISC1);
-			wiRenderer::UpdateGBuffer(rtGBuffer.GetTexture(0), rtGBuffer.GetTexture(1), rtGBuffer.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC1);
-			RenderSecondaryScene(rtGBuffer, GetFinalRT(), GRAPHICSTHREAD_MISC1);
-			RenderComposition(GetFinalRT(), rtGBuffer, GRAPHICSTHREAD_MISC1);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC1);
-		}));
-		break;
-	case 4:
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
-			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS); 
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			RenderShadows(GRAPHICSTHREAD_SCENE);
-			RenderScene(GRAPHICSTHREAD_SCENE);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE); 
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC1);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC1);
-			wiRenderer::UpdateDepthBuffer(dtDepthCopy.GetTexture(), rtLinearDepth.GetTexture(), GRAPHICSTHREAD_MISC1);
-			wiRenderer::UpdateGBuffer(rtGBuffer.GetTexture(0), rtGBuffer.GetTexture(1), rtGBuffer.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC1);
-			RenderSecondaryScene(rtGBuffer, GetFinalRT(), GRAPHICSTHREAD_MISC1);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC1); 
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC2);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC2);
-			wiRenderer::UpdateDepthBuffer(dtDepthCopy.GetTexture(), rtLinearDepth.GetTexture(), GRAPHICSTHREAD_MISC2);
-			wiRenderer::UpdateGBuffer(rtGBuffer.GetTexture(0), rtGBuffer.GetTexture(1), rtGBuffer.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC2);
-			RenderComposition(GetFinalRT(), rtGBuffer, GRAPHICSTHREAD_MISC2);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC2);
-		}));
-		break;
-	};
-}
-
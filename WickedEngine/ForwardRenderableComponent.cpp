@@ -4,6 +4,7 @@
 #include "wiImageEffects.h"
 #include "wiHelper.h"
 #include "wiProfiler.h"
+#include "wiJobSystem.h"
 #include "wiTextureHelper.h"
 
 using namespace wiGraphicsTypes;
@@ -70,16 +71,41 @@ void ForwardRenderableComponent::Render()
 {
 	if (getThreadingCount() > 1)
 	{
-
-		for (auto workerThread : workerThreads)
+		// Every command list is recorded by a separate job, the job system distributes them to the available threads:
+		wiJobSystem::context ctx;
+		wiJobSystem::Execute(ctx, [&](wiJobSystem::JobArgs args)
 		{
-			workerThread->wakeup();
-		}
-
-		for (auto workerThread : workerThreads)
+			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
+			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
+			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS);
+		});
+		wiJobSystem::Execute(ctx, [&](wiJobSystem::JobArgs args)
 		{
-			workerThread->wait();
-		}
+			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
+			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
+			RenderShadows(GRAPHICSTHREAD_SCENE);
+			RenderScene(GRAPHICSTHREAD_SCENE);
+			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
+		});
+		wiJobSystem::Execute(ctx, [&](wiJobSystem::JobArgs args)
+		{
+			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC1);
+			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC1);
+			wiRenderer::UpdateDepthBuffer(dtDepthCopy.GetTexture(), rtLinearDepth.GetTexture(), GRAPHICSTHREAD_MISC1);
+			wiRenderer::UpdateGBuffer(rtMain.GetTexture(0), rtMain.GetTexture(1), rtMain.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC1);
+			RenderSecondaryScene(rtMain, rtMain, GRAPHICSTHREAD_MISC1);
+			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC1);
+		});
+		wiJobSystem::Execute(ctx, [&](wiJobSystem::JobArgs args)
+		{
+			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC2);
+			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC2);
+			wiRenderer::UpdateDepthBuffer(dtDepthCopy.GetTexture(), rtLinearDepth.GetTexture(), GRAPHICSTHREAD_MISC2);
+			wiRenderer::UpdateGBuffer(rtMain.GetTexture(0), rtMain.GetTexture(1), rtMain.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC2);
+			RenderComposition(rtMain, rtMain, GRAPHICSTHREAD_MISC2);
+			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC2);
+		});
+		wiJobSystem::Wait(ctx);
 
 		wiRenderer::GetDevice()->ExecuteDeferredContexts();
 	}
@@ -190,98 +216,3 @@ wiDepthTarget* ForwardRenderableComponent::GetDepthBuffer()
 {
 	return rtMain.depth;
 }
-
-void ForwardRenderableComponent::setPreferredThreadingCount(unsigned short value)
-{
-	Renderable3DComponent::setPreferredThreadingCount(value);
-
-	if (!wiRenderer::GetDevice()->CheckCapability(GraphicsDevice::GRAPHICSDEVICE_CAPABILITY_MULTITHREADED_RENDERING))
-	{
-		if (value > 1)
-			wiHelper::messageBox("Multithreaded rendering not supported by your hardware! Falling back to single threading!", "Caution");
-		return;
-	}
-
-
-	switch (value) {
-	case 2:
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
-			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			RenderShadows(GRAPHICSTHREAD_SCENE);
-			RenderScene(GRAPHICSTHREAD_SCENE);
-			RenderSecondaryScene(rtMain, rtMain, GRAPHICSTHREAD_SCENE);
-			RenderComposition(rtMain, rtMain, GRAPHICSTHREAD_SCENE);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
-		}));
-		break;
-	case 3:
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
-			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			RenderShadows(GRAPHICSTHREAD_SCENE);
-			RenderScene(GRAPHICSTHREAD_SCENE);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC1);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC1);
-			wiRenderer::UpdateDepthBuffer(dtDepthCopy.GetTexture(), rtLinearDepth.GetTexture(), GRAPHICSTHREAD_MISC1);
-			wiRenderer::UpdateGBuffer(rtMain.GetTexture(0), rtMain.GetTexture(1), rtMain.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC1);
-			RenderSecondaryScene(rtMain, rtMain, GRAPHICSTHREAD_MISC1);
-			RenderComposition(rtMain, rtMain, GRAPHICSTHREAD_MISC1);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC1);
-		}));
-		break;
-	case 4:
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
-			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
-			RenderShadows(GRAPHICSTHREAD_SCENE);
-			RenderScene(GRAPHICSTHREAD_SCENE);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC1);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC1);
-			wiRenderer::UpdateDepthBuffer(dtDepthCopy.GetTexture(), rtLinearDepth.GetTexture(), GRAPHICSTHREAD_MISC1);
-			wiRenderer::UpdateGBuffer(rtMain.GetTexture(0), rtMain.GetTexture(1), rtMain.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC1);
-			RenderSecondaryScene(rtMain, rtMain, GRAPHICSTHREAD_MISC1);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC1);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
-		{
-			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC2);
-			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC2);
-			wiRenderer::UpdateDepthBuffer(dtDepthCopy.GetTexture(), rtLinearDepth.GetTexture(), GRAPHICSTHREAD_MISC2);
-			wiRenderer::UpdateGBuffer(rtMain.GetTexture(0), rtMain.GetTexture(1), rtMain.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC2);
-			RenderComposition(rtMain, rtMain, GRAPHICSTHREAD_MISC2);
-			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC2);
-		}));
-		break;
-	};
-
-}
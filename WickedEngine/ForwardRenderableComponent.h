@@ -18,9 +18,6 @@ public:
 
 	virtual wiDepthTarget* GetDepthBuffer() override;
 
-
-	virtual void setPreferredThreadingCount(unsigned short value) override;
-
 	virtual void Initialize() override;
 	virtual void Load() override;
 	virtual void Start() override;
@@ -18,6 +18,7 @@
 #include "wiGraphicsDevice_DX11.h"
 #include "wiGraphicsDevice_DX12.h"
 #include "wiGraphicsDevice_Vulkan.h"
+#include "wiGraphicsDevice_Null.h"
 
 
 using namespace std;
@@ -73,6 +74,11 @@ void MainComponent::Initialize()
 			wiHelper::messageBox("Vulkan SDK not found during building the application! Vulkan API disabled!", "Error");
 #endif
 		}
+		else if (wiStartupArguments::HasArgument("nulldevice"))
+		{
+			// Headless: nothing is rendered, only the CPU side of the rendering is executed
+			wiRenderer::graphicsDevice = new GraphicsDevice_Null();
+		}
 		else if (wiStartupArguments::HasArgument("dx12"))
 		{
 			if (wiStartupArguments::HasArgument("hlsl6"))
@@ -89,6 +95,9 @@ void MainComponent::Initialize()
 	}
 
 
+	// The frames are run by the thread that initializes the main component, this names its track in the profiler traces:
+	wiProfiler::GetInstance().SetThreadName("Main Thread");
+
 	wiInitializer::InitializeComponents();
 
 	wiLua::GetGlobal()->RegisterObject(MainComponent_BindLua::className, "main", new MainComponent_BindLua(this));
@@ -225,6 +234,10 @@ void MainComponent::Compose()
 		wiImage::Draw(wiTextureHelper::getInstance()->getColor(fadeManager.color), fx, GRAPHICSTHREAD_IMMEDIATE);
 	}
 
+	// The information display and the profiler texts and images are submitted together:
+	wiImage::BatchBegin(GRAPHICSTHREAD_IMMEDIATE);
+	wiFont::BatchBegin(GRAPHICSTHREAD_IMMEDIATE);
+
 	// Draw the information display
 	if (infoDisplay.active)
 	{
@@ -247,6 +260,10 @@ void MainComponent::Compose()
 				ss << "[Vulkan]";
 			}
 #endif
+			else if (dynamic_cast<GraphicsDevice_Null*>(wiRenderer::GetDevice()))
+			{
+				ss << "[Null]";
+			}
 
 #ifdef _DEBUG
 			ss << "[DEBUG]";
@@ -282,6 +299,9 @@ void MainComponent::Compose()
 
 	wiProfiler::GetInstance().DrawData(4, 120, GRAPHICSTHREAD_IMMEDIATE);
 
+	wiFont::BatchEnd(GRAPHICSTHREAD_IMMEDIATE);
+	wiImage::BatchEnd(GRAPHICSTHREAD_IMMEDIATE);
+
 	// Draw the color grading palette
 	if (colorGradingPaletteDisplayEnabled)
 	{
@@ -324,6 +324,19 @@ int SetProfilerEnabled(lua_State* L)
 
 	return 0;
 }
+int ExportProfilerTrace(lua_State* L)
+{
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		wiLua::SSetBool(L, wiProfiler::GetInstance().ExportChromeTrace(wiLua::SGetString(L, 1)));
+		return 1;
+	}
+	else
+		wiLua::SError(L, "ExportProfilerTrace(string fileName) not enough arguments!");
+
+	return 0;
+}
 
 void MainComponent_BindLua::Bind()
 {
@@ -334,5 +347,6 @@ void MainComponent_BindLua::Bind()
 		Luna<MainComponent_BindLua>::Register(wiLua::GetGlobal()->GetLuaState()); 
 		
 		wiLua::GetGlobal()->RegisterFunc("SetProfilerEnabled", SetProfilerEnabled);
+		wiLua::GetGlobal()->RegisterFunc("ExportProfilerTrace", ExportProfilerTrace);
 	}
 }
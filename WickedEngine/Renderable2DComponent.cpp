@@ -110,6 +110,8 @@ void Renderable2DComponent::Render()
 	rtFinal.Activate(GRAPHICSTHREAD_IMMEDIATE, 0.0f, 0.0f, 0.0f, 0.0f);
 
 	wiRenderer::GetDevice()->EventBegin("Sprite Layers", GRAPHICSTHREAD_IMMEDIATE);
+	wiImage::BatchBegin(GRAPHICSTHREAD_IMMEDIATE);
+	wiFont::BatchBegin(GRAPHICSTHREAD_IMMEDIATE);
 	for (auto& x : layers)
 	{
 		for (auto& y : x.entities)
@@ -124,6 +126,8 @@ void Renderable2DComponent::Render()
 			}
 		}
 	}
+	wiFont::BatchEnd(GRAPHICSTHREAD_IMMEDIATE);
+	wiImage::BatchEnd(GRAPHICSTHREAD_IMMEDIATE);
 	wiRenderer::GetDevice()->EventEnd(GRAPHICSTHREAD_IMMEDIATE);
 
 	GetGUI().Render();
@@ -15,10 +15,6 @@ Renderable3DComponent::Renderable3DComponent() : Renderable2DComponent()
 }
 Renderable3DComponent::~Renderable3DComponent()
 {
-	for (auto& wt : workerThreads)
-	{
-		delete wt;
-	}
 }
 
 wiRenderTarget
@@ -711,10 +707,11 @@ void Renderable3DComponent::RenderColorGradedComposition()
 
 void Renderable3DComponent::setPreferredThreadingCount(unsigned short value)
 {
-	for (auto& wt : workerThreads)
+	threadingCount = value;
+
+	if (value > 1 && !wiRenderer::GetDevice()->CheckCapability(GraphicsDevice::GRAPHICSDEVICE_CAPABILITY_MULTITHREADED_RENDERING))
 	{
-		delete wt;
+		wiHelper::messageBox("Multithreaded rendering not supported by your hardware! Falling back to single threading!", "Caution");
+		threadingCount = 1;
 	}
-
-	workerThreads.clear();
 }
\ No newline at end of file
@@ -1,6 +1,5 @@
 #pragma once
 #include "Renderable2DComponent.h"
-#include "wiTaskThread.h"
 #include "wiRenderer.h"
 #include "wiWaterPlane.h"
 #include "wiGraphicsDevice.h"
@@ -67,7 +66,7 @@ protected:
 
 	virtual void ResizeBuffers() override;
 
-	std::vector<wiTaskThread*> workerThreads;
+	unsigned short threadingCount = 0;
 
 	virtual void RenderFrameSetUp(GRAPHICSTHREAD threadID);
 	virtual void RenderReflections(GRAPHICSTHREAD threadID);
@@ -116,7 +115,7 @@ public:
 
 	inline UINT getMSAASampleCount() { return msaaSampleCount; }
 
-	inline unsigned int getThreadingCount(){ return (unsigned int)workerThreads.size(); }
+	inline unsigned int getThreadingCount(){ return threadingCount; }
 
 	inline void setLightShaftQuality(float value){ lightShaftQuality = value; }
 	inline void setBloomDownSample(float value){ bloomDownSample = value; }
@@ -27,6 +27,7 @@
 #include "wiXInput.h"
 #include "wiRawInput.h"
 #include "wiTaskThread.h"
+#include "wiJobSystem.h"
 #include "wiMath.h"
 #include "wiLensFlare.h"
 #include "wiSound.h"
@@ -55,6 +56,7 @@
 #include "wiArchive.h"
 #include "wiSpinLock.h"
 #include "wiRectPacker.h"
+#include "wiAtlasAllocator.h"
 #include "wiProfiler.h"
 #include "wiOcean.h"
 #include "wiStartupArguments.h"
@@ -72,6 +74,7 @@
 #include "wiGraphicsDevice_DX11.h"
 #include "wiGraphicsDevice_DX12.h"
 #include "wiGraphicsDevice_Vulkan.h"
+#include "wiGraphicsDevice_Null.h"
 
 #ifdef _WIN32
 
@@ -4,9 +4,10 @@ struct VertextoPixel
 {
 	float4 pos				: SV_POSITION;
 	float2 tex				: TEXCOORD0;
+	float4 color			: COLOR;
 };
 
 float4 main(VertextoPixel PSIn) : SV_TARGET
 {
-	return texture_1.Sample(sampler_linear_clamp, PSIn.tex) * g_xColor;
-}
\ No newline at end of file
+	return texture_1.Sample(sampler_linear_clamp, PSIn.tex) * PSIn.color;
+}
@@ -4,9 +4,10 @@ struct VertextoPixel
 {
 	float4 pos				: SV_POSITION;
 	float2 tex				: TEXCOORD0;
+	float4 color			: COLOR;
 };
 
-VertextoPixel main(float2 inPos : POSITION, float2 inTex : TEXCOORD0)
+VertextoPixel main(float2 inPos : POSITION, float2 inTex : TEXCOORD0, float4 inColor : COLOR)
 {
 	VertextoPixel Out = (VertextoPixel)0;
 
@@ -14,5 +15,7 @@ VertextoPixel main(float2 inPos : POSITION, float2 inTex : TEXCOORD0)
 	
 	Out.tex=inTex;
 
+	Out.color = inColor * g_xColor;
+
 	return Out;
 }
@@ -14,6 +14,8 @@ struct VertextoPixel
 	float4 pos				: SV_POSITION;
 	float2 tex				: TEXCOORD0;
 	float4 pos2D			: TEXCOORD1;
+	nointerpolation float4 color	: COLOR;
+	nointerpolation float mip		: TEXCOORD2;
 };
 struct VertexToPixelPostProcess
 {
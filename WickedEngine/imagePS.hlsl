@@ -2,7 +2,7 @@
 
 float4 main(VertextoPixel PSIn) : SV_TARGET
 {
-	float4 color = xTexture.SampleLevel(Sampler, PSIn.tex.xy, xMipLevel) * xColor;
+	float4 color = xTexture.SampleLevel(Sampler, PSIn.tex.xy, PSIn.mip) * PSIn.color;
 
 	return color;
 }
\ No newline at end of file
@@ -6,7 +6,7 @@ float4 main(VertextoPixel PSIn) : SV_TARGET
 	float2 distort = xDistortionTex.SampleLevel(Sampler, PSIn.tex.xy, 0).rg * 2 - 1;
 	PSIn.tex.xy = distortionCo + distort;
 
-	float4 color = xTexture.SampleLevel(Sampler, PSIn.tex.xy, xMipLevel) * xColor;
+	float4 color = xTexture.SampleLevel(Sampler, PSIn.tex.xy, PSIn.mip) * PSIn.color;
 
 	return color;
 }
\ No newline at end of file
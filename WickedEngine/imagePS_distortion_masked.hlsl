@@ -6,9 +6,9 @@ float4 main(VertextoPixel PSIn) : SV_TARGET
 	float2 distort = xDistortionTex.SampleLevel(Sampler, PSIn.tex.xy, 0).rg * 2 - 1;
 	PSIn.tex.xy = distortionCo + distort;
 
-	float4 color = xTexture.SampleLevel(Sampler, PSIn.tex.xy, xMipLevel) * xColor;
+	float4 color = xTexture.SampleLevel(Sampler, PSIn.tex.xy, PSIn.mip) * PSIn.color;
 
-	color *= xMaskTex.SampleLevel(Sampler, PSIn.tex.xy, xMipLevel).a;
+	color *= xMaskTex.SampleLevel(Sampler, PSIn.tex.xy, PSIn.mip).a;
 
 	return color;
 }
\ No newline at end of file
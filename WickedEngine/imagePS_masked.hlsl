@@ -2,9 +2,9 @@
 
 float4 main(VertextoPixel PSIn) : SV_TARGET
 {
-	float4 color = xTexture.SampleLevel(Sampler, PSIn.tex.xy, xMipLevel) * xColor;
+	float4 color = xTexture.SampleLevel(Sampler, PSIn.tex.xy, PSIn.mip) * PSIn.color;
 	
-	color *= xMaskTex.SampleLevel(Sampler, PSIn.tex.xy, xMipLevel).a;
+	color *= xMaskTex.SampleLevel(Sampler, PSIn.tex.xy, PSIn.mip).a;
 
 	return color;
 }
\ No newline at end of file
@@ -2,11 +2,11 @@
 
 float4 main(VertextoPixel PSIn) : SV_TARGET
 {
-	float4 color = xTexture.SampleLevel(Sampler, PSIn.tex.xy, xMipLevel);
+	float4 color = xTexture.SampleLevel(Sampler, PSIn.tex.xy, PSIn.mip);
 
 	color = 2 * color - 1;
 
-	color *= xColor;
+	color *= PSIn.color;
 
 	return color;
 }
\ No newline at end of file
@@ -20,6 +20,9 @@ VertextoPixel main(uint vI : SV_VERTEXID)
 
 	Out.pos2D = Out.pos;
 
+	Out.color = xColor;
+	Out.mip = xMipLevel;
+
 	return Out;
 }
 
@@ -0,0 +1,37 @@
+#include "globals.hlsli"
+#include "imageHF.hlsli"
+
+// Per-instance data of the batched images (wiImage::ImageInstance)
+struct ImageInstance
+{
+	float4 mat0			: TRANSFORM0;
+	float4 mat1			: TRANSFORM1;
+	float4 mat2			: TRANSFORM2;
+	float4 mat3			: TRANSFORM3;
+	float4 texMulAdd	: TEXMULADD;
+	float4 color		: COLOR;
+	float4 pivot_mip	: PIVOTMIP;
+};
+
+VertextoPixel main(uint vI : SV_VERTEXID, ImageInstance instance)
+{
+	VertextoPixel Out = (VertextoPixel)0;
+
+	// Same trianglestrip as imageVS, but every property comes from the instance:
+	float2 inTex = float2(vI % 2, vI % 4 / 2);
+
+	float4 inPos = float4(inTex - instance.pivot_mip.xy, 0, 1);
+
+	float4x4 transform = float4x4(instance.mat0, instance.mat1, instance.mat2, instance.mat3);
+
+	Out.pos = mul(inPos, transform);
+
+	Out.tex.xy = inTex * instance.texMulAdd.xy + instance.texMulAdd.zw;
+
+	Out.pos2D = Out.pos;
+
+	Out.color = instance.color;
+	Out.mip = instance.pivot_mip.z;
+
+	return Out;
+}
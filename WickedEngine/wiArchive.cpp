@@ -13,24 +13,18 @@ uint64_t __archiveVersionBarrier = 1;
 
 // version history is logged in ArchiveVersionHistory.txt file!
 
-wiArchive::wiArchive()
+wiArchive::wiArchive() :DATA(nullptr), readData(nullptr), fileHandle(nullptr), fileMapping(nullptr), fileView(nullptr)
 {
 	CreateEmpty();
 }
-wiArchive::wiArchive(const std::string& fileName, bool readMode):readMode(readMode),pos(0),DATA(nullptr),dataSize(0),fileName(fileName)
+wiArchive::wiArchive(const std::string& fileName, bool readMode):readMode(readMode),pos(0),DATA(nullptr),dataSize(0),readData(nullptr),fileName(fileName),fileHandle(nullptr),fileMapping(nullptr),fileView(nullptr)
 {
 	if (!fileName.empty())
 	{
 		if (readMode)
 		{
-			ifstream file(fileName, ios::binary | ios::ate);
-			if (file.is_open())
+			if (MapFile())
 			{
-				dataSize = (size_t)file.tellg();
-				file.seekg(0, file.beg);
-				DATA = new char[(size_t)dataSize];
-				file.read(DATA, dataSize);
-				file.close();
 				(*this) >> version;
 				if (version < __archiveVersionBarrier)
 				{
@@ -51,7 +45,16 @@ wiArchive::wiArchive(const std::string& fileName, bool readMode):readMode(readMo
 		}
 		else
 		{
-			CreateEmpty();
+			stream.open(fileName, ios::binary | ios::trunc);
+			if (stream.is_open())
+			{
+				readMode = false;
+				pos = 0;
+				version = __archiveVersion;
+				dataSize = STREAM_CHUNK_SIZE;
+				DATA = new char[dataSize];
+				(*this) << version;
+			}
 		}
 	}
 }
@@ -73,39 +76,152 @@ void wiArchive::CreateEmpty()
 	(*this) << version;
 }
 
+bool wiArchive::MapFile()
+{
+#ifndef WINSTORE_SUPPORT
+	// The file is mapped into memory instead of being copied, reads come directly from the (OS cached) file pages:
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	fileMapping = mapping;
+	fileView = view;
+	readData = reinterpret_cast<const char*>(view);
+	dataSize = (size_t)size.QuadPart;
+	return true;
+#else
+	// File mapping is not available for store apps, read the whole file instead:
+	ifstream file(fileName, ios::binary | ios::ate);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	dataSize = (size_t)file.tellg();
+	file.seekg(0, file.beg);
+	DATA = new char[dataSize];
+	file.read(DATA, dataSize);
+	file.close();
+	readData = DATA;
+	return true;
+#endif // WINSTORE_SUPPORT
+}
+
+void wiArchive::WriteOverflow(const char* src, size_t size)
+{
+	if (stream.is_open())
+	{
+		// Fill and flush chunks until the rest of the data fits:
+		while (pos + size > dataSize)
+		{
+			const size_t fill = dataSize - pos;
+			memcpy(DATA + pos, src, fill);
+			stream.write(DATA, (streamsize)dataSize);
+			src += fill;
+			size -= fill;
+			pos = 0;
+		}
+		memcpy(DATA + pos, src, size);
+		pos += size;
+	}
+	else
+	{
+		// In-memory archive, it must stay contiguous:
+		size_t _right = pos + size;
+		char* NEWDATA = new char[_right * 2];
+		if (DATA != nullptr)
+		{
+			memcpy(NEWDATA, DATA, pos);
+		}
+		dataSize = _right * 2;
+		SAFE_DELETE_ARRAY(DATA);
+		DATA = NEWDATA;
+		memcpy(DATA + pos, src, size);
+		pos = _right;
+	}
+}
+
 void wiArchive::SetReadModeAndResetPos(bool isReadMode)
 {
+	assert(!stream.is_open() && "Archive that is streamed to a file can not be rewound!");
+
 	readMode = isReadMode; 
 	pos = 0;
 
 	if (readMode)
 	{
+		if (DATA != nullptr)
+		{
+			readData = DATA;
+		}
 		(*this) >> version;
 	}
 	else
 	{
+		if (DATA == nullptr)
+		{
+			dataSize = 0;
+		}
 		(*this) << version;
 	}
 }
 
 bool wiArchive::IsOpen()
 {
-	// when it is open, DATA is not null because it contains the version number at least!
-	return DATA != nullptr;
+	// when it is open, DATA or the mapping is not null because it contains the version number at least!
+	return DATA != nullptr || readData != nullptr;
 }
 
 void wiArchive::Close()
 {
-	if (!readMode && !fileName.empty())
+	if (stream.is_open())
+	{
+		stream.write(DATA, (streamsize)pos);
+		stream.close();
+	}
+	else if (!readMode && !fileName.empty())
 	{
 		SaveFile(fileName);
 	}
 	SAFE_DELETE_ARRAY(DATA);
+
+#ifndef WINSTORE_SUPPORT
+	if (fileMapping != nullptr)
+	{
+		UnmapViewOfFile(fileView);
+		CloseHandle((HANDLE)fileMapping);
+		CloseHandle((HANDLE)fileHandle);
+		fileView = nullptr;
+		fileMapping = nullptr;
+		fileHandle = nullptr;
+	}
+#endif // WINSTORE_SUPPORT
+	readData = nullptr;
 }
 
 bool wiArchive::SaveFile(const std::string& fileName)
 {
-	if (pos <= 0)
+	if (pos <= 0 || stream.is_open())
 	{
 		return false;
 	}
@@ -3,6 +3,8 @@
 #include <stdint.h>
 
 #include <string>
+#include <vector>
+#include <fstream>
 
 class wiArchive
 {
@@ -10,12 +12,25 @@ private:
 	uint64_t version;
 	bool readMode;
 	size_t pos;
-	char* DATA;
+	char* DATA; // memory owned by the archive: the write buffer, or the read buffer of an in-memory archive
 	size_t dataSize;
+	const char* readData; // read operations use this, which is either DATA or the memory mapped file
 
 	std::string fileName; // save to this file on closing if not empty
 
+	// Memory mapped file for read mode:
+	void* fileHandle;
+	void* fileMapping;
+	const void* fileView;
+
+	// Archives that are opened for writing to a file stream the data to disk in fixed-size chunks, DATA is the current chunk:
+	static const size_t STREAM_CHUNK_SIZE = 4 * 1024 * 1024;
+	std::ofstream stream;
+
 	void CreateEmpty();
+	bool MapFile();
+	// Write data that doesn't fit into the current buffer: grow the in-memory buffer or flush the chunk to the stream
+	void WriteOverflow(const char* src, size_t size);
 
 public:
 	// Create empty arhive for writing
@@ -29,6 +44,8 @@ public:
 	void SetReadModeAndResetPos(bool isReadMode);
 	bool IsOpen();
 	void Close();
+	// Bytes that are left to read in read mode
+	size_t GetRemainingSize() const { return readData != nullptr && pos < dataSize ? dataSize - pos : 0; }
 	bool SaveFile(const std::string& fileName);
 	std::string GetSourceDirectory();
 	std::string GetSourceFileName();
@@ -120,6 +137,16 @@ public:
 		_write(*data.c_str(), len);
 		return *this;
 	}
+	wiArchive& operator<<(const std::vector<uint8_t>& data)
+	{
+		uint64_t len = (uint64_t)data.size();
+		_write(len);
+		if (len > 0)
+		{
+			_write(data[0], len);
+		}
+		return *this;
+	}
 
 	// Read operations
 	wiArchive& operator >> (bool& data)
@@ -215,11 +242,28 @@ public:
 	{
 		uint64_t len;
 		_read(len);
-		char* str = new char[(size_t)len];
-		memset(str, '\0', (size_t)(sizeof(char)*len));
-		_read(*str, len);
-		data = std::string(str);
-		delete[] str;
+		// Read directly from the archive memory, without a temporary buffer:
+		const char* str = readData + pos;
+		data.assign(str, strnlen(str, (size_t)len));
+		pos += (size_t)len;
+		return *this;
+	}
+	wiArchive& operator >> (std::vector<uint8_t>& data)
+	{
+		uint64_t len;
+		_read(len);
+		if (len > GetRemainingSize())
+		{
+			// corrupted length, don't allocate or read past the end, the archive is consumed:
+			data.clear();
+			pos = dataSize;
+			return *this;
+		}
+		data.resize((size_t)len);
+		if (len > 0)
+		{
+			_read(data[0], len);
+		}
 		return *this;
 	}
 
@@ -236,24 +280,20 @@ private:
 	void _write(const T& data, uint64_t count = 1)
 	{
 		size_t _size = (size_t)(sizeof(data)*count);
-		size_t _right = pos + _size;
-		if (_right > dataSize)
+		if (pos + _size > dataSize)
 		{
-			char* NEWDATA = new char[_right * 2];
-			memcpy(NEWDATA, DATA, dataSize);
-			dataSize = _right * 2;
-			SAFE_DELETE_ARRAY(DATA);
-			DATA = NEWDATA;
+			WriteOverflow(reinterpret_cast<const char*>(&data), _size);
+			return;
 		}
-		memcpy(reinterpret_cast<void*>((uint64_t)DATA + (uint64_t)pos), &data, _size);
-		pos = _right;
+		memcpy(DATA + pos, &data, _size);
+		pos += _size;
 	}
 
 	// Read data using memory operations
 	template<typename T>
 	void _read(T& data, uint64_t count = 1)
 	{
-		memcpy(&data, reinterpret_cast<void*>((uint64_t)DATA + (uint64_t)pos), (size_t)(sizeof(data)*count));
+		memcpy(&data, readData + pos, (size_t)(sizeof(data)*count));
 		pos += (size_t)(sizeof(data)*count);
 	}
 };
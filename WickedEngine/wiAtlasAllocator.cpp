@@ -0,0 +1,167 @@
+#include "wiAtlasAllocator.h"
+
+using namespace std;
+
+wiAtlasAllocator::wiAtlasAllocator(int width, int height)
+{
+	Reset(width, height);
+}
+
+void wiAtlasAllocator::Reset(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	usedArea = 0;
+	freeRects.clear();
+	if (width > 0 && height > 0)
+	{
+		Rect rect;
+		rect.w = width;
+		rect.h = height;
+		freeRects.push_back(rect);
+	}
+}
+
+void wiAtlasAllocator::Grow(int newWidth, int newHeight)
+{
+	assert(newWidth >= width && newHeight >= height);
+
+	Rect right;
+	right.x = width;
+	right.w = newWidth - width;
+	right.h = height;
+
+	Rect bottom;
+	bottom.y = height;
+	bottom.w = newWidth;
+	bottom.h = newHeight - height;
+
+	width = newWidth;
+	height = newHeight;
+
+	if (right.area() > 0)
+	{
+		InsertFreeRect(right);
+	}
+	if (bottom.area() > 0)
+	{
+		InsertFreeRect(bottom);
+	}
+}
+
+bool wiAtlasAllocator::Allocate(int w, int h, Rect& result)
+{
+	if (w <= 0 || h <= 0)
+	{
+		return false;
+	}
+
+	// Best area fit, ties are broken by the shorter leftover side:
+	int best = -1;
+	int bestArea = INT_MAX;
+	int bestSide = INT_MAX;
+	for (int i = 0; i < (int)freeRects.size(); ++i)
+	{
+		const Rect& rect = freeRects[i];
+		if (rect.w < w || rect.h < h)
+		{
+			continue;
+		}
+		const int leftoverArea = rect.area() - w * h;
+		const int leftoverSide = min(rect.w - w, rect.h - h);
+		if (leftoverArea < bestArea || (leftoverArea == bestArea && leftoverSide < bestSide))
+		{
+			best = i;
+			bestArea = leftoverArea;
+			bestSide = leftoverSide;
+		}
+	}
+	if (best < 0)
+	{
+		return false;
+	}
+
+	const Rect rect = freeRects[best];
+	freeRects[best] = freeRects.back();
+	freeRects.pop_back();
+
+	result.x = rect.x;
+	result.y = rect.y;
+	result.w = w;
+	result.h = h;
+	usedArea += result.area();
+
+	// Guillotine split along the shorter leftover axis, so that the larger remainder stays in one piece:
+	Rect right, bottom;
+	right.x = rect.x + w;
+	right.y = rect.y;
+	right.w = rect.w - w;
+	bottom.x = rect.x;
+	bottom.y = rect.y + h;
+	bottom.h = rect.h - h;
+	if (right.w < bottom.h)
+	{
+		right.h = h;
+		bottom.w = rect.w;
+	}
+	else
+	{
+		right.h = rect.h;
+		bottom.w = w;
+	}
+	if (right.area() > 0)
+	{
+		freeRects.push_back(right);
+	}
+	if (bottom.area() > 0)
+	{
+		freeRects.push_back(bottom);
+	}
+
+	return true;
+}
+
+void wiAtlasAllocator::Free(const Rect& rect)
+{
+	usedArea -= rect.area();
+	assert(usedArea >= 0);
+	if (usedArea == 0)
+	{
+		// nothing is allocated, the free list can start over as one piece:
+		Reset(width, height);
+		return;
+	}
+	InsertFreeRect(rect);
+}
+
+void wiAtlasAllocator::InsertFreeRect(Rect rect)
+{
+	bool merged = true;
+	while (merged)
+	{
+		merged = false;
+		for (size_t i = 0; i < freeRects.size(); ++i)
+		{
+			const Rect& other = freeRects[i];
+			if (other.y == rect.y && other.h == rect.h && (other.x + other.w == rect.x || rect.x + rect.w == other.x))
+			{
+				rect.x = min(rect.x, other.x);
+				rect.w += other.w;
+				merged = true;
+			}
+			else if (other.x == rect.x && other.w == rect.w && (other.y + other.h == rect.y || rect.y + rect.h == other.y))
+			{
+				rect.y = min(rect.y, other.y);
+				rect.h += other.h;
+				merged = true;
+			}
+			if (merged)
+			{
+				freeRects[i] = freeRects.back();
+				freeRects.pop_back();
+				break;
+			}
+		}
+	}
+	freeRects.push_back(rect);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <vector>
+
+// Persistent rectangle allocator for texture atlases (guillotine packing with a free list).
+//	Unlike wiRectPacker, rectangles can be inserted and removed one by one without moving the other ones.
+class wiAtlasAllocator
+{
+public:
+	struct Rect
+	{
+		int x = 0, y = 0, w = 0, h = 0;
+
+		int area() const { return w * h; }
+	};
+
+private:
+	int width = 0, height = 0;
+	int usedArea = 0;
+	std::vector<Rect> freeRects;
+
+	// Add to the free list, merged with the free neighbours that share a whole edge with it
+	void InsertFreeRect(Rect rect);
+public:
+	wiAtlasAllocator(int width = 0, int height = 0);
+
+	// Forget every allocation and start over with the given size
+	void Reset(int width, int height);
+	// Enlarge the atlas, the existing allocations keep their places
+	void Grow(int newWidth, int newHeight);
+
+	// Find room for a w*h rectangle (best area fit). Returns false if no free rectangle is large enough.
+	bool Allocate(int w, int h, Rect& result);
+	// Give back a rectangle that was returned by Allocate, it is merged with its free neighbours where possible
+	void Free(const Rect& rect);
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	int GetUsedArea() const { return usedArea; }
+	int GetFreeArea() const { return width * height - usedArea; }
+	size_t GetFreeRectCount() const { return freeRects.size(); }
+};
+
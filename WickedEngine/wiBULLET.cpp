@@ -1,9 +1,11 @@
 #include "wiBULLET.h"
 #include "wiLoader.h"
+#include "wiArchive.h"
 
 
 
 #include "LinearMath/btHashMap.h"
+#include "LinearMath/btConvexHullComputer.h"
 #include "BulletSoftBody/btSoftRigidDynamicsWorld.h"
 #include "BulletSoftBody/btSoftBodyHelpers.h"
 
@@ -68,6 +70,9 @@ wiBULLET::wiBULLET()
 
 wiBULLET::~wiBULLET()
 {
+	// the simulation thread must not step the world while it is destroyed
+	StopThread();
+
 	//cleanup in the reverse order of creation/initialization
 	
 	///-----cleanup_start-----
@@ -327,52 +332,7 @@ void wiBULLET::addConvexHull(const std::vector<XMFLOAT4>& vertices, const XMFLOA
 
 	collisionShapes.push_back(shape);
 
-	btTransform shapeTransform;
-	shapeTransform.setIdentity();
-	shapeTransform.setOrigin(btVector3(pos.x,pos.y,pos.z));
-	shapeTransform.setRotation(btQuaternion(rot.x,rot.y,rot.z,rot.w));
-	{
-		btScalar mass(newMass);
-
-		//rigidbody is dynamic if and only if mass is non zero, otherwise static
-		bool isDynamic = (mass != 0.f && !kinematic);
-
-		btVector3 localInertia(0,0,0);
-		if (isDynamic)
-			shape->calculateLocalInertia(mass,localInertia);
-		else
-			mass=0;
-
-		//using motionstate is recommended, it provides interpolation capabilities, and only synchronizes 'active' objects
-		btDefaultMotionState* myMotionState = new btDefaultMotionState(shapeTransform);
-		btRigidBody::btRigidBodyConstructionInfo rbInfo(mass,myMotionState,shape,localInertia);
-		rbInfo.m_friction=newFriction;
-		rbInfo.m_restitution=newRestitution;
-		rbInfo.m_linearDamping = newDamping;
-		rbInfo.m_angularDamping = newDamping;
-		btRigidBody* body = new btRigidBody(rbInfo);
-		if(kinematic) {
-			body->setCollisionFlags( body->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
-		}
-		body->setActivationState(DISABLE_DEACTIVATION);
-
-		//add the body to the dynamics world
-		dynamicsWorld->addRigidBody(body);
-
-		
-		if (body->getMotionState())
-		{
-			btTransform trans;
-			body->getMotionState()->getWorldTransform(trans);
-			btQuaternion nRot = trans.getRotation();
-			btVector3 nPos = trans.getOrigin();
-			transforms.push_back(new PhysicsTransform(
-				XMFLOAT4(nRot.getX(),nRot.getY(),nRot.getZ(),nRot.getW()),XMFLOAT3(nPos.getX(),nPos.getY(),nPos.getZ()))
-				);
-		}
-	}
-
-	
+	addRigidBody(shape, rot, pos, newMass, newFriction, newRestitution, newDamping, kinematic);
 }
 
 void wiBULLET::addTriangleMesh(const std::vector<XMFLOAT4>& vertices, const std::vector<unsigned int>& indices, const XMFLOAT3& sca, const XMFLOAT4& rot, const XMFLOAT3& pos
@@ -409,6 +369,13 @@ void wiBULLET::addTriangleMesh(const std::vector<XMFLOAT4>& vertices, const std:
 
 	collisionShapes.push_back(shape);
 
+	addRigidBody(shape, rot, pos, newMass, newFriction, newRestitution, newDamping, kinematic);
+}
+
+
+void wiBULLET::addRigidBody(btCollisionShape* shape, const XMFLOAT4& rot, const XMFLOAT3& pos
+					, float newMass, float newFriction, float newRestitution, float newDamping, bool kinematic){
+
 	btTransform shapeTransform;
 	shapeTransform.setIdentity();
 	shapeTransform.setOrigin(btVector3(pos.x,pos.y,pos.z));
@@ -451,10 +418,377 @@ void wiBULLET::addTriangleMesh(const std::vector<XMFLOAT4>& vertices, const std:
 				);
 		}
 	}
+}
 
-	
+void wiBULLET::addMeshShape(const Mesh* mesh, MESH_SHAPE type, const XMFLOAT3& sca, const XMFLOAT4& rot, const XMFLOAT3& pos
+					, float newMass, float newFriction, float newRestitution, float newDamping, bool kinematic){
+
+	CachedShape* entry = AcquireShape(mesh, type, sca);
+	addRigidBody(entry->shape, rot, pos, newMass, newFriction, newRestitution, newDamping, kinematic);
 }
 
+bool wiBULLET::ShapeKey::operator<(const ShapeKey& other) const
+{
+	if (mesh != other.mesh)
+		return mesh < other.mesh;
+	if (type != other.type)
+		return type < other.type;
+	if (scale.x != other.scale.x)
+		return scale.x < other.scale.x;
+	if (scale.y != other.scale.y)
+		return scale.y < other.scale.y;
+	return scale.z < other.scale.z;
+}
+
+uint64_t wiBULLET::ComputeContentHash(const Mesh* mesh, MESH_SHAPE type)
+{
+	// FNV-1a of the data that the shape is built from:
+	uint64_t hash = 14695981039346656037ull;
+	auto append = [&](const void* data, size_t size) {
+		const uint8_t* bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	};
+	const uint32_t typeValue = (uint32_t)type;
+	append(&typeValue, sizeof(typeValue));
+	for (auto& x : mesh->vertices_POS)
+	{
+		append(&x.pos, sizeof(x.pos));
+	}
+	if (type == MESH_SHAPE_TRIANGLE_MESH && !mesh->indices.empty())
+	{
+		append(&mesh->indices[0], sizeof(mesh->indices[0]) * mesh->indices.size());
+	}
+	return hash;
+}
+
+wiBULLET::CachedShape* wiBULLET::AcquireShape(const Mesh* mesh, MESH_SHAPE type, const XMFLOAT3& scale)
+{
+	const ShapeKey key = { mesh, type, scale };
+	auto it = shapeCache.find(key);
+	if (it != shapeCache.end())
+	{
+		it->second.refCount++;
+		shapeCacheStats.hits++;
+		return &it->second;
+	}
+	shapeCacheStats.misses++;
+
+	const bool unscaled = scale.x == 1 && scale.y == 1 && scale.z == 1;
+	if (type == MESH_SHAPE_TRIANGLE_MESH && !unscaled)
+	{
+		// Changing the scaling of a BVH triangle mesh would rebuild the BVH, so the scaled shapes are views of the unscaled one:
+		CachedShape* base = AcquireShape(mesh, type, XMFLOAT3(1, 1, 1));
+
+		it = shapeCache.insert(make_pair(key, CachedShape())).first;
+		CachedShape& entry = it->second;
+		entry.refCount = 1;
+		entry.base = base;
+		entry.contentHash = base->contentHash;
+		if (base->meshInterface != nullptr)
+		{
+			entry.shape = new btScaledBvhTriangleMeshShape((btBvhTriangleMeshShape*)base->shape, btVector3(scale.x, scale.y, scale.z));
+		}
+		else
+		{
+			entry.shape = new btEmptyShape();
+		}
+		entry.shape->setMargin(btScalar(0.05));
+		shapeCacheLookup[entry.shape] = it;
+		return &entry;
+	}
+
+	it = shapeCache.insert(make_pair(key, CachedShape())).first;
+	CachedShape& entry = it->second;
+	entry.refCount = 1;
+	entry.contentHash = ComputeContentHash(mesh, type);
+
+	// The cooked data is there if the mesh was already used with an other scale, or if it was loaded from a shape cache file:
+	auto cooked = cookedShapes.find(entry.contentHash);
+	if (cooked != cookedShapes.end() && cooked->second.type != type)
+	{
+		cooked = cookedShapes.end();
+	}
+
+	if (type == MESH_SHAPE_CONVEX_HULL)
+	{
+		if (cooked == cookedShapes.end())
+		{
+			// Only the vertices of the hull are kept, the inner points don't change the shape, but they would slow down the collision detection
+			CookedShape& c = cookedShapes[entry.contentHash];
+			c.type = type;
+			if (!mesh->vertices_POS.empty())
+			{
+				btConvexHullComputer computer;
+				computer.compute(&mesh->vertices_POS[0].pos.x, (int)sizeof(Mesh::Vertex_POS), (int)mesh->vertices_POS.size(), 0, 0);
+				c.hullPoints.resize(computer.vertices.size());
+				for (int i = 0; i < computer.vertices.size(); ++i)
+				{
+					const btVector3& v = computer.vertices[i];
+					c.hullPoints[i] = XMFLOAT3((float)v.x(), (float)v.y(), (float)v.z());
+				}
+			}
+			shapeCacheStats.cooked++;
+			cooked = cookedShapes.find(entry.contentHash);
+		}
+
+		btConvexHullShape* hull = new btConvexHullShape();
+		for (auto& x : cooked->second.hullPoints)
+		{
+			hull->addPoint(btVector3(x.x, x.y, x.z), false);
+		}
+		hull->recalcLocalAabb();
+		hull->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
+		entry.shape = hull;
+	}
+	else if (mesh->vertices_POS.empty() || mesh->indices.size() < 3)
+	{
+		entry.shape = new btEmptyShape();
+	}
+	else
+	{
+		const int totalVerts = (int)mesh->vertices_POS.size();
+		const int totalTriangles = (int)mesh->indices.size() / 3;
+
+		entry.vertices.resize(totalVerts);
+		for (int i = 0; i < totalVerts; ++i)
+		{
+			const XMFLOAT3& p = mesh->vertices_POS[i].pos;
+			entry.vertices[i] = btVector3(p.x, p.y, p.z);
+		}
+		entry.indices.resize(totalTriangles * 3);
+		for (int i = 0; i < totalTriangles * 3; ++i)
+		{
+			entry.indices[i] = (int)mesh->indices[i];
+		}
+		entry.meshInterface = new btTriangleIndexVertexArray(
+			totalTriangles,
+			&entry.indices[0],
+			3 * sizeof(int),
+			totalVerts,
+			(btScalar*)&entry.vertices[0].x(),
+			sizeof(btVector3)
+			);
+
+		const bool useQuantizedAabbCompression = true;
+		btBvhTriangleMeshShape* meshShape = nullptr;
+		if (cooked != cookedShapes.end() && !cooked->second.bvh.empty())
+		{
+			const vector<uint8_t>& data = cooked->second.bvh;
+			entry.bvhBuffer = btAlignedAlloc((int)data.size(), 16);
+			memcpy(entry.bvhBuffer, data.data(), data.size());
+			btQuantizedBvh* bvh = btQuantizedBvh::deSerializeInPlace(entry.bvhBuffer, (unsigned int)data.size(), false);
+			if (bvh != nullptr)
+			{
+				meshShape = new btBvhTriangleMeshShape(entry.meshInterface, useQuantizedAabbCompression, false);
+				meshShape->setOptimizedBvh((btOptimizedBvh*)bvh);
+			}
+			else
+			{
+				btAlignedFree(entry.bvhBuffer);
+				entry.bvhBuffer = nullptr;
+			}
+		}
+		if (meshShape == nullptr)
+		{
+			meshShape = new btBvhTriangleMeshShape(entry.meshInterface, useQuantizedAabbCompression);
+			shapeCacheStats.cooked++;
+		}
+		entry.shape = meshShape;
+	}
+	entry.shape->setMargin(btScalar(0.05));
+	shapeCacheLookup[entry.shape] = it;
+
+	return &entry;
+}
+
+void wiBULLET::ReleaseShape(const btCollisionShape* shape)
+{
+	auto it = shapeCacheLookup.find(shape);
+	if (it == shapeCacheLookup.end())
+	{
+		// not a shared shape
+		return;
+	}
+	CachedShape& entry = it->second->second;
+	if (--entry.refCount > 0)
+	{
+		return;
+	}
+
+	CachedShape* base = entry.base;
+	delete entry.shape;
+	delete entry.meshInterface;
+	if (entry.bvhBuffer != nullptr)
+	{
+		// the BVH was deserialized in place, the shape doesn't own it
+		btAlignedFree(entry.bvhBuffer);
+	}
+	shapeCache.erase(it->second);
+	shapeCacheLookup.erase(it);
+
+	if (base != nullptr)
+	{
+		ReleaseShape(base->shape);
+	}
+}
+
+// Increment when the layout of the shape cache files changes
+static const unsigned int SHAPE_CACHE_VERSION = 1;
+
+bool wiBULLET::SaveShapeCache(const std::string& fileName){
+	MarkForWrite();
+
+	// The hulls are always kept cooked, but the BVHs are only serialized now from the triangle mesh shapes:
+	unordered_map<uint64_t, CookedShape> bvhs;
+	for (auto& x : shapeCache)
+	{
+		const CachedShape& entry = x.second;
+		if (entry.meshInterface == nullptr || bvhs.count(entry.contentHash) > 0)
+		{
+			continue;
+		}
+		auto cooked = cookedShapes.find(entry.contentHash);
+		if (cooked != cookedShapes.end() && !cooked->second.bvh.empty())
+		{
+			continue;
+		}
+
+		const btOptimizedBvh* bvh = ((btBvhTriangleMeshShape*)entry.shape)->getOptimizedBvh();
+		if (bvh == nullptr)
+		{
+			continue;
+		}
+		const unsigned int size = bvh->calculateSerializeBufferSize();
+		void* buffer = btAlignedAlloc((int)size, 16);
+		if (bvh->serialize(buffer, size, false))
+		{
+			CookedShape& c = bvhs[entry.contentHash];
+			c.type = MESH_SHAPE_TRIANGLE_MESH;
+			c.bvh.assign((const uint8_t*)buffer, (const uint8_t*)buffer + size);
+		}
+		btAlignedFree(buffer);
+	}
+
+	wiArchive archive(fileName, false);
+	const bool success = archive.IsOpen();
+	if (success)
+	{
+		// The BVHs are stored in their in-memory layout, so the files are only valid for the same kind of build:
+		archive << SHAPE_CACHE_VERSION;
+		archive << (unsigned int)sizeof(void*);
+		archive << (unsigned int)sizeof(btScalar);
+
+		archive << (uint64_t)(cookedShapes.size() + bvhs.size());
+		auto write = [&](uint64_t hash, const CookedShape& c) {
+			archive << hash;
+			archive << (unsigned int)c.type;
+			archive << (uint64_t)c.hullPoints.size();
+			for (auto& x : c.hullPoints)
+			{
+				archive << x;
+			}
+			archive << c.bvh;
+		};
+		for (auto& x : cookedShapes)
+		{
+			write(x.first, x.second);
+		}
+		for (auto& x : bvhs)
+		{
+			write(x.first, x.second);
+		}
+		archive.Close();
+	}
+
+	UnMarkForWrite();
+	return success;
+}
+bool wiBULLET::LoadShapeCache(const std::string& fileName){
+	wiArchive archive(fileName, true);
+	if (!archive.IsOpen() || archive.GetRemainingSize() < sizeof(uint64_t) * 3)
+	{
+		return false;
+	}
+
+	unsigned int version, pointerSize, scalarSize;
+	archive >> version;
+	archive >> pointerSize;
+	archive >> scalarSize;
+	if (version != SHAPE_CACHE_VERSION || pointerSize != sizeof(void*) || scalarSize != sizeof(btScalar))
+	{
+		return false;
+	}
+
+	MarkForWrite();
+
+	// The counts and sizes in the file are not trusted, everything is checked against the remaining size of the file before it is read:
+	bool success = true;
+	uint64_t count = 0;
+	if (archive.GetRemainingSize() >= sizeof(uint64_t))
+	{
+		archive >> count;
+	}
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		// hash, type, point count:
+		if (archive.GetRemainingSize() < sizeof(uint64_t) * 3)
+		{
+			success = false;
+			break;
+		}
+		uint64_t hash;
+		unsigned int type;
+		uint64_t pointCount;
+		archive >> hash;
+		archive >> type;
+		archive >> pointCount;
+
+		// the points, then the size of the BVH:
+		if (type > MESH_SHAPE_TRIANGLE_MESH || archive.GetRemainingSize() < sizeof(uint64_t) ||
+			pointCount > (archive.GetRemainingSize() - sizeof(uint64_t)) / sizeof(XMFLOAT3))
+		{
+			success = false;
+			break;
+		}
+		CookedShape c;
+		c.type = (MESH_SHAPE)type;
+		c.hullPoints.resize((size_t)pointCount);
+		for (auto& x : c.hullPoints)
+		{
+			archive >> x;
+		}
+
+		// the archive refuses a BVH size that is larger than the rest of the file, the BVH is empty then and it will be built again:
+		archive >> c.bvh;
+		cookedShapes[hash] = move(c);
+	}
+
+	UnMarkForWrite();
+	return success;
+}
+wiBULLET::ShapeCacheStats wiBULLET::GetShapeCacheStats(){
+	MarkForWrite();
+
+	ShapeCacheStats stats = shapeCacheStats;
+	stats.shapeCount = (uint32_t)shapeCache.size();
+	stats.referenceCount = 0;
+	for (auto& x : shapeCache)
+	{
+		stats.referenceCount += x.second.refCount;
+		if (x.second.base != nullptr)
+		{
+			// the reference of the scaled shape to the unscaled one is not a body
+			stats.referenceCount--;
+		}
+	}
+
+	UnMarkForWrite();
+	return stats;
+}
 
 void wiBULLET::addSoftBodyTriangleMesh(const Mesh* mesh, const XMFLOAT3& sca, const XMFLOAT4& rot, const XMFLOAT3& pos
 	, float newMass, float newFriction, float newRestitution, float newDamping){
@@ -533,9 +867,10 @@ void wiBULLET::addSoftBodyTriangleMesh(const Mesh* mesh, const XMFLOAT3& sca, co
 		
 		int mvg = mesh->massVG;
 		if(mvg>=0){
-			for(std::map<int,float>::const_iterator it=mesh->vertexGroups[mvg].vertices.begin();it!=mesh->vertexGroups[mvg].vertices.end();++it){
-				int vi = (*it).first;
-				float wei = (*it).second;
+			const VertexGroup& group = mesh->vertexGroups[mvg];
+			for(size_t i=0;i<group.indices.size();++i){
+				int vi = group.indices[i];
+				float wei = group.weights[i];
 				int index=mesh->physicalmapGP[vi];
 				softBody->setMass(index,softBody->getMass(index)*btScalar(wei));
 			}
@@ -544,10 +879,11 @@ void wiBULLET::addSoftBodyTriangleMesh(const Mesh* mesh, const XMFLOAT3& sca, co
 		
 		int gvg = mesh->goalVG;
 		if(gvg>=0){
-			for(std::map<int,float>::const_iterator it=mesh->vertexGroups[gvg].vertices.begin();it!=mesh->vertexGroups[gvg].vertices.end();++it){
-				int vi = (*it).first;
+			const VertexGroup& group = mesh->vertexGroups[gvg];
+			for(size_t i=0;i<group.indices.size();++i){
+				int vi = group.indices[i];
 				int index=mesh->physicalmapGP[vi];
-				float weight = (*it).second;
+				float weight = group.weights[i];
 				if(weight==1)
 					softBody->setMass(index,0);
 			}
@@ -569,37 +905,32 @@ void wiBULLET::addSoftBodyTriangleMesh(const Mesh* mesh, const XMFLOAT3& sca, co
 }
 
 
-void wiBULLET::connectVerticesToSoftBody(Mesh* const mesh, int objectI){
-	if (!softBodyPhysicsEnabled)
-		return;
-
+void wiBULLET::connectVerticesToSoftBody(int objectI, SoftBodyState& state){
 	btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[objectI];
 	btSoftBody* softBody = btSoftBody::upcast(obj);
 
+	state.objectID = objectI;
+	state.positions.clear();
+	state.normals.clear();
 
 	if(softBody){
 		btVector3 min, max;
 		softBody->getAabb(min, max);
-		mesh->aabb.create(XMFLOAT3(min.x(), min.y(), min.z()), XMFLOAT3(max.x(), max.y(), max.z()));
-
-		softBody->setWindVelocity(wind);
+		state.aabbMin = XMFLOAT3(min.x(), min.y(), min.z());
+		state.aabbMax = XMFLOAT3(max.x(), max.y(), max.z());
 
 		btSoftBody::tNodeArray&   nodes(softBody->m_nodes);
-		
-		int gvg = mesh->goalVG;
-		for (unsigned int i = 0; i<mesh->vertices_POS.size(); ++i)
+
+		state.positions.resize(nodes.size());
+		state.normals.resize(nodes.size());
+		for (int i = 0; i < nodes.size(); ++i)
 		{
-			int indexP = mesh->physicalmapGP[i];
-			float weight = mesh->vertexGroups[gvg].vertices[indexP];
-			mesh->vertices_Transformed_PRE[i].pos = mesh->vertices_Transformed_POS[i].pos;
-			mesh->vertices_Transformed_POS[i].pos.x = nodes[indexP].m_x.getX();
-			mesh->vertices_Transformed_POS[i].pos.y = nodes[indexP].m_x.getY();
-			mesh->vertices_Transformed_POS[i].pos.z = nodes[indexP].m_x.getZ();
-			mesh->vertices_Transformed_POS[i].NORWINDFromFloat(XMFLOAT3(-nodes[indexP].m_n.getX(), -nodes[indexP].m_n.getY(), -nodes[indexP].m_n.getZ()), 0);
+			state.positions[i] = XMFLOAT3(nodes[i].m_x.getX(), nodes[i].m_x.getY(), nodes[i].m_x.getZ());
+			state.normals[i] = XMFLOAT3(-nodes[i].m_n.getX(), -nodes[i].m_n.getY(), -nodes[i].m_n.getZ());
 		}
 	}
 }
-void wiBULLET::connectSoftBodyToVertices(const Mesh* const mesh, int objectI){
+void wiBULLET::connectSoftBodyToVertices(const Mesh* const mesh, const std::vector<XMFLOAT3>& goalPositions, int objectI){
 	if (!softBodyPhysicsEnabled)
 		return;
 
@@ -612,13 +943,13 @@ void wiBULLET::connectSoftBodyToVertices(const Mesh* const mesh, int objectI){
 		
 			int gvg = mesh->goalVG;
 			if(gvg>=0){
-				int j=0;
-				for(std::map<int,float>::const_iterator it=mesh->vertexGroups[gvg].vertices.begin();it!=mesh->vertexGroups[gvg].vertices.end();++it){
-					int vi = (*it).first;
+				const VertexGroup& group = mesh->vertexGroups[gvg];
+				const size_t count = min(group.indices.size(), goalPositions.size());
+				for(size_t j=0;j<count;++j){
+					int vi = group.indices[j];
 					int index=mesh->physicalmapGP[vi];
-					float weight = (*it).second;
-					nodes[index].m_x=nodes[index].m_x.lerp(btVector3(mesh->goalPositions[j].x,mesh->goalPositions[j].y,mesh->goalPositions[j].z),weight);
-					++j;
+					float weight = group.weights[j];
+					nodes[index].m_x=nodes[index].m_x.lerp(btVector3(goalPositions[j].x,goalPositions[j].y,goalPositions[j].z),weight);
 				}
 			}
 		}
@@ -666,6 +997,8 @@ PHYSICS::PhysicsTransform* wiBULLET::getObject(int index){
 }
 
 void wiBULLET::registerObject(Object* object){
+	MarkForWrite();
+
 	if(object->rigidBody && object->mesh != nullptr && rigidBodyPhysicsEnabled){
 		XMFLOAT3 S,T;
 		XMFLOAT4 R;
@@ -701,17 +1034,8 @@ void wiBULLET::registerObject(Object* object){
 			object->physicsObjectID = ++registeredObjects;
 		}
 		if(!object->collisionShape.compare("CONVEX_HULL")){
-			vector<XMFLOAT4> pos_stream(object->mesh->vertices_POS.size());
-			for (size_t i = 0; i < object->mesh->vertices_POS.size(); ++i)
-			{
-				pos_stream[i].x = object->mesh->vertices_POS[i].pos.x;
-				pos_stream[i].y = object->mesh->vertices_POS[i].pos.y;
-				pos_stream[i].z = object->mesh->vertices_POS[i].pos.z;
-				pos_stream[i].w = 1;
-			}
-
-			addConvexHull(
-				pos_stream,
+			addMeshShape(
+				object->mesh, MESH_SHAPE_CONVEX_HULL,
 				S,R,T
 				,object->mass,object->friction,object->restitution
 				,object->damping,object->kinematic
@@ -719,17 +1043,8 @@ void wiBULLET::registerObject(Object* object){
 			object->physicsObjectID = ++registeredObjects;
 		}
 		if(!object->collisionShape.compare("MESH")){
-			vector<XMFLOAT4> pos_stream(object->mesh->vertices_POS.size());
-			for (size_t i = 0; i < object->mesh->vertices_POS.size(); ++i)
-			{
-				pos_stream[i].x = object->mesh->vertices_POS[i].pos.x;
-				pos_stream[i].y = object->mesh->vertices_POS[i].pos.y;
-				pos_stream[i].z = object->mesh->vertices_POS[i].pos.z;
-				pos_stream[i].w = 1;
-			}
-
-			addTriangleMesh(
-				pos_stream,object->mesh->indices,
+			addMeshShape(
+				object->mesh, MESH_SHAPE_TRIANGLE_MESH,
 				S,R,T
 				,object->mass,object->friction,object->restitution
 				,object->damping,object->kinematic
@@ -758,16 +1073,31 @@ void wiBULLET::registerObject(Object* object){
 		);
 		object->physicsObjectID = ++registeredObjects;
 	}
+
+	AddObjectID(object);
+
+	UnMarkForWrite();
 }
 void wiBULLET::removeObject(Object* object)
 {
-	if (object == nullptr || object->physicsObjectID < 0)
+	if (object == nullptr)
+	{
+		return;
+	}
+	RequestRegistration();
+	if (object->physicsObjectID < 0)
 	{
 		return;
 	}
 
-	deleteObject(object->physicsObjectID);
+	MarkForWrite();
+
+	const int id = object->physicsObjectID;
+	deleteObject(id);
+	RemoveObjectID(id);
 	object->physicsObjectID = -1;
+
+	UnMarkForWrite();
 }
 
 void wiBULLET::Update(float dt){
@@ -775,18 +1105,75 @@ void wiBULLET::Update(float dt){
 		dynamicsWorld->stepSimulation(dt, 6);
 }
 void wiBULLET::MarkForRead(){
-
+	resultLock.lock();
 }
 void wiBULLET::UnMarkForRead(){
-
+	resultLock.unlock();
 }
 void wiBULLET::MarkForWrite(){
-
+	worldLock.lock();
 }
 void wiBULLET::UnMarkForWrite(){
+	worldLock.unlock();
+}
+
+void wiBULLET::ApplyInput(const Input& input){
+	addWind(input.wind);
+
+	const int count = dynamicsWorld->getNumCollisionObjects();
+	for (auto& x : input.kinematicBodies)
+	{
+		if (x.first < count)
+		{
+			transformBody(x.second.rotation, x.second.position, x.first);
+		}
+	}
+
+	if (softBodyPhysicsEnabled)
+	{
+		for (auto& x : input.softBodyGoals)
+		{
+			if (x.first < count && x.first < (int)objects.size() && objects[x.first] != nullptr)
+			{
+				connectSoftBodyToVertices(objects[x.first]->mesh, x.second, x.first);
+			}
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			btSoftBody* softBody = btSoftBody::upcast(dynamicsWorld->getCollisionObjectArray()[i]);
+			if (softBody)
+			{
+				softBody->setWindVelocity(wind);
+			}
+		}
+	}
+}
+void wiBULLET::WriteSnapshot(Snapshot& snapshot){
+	const int count = dynamicsWorld->getNumCollisionObjects();
+
+	snapshot.bodies.resize(count);
+	size_t softBodyCount = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		snapshot.bodies[i] = *getObject(i);
 
+		if (softBodyPhysicsEnabled && btSoftBody::upcast(dynamicsWorld->getCollisionObjectArray()[i]) != nullptr)
+		{
+			// the vectors of the previous use are kept, so the nodes are copied without allocations
+			if (snapshot.softBodies.size() <= softBodyCount)
+			{
+				snapshot.softBodies.resize(softBodyCount + 1);
+			}
+			connectVerticesToSoftBody(i, snapshot.softBodies[softBodyCount]);
+			softBodyCount++;
+		}
+	}
+	snapshot.softBodies.resize(softBodyCount);
 }
+
 void wiBULLET::ClearWorld(){
+	MarkForWrite();
+
 	for(int i=dynamicsWorld->getNumCollisionObjects()-1;i>=0;i--)
 	{
 		deleteObject(i);
@@ -805,8 +1192,23 @@ void wiBULLET::ClearWorld(){
 		delete transforms[i];
 	transforms.clear();
 	registeredObjects=-1;
+
+	// The objects might outlive the world, they can be registered again:
+	for (Object* x : objects)
+	{
+		if (x != nullptr)
+		{
+			x->physicsObjectID = -1;
+		}
+	}
+	objects.clear();
+	ClearSnapshots();
+
+	UnMarkForWrite();
 }
 void wiBULLET::CleanUp(){
+	StopThread();
+
 	for (unsigned int i = 0; i<transforms.size(); ++i)
 		delete transforms[i];
 	transforms.clear();
@@ -841,6 +1243,7 @@ void wiBULLET::deleteObject(int id)
 		else
 			dynamicsWorld->removeCollisionObject(obj);
 	}
+	ReleaseShape(obj->getCollisionShape());
 	delete obj;
 
 	registeredObjects--;
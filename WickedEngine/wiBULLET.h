@@ -3,6 +3,9 @@
 
 #include "BULLET/btBulletDynamicsCommon.h"
 
+#include <map>
+#include <unordered_map>
+
 class btCollisionConfiguration;
 class btCollisionDispatcher;
 class btBroadphaseInterface;
@@ -16,6 +19,21 @@ struct RAY;
 
 class wiBULLET:public PHYSICS
 {
+public:
+	// Collision shapes that are built from mesh data
+	enum MESH_SHAPE
+	{
+		MESH_SHAPE_CONVEX_HULL,
+		MESH_SHAPE_TRIANGLE_MESH,
+	};
+	struct ShapeCacheStats
+	{
+		uint32_t shapeCount = 0;		// shapes that are in use
+		uint32_t referenceCount = 0;	// bodies that use them
+		uint32_t hits = 0;				// acquired shapes that already existed
+		uint32_t misses = 0;			// acquired shapes that had to be created
+		uint32_t cooked = 0;			// hulls and BVHs that had to be computed (the rest came from the cooked data)
+	};
 private:
 	btCollisionConfiguration* collisionConfiguration;
 	btCollisionDispatcher* dispatcher;
@@ -33,6 +51,49 @@ private:
 	static RAY grabRay;
 
 	void deleteObject(int id);
+
+	// The shapes are shared by every object that uses the same mesh with the same scale, and deleted when the last one is removed.
+	//	Triangle meshes have one unscaled BVH shape per mesh, and the scaled shapes reference that.
+	struct ShapeKey
+	{
+		const Mesh* mesh;
+		MESH_SHAPE type;
+		XMFLOAT3 scale;
+		bool operator<(const ShapeKey& other) const;
+	};
+	struct CachedShape
+	{
+		btCollisionShape* shape = nullptr;
+		uint32_t refCount = 0;
+		CachedShape* base = nullptr;	// the unscaled triangle mesh shape of a scaled one
+		uint64_t contentHash = 0;		// hash of the mesh data, identifies the cooked data
+
+		// The triangle mesh data that the unscaled shape refers to:
+		btAlignedObjectArray<btVector3> vertices;
+		btAlignedObjectArray<int> indices;
+		btTriangleIndexVertexArray* meshInterface = nullptr;
+		void* bvhBuffer = nullptr;		// the BVH was deserialized into this buffer
+	};
+	// Result of the expensive part of the shape creation, this is what the shape cache files contain
+	struct CookedShape
+	{
+		MESH_SHAPE type;
+		std::vector<XMFLOAT3> hullPoints;
+		std::vector<uint8_t> bvh;		// serialized btOptimizedBvh of the unscaled mesh
+	};
+	std::map<ShapeKey, CachedShape> shapeCache;
+	std::unordered_map<const btCollisionShape*, std::map<ShapeKey, CachedShape>::iterator> shapeCacheLookup;
+	std::unordered_map<uint64_t, CookedShape> cookedShapes; // by contentHash
+	ShapeCacheStats shapeCacheStats;
+
+	static uint64_t ComputeContentHash(const Mesh* mesh, MESH_SHAPE type);
+	CachedShape* AcquireShape(const Mesh* mesh, MESH_SHAPE type, const XMFLOAT3& scale);
+	void ReleaseShape(const btCollisionShape* shape);
+	void addRigidBody(btCollisionShape* shape, const XMFLOAT4& rot, const XMFLOAT3& pos
+		, float newMass, float newFriction, float newRestitution, float newDamping, bool kinematic);
+protected:
+	void ApplyInput(const Input& input);
+	void WriteSnapshot(Snapshot& snapshot);
 public:
 	wiBULLET();
 	~wiBULLET();
@@ -50,13 +111,17 @@ public:
 	void addTriangleMesh(const std::vector<XMFLOAT4>& vertices, const std::vector<unsigned int>& indices, const XMFLOAT3& sca, const XMFLOAT4& rot, const XMFLOAT3& pos
 		, float newMass, float newFriction, float newRestitution, float newDamping, bool kinematic);
 	
+	// Add a body with a shape that is built from the mesh, or shared with the other bodies of the mesh
+	void addMeshShape(const Mesh* mesh, MESH_SHAPE type, const XMFLOAT3& sca, const XMFLOAT4& rot, const XMFLOAT3& pos
+		, float newMass, float newFriction, float newRestitution, float newDamping, bool kinematic);
+	
 	void addSoftBodyTriangleMesh(const Mesh* mesh, const XMFLOAT3& sca, const XMFLOAT4& rot, const XMFLOAT3& pos
 		, float newMass, float newFriction, float newRestitution, float newDamping);
 
 	void addBone(float rad, float hei);
 	
-	void connectVerticesToSoftBody(Mesh* const mesh, int objectI);
-	void connectSoftBodyToVertices(const Mesh*  const mesh, int objectI);
+	void connectVerticesToSoftBody(int objectI, SoftBodyState& state);
+	void connectSoftBodyToVertices(const Mesh*  const mesh, const std::vector<XMFLOAT3>& goalPositions, int objectI);
 	void transformBody(const XMFLOAT4& rot, const XMFLOAT3& pos, int objectI);
 
 	PhysicsTransform* getObject(int index);
@@ -72,6 +137,12 @@ public:
 	void ClearWorld();
 	void CleanUp();
 
+	// The cooked convex hulls and triangle mesh BVHs of every mesh shape that was created, so that they don't have to be computed again when the level is loaded.
+	//	The cooked data is matched by the content of the meshes, and kept until the physics engine is destroyed.
+	bool SaveShapeCache(const std::string& fileName);
+	bool LoadShapeCache(const std::string& fileName);
+	ShapeCacheStats GetShapeCacheStats();
+
 	void setGrab(bool val, const RAY& ray);
 	static void pickingPreTickCallback (btDynamicsWorld *world, btScalar timeStep);
 	static void soundTickCallback(btDynamicsWorld *world, btScalar timeStep);
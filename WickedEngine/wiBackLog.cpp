@@ -66,15 +66,18 @@ void wiBackLog::Update(){
 }
 void wiBackLog::Draw(){
 	if(state!=DISABLED){
-		//wiImage::BatchBegin();
+		wiImage::BatchBegin(GRAPHICSTHREAD_IMMEDIATE);
 		wiImageEffects fx = wiImageEffects((float)wiRenderer::GetDevice()->GetScreenWidth(), (float)wiRenderer::GetDevice()->GetScreenHeight());
 		fx.pos=XMFLOAT3(0,pos,0);
 		fx.opacity = wiMath::Lerp(1, 0, -pos / wiRenderer::GetDevice()->GetScreenHeight());
 		wiImage::Draw(backgroundTex, fx, GRAPHICSTHREAD_IMMEDIATE);
+		wiFont::BatchBegin(GRAPHICSTHREAD_IMMEDIATE);
 		font.SetText(getText());
 		font.props.posY = wiRenderer::GetDevice()->GetScreenHeight() - 75 + (int)pos + (int)scroll;
 		font.Draw(GRAPHICSTHREAD_IMMEDIATE);
 		wiFont(inputArea.str().c_str(), wiFontProps(5, wiRenderer::GetDevice()->GetScreenHeight() - 10, -1, WIFALIGN_LEFT, WIFALIGN_BOTTOM)).Draw(GRAPHICSTHREAD_IMMEDIATE);
+		wiFont::BatchEnd(GRAPHICSTHREAD_IMMEDIATE);
+		wiImage::BatchEnd(GRAPHICSTHREAD_IMMEDIATE);
 	}
 }
 
@@ -1,16 +1,21 @@
 #include "wiFont.h"
 #include "wiRenderer.h"
+#include "wiImage.h"
 #include "wiResourceManager.h"
 #include "wiHelper.h"
 #include "wiLoader.h"
 #include "ResourceMapping.h"
 
 #include <fstream>
+#include <unordered_map>
 
 using namespace std;
 using namespace wiGraphicsTypes;
 
-#define MAX_TEXT 10000
+// Glyph quads drawn from a single ring buffer allocation, larger batches are split up
+#define MAX_BATCH_QUADS 32768
+// Unused layouts are kept in the per thread cache for this many frames
+#define LAYOUT_CACHE_FRAMES 60
 
 #define WHITESPACE_SIZE 3
 
@@ -25,6 +30,7 @@ RasterizerState		*wiFont::rasterizerState = nullptr;
 DepthStencilState	*wiFont::depthStencilState = nullptr;
 GraphicsPSO			*wiFont::PSO = nullptr;
 std::vector<wiFont::wiFontStyle> wiFont::fontStyles;
+wiFont::Batch		wiFont::batches[GRAPHICSTHREAD_COUNT];
 
 wiFont::wiFont(const std::string& text, wiFontProps props, int style) : props(props), style(style)
 {
@@ -49,7 +55,7 @@ void wiFont::LoadVertexBuffer()
 	GPUBufferDesc bd;
 	ZeroMemory(&bd, sizeof(bd));
 	bd.Usage = USAGE_DYNAMIC;
-	bd.ByteWidth = 256 * 1024; // just allocate 256KB to font renderer ring buffer..
+	bd.ByteWidth = 4 * 1024 * 1024; // a full batch chunk (MAX_BATCH_QUADS) must fit in the font renderer ring buffer
 	bd.BindFlags = BIND_VERTEX_BUFFER;
 	bd.CPUAccessFlags = CPU_ACCESS_WRITE;
 
@@ -58,8 +64,9 @@ void wiFont::LoadVertexBuffer()
 }
 void wiFont::LoadIndices()
 {
-	uint16_t indices[MAX_TEXT * 6];
-	for (uint16_t i = 0; i < MAX_TEXT * 4; i += 4) {
+	// 32-bit indices, so a batch can address more than 65536 vertices:
+	std::vector<uint32_t> indices(MAX_BATCH_QUADS * 6);
+	for (uint32_t i = 0; i < MAX_BATCH_QUADS * 4; i += 4) {
 		indices[i / 4 * 6 + 0] = i + 0;
 		indices[i / 4 * 6 + 1] = i + 2;
 		indices[i / 4 * 6 + 2] = i + 1;
@@ -71,12 +78,12 @@ void wiFont::LoadIndices()
 	GPUBufferDesc bd;
 	ZeroMemory(&bd, sizeof(bd));
 	bd.Usage = USAGE_IMMUTABLE;
-	bd.ByteWidth = sizeof(indices);
+	bd.ByteWidth = (UINT)(sizeof(uint32_t) * indices.size());
 	bd.BindFlags = BIND_INDEX_BUFFER;
 	bd.CPUAccessFlags = 0;
 	SubresourceData InitData;
 	ZeroMemory(&InitData, sizeof(InitData));
-	InitData.pSysMem = indices;
+	InitData.pSysMem = indices.data();
 	indexBuffer = new GPUBuffer;
 	wiRenderer::GetDevice()->CreateBuffer(&bd, &InitData, indexBuffer);
 }
@@ -127,6 +134,7 @@ void wiFont::LoadShaders()
 	{
 		{ "POSITION", 0, FORMAT_R32G32_FLOAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD", 0, FORMAT_R16G16_FLOAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
+		{ "COLOR", 0, FORMAT_R8G8B8A8_UNORM, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
 	};
 	UINT numElements = ARRAYSIZE(layout);
 	VertexShaderInfo* vsinfo = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(wiRenderer::SHADERPATH + "fontVS.cso", wiResourceManager::VERTEXSHADER, layout, numElements));
@@ -180,89 +188,99 @@ void wiFont::CleanUpStatic()
 }
 
 
-void wiFont::ModifyGeo(volatile Vertex* vertexList, const std::wstring& text, wiFontProps props, int style)
+const wiFont::Layout& wiFont::GetLayout(const std::wstring& text, const wiFontProps& props, int style)
 {
-	size_t vertexCount = text.length() * 4;
+	static thread_local unordered_map<size_t, Layout> cache;
+	static thread_local uint64_t lastCleanupFrame = 0;
 
-	const int lineHeight = (props.size < 0 ? fontStyles[style].lineHeight : props.size);
-	const float relativeSize = (props.size < 0 ? 1 : (float)props.size / (float)fontStyles[style].lineHeight);
+	const uint64_t frame = wiRenderer::GetDevice()->GetFrameCount();
+	if (frame != lastCleanupFrame)
+	{
+		lastCleanupFrame = frame;
+		for (auto it = cache.begin(); it != cache.end();)
+		{
+			if (it->second.lastUsedFrame + LAYOUT_CACHE_FRAMES < frame)
+				it = cache.erase(it);
+			else
+				++it;
+		}
+	}
+
+	size_t hash = std::hash<wstring>()(text);
+	hash ^= ((size_t)props.size * 73856093) ^ ((size_t)props.spacingX * 19349663) ^ ((size_t)props.spacingY * 83492791) ^ ((size_t)style << 24);
+
+	Layout& layout = cache[hash];
+	layout.lastUsedFrame = frame;
+	if (layout.text == text && layout.size == props.size && layout.spacingX == props.spacingX && layout.spacingY == props.spacingY && layout.style == style)
+	{
+		return layout;
+	}
+
+	layout.text = text;
+	layout.size = props.size;
+	layout.spacingX = props.spacingX;
+	layout.spacingY = props.spacingY;
+	layout.style = style;
+	layout.vertices.clear();
+	layout.width = 0;
+
+	const wiFontStyle& fontStyle = fontStyles[style];
+	const int lineHeight = (props.size < 0 ? fontStyle.lineHeight : props.size);
+	const float relativeSize = (props.size < 0 ? 1 : (float)props.size / (float)fontStyle.lineHeight);
+
+	const HALF h0 = XMConvertFloatToHalf(0.0f);
+	const HALF h1 = XMConvertFloatToHalf(1.0f);
 
+	int lines = 1;
 	int line = 0;
 	int pos = 0;
-	for (unsigned int i = 0; i<vertexCount; i += 4)
+	for (size_t i = 0; i < text.length(); ++i)
 	{
-		bool compatible = false;
-		wiFontStyle::LookUp lookup;
-		
-		if (text[i / 4] == '\n') 
+		const wchar_t character = text[i];
+
+		if (character == '\n') 
 		{
 			line += lineHeight + props.spacingY;
 			pos = 0;
+			lines++;
 		}
-		else if (text[i / 4] == ' ') 
+		else if (character == ' ') 
 		{
 			pos += WHITESPACE_SIZE + props.spacingX;
 		}
-		else if (text[i / 4] == '\t') 
+		else if (character == '\t') 
 		{
 			pos += (WHITESPACE_SIZE + props.spacingX) * 5;
 		}
-		else if (text[i / 4] < ARRAYSIZE(fontStyles[style].lookup) && fontStyles[style].lookup[text[i / 4]].character == text[i / 4]) 
+		else if (character < ARRAYSIZE(fontStyle.lookup) && fontStyle.lookup[character].character == character) 
 		{
-			lookup = fontStyles[style].lookup[text[i / 4]];
-			compatible = true;
-		}
-
-		HALF h0 = XMConvertFloatToHalf(0.0f);
-
-		if (compatible) 
-		{
-			int characterWidth = (int)(lookup.pixelWidth * relativeSize);
-
-			HALF h1 = XMConvertFloatToHalf(1.0f);
-			HALF hl = XMConvertFloatToHalf(lookup.left);
-			HALF hr = XMConvertFloatToHalf(lookup.right);
-
-			vertexList[i + 0].Pos.x = (float)pos;
-			vertexList[i + 0].Pos.y = (float)line;
-			vertexList[i + 1].Pos.x = (float)pos + (float)characterWidth;
-			vertexList[i + 1].Pos.y = (float)line;
-			vertexList[i + 2].Pos.x = (float)pos;
-			vertexList[i + 2].Pos.y = (float)line + (float)lineHeight;
-			vertexList[i + 3].Pos.x = (float)pos + (float)characterWidth;
-			vertexList[i + 3].Pos.y = (float)line + (float)lineHeight;
-
-			vertexList[i + 0].Tex.x = hl;
-			vertexList[i + 0].Tex.y = h0;
-			vertexList[i + 1].Tex.x = hr;
-			vertexList[i + 1].Tex.y = h0;
-			vertexList[i + 2].Tex.x = hl;
-			vertexList[i + 2].Tex.y = h1;
-			vertexList[i + 3].Tex.x = hr;
-			vertexList[i + 3].Tex.y = h1;
+			const wiFontStyle::LookUp& lookup = fontStyle.lookup[character];
+			const int characterWidth = (int)(lookup.pixelWidth * relativeSize);
+			const HALF hl = XMConvertFloatToHalf(lookup.left);
+			const HALF hr = XMConvertFloatToHalf(lookup.right);
+
+			Vertex quad[4];
+			quad[0].Pos = XMFLOAT2((float)pos, (float)line);
+			quad[1].Pos = XMFLOAT2((float)pos + (float)characterWidth, (float)line);
+			quad[2].Pos = XMFLOAT2((float)pos, (float)line + (float)lineHeight);
+			quad[3].Pos = XMFLOAT2((float)pos + (float)characterWidth, (float)line + (float)lineHeight);
+			quad[0].Tex = XMHALF2(hl, h0);
+			quad[1].Tex = XMHALF2(hr, h0);
+			quad[2].Tex = XMHALF2(hl, h1);
+			quad[3].Tex = XMHALF2(hr, h1);
+			for (int j = 0; j < 4; ++j)
+			{
+				quad[j].Color = 0;
+				layout.vertices.push_back(quad[j]);
+			}
 
 			pos += characterWidth + props.spacingX;
 		}
-		else
-		{
-			vertexList[i + 0].Pos.x = 0;
-			vertexList[i + 0].Pos.y = 0;
-			vertexList[i + 0].Tex.x = h0;
-			vertexList[i + 0].Tex.y = h0;
-			vertexList[i + 1].Pos.x = 0;
-			vertexList[i + 1].Pos.y = 0;
-			vertexList[i + 1].Tex.x = h0;
-			vertexList[i + 1].Tex.y = h0;
-			vertexList[i + 2].Pos.x = 0;
-			vertexList[i + 2].Pos.y = 0;
-			vertexList[i + 2].Tex.x = h0;
-			vertexList[i + 2].Tex.y = h0;
-			vertexList[i + 3].Pos.x = 0;
-			vertexList[i + 3].Pos.y = 0;
-			vertexList[i + 3].Tex.x = h0;
-			vertexList[i + 3].Tex.y = h0;
-		}
+		layout.width = max(layout.width, pos);
 	}
+	layout.height = lines * (lineHeight + props.spacingY);
+
+	return layout;
 }
 
 
@@ -273,73 +291,149 @@ void wiFont::Draw(GRAPHICSTHREAD threadID)
 		return;
 	}
 
-	wiFontProps newProps = props;
+	const Layout& layout = GetLayout(text, props, style);
+	if (layout.vertices.empty())
+	{
+		return;
+	}
+
+	// images that were batched before the text must stay below it:
+	wiImage::Flush(threadID);
+
+	int posX = props.posX;
+	int posY = props.posY;
 
 	if (props.h_align == WIFALIGN_CENTER || props.h_align == WIFALIGN_MID)
-		newProps.posX -= textWidth() / 2;
+		posX -= layout.width / 2;
 	else if (props.h_align == WIFALIGN_RIGHT)
-		newProps.posX -= textWidth();
+		posX -= layout.width;
 	if (props.v_align == WIFALIGN_CENTER || props.h_align == WIFALIGN_MID)
-		newProps.posY -= textHeight() / 2;
+		posY -= layout.height / 2;
 	else if (props.v_align == WIFALIGN_BOTTOM)
-		newProps.posY -= textHeight();
+		posY -= layout.height;
 
+	Batch& batch = batches[threadID];
 
+	const uint32_t quadCount = (uint32_t)layout.vertices.size() / 4;
+	auto addQuads = [&](float offsetX, float offsetY, const wiColor& color) {
+		const uint32_t packedColor = (uint32_t)color.r | ((uint32_t)color.g << 8) | ((uint32_t)color.b << 16) | ((uint32_t)color.a << 24);
+		const uint32_t firstQuad = (uint32_t)batch.vertices.size() / 4;
+		for (const Vertex& vertex : layout.vertices)
+		{
+			Vertex v;
+			v.Pos = XMFLOAT2(vertex.Pos.x + offsetX, vertex.Pos.y + offsetY);
+			v.Tex = vertex.Tex;
+			v.Color = packedColor;
+			batch.vertices.push_back(v);
+		}
+		if (!batch.ranges.empty() && batch.ranges.back().style == style)
+		{
+			batch.ranges.back().quadCount += quadCount;
+		}
+		else
+		{
+			Batch::Range range;
+			range.style = style;
+			range.firstQuad = firstQuad;
+			range.quadCount = quadCount;
+			batch.ranges.push_back(range);
+		}
+	};
 
-	GraphicsDevice* device = wiRenderer::GetDevice();
-	device->EventBegin("Font", threadID);
+	if (props.shadowColor.a > 0)
+	{
+		// font shadow render:
+		addQuads((float)posX + 1, (float)posY + 1, props.shadowColor);
+	}
+	// font base render:
+	addQuads((float)posX, (float)posY, props.color);
 
-	device->BindGraphicsPSO(PSO, threadID);
+	if (batch.depth == 0)
+	{
+		Flush(threadID);
+	}
+}
 
-	UINT vboffset;
-	volatile Vertex* textBuffer = (volatile Vertex*)device->AllocateFromRingBuffer(vertexBuffer, sizeof(Vertex) * text.length() * 4, vboffset, threadID);
-	if (textBuffer == nullptr)
+void wiFont::BatchBegin(GRAPHICSTHREAD threadID)
+{
+	batches[threadID].depth++;
+}
+void wiFont::BatchEnd(GRAPHICSTHREAD threadID)
+{
+	Batch& batch = batches[threadID];
+	assert(batch.depth > 0 && "BatchEnd without BatchBegin!");
+	batch.depth--;
+	if (batch.depth == 0)
+	{
+		Flush(threadID);
+	}
+}
+void wiFont::Flush(GRAPHICSTHREAD threadID)
+{
+	Batch& batch = batches[threadID];
+	if (batch.vertices.empty())
 	{
 		return;
 	}
-	ModifyGeo(textBuffer, text, newProps, style);
-	device->InvalidateBufferAccess(vertexBuffer, threadID);
-
-	GPUBuffer* vbs[] = {
-		vertexBuffer,
-	};
-	const UINT strides[] = {
-		sizeof(Vertex),
-	};
-	const UINT offsets[] = {
-		vboffset,
-	};
-	device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
 
-	assert(text.length() * 4 < 65536 && "The index buffer currently only supports so many characters!");
-	device->BindIndexBuffer(indexBuffer, INDEXFORMAT_16BIT, 0, threadID);
+	GraphicsDevice* device = wiRenderer::GetDevice();
+	device->EventBegin("Font", threadID);
 
-	device->BindResource(PS, fontStyles[style].texture, TEXSLOT_ONDEMAND1, threadID);
+	device->BindGraphicsPSO(PSO, threadID);
+	device->BindIndexBuffer(indexBuffer, INDEXFORMAT_32BIT, 0, threadID);
 
+	// Positions are already in screen space, colors are per vertex:
 	wiRenderer::MiscCB cb;
+	cb.mTransform = XMMatrixTranspose(device->GetScreenProjection());
+	cb.mColor = XMFLOAT4(1, 1, 1, 1);
+	device->UpdateBuffer(wiRenderer::constantBuffers[CBTYPE_MISC], &cb, threadID);
 
-	if (newProps.shadowColor.a > 0)
+	int boundStyle = -1;
+	const uint32_t totalQuads = (uint32_t)batch.vertices.size() / 4;
+	for (uint32_t chunkBegin = 0; chunkBegin < totalQuads; chunkBegin += MAX_BATCH_QUADS)
 	{
-		// font shadow render:
-		cb.mTransform = XMMatrixTranspose(
-			XMMatrixTranslation((float)newProps.posX + 1, (float)newProps.posY + 1, 0)
-			* device->GetScreenProjection()
-		);
-		cb.mColor = XMFLOAT4(newProps.shadowColor.R, newProps.shadowColor.G, newProps.shadowColor.B, newProps.shadowColor.A);
-		device->UpdateBuffer(wiRenderer::constantBuffers[CBTYPE_MISC], &cb, threadID);
-
-		device->DrawIndexed((int)text.length() * 6, 0, 0, threadID);
-	}
+		const uint32_t chunkQuads = min((uint32_t)MAX_BATCH_QUADS, totalQuads - chunkBegin);
 
-	// font base render:
-	cb.mTransform = XMMatrixTranspose(
-		XMMatrixTranslation((float)newProps.posX, (float)newProps.posY, 0)
-		* device->GetScreenProjection()
-	);
-	cb.mColor = XMFLOAT4(newProps.color.R, newProps.color.G, newProps.color.B, newProps.color.A);
-	device->UpdateBuffer(wiRenderer::constantBuffers[CBTYPE_MISC], &cb, threadID);
+		UINT vboffset;
+		void* textBuffer = device->AllocateFromRingBuffer(vertexBuffer, sizeof(Vertex) * chunkQuads * 4, vboffset, threadID);
+		if (textBuffer == nullptr)
+		{
+			break;
+		}
+		memcpy(textBuffer, &batch.vertices[chunkBegin * 4], sizeof(Vertex) * chunkQuads * 4);
+		device->InvalidateBufferAccess(vertexBuffer, threadID);
+
+		GPUBuffer* vbs[] = {
+			vertexBuffer,
+		};
+		const UINT strides[] = {
+			sizeof(Vertex),
+		};
+		const UINT offsets[] = {
+			vboffset,
+		};
+		device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
+
+		// One draw for every run of quads with the same style inside the chunk:
+		for (const Batch::Range& range : batch.ranges)
+		{
+			const uint32_t begin = max(range.firstQuad, chunkBegin);
+			const uint32_t end = min(range.firstQuad + range.quadCount, chunkBegin + chunkQuads);
+			if (begin >= end)
+			{
+				continue;
+			}
+			if (range.style != boundStyle)
+			{
+				device->BindResource(PS, fontStyles[range.style].texture, TEXSLOT_ONDEMAND1, threadID);
+				boundStyle = range.style;
+			}
+			device->DrawIndexed((int)(end - begin) * 6, 0, (begin - chunkBegin) * 4, threadID);
+		}
+	}
 
-	device->DrawIndexed((int)text.length() * 6, 0, 0, threadID);
+	batch.vertices.clear();
+	batch.ranges.clear();
 
 	device->EventEnd(threadID);
 }
@@ -348,49 +442,11 @@ void wiFont::Draw(GRAPHICSTHREAD threadID)
 
 int wiFont::textWidth()
 {
-	int maxWidth = 0;
-	int currentLineWidth = 0;
-	const float relativeSize = (props.size < 0 ? 1.0f : (float)props.size / (float)fontStyles[style].lineHeight);
-	for (size_t i = 0; i < text.length(); ++i)
-	{
-		if (text[i] == '\n')
-		{
-			currentLineWidth = 0;
-		}
-		else if (text[i] == ' ')
-		{
-			currentLineWidth += WHITESPACE_SIZE + props.spacingX;
-		}
-		else if (text[i] == '\t')
-		{
-			currentLineWidth += (WHITESPACE_SIZE + props.spacingX) * 5;
-		}
-		else
-		{
-			int characterWidth = (int)(fontStyles[style].lookup[text[i]].pixelWidth * relativeSize);
-			currentLineWidth += characterWidth + props.spacingX;
-		}
-		maxWidth = max(maxWidth, currentLineWidth);
-	}
-
-	return maxWidth;
+	return GetLayout(text, props, style).width;
 }
 int wiFont::textHeight()
 {
-	int i=0;
-	int lines=1;
-	int len=(int)text.length();
-	while(i<len)
-	{
-		if(text[i]=='\n')
-		{
-			lines++;
-		}
-		i++;
-	}
-
-	const int lineHeight = (props.size < 0 ? fontStyles[style].lineHeight : props.size);
-	return lines*(lineHeight + props.spacingY);
+	return GetLayout(text, props, style).height;
 }
 
 
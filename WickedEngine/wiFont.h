@@ -44,6 +44,7 @@ protected:
 	{
 		XMFLOAT2 Pos;
 		XMHALF2 Tex;
+		uint32_t Color; // R8G8B8A8
 	};
 	static wiGraphicsTypes::GPURingBuffer       *vertexBuffer;
 	static wiGraphicsTypes::GPUBuffer           *indexBuffer;
@@ -87,7 +88,32 @@ private:
 	static std::vector<wiFontStyle> fontStyles;
 
 
-	static void ModifyGeo(volatile Vertex* vertexList, const std::wstring& text, wiFontProps props, int style);
+	// Glyph quads of a text relative to its top left corner, and its size. Layouts are cached per thread by (text, size, spacing, style),
+	//	so a text that doesn't change is not laid out again every frame, even if it is drawn by a temporary wiFont.
+	struct Layout
+	{
+		std::wstring text;
+		int size = 0, spacingX = 0, spacingY = 0, style = 0;
+		std::vector<Vertex> vertices; // 4 per visible glyph, color is not used
+		int width = 0, height = 0;
+		uint64_t lastUsedFrame = 0;
+	};
+	static const Layout& GetLayout(const std::wstring& text, const wiFontProps& props, int style);
+
+	// Glyph quads of the Draw calls on a thread are collected here, then uploaded with a single ring buffer allocation and drawn with one draw call per font style
+	struct Batch
+	{
+		struct Range
+		{
+			int style;
+			uint32_t firstQuad;
+			uint32_t quadCount;
+		};
+		std::vector<Vertex> vertices;
+		std::vector<Range> ranges;
+		int depth = 0; // BatchBegin nesting
+	};
+	static Batch batches[GRAPHICSTHREAD_COUNT];
 
 public:
 	static void Initialize();
@@ -103,8 +129,17 @@ public:
 	~wiFont();
 
 	
+	// Inside a BatchBegin - BatchEnd block the text is only added to the batch of the thread, otherwise it is drawn immediately
 	void Draw(GRAPHICSTHREAD threadID);
 
+	// Texts drawn between these are submitted together at BatchEnd (blocks can be nested, the outermost BatchEnd submits).
+	//	Only put draws inside a block that don't depend on render state changing between them (render targets, scissor);
+	//	wiImage::Draw flushes the batch itself, so images and texts can be mixed.
+	static void BatchBegin(GRAPHICSTHREAD threadID);
+	static void BatchEnd(GRAPHICSTHREAD threadID);
+	// Submit the texts that were collected so far on the thread
+	static void Flush(GRAPHICSTHREAD threadID);
+
 
 	int textWidth();
 	int textHeight();
@@ -2,6 +2,8 @@
 #include "wiWidget.h"
 #include "wiHashString.h"
 #include "wiRenderer.h"
+#include "wiFont.h"
+#include "wiImage.h"
 #include "wiInputManager.h"
 
 using namespace std;
@@ -50,6 +52,8 @@ void wiGUI::Update(float dt)
 void wiGUI::Render()
 {
 	wiRenderer::GetDevice()->EventBegin("GUI", GetGraphicsThread());
+	wiImage::BatchBegin(GetGraphicsThread());
+	wiFont::BatchBegin(GetGraphicsThread());
 	for (auto&x : widgets)
 	{
 		if (x->container == nullptr && x != activeWidget)
@@ -69,6 +73,8 @@ void wiGUI::Render()
 		x->RenderTooltip(this);
 	}
 
+	wiFont::BatchEnd(GetGraphicsThread());
+	wiImage::BatchEnd(GetGraphicsThread());
 	ResetScissor();
 	wiRenderer::GetDevice()->EventEnd(GetGraphicsThread());
 }
@@ -80,6 +86,8 @@ void wiGUI::ResetScissor()
 	scissor[0].left = (LONG)(0);
 	scissor[0].right = (LONG)(wiRenderer::GetDevice()->GetScreenWidth());
 	scissor[0].top = (LONG)(0);
+	wiFont::Flush(GetGraphicsThread());
+	wiImage::Flush(GetGraphicsThread());
 	wiRenderer::GetDevice()->SetScissorRects(1, scissor, GetGraphicsThread());
 }
 
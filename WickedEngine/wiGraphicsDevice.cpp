@@ -1,5 +1,9 @@
 #include "wiGraphicsDevice.h"
 
+#include <fstream>
+#include <cstring>
+
+using namespace std;
 using namespace wiGraphicsTypes;
 
 bool GraphicsDevice::CheckCapability(GRAPHICSDEVICE_CAPABILITY capability)
@@ -56,3 +60,334 @@ uint32_t GraphicsDevice::GetFormatStride(FORMAT value)
 	return 16;
 }
 
+
+
+// FNV-1a hashing of the pipeline descriptions. Fields are hashed one by one, because the descriptor structs have padding.
+static const uint64_t PIPELINEHASH_OFFSET = 14695981039346656037ull;
+static const uint64_t PIPELINEHASH_PRIME = 1099511628211ull;
+static void HashBytes(uint64_t& hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * PIPELINEHASH_PRIME;
+	}
+}
+template<typename T>
+static void HashValue(uint64_t& hash, const T& value)
+{
+	HashBytes(hash, &value, sizeof(value));
+}
+static void HashBool(uint64_t& hash, bool value)
+{
+	HashValue(hash, (uint8_t)(value ? 1 : 0));
+}
+static void HashShader(uint64_t& hash, const ShaderByteCode* code)
+{
+	if (code == nullptr || code->data == nullptr)
+	{
+		HashValue(hash, (uint64_t)0);
+		return;
+	}
+	HashValue(hash, (uint64_t)code->size);
+	HashBytes(hash, code->data, code->size);
+}
+
+uint64_t GraphicsDevice::ComputePipelineHash(const GraphicsPSODesc* pDesc)
+{
+	uint64_t hash = PIPELINEHASH_OFFSET;
+
+	HashShader(hash, pDesc->vs == nullptr ? nullptr : &pDesc->vs->code);
+	HashShader(hash, pDesc->ps == nullptr ? nullptr : &pDesc->ps->code);
+	HashShader(hash, pDesc->hs == nullptr ? nullptr : &pDesc->hs->code);
+	HashShader(hash, pDesc->ds == nullptr ? nullptr : &pDesc->ds->code);
+	HashShader(hash, pDesc->gs == nullptr ? nullptr : &pDesc->gs->code);
+
+	HashBool(hash, pDesc->bs != nullptr);
+	if (pDesc->bs != nullptr)
+	{
+		const BlendStateDesc& desc = pDesc->bs->desc;
+		HashBool(hash, desc.AlphaToCoverageEnable);
+		HashBool(hash, desc.IndependentBlendEnable);
+		for (int i = 0; i < ARRAYSIZE(desc.RenderTarget); ++i)
+		{
+			const RenderTargetBlendStateDesc& rt = desc.RenderTarget[i];
+			HashBool(hash, rt.BlendEnable);
+			HashValue(hash, rt.SrcBlend);
+			HashValue(hash, rt.DestBlend);
+			HashValue(hash, rt.BlendOp);
+			HashValue(hash, rt.SrcBlendAlpha);
+			HashValue(hash, rt.DestBlendAlpha);
+			HashValue(hash, rt.BlendOpAlpha);
+			HashValue(hash, rt.RenderTargetWriteMask);
+		}
+	}
+
+	HashBool(hash, pDesc->rs != nullptr);
+	if (pDesc->rs != nullptr)
+	{
+		const RasterizerStateDesc& desc = pDesc->rs->desc;
+		HashValue(hash, desc.FillMode);
+		HashValue(hash, desc.CullMode);
+		HashBool(hash, desc.FrontCounterClockwise);
+		HashValue(hash, desc.DepthBias);
+		HashValue(hash, desc.DepthBiasClamp);
+		HashValue(hash, desc.SlopeScaledDepthBias);
+		HashBool(hash, desc.DepthClipEnable);
+		HashBool(hash, desc.MultisampleEnable);
+		HashBool(hash, desc.AntialiasedLineEnable);
+		HashBool(hash, desc.ConservativeRasterizationEnable);
+		HashValue(hash, desc.ForcedSampleCount);
+	}
+
+	HashBool(hash, pDesc->dss != nullptr);
+	if (pDesc->dss != nullptr)
+	{
+		const DepthStencilStateDesc& desc = pDesc->dss->desc;
+		HashBool(hash, desc.DepthEnable);
+		HashValue(hash, desc.DepthWriteMask);
+		HashValue(hash, desc.DepthFunc);
+		HashBool(hash, desc.StencilEnable);
+		HashValue(hash, desc.StencilReadMask);
+		HashValue(hash, desc.StencilWriteMask);
+		for (const DepthStencilOpDesc* op : { &desc.FrontFace, &desc.BackFace })
+		{
+			HashValue(hash, op->StencilFailOp);
+			HashValue(hash, op->StencilDepthFailOp);
+			HashValue(hash, op->StencilPassOp);
+			HashValue(hash, op->StencilFunc);
+		}
+	}
+
+	HashBool(hash, pDesc->il != nullptr);
+	if (pDesc->il != nullptr)
+	{
+		HashValue(hash, (uint64_t)pDesc->il->desc.size());
+		for (const VertexLayoutDesc& element : pDesc->il->desc)
+		{
+			if (element.SemanticName != nullptr)
+			{
+				HashBytes(hash, element.SemanticName, strlen(element.SemanticName));
+			}
+			HashValue(hash, element.SemanticIndex);
+			HashValue(hash, element.Format);
+			HashValue(hash, element.InputSlot);
+			HashValue(hash, element.AlignedByteOffset);
+			HashValue(hash, element.InputSlotClass);
+			HashValue(hash, element.InstanceDataStepRate);
+		}
+	}
+
+	HashValue(hash, pDesc->pt);
+	HashValue(hash, pDesc->numRTs);
+	for (UINT i = 0; i < pDesc->numRTs && i < ARRAYSIZE(pDesc->RTFormats); ++i)
+	{
+		HashValue(hash, pDesc->RTFormats[i]);
+	}
+	HashValue(hash, pDesc->DSFormat);
+	HashValue(hash, pDesc->sampleDesc.Count);
+	HashValue(hash, pDesc->sampleDesc.Quality);
+	HashValue(hash, pDesc->sampleMask);
+
+	return hash;
+}
+uint64_t GraphicsDevice::ComputePipelineHash(const ComputePSODesc* pDesc)
+{
+	uint64_t hash = PIPELINEHASH_OFFSET;
+	HashValue(hash, (uint32_t)0xC0C0C0C0); // compute pipelines never share keys with graphics pipelines
+	HashShader(hash, pDesc->cs == nullptr ? nullptr : &pDesc->cs->code);
+	return hash;
+}
+
+bool GraphicsDevice::FindPipelineCacheEntry(uint64_t key, std::vector<uint8_t>& data)
+{
+	std::lock_guard<std::mutex> lock(pipelineCacheMutex);
+	auto it = pipelineCacheEntries.find(key);
+	if (it == pipelineCacheEntries.end())
+	{
+		pipelineCacheStats.misses++;
+		return false;
+	}
+	pipelineCacheStats.hits++;
+	pipelineCacheUsed.insert(key);
+	data = it->second;
+	return true;
+}
+void GraphicsDevice::StorePipelineCacheEntry(uint64_t key, const void* data, size_t size)
+{
+	std::lock_guard<std::mutex> lock(pipelineCacheMutex);
+	pipelineCacheUsed.insert(key);
+	std::vector<uint8_t>& entry = pipelineCacheEntries[key];
+	entry.resize(size);
+	if (size > 0)
+	{
+		memcpy(entry.data(), data, size);
+	}
+}
+void GraphicsDevice::InvalidatePipelineCacheEntry(uint64_t key)
+{
+	std::lock_guard<std::mutex> lock(pipelineCacheMutex);
+	if (pipelineCacheEntries.erase(key) > 0 && pipelineCacheStats.hits > 0)
+	{
+		pipelineCacheStats.hits--;
+		pipelineCacheStats.misses++;
+	}
+}
+GraphicsDevice::PipelineCacheStats GraphicsDevice::GetPipelineCacheStats()
+{
+	std::lock_guard<std::mutex> lock(pipelineCacheMutex);
+	return pipelineCacheStats;
+}
+void GraphicsDevice::ResetPipelineCacheStats()
+{
+	std::lock_guard<std::mutex> lock(pipelineCacheMutex);
+	pipelineCacheStats = PipelineCacheStats();
+}
+void GraphicsDevice::ResetPipelineCacheUsage()
+{
+	std::lock_guard<std::mutex> lock(pipelineCacheMutex);
+	pipelineCacheUsed.clear();
+}
+void GraphicsDevice::EvictUnusedPipelineCacheEntries()
+{
+	std::lock_guard<std::mutex> lock(pipelineCacheMutex);
+	for (auto it = pipelineCacheEntries.begin(); it != pipelineCacheEntries.end();)
+	{
+		if (pipelineCacheUsed.count(it->first) == 0)
+		{
+			it = pipelineCacheEntries.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+// Pipeline cache file layout:
+//	magic, format version, backend name, backend data, entry count, entries (key, data)
+static const uint32_t PIPELINECACHE_MAGIC = 0x43504957; // "WIPC"
+static const uint32_t PIPELINECACHE_VERSION = 1;
+
+// Bounds checked reading of the cache file, a truncated or corrupt file is just ignored
+struct PipelineCacheReader
+{
+	const uint8_t* data;
+	size_t size;
+	size_t pos = 0;
+
+	bool read(void* dest, size_t count)
+	{
+		if (pos + count > size)
+		{
+			return false;
+		}
+		memcpy(dest, data + pos, count);
+		pos += count;
+		return true;
+	}
+	bool read(std::vector<uint8_t>& dest)
+	{
+		uint64_t count;
+		if (!read(&count, sizeof(count)) || pos + count > size)
+		{
+			return false;
+		}
+		dest.assign(data + pos, data + pos + count);
+		pos += (size_t)count;
+		return true;
+	}
+};
+static void WriteBlob(ofstream& file, const void* data, uint64_t size)
+{
+	file.write((const char*)&size, sizeof(size));
+	if (size > 0)
+	{
+		file.write((const char*)data, size);
+	}
+}
+
+bool GraphicsDevice::LoadPipelineCache(const std::string& fileName)
+{
+	// Not using wiHelper::readByteData, because a missing cache (first start) is not an error
+	ifstream file(fileName, ios::binary | ios::ate);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	std::vector<uint8_t> fileData((size_t)file.tellg());
+	file.seekg(0, file.beg);
+	file.read((char*)fileData.data(), fileData.size());
+	file.close();
+
+	PipelineCacheReader reader;
+	reader.data = fileData.data();
+	reader.size = fileData.size();
+
+	bool success = false;
+	uint32_t magic = 0, version = 0;
+	std::vector<uint8_t> backendName, backendData;
+	uint64_t entryCount = 0;
+	const std::string expectedBackendName = GetPipelineCacheBackendName();
+	if (reader.read(&magic, sizeof(magic)) && magic == PIPELINECACHE_MAGIC &&
+		reader.read(&version, sizeof(version)) && version == PIPELINECACHE_VERSION &&
+		reader.read(backendName) && std::string(backendName.begin(), backendName.end()) == expectedBackendName &&
+		reader.read(backendData) &&
+		reader.read(&entryCount, sizeof(entryCount)))
+	{
+		std::unordered_map<uint64_t, std::vector<uint8_t>> entries;
+		success = true;
+		for (uint64_t i = 0; i < entryCount && success; ++i)
+		{
+			uint64_t key;
+			success = reader.read(&key, sizeof(key)) && reader.read(entries[key]);
+		}
+
+		if (success)
+		{
+			{
+				std::lock_guard<std::mutex> lock(pipelineCacheMutex);
+				pipelineCacheEntries.insert(entries.begin(), entries.end());
+			}
+			if (!backendData.empty())
+			{
+				SetPipelineCacheData(backendData);
+			}
+		}
+	}
+
+	return success;
+}
+bool GraphicsDevice::SavePipelineCache(const std::string& fileName)
+{
+	std::vector<uint8_t> backendData;
+	GetPipelineCacheData(backendData);
+
+	std::lock_guard<std::mutex> lock(pipelineCacheMutex);
+	if (pipelineCacheEntries.empty() && backendData.empty())
+	{
+		// The backend doesn't compile pipeline states (DX11)
+		return false;
+	}
+
+	ofstream file(fileName, ios::binary | ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	const std::string backendName = GetPipelineCacheBackendName();
+	file.write((const char*)&PIPELINECACHE_MAGIC, sizeof(PIPELINECACHE_MAGIC));
+	file.write((const char*)&PIPELINECACHE_VERSION, sizeof(PIPELINECACHE_VERSION));
+	WriteBlob(file, backendName.c_str(), backendName.length());
+	WriteBlob(file, backendData.data(), backendData.size());
+	const uint64_t entryCount = pipelineCacheEntries.size();
+	file.write((const char*)&entryCount, sizeof(entryCount));
+	for (auto& x : pipelineCacheEntries)
+	{
+		file.write((const char*)&x.first, sizeof(x.first));
+		WriteBlob(file, x.second.data(), x.second.size());
+	}
+
+	return file.good();
+}
@@ -7,6 +7,11 @@
 #include "wiGraphicsDescriptors.h"
 #include "wiGraphicsResource.h"
 
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 namespace wiGraphicsTypes
 {
 
@@ -86,6 +91,31 @@ namespace wiGraphicsTypes
 		FORMAT GetBackBufferFormat() { return BACKBUFFER_FORMAT; }
 		static UINT GetBackBufferCount() { return BACKBUFFER_COUNT; }
 
+		// Persistent pipeline cache: pipeline states are identified by a hash of their description and shader bytecode,
+		//	and the data that the backend compiled them into is saved to disk, so the next run can skip the compilation.
+		//	Load the cache before creating pipeline states, and save it after the pipeline states of the application were created.
+		struct PipelineCacheStats
+		{
+			uint32_t hits = 0;		// pipeline states that were found in the cache
+			uint32_t misses = 0;	// pipeline states that had to be compiled from scratch
+		};
+		bool LoadPipelineCache(const std::string& fileName);
+		bool SavePipelineCache(const std::string& fileName);
+		PipelineCacheStats GetPipelineCacheStats();
+		void ResetPipelineCacheStats();
+		// When the shaders are reloaded, the entries of the replaced shaders are not needed any more. Reset the usage before reloading,
+		//	then evict the entries that were not looked up or stored since then, so that they are not kept and saved forever.
+		void ResetPipelineCacheUsage();
+		void EvictUnusedPipelineCacheEntries();
+
+		// Buffer update statistics of the last presented frame, for backends that record buffer updates as GPU copies
+		struct UploadStats
+		{
+			uint32_t uploads = 0;	// buffer copies recorded from the staging memory
+			uint32_t barriers = 0;	// pipeline barriers recorded around those copies
+		};
+		const UploadStats& GetUploadStats() const { return uploadStats; }
+
 
 		///////////////Thread-sensitive////////////////////////
 
@@ -141,6 +171,31 @@ namespace wiGraphicsTypes
 		virtual void EventBegin(const std::string& name, GRAPHICSTHREAD threadID) = 0;
 		virtual void EventEnd(GRAPHICSTHREAD threadID) = 0;
 		virtual void SetMarker(const std::string& name, GRAPHICSTHREAD threadID) = 0;
+
+	protected:
+		UploadStats uploadStats;
+
+		// Key of the pipeline state in the persistent pipeline cache
+		static uint64_t ComputePipelineHash(const GraphicsPSODesc* pDesc);
+		static uint64_t ComputePipelineHash(const ComputePSODesc* pDesc);
+		// Look up the data that was stored for a pipeline state, this also counts the cache hits and misses
+		bool FindPipelineCacheEntry(uint64_t key, std::vector<uint8_t>& data);
+		// Store the data of a pipeline state (can be empty if the backend only needs the key to be tracked)
+		void StorePipelineCacheEntry(uint64_t key, const void* data, size_t size);
+		// The stored data of a pipeline state was rejected by the backend (different driver or adapter), it is counted as a miss instead
+		void InvalidatePipelineCacheEntry(uint64_t key);
+
+		// Backends that have a single cache object for all pipeline states (like VkPipelineCache) exchange its data here.
+		//	The backend name is saved with the cache, so files from an other backend are not used.
+		virtual const char* GetPipelineCacheBackendName() { return ""; }
+		virtual void SetPipelineCacheData(const std::vector<uint8_t>& data) {}
+		virtual void GetPipelineCacheData(std::vector<uint8_t>& data) {}
+
+	private:
+		std::mutex pipelineCacheMutex;
+		std::unordered_map<uint64_t, std::vector<uint8_t>> pipelineCacheEntries;
+		std::unordered_set<uint64_t> pipelineCacheUsed;
+		PipelineCacheStats pipelineCacheStats;
 	};
 
 }
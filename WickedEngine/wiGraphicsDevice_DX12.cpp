@@ -2968,9 +2968,30 @@ namespace wiGraphicsTypes
 
 		desc.pRootSignature = graphicsRootSig;
 
+		// Creating from the cached blob skips the shader compilation in the driver. The blob is rejected if the driver or adapter changed since it was saved.
+		const uint64_t cacheKey = ComputePipelineHash(pDesc);
+		std::vector<uint8_t> cachedBlob;
+		const bool cached = FindPipelineCacheEntry(cacheKey, cachedBlob) && !cachedBlob.empty();
+		if (cached)
+		{
+			desc.CachedPSO.pCachedBlob = cachedBlob.data();
+			desc.CachedPSO.CachedBlobSizeInBytes = cachedBlob.size();
+		}
+
 		HRESULT hr = device->CreateGraphicsPipelineState(&desc, __uuidof(ID3D12PipelineState), (void**)&pso->resource_DX12);
+		if (FAILED(hr) && cached)
+		{
+			InvalidatePipelineCacheEntry(cacheKey);
+			desc.CachedPSO = {};
+			hr = device->CreateGraphicsPipelineState(&desc, __uuidof(ID3D12PipelineState), (void**)&pso->resource_DX12);
+		}
 		assert(SUCCEEDED(hr));
 
+		if (SUCCEEDED(hr) && desc.CachedPSO.pCachedBlob == nullptr)
+		{
+			StorePipelineCachedBlob(cacheKey, pso->resource_DX12);
+		}
+
 		SAFE_DELETE_ARRAY(elements);
 
 		return hr;
@@ -2989,11 +3010,40 @@ namespace wiGraphicsTypes
 
 		desc.pRootSignature = computeRootSig;
 
+		const uint64_t cacheKey = ComputePipelineHash(pDesc);
+		std::vector<uint8_t> cachedBlob;
+		const bool cached = FindPipelineCacheEntry(cacheKey, cachedBlob) && !cachedBlob.empty();
+		if (cached)
+		{
+			desc.CachedPSO.pCachedBlob = cachedBlob.data();
+			desc.CachedPSO.CachedBlobSizeInBytes = cachedBlob.size();
+		}
+
 		HRESULT hr = device->CreateComputePipelineState(&desc, __uuidof(ID3D12PipelineState), (void**)&pso->resource_DX12);
+		if (FAILED(hr) && cached)
+		{
+			InvalidatePipelineCacheEntry(cacheKey);
+			desc.CachedPSO = {};
+			hr = device->CreateComputePipelineState(&desc, __uuidof(ID3D12PipelineState), (void**)&pso->resource_DX12);
+		}
 		assert(SUCCEEDED(hr));
 
+		if (SUCCEEDED(hr) && desc.CachedPSO.pCachedBlob == nullptr)
+		{
+			StorePipelineCachedBlob(cacheKey, pso->resource_DX12);
+		}
+
 		return hr;
 	}
+	void GraphicsDevice_DX12::StorePipelineCachedBlob(uint64_t cacheKey, ID3D12PipelineState* pipelineState)
+	{
+		ID3DBlob* blob = nullptr;
+		if (SUCCEEDED(pipelineState->GetCachedBlob(&blob)) && blob != nullptr)
+		{
+			StorePipelineCacheEntry(cacheKey, blob->GetBufferPointer(), blob->GetBufferSize());
+			blob->Release();
+		}
+	}
 
 
 	void GraphicsDevice_DX12::PresentBegin()
@@ -138,6 +138,11 @@ namespace wiGraphicsTypes
 		IDXGISwapChain3*			swapChain;
 		ViewPort					viewPort;
 
+		// Store the compiled blob of a newly created pipeline state in the persistent pipeline cache
+		void StorePipelineCachedBlob(uint64_t cacheKey, ID3D12PipelineState* pipelineState);
+
+	protected:
+		virtual const char* GetPipelineCacheBackendName() override { return "DX12"; }
 
 	public:
 		GraphicsDevice_DX12(wiWindowRegistration::window_type window, bool fullscreen = false, bool debuglayer = false);
@@ -0,0 +1,567 @@
+#include "wiGraphicsDevice_Null.h"
+
+#include <fstream>
+
+using namespace std;
+
+namespace wiGraphicsTypes
+{
+
+void GraphicsDevice_Null::Counters::operator+=(const Counters& other)
+{
+	commands += other.commands;
+	drawCalls += other.drawCalls;
+	dispatches += other.dispatches;
+	binds += other.binds;
+	stateChanges += other.stateChanges;
+	vertices += other.vertices;
+	bytesUploaded += other.bytesUploaded;
+}
+
+void GraphicsDevice_Null::CommandList::record(COMMAND_TYPE type, uint32_t arg0, uint32_t arg1, const void* object)
+{
+	Command command;
+	command.type = type;
+	command.arg0 = arg0;
+	command.arg1 = arg1;
+	command.object = object;
+	commands.push_back(command);
+	counters.commands++;
+}
+void GraphicsDevice_Null::CommandList::clear()
+{
+	// the memory of the command stream is kept for the next frame
+	commands.clear();
+	counters = Counters();
+}
+
+// Bytes of the initial data of a texture, only the first mip level of every slice is counted
+static uint64_t GetInitialDataSize(const TextureDesc* pDesc, const SubresourceData *pInitialData)
+{
+	uint64_t size = 0;
+	if (pInitialData != nullptr)
+	{
+		for (UINT slice = 0; slice < pDesc->ArraySize; ++slice)
+		{
+			const SubresourceData& data = pInitialData[slice];
+			size += data.SysMemSlicePitch > 0 ? (uint64_t)data.SysMemSlicePitch * max(1u, pDesc->Depth) : (uint64_t)data.SysMemPitch * max(1u, pDesc->Height);
+		}
+	}
+	return size;
+}
+
+
+// Engine functions
+
+GraphicsDevice_Null::GraphicsDevice_Null(int width, int height) : GraphicsDevice()
+{
+	SCREENWIDTH = width;
+	SCREENHEIGHT = height;
+
+	// Report every capability, so that the renderer prepares the same work as on a capable GPU:
+	TESSELLATION = true;
+	MULTITHREADED_RENDERING = true;
+	CONSERVATIVE_RASTERIZATION = true;
+	RASTERIZER_ORDERED_VIEWS = true;
+	UNORDEREDACCESSTEXTURE_LOAD_EXT = true;
+}
+GraphicsDevice_Null::~GraphicsDevice_Null()
+{
+}
+
+void GraphicsDevice_Null::SetResolution(int width, int height)
+{
+	if (width != SCREENWIDTH || height != SCREENHEIGHT)
+	{
+		SCREENWIDTH = width;
+		SCREENHEIGHT = height;
+		RESOLUTIONCHANGED = true;
+	}
+}
+
+Texture2D GraphicsDevice_Null::GetBackBuffer()
+{
+	Texture2D result;
+	result.desc.Width = SCREENWIDTH;
+	result.desc.Height = SCREENHEIGHT;
+	result.desc.Format = GetBackBufferFormat();
+	result.desc.BindFlags = BIND_RENDER_TARGET;
+	return result;
+}
+
+HRESULT GraphicsDevice_Null::CreateBuffer(const GPUBufferDesc *pDesc, const SubresourceData* pInitialData, GPUBuffer *ppBuffer)
+{
+	ppBuffer->desc = *pDesc;
+	ppBuffer->memory_Null.resize(max(1u, pDesc->ByteWidth));
+
+	if (pInitialData != nullptr && pInitialData->pSysMem != nullptr)
+	{
+		memcpy(ppBuffer->memory_Null.data(), pInitialData->pSysMem, pDesc->ByteWidth);
+		initialDataBytes.fetch_add(pDesc->ByteWidth);
+	}
+
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateTexture1D(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture1D **ppTexture1D)
+{
+	if ((*ppTexture1D) == nullptr)
+	{
+		(*ppTexture1D) = new Texture1D;
+	}
+	(*ppTexture1D)->desc = *pDesc;
+	initialDataBytes.fetch_add(GetInitialDataSize(pDesc, pInitialData));
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateTexture2D(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture2D **ppTexture2D)
+{
+	if ((*ppTexture2D) == nullptr)
+	{
+		(*ppTexture2D) = new Texture2D;
+	}
+	(*ppTexture2D)->desc = *pDesc;
+	initialDataBytes.fetch_add(GetInitialDataSize(pDesc, pInitialData));
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateTexture3D(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture3D **ppTexture3D)
+{
+	if ((*ppTexture3D) == nullptr)
+	{
+		(*ppTexture3D) = new Texture3D;
+	}
+	(*ppTexture3D)->desc = *pDesc;
+	initialDataBytes.fetch_add(GetInitialDataSize(pDesc, pInitialData));
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateInputLayout(const VertexLayoutDesc *pInputElementDescs, UINT NumElements,
+	const void *pShaderBytecodeWithInputSignature, SIZE_T BytecodeLength, VertexLayout *pInputLayout)
+{
+	pInputLayout->desc.assign(pInputElementDescs, pInputElementDescs + NumElements);
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateVertexShader(const void *pShaderBytecode, SIZE_T BytecodeLength, VertexShader *pVertexShader)
+{
+	pVertexShader->code.data = new BYTE[BytecodeLength];
+	memcpy(pVertexShader->code.data, pShaderBytecode, BytecodeLength);
+	pVertexShader->code.size = BytecodeLength;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreatePixelShader(const void *pShaderBytecode, SIZE_T BytecodeLength, PixelShader *pPixelShader)
+{
+	pPixelShader->code.data = new BYTE[BytecodeLength];
+	memcpy(pPixelShader->code.data, pShaderBytecode, BytecodeLength);
+	pPixelShader->code.size = BytecodeLength;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateGeometryShader(const void *pShaderBytecode, SIZE_T BytecodeLength, GeometryShader *pGeometryShader)
+{
+	pGeometryShader->code.data = new BYTE[BytecodeLength];
+	memcpy(pGeometryShader->code.data, pShaderBytecode, BytecodeLength);
+	pGeometryShader->code.size = BytecodeLength;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateHullShader(const void *pShaderBytecode, SIZE_T BytecodeLength, HullShader *pHullShader)
+{
+	pHullShader->code.data = new BYTE[BytecodeLength];
+	memcpy(pHullShader->code.data, pShaderBytecode, BytecodeLength);
+	pHullShader->code.size = BytecodeLength;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateDomainShader(const void *pShaderBytecode, SIZE_T BytecodeLength, DomainShader *pDomainShader)
+{
+	pDomainShader->code.data = new BYTE[BytecodeLength];
+	memcpy(pDomainShader->code.data, pShaderBytecode, BytecodeLength);
+	pDomainShader->code.size = BytecodeLength;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateComputeShader(const void *pShaderBytecode, SIZE_T BytecodeLength, ComputeShader *pComputeShader)
+{
+	pComputeShader->code.data = new BYTE[BytecodeLength];
+	memcpy(pComputeShader->code.data, pShaderBytecode, BytecodeLength);
+	pComputeShader->code.size = BytecodeLength;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateBlendState(const BlendStateDesc *pBlendStateDesc, BlendState *pBlendState)
+{
+	pBlendState->desc = *pBlendStateDesc;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateDepthStencilState(const DepthStencilStateDesc *pDepthStencilStateDesc, DepthStencilState *pDepthStencilState)
+{
+	pDepthStencilState->desc = *pDepthStencilStateDesc;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateRasterizerState(const RasterizerStateDesc *pRasterizerStateDesc, RasterizerState *pRasterizerState)
+{
+	pRasterizerState->desc = *pRasterizerStateDesc;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateSamplerState(const SamplerDesc *pSamplerDesc, Sampler *pSamplerState)
+{
+	pSamplerState->desc = *pSamplerDesc;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateQuery(const GPUQueryDesc *pDesc, GPUQuery *pQuery)
+{
+	// The query has no native resource, so it is not valid for occlusion culling, but it can be read (timestamps are zero)
+	pQuery->desc = *pDesc;
+	pQuery->async_frameshift = 0;
+	pQuery->active.resize(1);
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateGraphicsPSO(const GraphicsPSODesc* pDesc, GraphicsPSO* pso)
+{
+	pso->desc = *pDesc;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateComputePSO(const ComputePSODesc* pDesc, ComputePSO* pso)
+{
+	pso->desc = *pDesc;
+	return S_OK;
+}
+
+
+void GraphicsDevice_Null::PresentBegin()
+{
+	LOCK();
+
+	ViewPort viewPort;
+	viewPort.Width = (FLOAT)SCREENWIDTH;
+	viewPort.Height = (FLOAT)SCREENHEIGHT;
+	BindViewports(1, &viewPort, GRAPHICSTHREAD_IMMEDIATE);
+	commandLists[GRAPHICSTHREAD_IMMEDIATE].record(COMMAND_BIND_RENDERTARGETS, 1);
+	commandLists[GRAPHICSTHREAD_IMMEDIATE].counters.stateChanges++;
+	commandLists[GRAPHICSTHREAD_IMMEDIATE].record(COMMAND_CLEAR, 1);
+}
+void GraphicsDevice_Null::PresentEnd()
+{
+	SubmitCommandList(GRAPHICSTHREAD_IMMEDIATE);
+	frameCounters.bytesUploaded += initialDataBytes.exchange(0);
+
+	lastFrameCommands.swap(frameCommands);
+	lastFrameCounters = frameCounters;
+	frameCommands.clear();
+	frameCounters = Counters();
+
+	FRAMECOUNT++;
+
+	RESOLUTIONCHANGED = false;
+
+	UNLOCK();
+}
+
+void GraphicsDevice_Null::SubmitCommandList(GRAPHICSTHREAD threadID)
+{
+	CommandList& commandList = commandLists[threadID];
+	frameCommands.insert(frameCommands.end(), commandList.commands.begin(), commandList.commands.end());
+	frameCounters += commandList.counters;
+	commandList.clear();
+}
+
+void GraphicsDevice_Null::ExecuteDeferredContexts()
+{
+	// Submit what the immediate context recorded so far, so the frame stream keeps the execution order:
+	SubmitCommandList(GRAPHICSTHREAD_IMMEDIATE);
+	for (int i = 0; i < GRAPHICSTHREAD_COUNT; i++)
+	{
+		if (i != GRAPHICSTHREAD_IMMEDIATE)
+		{
+			SubmitCommandList((GRAPHICSTHREAD)i);
+		}
+	}
+}
+void GraphicsDevice_Null::FinishCommandList(GRAPHICSTHREAD thread)
+{
+	// The command list of the thread is kept until ExecuteDeferredContexts
+}
+
+void GraphicsDevice_Null::BindViewports(UINT NumViewports, const ViewPort *pViewports, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BIND_VIEWPORTS, NumViewports);
+	commandLists[threadID].counters.stateChanges++;
+}
+void GraphicsDevice_Null::BindRenderTargetsUAVs(UINT NumViews, Texture2D* const *ppRenderTargets, Texture2D* depthStencilTexture, GPUResource* const *ppUAVs, int slotUAV, int countUAV,
+	GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	commandLists[threadID].record(COMMAND_BIND_RENDERTARGETS, NumViews, (uint32_t)countUAV, depthStencilTexture);
+	commandLists[threadID].counters.stateChanges++;
+}
+void GraphicsDevice_Null::BindRenderTargets(UINT NumViews, Texture2D* const *ppRenderTargets, Texture2D* depthStencilTexture, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	commandLists[threadID].record(COMMAND_BIND_RENDERTARGETS, NumViews, 0, depthStencilTexture);
+	commandLists[threadID].counters.stateChanges++;
+}
+void GraphicsDevice_Null::ClearRenderTarget(Texture* pTexture, const FLOAT ColorRGBA[4], GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	commandLists[threadID].record(COMMAND_CLEAR, 0, 0, pTexture);
+}
+void GraphicsDevice_Null::ClearDepthStencil(Texture2D* pTexture, UINT ClearFlags, FLOAT Depth, UINT8 Stencil, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	commandLists[threadID].record(COMMAND_CLEAR, ClearFlags, 0, pTexture);
+}
+void GraphicsDevice_Null::BindResource(SHADERSTAGE stage, GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	commandLists[threadID].record(COMMAND_BIND_RESOURCE, (uint32_t)slot, 1, resource);
+	commandLists[threadID].counters.binds++;
+}
+void GraphicsDevice_Null::BindResources(SHADERSTAGE stage, GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BIND_RESOURCE, (uint32_t)slot, (uint32_t)count, count > 0 ? resources[0] : nullptr);
+	commandLists[threadID].counters.binds += (uint32_t)count;
+}
+void GraphicsDevice_Null::BindUnorderedAccessResourceCS(GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	commandLists[threadID].record(COMMAND_BIND_UAV, (uint32_t)slot, 1, resource);
+	commandLists[threadID].counters.binds++;
+}
+void GraphicsDevice_Null::BindUnorderedAccessResourcesCS(GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BIND_UAV, (uint32_t)slot, (uint32_t)count, count > 0 ? resources[0] : nullptr);
+	commandLists[threadID].counters.binds += (uint32_t)count;
+}
+void GraphicsDevice_Null::UnBindResources(int slot, int num, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_UNBIND, (uint32_t)slot, (uint32_t)num);
+}
+void GraphicsDevice_Null::UnBindUnorderedAccessResources(int slot, int num, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_UNBIND, (uint32_t)slot, (uint32_t)num);
+}
+void GraphicsDevice_Null::BindSampler(SHADERSTAGE stage, Sampler* sampler, int slot, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BIND_SAMPLER, (uint32_t)slot, 1, sampler);
+	commandLists[threadID].counters.binds++;
+}
+void GraphicsDevice_Null::BindConstantBuffer(SHADERSTAGE stage, GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BIND_CONSTANTBUFFER, (uint32_t)slot, 1, buffer);
+	commandLists[threadID].counters.binds++;
+}
+void GraphicsDevice_Null::BindVertexBuffers(GPUBuffer* const *vertexBuffers, int slot, int count, const UINT* strides, const UINT* offsets, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BIND_VERTEXBUFFERS, (uint32_t)slot, (uint32_t)count, count > 0 ? vertexBuffers[0] : nullptr);
+	commandLists[threadID].counters.binds += (uint32_t)count;
+}
+void GraphicsDevice_Null::BindIndexBuffer(GPUBuffer* indexBuffer, const INDEXBUFFER_FORMAT format, UINT offset, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BIND_INDEXBUFFER, (uint32_t)format, offset, indexBuffer);
+	commandLists[threadID].counters.binds++;
+}
+void GraphicsDevice_Null::BindStencilRef(UINT value, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BIND_STENCILREF, value);
+	commandLists[threadID].counters.stateChanges++;
+}
+void GraphicsDevice_Null::BindBlendFactor(XMFLOAT4 value, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BIND_BLENDFACTOR);
+	commandLists[threadID].counters.stateChanges++;
+}
+void GraphicsDevice_Null::BindGraphicsPSO(GraphicsPSO* pso, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BIND_GRAPHICSPSO, 0, 0, pso);
+	commandLists[threadID].counters.stateChanges++;
+}
+void GraphicsDevice_Null::BindComputePSO(ComputePSO* pso, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BIND_COMPUTEPSO, 0, 0, pso);
+	commandLists[threadID].counters.stateChanges++;
+}
+void GraphicsDevice_Null::Draw(int vertexCount, UINT startVertexLocation, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_DRAW, (uint32_t)vertexCount, 1);
+	commandLists[threadID].counters.drawCalls++;
+	commandLists[threadID].counters.vertices += (uint64_t)vertexCount;
+}
+void GraphicsDevice_Null::DrawIndexed(int indexCount, UINT startIndexLocation, UINT baseVertexLocation, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_DRAW, (uint32_t)indexCount, 1);
+	commandLists[threadID].counters.drawCalls++;
+	commandLists[threadID].counters.vertices += (uint64_t)indexCount;
+}
+void GraphicsDevice_Null::DrawInstanced(int vertexCount, int instanceCount, UINT startVertexLocation, UINT startInstanceLocation, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_DRAW, (uint32_t)vertexCount, (uint32_t)instanceCount);
+	commandLists[threadID].counters.drawCalls++;
+	commandLists[threadID].counters.vertices += (uint64_t)vertexCount * (uint64_t)instanceCount;
+}
+void GraphicsDevice_Null::DrawIndexedInstanced(int indexCount, int instanceCount, UINT startIndexLocation, UINT baseVertexLocation, UINT startInstanceLocation, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_DRAW, (uint32_t)indexCount, (uint32_t)instanceCount);
+	commandLists[threadID].counters.drawCalls++;
+	commandLists[threadID].counters.vertices += (uint64_t)indexCount * (uint64_t)instanceCount;
+}
+void GraphicsDevice_Null::DrawInstancedIndirect(GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_DRAW_INDIRECT, args_offset, 0, args);
+	commandLists[threadID].counters.drawCalls++;
+}
+void GraphicsDevice_Null::DrawIndexedInstancedIndirect(GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_DRAW_INDIRECT, args_offset, 0, args);
+	commandLists[threadID].counters.drawCalls++;
+}
+void GraphicsDevice_Null::Dispatch(UINT threadGroupCountX, UINT threadGroupCountY, UINT threadGroupCountZ, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_DISPATCH, threadGroupCountX * threadGroupCountY * threadGroupCountZ);
+	commandLists[threadID].counters.dispatches++;
+}
+void GraphicsDevice_Null::DispatchIndirect(GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_DISPATCH_INDIRECT, args_offset, 0, args);
+	commandLists[threadID].counters.dispatches++;
+}
+void GraphicsDevice_Null::GenerateMips(Texture* texture, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	commandLists[threadID].record(COMMAND_COPY, 0, 0, texture);
+}
+void GraphicsDevice_Null::CopyTexture2D(Texture2D* pDst, Texture2D* pSrc, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_COPY, 0, 0, pDst);
+}
+void GraphicsDevice_Null::CopyTexture2D_Region(Texture2D* pDst, UINT dstMip, UINT dstX, UINT dstY, Texture2D* pSrc, UINT srcMip, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_COPY, dstMip, srcMip, pDst);
+}
+void GraphicsDevice_Null::MSAAResolve(Texture2D* pDst, Texture2D* pSrc, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_COPY, 0, 0, pDst);
+}
+void GraphicsDevice_Null::UpdateBuffer(GPUBuffer* buffer, const void* data, GRAPHICSTHREAD threadID, int dataSize)
+{
+	assert(buffer->desc.Usage != USAGE_IMMUTABLE && "Cannot update IMMUTABLE GPUBuffer!");
+	assert((int)buffer->desc.ByteWidth >= dataSize || dataSize < 0 && "Data size is too big!");
+
+	if (dataSize == 0)
+	{
+		return;
+	}
+
+	const size_t size = dataSize < 0 ? (size_t)buffer->desc.ByteWidth : min((size_t)buffer->desc.ByteWidth, (size_t)dataSize);
+	memcpy(buffer->memory_Null.data(), data, size);
+
+	commandLists[threadID].record(COMMAND_UPDATE_BUFFER, (uint32_t)size, 0, buffer);
+	commandLists[threadID].counters.bytesUploaded += size;
+}
+void* GraphicsDevice_Null::AllocateFromRingBuffer(GPURingBuffer* buffer, size_t dataSize, UINT& offsetIntoBuffer, GRAPHICSTHREAD threadID)
+{
+	assert(buffer->desc.Usage == USAGE_DYNAMIC && (buffer->desc.CPUAccessFlags & CPU_ACCESS_WRITE) && "Ringbuffer must be writable by the CPU!");
+	assert(buffer->desc.ByteWidth > dataSize && "Data of the required size cannot fit!");
+
+	if (dataSize == 0)
+	{
+		return nullptr;
+	}
+
+	dataSize = min(buffer->desc.ByteWidth, dataSize);
+
+	size_t position = buffer->byteOffset;
+	bool wrap = position + dataSize > buffer->desc.ByteWidth || buffer->residentFrame != FRAMECOUNT;
+	position = wrap ? 0 : position;
+
+	buffer->byteOffset = position + dataSize;
+	buffer->residentFrame = FRAMECOUNT;
+
+	commandLists[threadID].counters.bytesUploaded += dataSize;
+
+	offsetIntoBuffer = (UINT)position;
+	return buffer->memory_Null.data() + position;
+}
+void GraphicsDevice_Null::InvalidateBufferAccess(GPUBuffer* buffer, GRAPHICSTHREAD threadID)
+{
+}
+bool GraphicsDevice_Null::DownloadBuffer(GPUBuffer* bufferToDownload, GPUBuffer* bufferDest, void* dataDest, GRAPHICSTHREAD threadID)
+{
+	assert(bufferToDownload->desc.ByteWidth <= bufferDest->desc.ByteWidth);
+	assert(bufferDest->desc.Usage & USAGE_STAGING);
+	assert(dataDest != nullptr);
+
+	// Nothing writes the buffers on the GPU timeline, so the download returns what the CPU uploaded:
+	memcpy(bufferDest->memory_Null.data(), bufferToDownload->memory_Null.data(), bufferToDownload->desc.ByteWidth);
+	memcpy(dataDest, bufferDest->memory_Null.data(), bufferToDownload->desc.ByteWidth);
+
+	commandLists[threadID].record(COMMAND_COPY, bufferToDownload->desc.ByteWidth, 0, bufferDest);
+	return true;
+}
+void GraphicsDevice_Null::SetScissorRects(UINT numRects, const Rect* rects, GRAPHICSTHREAD threadID)
+{
+	assert(rects != nullptr);
+	assert(numRects <= 8);
+	commandLists[threadID].record(COMMAND_SET_SCISSORRECTS, numRects);
+	commandLists[threadID].counters.stateChanges++;
+}
+
+void GraphicsDevice_Null::WaitForGPU()
+{
+}
+
+void GraphicsDevice_Null::QueryBegin(GPUQuery *query, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_QUERY, 0, 0, query);
+}
+void GraphicsDevice_Null::QueryEnd(GPUQuery *query, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_QUERY, 1, 0, query);
+}
+bool GraphicsDevice_Null::QueryRead(GPUQuery *query, GRAPHICSTHREAD threadID)
+{
+	// Results are always available immediately: everything passes, and no time elapses on the GPU
+	query->result_passed = TRUE;
+	query->result_passed_sample_count = 1;
+	query->result_timestamp = 0;
+	query->result_timestamp_frequency = 1000000;
+	query->result_disjoint = FALSE;
+	return true;
+}
+void GraphicsDevice_Null::UAVBarrier(GPUResource *const* uavs, UINT NumBarriers, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BARRIER, NumBarriers);
+}
+void GraphicsDevice_Null::TransitionBarrier(GPUResource *const* resources, UINT NumBarriers, RESOURCE_STATES stateBefore, RESOURCE_STATES stateAfter, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_BARRIER, NumBarriers);
+}
+
+
+HRESULT GraphicsDevice_Null::CreateTextureFromFile(const std::string& fileName, Texture2D **ppTexture, bool mipMaps, GRAPHICSTHREAD threadID)
+{
+	// The image is not decoded, a texture is only created if the file exists, so the loading code paths behave the same
+	ifstream file(fileName, ios::binary | ios::ate);
+	if (!file.is_open())
+	{
+		return E_FAIL;
+	}
+
+	TextureDesc desc;
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.Format = FORMAT_R8G8B8A8_UNORM;
+	desc.BindFlags = BIND_SHADER_RESOURCE;
+
+	(*ppTexture) = nullptr;
+	HRESULT hr = CreateTexture2D(&desc, nullptr, ppTexture);
+	initialDataBytes.fetch_add((uint64_t)file.tellg());
+	return hr;
+}
+HRESULT GraphicsDevice_Null::SaveTexturePNG(const std::string& fileName, Texture2D *pTexture, GRAPHICSTHREAD threadID)
+{
+	return E_FAIL;
+}
+HRESULT GraphicsDevice_Null::SaveTextureDDS(const std::string& fileName, Texture *pTexture, GRAPHICSTHREAD threadID)
+{
+	return E_FAIL;
+}
+
+void GraphicsDevice_Null::EventBegin(const std::string& name, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_EVENT, 0);
+}
+void GraphicsDevice_Null::EventEnd(GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_EVENT, 1);
+}
+void GraphicsDevice_Null::SetMarker(const std::string& name, GRAPHICSTHREAD threadID)
+{
+	commandLists[threadID].record(COMMAND_EVENT, 2);
+}
+
+}
@@ -0,0 +1,187 @@
+#ifndef _GRAPHICSDEVICE_NULL_H_
+#define _GRAPHICSDEVICE_NULL_H_
+
+#include "CommonInclude.h"
+#include "wiGraphicsDevice.h"
+
+#include <vector>
+#include <atomic>
+
+namespace wiGraphicsTypes
+{
+
+	// Graphics device that doesn't need a window or a GPU. Buffers are backed by CPU memory, and the commands are only recorded
+	//	into a compact command stream per graphics thread, with counters. Use it to profile the CPU side of the rendering (render data
+	//	updates, culling, instance packing, image and font submission, etc.) headless, for example on build machines.
+	class GraphicsDevice_Null : public GraphicsDevice
+	{
+	public:
+		enum COMMAND_TYPE : uint8_t
+		{
+			COMMAND_BIND_VIEWPORTS,
+			COMMAND_BIND_RENDERTARGETS,
+			COMMAND_CLEAR,
+			COMMAND_BIND_RESOURCE,
+			COMMAND_BIND_UAV,
+			COMMAND_UNBIND,
+			COMMAND_BIND_SAMPLER,
+			COMMAND_BIND_CONSTANTBUFFER,
+			COMMAND_BIND_VERTEXBUFFERS,
+			COMMAND_BIND_INDEXBUFFER,
+			COMMAND_BIND_STENCILREF,
+			COMMAND_BIND_BLENDFACTOR,
+			COMMAND_BIND_GRAPHICSPSO,
+			COMMAND_BIND_COMPUTEPSO,
+			COMMAND_SET_SCISSORRECTS,
+			COMMAND_DRAW,
+			COMMAND_DRAW_INDIRECT,
+			COMMAND_DISPATCH,
+			COMMAND_DISPATCH_INDIRECT,
+			COMMAND_COPY,
+			COMMAND_UPDATE_BUFFER,
+			COMMAND_QUERY,
+			COMMAND_BARRIER,
+			COMMAND_EVENT,
+		};
+		// A recorded command. The meaning of the arguments depends on the type, for example draws store the vertex/index and instance counts,
+		//	binds store the slot and count of the bound resources.
+		struct Command
+		{
+			COMMAND_TYPE type;
+			uint32_t arg0;
+			uint32_t arg1;
+			const void* object; // the bound or updated object (resource, pipeline state, etc.), the first one when an array is bound, can be nullptr
+		};
+		struct Counters
+		{
+			uint32_t commands = 0;
+			uint32_t drawCalls = 0;
+			uint32_t dispatches = 0;
+			uint32_t binds = 0;			// resources, samplers, constant buffers, vertex and index buffers
+			uint32_t stateChanges = 0;	// pipeline states, render targets, viewports, scissors, stencil ref, blend factor
+			uint64_t vertices = 0;		// vertices or indices of the draw calls, multiplied by the instance counts
+			uint64_t bytesUploaded = 0;	// buffer updates, ring buffer allocations and initial data of new resources
+
+			void operator+=(const Counters& other);
+		};
+
+	private:
+		struct CommandList
+		{
+			std::vector<Command> commands;
+			Counters counters;
+
+			void record(COMMAND_TYPE type, uint32_t arg0 = 0, uint32_t arg1 = 0, const void* object = nullptr);
+			void clear();
+		};
+		CommandList commandLists[GRAPHICSTHREAD_COUNT];
+
+		// Commands of the frame in submission order: the immediate commands, with the deferred command lists inserted where they were executed
+		std::vector<Command> frameCommands;
+		Counters frameCounters;
+		// Results of the last finished frame
+		std::vector<Command> lastFrameCommands;
+		Counters lastFrameCounters;
+		// Resources can be created from any thread, their initial data is counted separately
+		std::atomic<uint64_t> initialDataBytes{ 0 };
+
+		void SubmitCommandList(GRAPHICSTHREAD threadID);
+
+	public:
+		GraphicsDevice_Null(int width = 1920, int height = 1080);
+
+		~GraphicsDevice_Null();
+
+		// Counters and commands of the last presented frame
+		const Counters& GetFrameCounters() const { return lastFrameCounters; }
+		const std::vector<Command>& GetFrameCommands() const { return lastFrameCommands; }
+
+		virtual HRESULT CreateBuffer(const GPUBufferDesc *pDesc, const SubresourceData* pInitialData, GPUBuffer *ppBuffer) override;
+		virtual HRESULT CreateTexture1D(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture1D **ppTexture1D) override;
+		virtual HRESULT CreateTexture2D(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture2D **ppTexture2D) override;
+		virtual HRESULT CreateTexture3D(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture3D **ppTexture3D) override;
+		virtual HRESULT CreateInputLayout(const VertexLayoutDesc *pInputElementDescs, UINT NumElements,
+			const void *pShaderBytecodeWithInputSignature, SIZE_T BytecodeLength, VertexLayout *pInputLayout) override;
+		virtual HRESULT CreateVertexShader(const void *pShaderBytecode, SIZE_T BytecodeLength, VertexShader *pVertexShader) override;
+		virtual HRESULT CreatePixelShader(const void *pShaderBytecode, SIZE_T BytecodeLength, PixelShader *pPixelShader) override;
+		virtual HRESULT CreateGeometryShader(const void *pShaderBytecode, SIZE_T BytecodeLength, GeometryShader *pGeometryShader) override;
+		virtual HRESULT CreateHullShader(const void *pShaderBytecode, SIZE_T BytecodeLength, HullShader *pHullShader) override;
+		virtual HRESULT CreateDomainShader(const void *pShaderBytecode, SIZE_T BytecodeLength, DomainShader *pDomainShader) override;
+		virtual HRESULT CreateComputeShader(const void *pShaderBytecode, SIZE_T BytecodeLength, ComputeShader *pComputeShader) override;
+		virtual HRESULT CreateBlendState(const BlendStateDesc *pBlendStateDesc, BlendState *pBlendState) override;
+		virtual HRESULT CreateDepthStencilState(const DepthStencilStateDesc *pDepthStencilStateDesc, DepthStencilState *pDepthStencilState) override;
+		virtual HRESULT CreateRasterizerState(const RasterizerStateDesc *pRasterizerStateDesc, RasterizerState *pRasterizerState) override;
+		virtual HRESULT CreateSamplerState(const SamplerDesc *pSamplerDesc, Sampler *pSamplerState) override;
+		virtual HRESULT CreateQuery(const GPUQueryDesc *pDesc, GPUQuery *pQuery) override;
+		virtual HRESULT CreateGraphicsPSO(const GraphicsPSODesc* pDesc, GraphicsPSO* pso) override;
+		virtual HRESULT CreateComputePSO(const ComputePSODesc* pDesc, ComputePSO* pso) override;
+
+		virtual void PresentBegin() override;
+		virtual void PresentEnd() override;
+
+		virtual void ExecuteDeferredContexts() override;
+		virtual void FinishCommandList(GRAPHICSTHREAD thread) override;
+
+		virtual void SetResolution(int width, int height) override;
+
+		virtual Texture2D GetBackBuffer() override;
+
+		///////////////Thread-sensitive////////////////////////
+
+		virtual void BindViewports(UINT NumViewports, const ViewPort *pViewports, GRAPHICSTHREAD threadID) override;
+		virtual void BindRenderTargetsUAVs(UINT NumViews, Texture2D* const *ppRenderTargets, Texture2D* depthStencilTexture, GPUResource* const *ppUAVs, int slotUAV, int countUAV,
+			GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindRenderTargets(UINT NumViews, Texture2D* const *ppRenderTargets, Texture2D* depthStencilTexture, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void ClearRenderTarget(Texture* pTexture, const FLOAT ColorRGBA[4], GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void ClearDepthStencil(Texture2D* pTexture, UINT ClearFlags, FLOAT Depth, UINT8 Stencil, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindResource(SHADERSTAGE stage, GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindResources(SHADERSTAGE stage, GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID) override;
+		virtual void BindUnorderedAccessResourceCS(GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindUnorderedAccessResourcesCS(GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID) override;
+		virtual void UnBindResources(int slot, int num, GRAPHICSTHREAD threadID) override;
+		virtual void UnBindUnorderedAccessResources(int slot, int num, GRAPHICSTHREAD threadID) override;
+		virtual void BindSampler(SHADERSTAGE stage, Sampler* sampler, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindConstantBuffer(SHADERSTAGE stage, GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindVertexBuffers(GPUBuffer* const *vertexBuffers, int slot, int count, const UINT* strides, const UINT* offsets, GRAPHICSTHREAD threadID) override;
+		virtual void BindIndexBuffer(GPUBuffer* indexBuffer, const INDEXBUFFER_FORMAT format, UINT offset, GRAPHICSTHREAD threadID) override;
+		virtual void BindStencilRef(UINT value, GRAPHICSTHREAD threadID) override;
+		virtual void BindBlendFactor(XMFLOAT4 value, GRAPHICSTHREAD threadID) override;
+		virtual void BindGraphicsPSO(GraphicsPSO* pso, GRAPHICSTHREAD threadID) override;
+		virtual void BindComputePSO(ComputePSO* pso, GRAPHICSTHREAD threadID) override;
+		virtual void Draw(int vertexCount, UINT startVertexLocation, GRAPHICSTHREAD threadID) override;
+		virtual void DrawIndexed(int indexCount, UINT startIndexLocation, UINT baseVertexLocation, GRAPHICSTHREAD threadID) override;
+		virtual void DrawInstanced(int vertexCount, int instanceCount, UINT startVertexLocation, UINT startInstanceLocation, GRAPHICSTHREAD threadID) override;
+		virtual void DrawIndexedInstanced(int indexCount, int instanceCount, UINT startIndexLocation, UINT baseVertexLocation, UINT startInstanceLocation, GRAPHICSTHREAD threadID) override;
+		virtual void DrawInstancedIndirect(GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID) override;
+		virtual void DrawIndexedInstancedIndirect(GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID) override;
+		virtual void Dispatch(UINT threadGroupCountX, UINT threadGroupCountY, UINT threadGroupCountZ, GRAPHICSTHREAD threadID) override;
+		virtual void DispatchIndirect(GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID) override;
+		virtual void GenerateMips(Texture* texture, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void CopyTexture2D(Texture2D* pDst, Texture2D* pSrc, GRAPHICSTHREAD threadID) override;
+		virtual void CopyTexture2D_Region(Texture2D* pDst, UINT dstMip, UINT dstX, UINT dstY, Texture2D* pSrc, UINT srcMip, GRAPHICSTHREAD threadID) override;
+		virtual void MSAAResolve(Texture2D* pDst, Texture2D* pSrc, GRAPHICSTHREAD threadID) override;
+		virtual void UpdateBuffer(GPUBuffer* buffer, const void* data, GRAPHICSTHREAD threadID, int dataSize = -1) override;
+		virtual void* AllocateFromRingBuffer(GPURingBuffer* buffer, size_t dataSize, UINT& offsetIntoBuffer, GRAPHICSTHREAD threadID) override;
+		virtual void InvalidateBufferAccess(GPUBuffer* buffer, GRAPHICSTHREAD threadID) override;
+		virtual bool DownloadBuffer(GPUBuffer* bufferToDownload, GPUBuffer* bufferDest, void* dataDest, GRAPHICSTHREAD threadID) override;
+		virtual void SetScissorRects(UINT numRects, const Rect* rects, GRAPHICSTHREAD threadID) override;
+		virtual void QueryBegin(GPUQuery *query, GRAPHICSTHREAD threadID) override;
+		virtual void QueryEnd(GPUQuery *query, GRAPHICSTHREAD threadID) override;
+		virtual bool QueryRead(GPUQuery *query, GRAPHICSTHREAD threadID) override;
+		virtual void UAVBarrier(GPUResource *const* uavs, UINT NumBarriers, GRAPHICSTHREAD threadID) override;
+		virtual void TransitionBarrier(GPUResource *const* resources, UINT NumBarriers, RESOURCE_STATES stateBefore, RESOURCE_STATES stateAfter, GRAPHICSTHREAD threadID) override;
+
+		virtual void WaitForGPU() override;
+
+		virtual HRESULT CreateTextureFromFile(const std::string& fileName, Texture2D **ppTexture, bool mipMaps, GRAPHICSTHREAD threadID) override;
+		virtual HRESULT SaveTexturePNG(const std::string& fileName, Texture2D *pTexture, GRAPHICSTHREAD threadID) override;
+		virtual HRESULT SaveTextureDDS(const std::string& fileName, Texture *pTexture, GRAPHICSTHREAD threadID) override;
+
+		virtual void EventBegin(const std::string& name, GRAPHICSTHREAD threadID) override;
+		virtual void EventEnd(GRAPHICSTHREAD threadID) override;
+		virtual void SetMarker(const std::string& name, GRAPHICSTHREAD threadID) override;
+	};
+
+}
+
+#endif // _GRAPHICSDEVICE_NULL_H_
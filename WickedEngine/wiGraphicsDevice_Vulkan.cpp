@@ -2140,6 +2140,10 @@ namespace wiGraphicsTypes
 		}
 
 
+		// Create an empty pipeline cache, it can be replaced by the data of a previous run with LoadPipelineCache:
+		CreatePipelineCache(nullptr, 0);
+
+
 		// Create resource upload buffers
 		bufferUploader = new UploadBuffer(physicalDevice, device, queueIndices, 256 * 1024 * 1024);
 		textureUploader = new UploadBuffer(physicalDevice, device, queueIndices, 256 * 1024 * 1024);
@@ -2319,6 +2323,7 @@ namespace wiGraphicsTypes
 		vkDestroyPipelineLayout(device, defaultPipelineLayout_Graphics, nullptr);
 		vkDestroyPipelineLayout(device, defaultPipelineLayout_Compute, nullptr);
 		vkDestroyRenderPass(device, defaultRenderPass, nullptr);
+		vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
 		for (auto& x : swapChainImages)
 		{
@@ -2330,6 +2335,47 @@ namespace wiGraphicsTypes
 		vkDestroyInstance(instance, nullptr);
 	}
 
+	void GraphicsDevice_Vulkan::CreatePipelineCache(const void* initialData, size_t initialDataSize)
+	{
+		if (pipelineCache != VK_NULL_HANDLE)
+		{
+			vkDestroyPipelineCache(device, pipelineCache, nullptr);
+			pipelineCache = VK_NULL_HANDLE;
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo = {};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = initialDataSize;
+		cacheInfo.pInitialData = initialData;
+
+		// The driver validates the header of the initial data, and ignores it if it was created by an other device or driver version
+		VkResult res = vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache);
+		if (res != VK_SUCCESS && initialData != nullptr)
+		{
+			cacheInfo.initialDataSize = 0;
+			cacheInfo.pInitialData = nullptr;
+			res = vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache);
+		}
+		assert(res == VK_SUCCESS);
+	}
+	void GraphicsDevice_Vulkan::SetPipelineCacheData(const std::vector<uint8_t>& data)
+	{
+		CreatePipelineCache(data.data(), data.size());
+	}
+	void GraphicsDevice_Vulkan::GetPipelineCacheData(std::vector<uint8_t>& data)
+	{
+		size_t size = 0;
+		VkResult res = vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+		if (res != VK_SUCCESS || size == 0)
+		{
+			data.clear();
+			return;
+		}
+		data.resize(size);
+		res = vkGetPipelineCacheData(device, pipelineCache, &size, data.data());
+		data.resize(res == VK_SUCCESS || res == VK_INCOMPLETE ? size : 0);
+	}
+
 	void GraphicsDevice_Vulkan::SetResolution(int width, int height)
 	{
 		if (width != SCREENWIDTH || height != SCREENHEIGHT)
@@ -2352,9 +2398,12 @@ namespace wiGraphicsTypes
 
 		ppBuffer->desc = *pDesc;
 
+		// Ring buffers live in host visible memory with a separate region for every frame in flight, the GPU reads them directly from there:
+		GPURingBuffer* ringBuffer = dynamic_cast<GPURingBuffer*>(ppBuffer);
+
 		VkBufferCreateInfo bufferInfo = {};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.size = ppBuffer->desc.ByteWidth /** BACKBUFFER_COUNT*/;
+		bufferInfo.size = ppBuffer->desc.ByteWidth * (ringBuffer != nullptr ? BACKBUFFER_COUNT : 1);
 		bufferInfo.usage = 0;
 		if (ppBuffer->desc.BindFlags & BIND_VERTEX_BUFFER)
 		{
@@ -2420,7 +2469,14 @@ namespace wiGraphicsTypes
 		VkMemoryAllocateInfo allocInfo = {};
 		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT /*| VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT*/);
+		if (ringBuffer != nullptr)
+		{
+			allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+		else
+		{
+			allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
 
 		if (vkAllocateMemory(device, &allocInfo, nullptr, reinterpret_cast<VkDeviceMemory*>(&ppBuffer->resourceMemory_Vulkan)) != VK_SUCCESS) {
 			throw std::runtime_error("failed to allocate buffer memory!");
@@ -2430,6 +2486,15 @@ namespace wiGraphicsTypes
 		hr = res == VK_SUCCESS;
 		assert(SUCCEEDED(hr));
 
+		if (ringBuffer != nullptr)
+		{
+			// Persistently mapped, the mapping is released with the memory:
+			void* pData = nullptr;
+			res = vkMapMemory(device, static_cast<VkDeviceMemory>(ppBuffer->resourceMemory_Vulkan), 0, bufferInfo.size, 0, &pData);
+			assert(res == VK_SUCCESS);
+			ringBuffer->mappedData_Vulkan = reinterpret_cast<uint8_t*>(pData);
+		}
+
 
 
 		// Issue data copy on request:
@@ -3791,7 +3856,15 @@ namespace wiGraphicsTypes
 		pipelineInfo.pDynamicState = &dynamicState;
 
 
-		VkResult res = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, reinterpret_cast<VkPipeline*>(&pso->pipeline_Vulkan));
+		// The compiled pipelines live in the driver's opaque cache, the base class only tracks which ones it has seen for the statistics:
+		const uint64_t cacheKey = ComputePipelineHash(pDesc);
+		std::vector<uint8_t> cacheData;
+		if (!FindPipelineCacheEntry(cacheKey, cacheData))
+		{
+			StorePipelineCacheEntry(cacheKey, nullptr, 0);
+		}
+
+		VkResult res = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, reinterpret_cast<VkPipeline*>(&pso->pipeline_Vulkan));
 		HRESULT hr = res == VK_SUCCESS ? S_OK : E_FAIL;
 		assert(SUCCEEDED(hr));
 
@@ -3832,7 +3905,14 @@ namespace wiGraphicsTypes
 		}
 
 
-		VkResult res = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, reinterpret_cast<VkPipeline*>(&pso->pipeline_Vulkan));
+		const uint64_t cacheKey = ComputePipelineHash(pDesc);
+		std::vector<uint8_t> cacheData;
+		if (!FindPipelineCacheEntry(cacheKey, cacheData))
+		{
+			StorePipelineCacheEntry(cacheKey, nullptr, 0);
+		}
+
+		VkResult res = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, reinterpret_cast<VkPipeline*>(&pso->pipeline_Vulkan));
 		HRESULT hr = res == VK_SUCCESS ? S_OK : E_FAIL;
 		assert(SUCCEEDED(hr));
 
@@ -3946,8 +4026,18 @@ namespace wiGraphicsTypes
 
 
 		// ...end presentation render pass
+		FlushUploads(GRAPHICSTHREAD_IMMEDIATE);
 		renderPass[GRAPHICSTHREAD_IMMEDIATE].disable(GetDirectCommandList(GRAPHICSTHREAD_IMMEDIATE));
 
+		uploadStats = UploadStats();
+		for (int threadID = 0; threadID < GRAPHICSTHREAD_COUNT; ++threadID)
+		{
+			uploadStats.uploads += uploadBatches[threadID].uploads;
+			uploadStats.barriers += uploadBatches[threadID].barriers;
+			uploadBatches[threadID].uploads = 0;
+			uploadBatches[threadID].barriers = 0;
+		}
+
 
 
 
@@ -4109,6 +4199,7 @@ namespace wiGraphicsTypes
 	{
 		if (threadID == GRAPHICSTHREAD_IMMEDIATE)
 			return;
+		FlushUploads(threadID);
 		if (vkEndCommandBuffer(GetDirectCommandList(threadID)) != VK_SUCCESS) {
 			throw std::runtime_error("failed to record command buffer!");
 		}
@@ -4594,24 +4685,28 @@ namespace wiGraphicsTypes
 	}
 	void GraphicsDevice_Vulkan::Draw(int vertexCount, UINT startVertexLocation, GRAPHICSTHREAD threadID)
 	{
+		FlushUploads(threadID);
 		renderPass[threadID].validate(device, GetDirectCommandList(threadID));
 		GetFrameResources().ResourceDescriptorsGPU[threadID]->validate(GetDirectCommandList(threadID));
 		vkCmdDraw(GetDirectCommandList(threadID), static_cast<uint32_t>(vertexCount), 1, startVertexLocation, 0);
 	}
 	void GraphicsDevice_Vulkan::DrawIndexed(int indexCount, UINT startIndexLocation, UINT baseVertexLocation, GRAPHICSTHREAD threadID)
 	{
+		FlushUploads(threadID);
 		renderPass[threadID].validate(device, GetDirectCommandList(threadID));
 		GetFrameResources().ResourceDescriptorsGPU[threadID]->validate(GetDirectCommandList(threadID));
 		vkCmdDrawIndexed(GetDirectCommandList(threadID), static_cast<uint32_t>(indexCount), 1, startIndexLocation, baseVertexLocation, 0);
 	}
 	void GraphicsDevice_Vulkan::DrawInstanced(int vertexCount, int instanceCount, UINT startVertexLocation, UINT startInstanceLocation, GRAPHICSTHREAD threadID)
 	{
+		FlushUploads(threadID);
 		renderPass[threadID].validate(device, GetDirectCommandList(threadID));
 		GetFrameResources().ResourceDescriptorsGPU[threadID]->validate(GetDirectCommandList(threadID));
 		vkCmdDraw(GetDirectCommandList(threadID), static_cast<uint32_t>(vertexCount), static_cast<uint32_t>(instanceCount), startVertexLocation, startInstanceLocation);
 	}
 	void GraphicsDevice_Vulkan::DrawIndexedInstanced(int indexCount, int instanceCount, UINT startIndexLocation, UINT baseVertexLocation, UINT startInstanceLocation, GRAPHICSTHREAD threadID)
 	{
+		FlushUploads(threadID);
 		renderPass[threadID].validate(device, GetDirectCommandList(threadID));
 		GetFrameResources().ResourceDescriptorsGPU[threadID]->validate(GetDirectCommandList(threadID));
 		vkCmdDrawIndexed(GetDirectCommandList(threadID), static_cast<uint32_t>(indexCount), static_cast<uint32_t>(instanceCount), startIndexLocation, baseVertexLocation, startInstanceLocation);
@@ -4624,6 +4719,7 @@ namespace wiGraphicsTypes
 	}
 	void GraphicsDevice_Vulkan::Dispatch(UINT threadGroupCountX, UINT threadGroupCountY, UINT threadGroupCountZ, GRAPHICSTHREAD threadID)
 	{
+		FlushUploads(threadID);
 		renderPass[threadID].disable(GetDirectCommandList(threadID));
 
 		GetFrameResources().ResourceDescriptorsGPU[threadID]->validate(GetDirectCommandList(threadID));
@@ -4651,6 +4747,8 @@ namespace wiGraphicsTypes
 	}
 	void GraphicsDevice_Vulkan::CopyTexture2D(Texture2D* pDst, Texture2D* pSrc, GRAPHICSTHREAD threadID)
 	{
+		FlushUploads(threadID);
+
 		VkImageCopy copy;
 		copy.extent.width = pDst->desc.Width;
 		copy.extent.height = pDst->desc.Height;
@@ -4698,92 +4796,132 @@ namespace wiGraphicsTypes
 		dataSize = min((int)buffer->desc.ByteWidth, dataSize);
 		dataSize = (dataSize >= 0 ? dataSize : buffer->desc.ByteWidth);
 
+		UploadBatch& batch = uploadBatches[threadID];
+		VkBuffer resource = static_cast<VkBuffer>(buffer->resource_Vulkan);
 
+		// The buffer was already updated since the last flush, so only the newest data needs to be copied:
+		auto it = batch.copyIndices.find(resource);
+		if (it != batch.copyIndices.end())
+		{
+			UploadBatch::Copy& copy = batch.copies[it->second];
+			if ((VkDeviceSize)dataSize <= copy.region.size)
+			{
+				memcpy(copy.data, data, dataSize);
+				return;
+			}
+			copy.data = GetFrameResources().resourceBuffer[threadID]->allocate(dataSize, 256);
+			memcpy(copy.data, data, dataSize);
+			copy.region.srcOffset = GetFrameResources().resourceBuffer[threadID]->calculateOffset(copy.data);
+			copy.region.size = dataSize;
+			return;
+		}
 
-		renderPass[threadID].disable(GetDirectCommandList(threadID));
-
-
-
-
-		VkPipelineStageFlags stages = 0;
-
-		VkBufferMemoryBarrier barrier = {};
-		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-		barrier.buffer = static_cast<VkBuffer>(buffer->resource_Vulkan);
-		barrier.srcAccessMask = 0;
+		UploadBatch::Copy copy;
+		copy.buffer = resource;
 		if (buffer->desc.BindFlags & BIND_CONSTANT_BUFFER)
 		{
-			barrier.srcAccessMask = VK_ACCESS_UNIFORM_READ_BIT;
-			stages = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			copy.access = VK_ACCESS_UNIFORM_READ_BIT;
+			copy.stages = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		}
 		else if (buffer->desc.BindFlags & BIND_VERTEX_BUFFER)
 		{
-			barrier.srcAccessMask = VK_ACCESS_INDEX_READ_BIT;
-			stages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+			copy.access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			copy.stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
 		}
 		else if (buffer->desc.BindFlags & BIND_INDEX_BUFFER)
 		{
-			barrier.srcAccessMask = VK_ACCESS_INDEX_READ_BIT;
-			stages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+			copy.access = VK_ACCESS_INDEX_READ_BIT;
+			copy.stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
 		}
 		else
 		{
-			barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			stages = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			copy.access = VK_ACCESS_SHADER_READ_BIT;
+			copy.stages = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		}
+
+		copy.data = GetFrameResources().resourceBuffer[threadID]->allocate(dataSize, 256);
+		memcpy(copy.data, data, dataSize);
+		copy.region = {};
+		copy.region.size = dataSize;
+		copy.region.srcOffset = GetFrameResources().resourceBuffer[threadID]->calculateOffset(copy.data);
+		copy.region.dstOffset = 0;
+
+		batch.copyIndices[resource] = batch.copies.size();
+		batch.copies.push_back(copy);
+	}
+	void GraphicsDevice_Vulkan::FlushUploads(GRAPHICSTHREAD threadID)
+	{
+		UploadBatch& batch = uploadBatches[threadID];
+		if (batch.copies.empty())
+		{
+			return;
+		}
+
+		VkCommandBuffer commandBuffer = GetDirectCommandList(threadID);
+
+		// Copies are not allowed inside a render pass, it will be started again by the next draw:
+		renderPass[threadID].disable(commandBuffer);
+
+		static thread_local std::vector<VkBufferMemoryBarrier> barriers;
+		barriers.clear();
+		VkPipelineStageFlags stages = 0;
+		for (const UploadBatch::Copy& copy : batch.copies)
+		{
+			VkBufferMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.buffer = copy.buffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			barrier.srcAccessMask = copy.access;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barriers.push_back(barrier);
+			stages |= copy.stages;
 		}
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
 		vkCmdPipelineBarrier(
-			GetDirectCommandList(threadID),
+			commandBuffer,
 			stages,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_DEPENDENCY_BY_REGION_BIT,
 			0, nullptr,
-			1, &barrier,
+			(uint32_t)barriers.size(), barriers.data(),
 			0, nullptr
 		);
 
+		for (const UploadBatch::Copy& copy : batch.copies)
+		{
+			vkCmdCopyBuffer(commandBuffer, GetFrameResources().resourceBuffer[threadID]->resource, copy.buffer, 1, &copy.region);
+		}
 
-		// issue data copy:
-		uint8_t* dest = GetFrameResources().resourceBuffer[threadID]->allocate(dataSize, 256);
-		memcpy(dest, data, dataSize);
-
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = dataSize;
-		copyRegion.srcOffset = GetFrameResources().resourceBuffer[threadID]->calculateOffset(dest);
-		copyRegion.dstOffset = 0;
-
-		vkCmdCopyBuffer(GetDirectCommandList(threadID), GetFrameResources().resourceBuffer[threadID]->resource, static_cast<VkBuffer>(buffer->resource_Vulkan), 1, &copyRegion);
-
-
-
-
-
-
-		VkAccessFlags tmp = barrier.srcAccessMask;
-		barrier.srcAccessMask = barrier.dstAccessMask;
-		barrier.dstAccessMask = tmp;
+		for (VkBufferMemoryBarrier& barrier : barriers)
+		{
+			VkAccessFlags tmp = barrier.srcAccessMask;
+			barrier.srcAccessMask = barrier.dstAccessMask;
+			barrier.dstAccessMask = tmp;
+		}
 
 		vkCmdPipelineBarrier(
-			GetDirectCommandList(threadID),
+			commandBuffer,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			stages,
 			VK_DEPENDENCY_BY_REGION_BIT,
 			0, nullptr,
-			1, &barrier,
+			(uint32_t)barriers.size(), barriers.data(),
 			0, nullptr
 		);
 
-
-		//renderPass[threadID].validate(device, GetDirectCommandList(threadID));
-
+		batch.uploads += (uint32_t)batch.copies.size();
+		batch.barriers += 2;
+		batch.copies.clear();
+		batch.copyIndices.clear();
 	}
 	void* GraphicsDevice_Vulkan::AllocateFromRingBuffer(GPURingBuffer* buffer, size_t dataSize, UINT& offsetIntoBuffer, GRAPHICSTHREAD threadID)
 	{
 		assert(buffer->desc.Usage == USAGE_DYNAMIC && (buffer->desc.CPUAccessFlags & CPU_ACCESS_WRITE) && "Ringbuffer must be writable by the CPU!");
 		assert(buffer->desc.ByteWidth > dataSize && "Data of the required size cannot fit!");
+		assert(buffer->mappedData_Vulkan != nullptr);
 
 		if (dataSize == 0)
 		{
@@ -4792,102 +4930,27 @@ namespace wiGraphicsTypes
 
 		dataSize = min(buffer->desc.ByteWidth, dataSize);
 
-		size_t position = buffer->byteOffset;
-		bool wrap = position + dataSize > buffer->desc.ByteWidth || buffer->residentFrame != FRAMECOUNT;
-		position = wrap ? 0 : position;
-
-		// TODO: realloc on wrap or something
-
-
-
-
-
-		renderPass[threadID].disable(GetDirectCommandList(threadID));
-
-
-
-
-		VkPipelineStageFlags stages = 0;
-
-		VkBufferMemoryBarrier barrier = {};
-		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-		barrier.buffer = static_cast<VkBuffer>(buffer->resource_Vulkan);
-		barrier.srcAccessMask = 0;
-		if (buffer->desc.BindFlags & BIND_CONSTANT_BUFFER)
-		{
-			barrier.srcAccessMask = VK_ACCESS_UNIFORM_READ_BIT;
-			stages = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-		}
-		else if (buffer->desc.BindFlags & BIND_VERTEX_BUFFER)
-		{
-			barrier.srcAccessMask = VK_ACCESS_INDEX_READ_BIT;
-			stages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
-		}
-		else if (buffer->desc.BindFlags & BIND_INDEX_BUFFER)
+		size_t position = buffer->residentFrame != FRAMECOUNT ? 0 : buffer->byteOffset;
+		if (position + dataSize > buffer->desc.ByteWidth)
 		{
-			barrier.srcAccessMask = VK_ACCESS_INDEX_READ_BIT;
-			stages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+			// The region of this frame is full. Wrapping around would overwrite data that the earlier draws of this frame still read,
+			//	and replacing the buffer would invalidate the offsets that were already handed out. The ring buffer must be created
+			//	large enough for everything that is allocated from it in one frame.
+			assert(0 && "Ringbuffer overflow in a single frame, increase its size!");
+			throw std::runtime_error("ring buffer overflow in a single frame!");
 		}
-		else
-		{
-			barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			stages = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-		}
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-		vkCmdPipelineBarrier(
-			GetDirectCommandList(threadID),
-			stages,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_DEPENDENCY_BY_REGION_BIT,
-			0, nullptr,
-			1, &barrier,
-			0, nullptr
-		);
-
-
-
-		// provide immediate buffer allocation address and issue deferred data copy:
-		uint8_t* dest = GetFrameResources().resourceBuffer[threadID]->allocate(dataSize, 256);
-
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = dataSize;
-		copyRegion.srcOffset = GetFrameResources().resourceBuffer[threadID]->calculateOffset(dest);
-		copyRegion.dstOffset = position;
-
-		vkCmdCopyBuffer(GetDirectCommandList(threadID), GetFrameResources().resourceBuffer[threadID]->resource, static_cast<VkBuffer>(buffer->resource_Vulkan), 1, &copyRegion);
-
-
-
-
-
-
-
-		VkAccessFlags tmp = barrier.srcAccessMask;
-		barrier.srcAccessMask = barrier.dstAccessMask;
-		barrier.dstAccessMask = tmp;
-
-		vkCmdPipelineBarrier(
-			GetDirectCommandList(threadID),
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			stages,
-			VK_DEPENDENCY_BY_REGION_BIT,
-			0, nullptr,
-			1, &barrier,
-			0, nullptr
-		);
-
-
-		//renderPass[threadID].validate(device, GetDirectCommandList(threadID));
 
+		// The data is written directly into the persistently mapped buffer, there is no copy and no barrier.
+		//	Every frame in flight has its own region, so the GPU can still read the previous frames while this one is written.
+		//	The returned offset is relative to the whole buffer, so it can be bound with it directly.
+		const size_t frameOffset = (size_t)(GetFrameCount() % BACKBUFFER_COUNT) * buffer->desc.ByteWidth;
+		uint8_t* dest = buffer->mappedData_Vulkan + frameOffset + position;
 
 		// Thread safety is compromised!
 		buffer->byteOffset = position + dataSize;
 		buffer->residentFrame = FRAMECOUNT;
 
-		offsetIntoBuffer = (UINT)position;
+		offsetIntoBuffer = (UINT)(frameOffset + position);
 		return reinterpret_cast<void*>(dest);
 	}
 	void GraphicsDevice_Vulkan::InvalidateBufferAccess(GPUBuffer* buffer, GRAPHICSTHREAD threadID)
@@ -181,6 +181,35 @@ namespace wiGraphicsTypes
 		UploadBuffer* bufferUploader;
 		UploadBuffer* textureUploader;
 
+		// Buffer updates are not copied immediately, but collected until a command that could read them is recorded (draw, dispatch, copy, end of the command list).
+		//	Then the whole batch is flushed with a single barrier - copy - barrier group, so a series of updates only interrupts the render pass once.
+		struct UploadBatch
+		{
+			struct Copy
+			{
+				VkBuffer buffer;
+				uint8_t* data; // staging memory in the frame resource buffer
+				VkBufferCopy region;
+				VkAccessFlags access; // how the buffer is read by the GPU
+				VkPipelineStageFlags stages; // where the buffer is read by the GPU
+			};
+			std::vector<Copy> copies;
+			std::unordered_map<VkBuffer, size_t> copyIndices; // a buffer updated multiple times in a batch only needs its last data copied
+
+			uint32_t uploads = 0;
+			uint32_t barriers = 0;
+		};
+		UploadBatch uploadBatches[GRAPHICSTHREAD_COUNT];
+		void FlushUploads(GRAPHICSTHREAD threadID);
+
+		// All pipelines are created through this cache, its data is persisted by the base class pipeline cache
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		void CreatePipelineCache(const void* initialData, size_t initialDataSize);
+
+	protected:
+		virtual const char* GetPipelineCacheBackendName() override { return "Vulkan"; }
+		virtual void SetPipelineCacheData(const std::vector<uint8_t>& data) override;
+		virtual void GetPipelineCacheData(std::vector<uint8_t>& data) override;
 
 	public:
 		GraphicsDevice_Vulkan(wiWindowRegistration::window_type window, bool fullscreen = false, bool debuglayer = false);
@@ -3,6 +3,8 @@
 #include "Include_DX12.h"
 #include "Include_Vulkan.h"
 
+#include <atomic>
+
 namespace wiGraphicsTypes
 {
 	VertexShader::VertexShader()
@@ -71,8 +73,11 @@ namespace wiGraphicsTypes
 		SAFE_DELETE(resource_DX12);
 	}
 
+	static std::atomic<uint64_t> nextUniqueID{ 1 };
+
 	GPUResource::GPUResource()
 	{
+		uniqueID = nextUniqueID.fetch_add(1);
 		SAFE_INIT(SRV_DX11);
 		SAFE_INIT(SRV_DX12);
 		SRV_Vulkan = WI_NULL_HANDLE;
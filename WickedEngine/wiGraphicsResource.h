@@ -54,9 +54,11 @@ namespace wiGraphicsTypes
 
 	class VertexShader
 	{
+		friend class GraphicsDevice;
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11VertexShader*		resource_DX11;
 		ShaderByteCode			code;
@@ -67,9 +69,11 @@ namespace wiGraphicsTypes
 
 	class PixelShader
 	{
+		friend class GraphicsDevice;
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11PixelShader*		resource_DX11;
 		ShaderByteCode			code;
@@ -80,9 +84,11 @@ namespace wiGraphicsTypes
 
 	class GeometryShader
 	{
+		friend class GraphicsDevice;
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11GeometryShader*	resource_DX11;
 		ShaderByteCode			code;
@@ -93,9 +99,11 @@ namespace wiGraphicsTypes
 
 	class HullShader
 	{
+		friend class GraphicsDevice;
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11HullShader*		resource_DX11;
 		ShaderByteCode			code;
@@ -106,9 +114,11 @@ namespace wiGraphicsTypes
 
 	class DomainShader
 	{
+		friend class GraphicsDevice;
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11DomainShader*		resource_DX11;
 		ShaderByteCode			code;
@@ -119,9 +129,11 @@ namespace wiGraphicsTypes
 
 	class ComputeShader
 	{
+		friend class GraphicsDevice;
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11ComputeShader*	resource_DX11;
 		ShaderByteCode			code;
@@ -135,6 +147,7 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11SamplerState*				resource_DX11;
 		D3D12_CPU_DESCRIPTOR_HANDLE*	resource_DX12;
@@ -153,6 +166,7 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	protected:
 		ID3D11ShaderResourceView*					SRV_DX11;					// main resource SRV
 		std::vector<ID3D11ShaderResourceView*>		additionalSRVs_DX11;		// can be used for sub-resources if requested
@@ -172,8 +186,15 @@ namespace wiGraphicsTypes
 		wiHandle									resource_Vulkan;
 		wiHandle									resourceMemory_Vulkan;
 
+		std::vector<uint8_t>						memory_Null;				// CPU memory backing the resource with the null device
+
 		GPUResource();
 		virtual ~GPUResource();
+	private:
+		uint64_t uniqueID;
+	public:
+		// Different for every resource that was ever created, unlike the address of the resource, which can be reused after it was deleted
+		uint64_t GetUniqueID() const { return uniqueID; }
 	};
 
 	class GPUBuffer : public GPUResource
@@ -181,6 +202,7 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11Buffer*								resource_DX11;
 		D3D12_CPU_DESCRIPTOR_HANDLE*				CBV_DX12;
@@ -189,7 +211,7 @@ namespace wiGraphicsTypes
 		GPUBuffer();
 		virtual ~GPUBuffer();
 
-		bool IsValid() { return resource_DX11 != nullptr || resource_DX12 != nullptr || resource_Vulkan != WI_NULL_HANDLE; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_DX12 != nullptr || resource_Vulkan != WI_NULL_HANDLE || !memory_Null.empty(); }
 		GPUBufferDesc GetDesc() { return desc; }
 	};
 
@@ -198,9 +220,11 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		size_t byteOffset;
 		uint64_t residentFrame;
+		uint8_t* mappedData_Vulkan = nullptr;
 	public:
 		GPURingBuffer() : byteOffset(0), residentFrame(0) {}
 		virtual ~GPURingBuffer() {}
@@ -211,9 +235,11 @@ namespace wiGraphicsTypes
 
 	class VertexLayout
 	{
+		friend class GraphicsDevice;
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11InputLayout*	resource_DX11;
 
@@ -225,9 +251,11 @@ namespace wiGraphicsTypes
 
 	class BlendState
 	{
+		friend class GraphicsDevice;
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11BlendState*	resource_DX11;
 		BlendStateDesc desc;
@@ -240,9 +268,11 @@ namespace wiGraphicsTypes
 
 	class DepthStencilState
 	{
+		friend class GraphicsDevice;
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11DepthStencilState*	resource_DX11;
 		DepthStencilStateDesc desc;
@@ -255,9 +285,11 @@ namespace wiGraphicsTypes
 
 	class RasterizerState
 	{
+		friend class GraphicsDevice;
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11RasterizerState*	resource_DX11;
 		RasterizerStateDesc desc;
@@ -282,6 +314,7 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		TextureDesc									desc;
 		ID3D11RenderTargetView*						RTV_DX11;
@@ -318,6 +351,7 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11Texture1D*			texture1D_DX11;
 	public:
@@ -330,6 +364,7 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11DepthStencilView*						DSV_DX11;
 		std::vector<ID3D11DepthStencilView*>		additionalDSVs_DX11;
@@ -349,6 +384,7 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11Texture3D*			texture3D_DX11;
 	public:
@@ -364,6 +400,7 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		std::vector<ID3D11Query*>	resource_DX11;
 		std::vector<int>			active;
@@ -389,6 +426,7 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D12PipelineState*			resource_DX12;
 		wiHandle						renderPass_Vulkan;
@@ -406,6 +444,7 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D12PipelineState*			resource_DX12;
 		wiHandle						pipeline_Vulkan;
@@ -423,6 +462,7 @@ namespace wiGraphicsTypes
 		friend class GraphicsDevice_DX11;
 		friend class GraphicsDevice_DX12;
 		friend class GraphicsDevice_Vulkan;
+		friend class GraphicsDevice_Null;
 	private:
 		RenderPassDesc desc;
 
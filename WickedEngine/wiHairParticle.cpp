@@ -322,7 +322,7 @@ void wiHairParticle::Generate()
 	
 	float avgPatchSize;
 	if(dVG>=0)
-		avgPatchSize = (float)count/((float)mesh->vertexGroups[dVG].vertices.size()/3.0f);
+		avgPatchSize = (float)count/((float)mesh->vertexGroups[dVG].size()/3.0f);
 	else
 		avgPatchSize = (float)count/((float)mesh->indices.size()/3.0f);
 
@@ -335,41 +335,13 @@ void wiHairParticle::Generate()
 		unsigned int vi[]={mesh->indices[i],mesh->indices[i+1],mesh->indices[i+2]};
 		float denMod[]={1,1,1},lenMod[]={1,1,1};
 		if (dVG >= 0) {
-			auto found = mesh->vertexGroups[dVG].vertices.find(vi[0]);
-			if (found != mesh->vertexGroups[dVG].vertices.end())
-				denMod[0] = found->second;
-			else
-				continue;
-
-			found = mesh->vertexGroups[dVG].vertices.find(vi[1]);
-			if (found != mesh->vertexGroups[dVG].vertices.end())
-				denMod[1] = found->second;
-			else
-				continue;
-
-			found = mesh->vertexGroups[dVG].vertices.find(vi[2]);
-			if (found != mesh->vertexGroups[dVG].vertices.end())
-				denMod[2] = found->second;
-			else
+			const VertexGroup& group = mesh->vertexGroups[dVG];
+			if (!group.findWeight(vi[0], denMod[0]) || !group.findWeight(vi[1], denMod[1]) || !group.findWeight(vi[2], denMod[2]))
 				continue;
 		}
 		if (lVG >= 0) {
-			auto found = mesh->vertexGroups[lVG].vertices.find(vi[0]);
-			if (found != mesh->vertexGroups[lVG].vertices.end())
-				lenMod[0] = found->second;
-			else
-				continue;
-
-			found = mesh->vertexGroups[lVG].vertices.find(vi[1]);
-			if (found != mesh->vertexGroups[lVG].vertices.end())
-				lenMod[1] = found->second;
-			else
-				continue;
-
-			found = mesh->vertexGroups[lVG].vertices.find(vi[2]);
-			if (found != mesh->vertexGroups[lVG].vertices.end())
-				lenMod[2] = found->second;
-			else
+			const VertexGroup& group = mesh->vertexGroups[lVG];
+			if (!group.findWeight(vi[0], lenMod[0]) || !group.findWeight(vi[1], lenMod[1]) || !group.findWeight(vi[2], lenMod[2]))
 				continue;
 		}
 		for (int m = 0; m < 3; ++m) {
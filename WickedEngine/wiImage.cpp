@@ -1,17 +1,23 @@
 #include "wiImage.h"
 #include "wiResourceManager.h"
 #include "wiRenderer.h"
+#include "wiFont.h"
 #include "wiImageEffects.h"
 #include "wiLoader.h"
 #include "wiHelper.h"
+#include "wiBackLog.h"
+#include "wiRectPacker.h"
 #include "SamplerMapping.h"
 #include "ResourceMapping.h"
 
 #include <thread>
+#include <algorithm>
 
 using namespace wiGraphicsTypes;
 using namespace std;
 
+#define MAX_BATCH_INSTANCES 4096
+
 #pragma region STATICS
 GPUBuffer			wiImage::constantBuffer, wiImage::processCb;
 
@@ -32,6 +38,15 @@ GraphicsPSO			wiImage::imagePSO[IMAGE_SHADER_COUNT][BLENDMODE_COUNT][STENCILMODE
 GraphicsPSO			wiImage::postprocessPSO[POSTPROCESS_COUNT];
 GraphicsPSO			wiImage::deferredPSO;
 
+VertexShader*		wiImage::instancedVS = nullptr;
+VertexLayout*		wiImage::instancedLayout = nullptr;
+GPURingBuffer		wiImage::instanceBuffer;
+GraphicsPSO			wiImage::imagePSO_instanced[IMAGE_SHADER_COUNT][BLENDMODE_COUNT][STENCILMODE_COUNT][IMAGE_HDR_COUNT];
+
+wiImage::Batch		wiImage::batches[GRAPHICSTHREAD_COUNT];
+wiImage::DrawStats	wiImage::frameDrawStats[GRAPHICSTHREAD_COUNT];
+wiImage::DrawStats	wiImage::drawStats;
+
 #pragma endregion
 
 wiImage::wiImage()
@@ -56,6 +71,13 @@ void wiImage::LoadBuffers()
 	bd.CPUAccessFlags = CPU_ACCESS_WRITE;
 	wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &processCb);
 
+	ZeroMemory(&bd, sizeof(bd));
+	bd.Usage = USAGE_DYNAMIC;
+	bd.ByteWidth = 4 * 1024 * 1024; // a full batch chunk (MAX_BATCH_INSTANCES) must fit in the image instance ring buffer
+	bd.BindFlags = BIND_VERTEX_BUFFER;
+	bd.CPUAccessFlags = CPU_ACCESS_WRITE;
+	wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &instanceBuffer);
+
 	BindPersistentState(GRAPHICSTHREAD_IMMEDIATE);
 }
 
@@ -64,6 +86,23 @@ void wiImage::LoadShaders()
 	vertexShader = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(wiRenderer::SHADERPATH + "imageVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
 	screenVS = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(wiRenderer::SHADERPATH + "screenVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
 
+	VertexLayoutDesc layout[] =
+	{
+		{ "TRANSFORM",	0, FORMAT_R32G32B32A32_FLOAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
+		{ "TRANSFORM",	1, FORMAT_R32G32B32A32_FLOAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
+		{ "TRANSFORM",	2, FORMAT_R32G32B32A32_FLOAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
+		{ "TRANSFORM",	3, FORMAT_R32G32B32A32_FLOAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
+		{ "TEXMULADD",	0, FORMAT_R32G32B32A32_FLOAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
+		{ "COLOR",		0, FORMAT_R32G32B32A32_FLOAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
+		{ "PIVOTMIP",	0, FORMAT_R32G32B32A32_FLOAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
+	};
+	VertexShaderInfo* vsinfo = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(wiRenderer::SHADERPATH + "imageVS_instanced.cso", wiResourceManager::VERTEXSHADER, layout, ARRAYSIZE(layout)));
+	if (vsinfo != nullptr)
+	{
+		instancedVS = vsinfo->vertexShader;
+		instancedLayout = vsinfo->vertexLayout;
+	}
+
 	imagePS[IMAGE_SHADER_STANDARD] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(wiRenderer::SHADERPATH + "imagePS.cso", wiResourceManager::PIXELSHADER));
 	imagePS[IMAGE_SHADER_SEPARATENORMALMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(wiRenderer::SHADERPATH + "imagePS_separatenormalmap.cso", wiResourceManager::PIXELSHADER));
 	imagePS[IMAGE_SHADER_DISTORTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(wiRenderer::SHADERPATH + "imagePS_distortion.cso", wiResourceManager::PIXELSHADER));
@@ -134,6 +173,19 @@ void wiImage::LoadShaders()
 
 					desc.RTFormats[0] = wiRenderer::RTFormat_hdr;
 					device->CreateGraphicsPSO(&desc, &imagePSO[i][j][k][1]);
+
+					if (i != IMAGE_SHADER_FULLSCREEN)
+					{
+						GraphicsPSODesc instancedDesc = desc;
+						instancedDesc.vs = instancedVS;
+						instancedDesc.il = instancedLayout;
+
+						instancedDesc.RTFormats[0] = wiRenderer::GetDevice()->GetBackBufferFormat();
+						device->CreateGraphicsPSO(&instancedDesc, &imagePSO_instanced[i][j][k][0]);
+
+						instancedDesc.RTFormats[0] = wiRenderer::RTFormat_hdr;
+						device->CreateGraphicsPSO(&instancedDesc, &imagePSO_instanced[i][j][k][1]);
+					}
 				}
 			}
 		}
@@ -341,43 +393,186 @@ void wiImage::BindPersistentState(GRAPHICSTHREAD threadID)
 	wiRenderer::GetDevice()->BindConstantBuffer(PS, &processCb, CB_GETBINDSLOT(PostProcessCB), threadID);
 }
 
-void wiImage::Draw(Texture2D* texture, const wiImageEffects& effects,GRAPHICSTHREAD threadID)
+Sampler* wiImage::GetSampler(const wiImageEffects& effects)
 {
-	GraphicsDevice* device = wiRenderer::GetDevice();
-	device->EventBegin("Image", threadID);
-
-	bool fullScreenEffect = false;
-
-	device->BindResource(PS, texture, TEXSLOT_ONDEMAND0, threadID);
-
-	device->BindStencilRef(effects.stencilRef, threadID);
-
-	if (effects.quality == QUALITY_NEAREST) 
+	if (effects.quality == QUALITY_NEAREST)
 	{
 		if (effects.sampleFlag == SAMPLEMODE_MIRROR)
-			device->BindSampler(PS, wiRenderer::samplers[SSLOT_POINT_MIRROR], SSLOT_ONDEMAND0, threadID);
+			return wiRenderer::samplers[SSLOT_POINT_MIRROR];
 		else if (effects.sampleFlag == SAMPLEMODE_WRAP)
-			device->BindSampler(PS, wiRenderer::samplers[SSLOT_POINT_WRAP], SSLOT_ONDEMAND0, threadID);
+			return wiRenderer::samplers[SSLOT_POINT_WRAP];
 		else if (effects.sampleFlag == SAMPLEMODE_CLAMP)
-			device->BindSampler(PS, wiRenderer::samplers[SSLOT_POINT_CLAMP], SSLOT_ONDEMAND0, threadID);
+			return wiRenderer::samplers[SSLOT_POINT_CLAMP];
 	}
-	else if (effects.quality == QUALITY_BILINEAR) 
+	else if (effects.quality == QUALITY_BILINEAR)
 	{
 		if (effects.sampleFlag == SAMPLEMODE_MIRROR)
-			device->BindSampler(PS, wiRenderer::samplers[SSLOT_LINEAR_MIRROR], SSLOT_ONDEMAND0, threadID);
+			return wiRenderer::samplers[SSLOT_LINEAR_MIRROR];
 		else if (effects.sampleFlag == SAMPLEMODE_WRAP)
-			device->BindSampler(PS, wiRenderer::samplers[SSLOT_LINEAR_WRAP], SSLOT_ONDEMAND0, threadID);
+			return wiRenderer::samplers[SSLOT_LINEAR_WRAP];
 		else if (effects.sampleFlag == SAMPLEMODE_CLAMP)
-			device->BindSampler(PS, wiRenderer::samplers[SSLOT_LINEAR_CLAMP], SSLOT_ONDEMAND0, threadID);
+			return wiRenderer::samplers[SSLOT_LINEAR_CLAMP];
 	}
-	else if (effects.quality == QUALITY_ANISOTROPIC) 
+	else if (effects.quality == QUALITY_ANISOTROPIC)
 	{
 		if (effects.sampleFlag == SAMPLEMODE_MIRROR)
-			device->BindSampler(PS, wiRenderer::samplers[SSLOT_ANISO_MIRROR], SSLOT_ONDEMAND0, threadID);
+			return wiRenderer::samplers[SSLOT_ANISO_MIRROR];
 		else if (effects.sampleFlag == SAMPLEMODE_WRAP)
-			device->BindSampler(PS, wiRenderer::samplers[SSLOT_ANISO_WRAP], SSLOT_ONDEMAND0, threadID);
+			return wiRenderer::samplers[SSLOT_ANISO_WRAP];
 		else if (effects.sampleFlag == SAMPLEMODE_CLAMP)
-			device->BindSampler(PS, wiRenderer::samplers[SSLOT_ANISO_CLAMP], SSLOT_ONDEMAND0, threadID);
+			return wiRenderer::samplers[SSLOT_ANISO_CLAMP];
+	}
+	return nullptr;
+}
+
+wiImage::IMAGE_SHADER wiImage::GetImageShader(const wiImageEffects& effects)
+{
+	// Determine relevant image rendering pixel shader:
+	bool NormalmapSeparate = effects.extractNormalMap;
+	bool Mask = effects.maskMap != nullptr;
+	bool Distort = effects.distortionMap != nullptr;
+	if (NormalmapSeparate)
+	{
+		return IMAGE_SHADER_SEPARATENORMALMAP;
+	}
+	if (Mask)
+	{
+		if (Distort)
+		{
+			return IMAGE_SHADER_DISTORTION_MASKED;
+		}
+		return IMAGE_SHADER_MASKED;
+	}
+	if (Distort)
+	{
+		return IMAGE_SHADER_DISTORTION;
+	}
+	return IMAGE_SHADER_STANDARD;
+}
+
+XMMATRIX wiImage::GetTransform(const wiImageEffects& effects)
+{
+	if (effects.typeFlag == WORLD)
+	{
+		XMMATRIX faceRot = XMMatrixIdentity();
+		if(effects.lookAt.w){
+			XMVECTOR vvv = (effects.lookAt.x==1 && !effects.lookAt.y && !effects.lookAt.z)?XMVectorSet(0,1,0,0):XMVectorSet(1,0,0,0);
+			faceRot =
+				XMMatrixLookAtLH(XMVectorSet(0,0,0,0)
+					,XMLoadFloat4(&effects.lookAt)
+					,XMVector3Cross(
+						vvv, XMLoadFloat4(&effects.lookAt)
+					)
+				)
+			;
+		}
+		else
+		{
+			faceRot = XMMatrixRotationQuaternion(XMLoadFloat4(&wiRenderer::getCamera()->rotation));
+		}
+
+		XMMATRIX view = wiRenderer::getCamera()->GetView();
+		XMMATRIX projection = wiRenderer::getCamera()->GetProjection();
+		// Remove possible jittering from temporal camera:
+		projection.r[2] = XMVectorSetX(projection.r[2], 0);
+		projection.r[2] = XMVectorSetY(projection.r[2], 0);
+
+		return XMMatrixScaling(effects.scale.x*effects.siz.x,-1*effects.scale.y*effects.siz.y,1)
+			*XMMatrixRotationZ(effects.rotation)
+			*faceRot
+			*XMMatrixTranslation(effects.pos.x,effects.pos.y,effects.pos.z)
+			*view * projection;
+	}
+
+	return XMMatrixScaling(effects.scale.x*effects.siz.x, effects.scale.y*effects.siz.y, 1)
+		* XMMatrixRotationZ(effects.rotation)
+		* XMMatrixTranslation(effects.pos.x, effects.pos.y, 0)
+		* wiRenderer::GetDevice()->GetScreenProjection();
+}
+
+XMFLOAT4 wiImage::GetColor(const wiImageEffects& effects)
+{
+	XMFLOAT4 color = effects.col;
+	color.x *= 1 - effects.fade;
+	color.y *= 1 - effects.fade;
+	color.z *= 1 - effects.fade;
+	color.w *= effects.opacity;
+	return color;
+}
+
+XMFLOAT4 wiImage::GetTexMulAdd(const wiImageEffects& effects)
+{
+	// todo: effects.drawRec -> texmuladd!
+
+	// the texture offset is in the space of the texture, then it is moved into its place inside the atlas:
+	const XMFLOAT4& atlas = effects.atlasMulAdd;
+	return XMFLOAT4(atlas.x, atlas.y, effects.texOffset.x * atlas.x + atlas.z, effects.texOffset.y * atlas.y + atlas.w);
+}
+
+void wiImage::Draw(Texture2D* texture, const wiImageEffects& effects,GRAPHICSTHREAD threadID)
+{
+	// texts that were batched before the image must stay below it:
+	wiFont::Flush(threadID);
+
+	frameDrawStats[threadID].images++;
+
+	Batch& batch = batches[threadID];
+	const bool normalImage = !effects.presentFullScreen && !effects.blur &&
+		!effects.process.active && !effects.bloom.separate && !effects.sunPos.x && !effects.sunPos.y;
+
+	if (batch.depth > 0 && normalImage)
+	{
+		ImageInstance instance;
+		XMStoreFloat4x4(&instance.mTransform, GetTransform(effects));
+		instance.mTexMulAdd = GetTexMulAdd(effects);
+		instance.mColor = GetColor(effects);
+		instance.mPivot_MipLevel = XMFLOAT4(effects.pivot.x, effects.pivot.y, effects.mipLevel, 0);
+
+		Batch::Range range;
+		range.texture = texture;
+		range.maskMap = effects.maskMap;
+		range.distortionMap = effects.distortionMap;
+		range.refractionSource = effects.refractionSource;
+		range.sampler = GetSampler(effects);
+		range.shader = GetImageShader(effects);
+		range.blendFlag = effects.blendFlag;
+		range.stencilComp = effects.stencilComp;
+		range.stencilRef = effects.stencilRef;
+		range.hdr = effects.hdr;
+		range.firstInstance = (uint32_t)batch.instances.size();
+		range.instanceCount = 1;
+
+		batch.instances.push_back(instance);
+
+		if (!batch.ranges.empty() && batch.ranges.back().SharesState(range))
+		{
+			batch.ranges.back().instanceCount++;
+		}
+		else
+		{
+			batch.ranges.push_back(range);
+		}
+		return;
+	}
+
+	// images that were batched before must stay below:
+	Flush(threadID);
+
+	frameDrawStats[threadID].drawCalls++;
+
+	GraphicsDevice* device = wiRenderer::GetDevice();
+	device->EventBegin("Image", threadID);
+
+	bool fullScreenEffect = false;
+
+	device->BindResource(PS, texture, TEXSLOT_ONDEMAND0, threadID);
+
+	device->BindStencilRef(effects.stencilRef, threadID);
+
+	Sampler* sampler = GetSampler(effects);
+	if (sampler != nullptr)
+	{
+		device->BindSampler(PS, sampler, SSLOT_ONDEMAND0, threadID);
 	}
 
 	if (effects.presentFullScreen)
@@ -392,96 +587,17 @@ void wiImage::Draw(Texture2D* texture, const wiImageEffects& effects,GRAPHICSTHR
 	{
 		ImageCB cb;
 
-		if(!effects.process.active && !effects.bloom.separate && !effects.sunPos.x && !effects.sunPos.y){
-			if(effects.typeFlag==SCREEN){
-				cb.mTransform = XMMatrixTranspose(
-					XMMatrixScaling(effects.scale.x*effects.siz.x, effects.scale.y*effects.siz.y, 1)
-					* XMMatrixRotationZ(effects.rotation)
-					* XMMatrixTranslation(effects.pos.x, effects.pos.y, 0)
-					* device->GetScreenProjection()
-				);
-			}
-			else if(effects.typeFlag==WORLD){
-				XMMATRIX faceRot = XMMatrixIdentity();
-				if(effects.lookAt.w){
-					XMVECTOR vvv = (effects.lookAt.x==1 && !effects.lookAt.y && !effects.lookAt.z)?XMVectorSet(0,1,0,0):XMVectorSet(1,0,0,0);
-					faceRot = 
-						XMMatrixLookAtLH(XMVectorSet(0,0,0,0)
-							,XMLoadFloat4(&effects.lookAt)
-							,XMVector3Cross(
-								vvv, XMLoadFloat4(&effects.lookAt)
-							)
-						)
-					;
-				}
-				else
-				{
-					faceRot = XMMatrixRotationQuaternion(XMLoadFloat4(&wiRenderer::getCamera()->rotation));
-				}
-
-				XMMATRIX view = wiRenderer::getCamera()->GetView();
-				XMMATRIX projection = wiRenderer::getCamera()->GetProjection();
-				// Remove possible jittering from temporal camera:
-				projection.r[2] = XMVectorSetX(projection.r[2], 0);
-				projection.r[2] = XMVectorSetY(projection.r[2], 0);
-
-				cb.mTransform = XMMatrixTranspose(
-						XMMatrixScaling(effects.scale.x*effects.siz.x,-1*effects.scale.y*effects.siz.y,1)
-						*XMMatrixRotationZ(effects.rotation)
-						*faceRot
-						*XMMatrixTranslation(effects.pos.x,effects.pos.y,effects.pos.z)
-						*view * projection
-					);
-			}
-
-			// todo: effects.drawRec -> texmuladd!
-
-			cb.mTexMulAdd = XMFLOAT4(1,1,effects.texOffset.x, effects.texOffset.y);
-			cb.mColor = effects.col;
-			cb.mColor.x *= 1 - effects.fade;
-			cb.mColor.y *= 1 - effects.fade;
-			cb.mColor.z *= 1 - effects.fade;
-			cb.mColor.w *= effects.opacity;
+		if(normalImage){
+			cb.mTransform = XMMatrixTranspose(GetTransform(effects));
+			cb.mTexMulAdd = GetTexMulAdd(effects);
+			cb.mColor = GetColor(effects);
 			cb.mPivot = effects.pivot;
 			cb.mMirror = effects.mirror;
-			cb.mPivot = effects.pivot;
 			cb.mMipLevel = effects.mipLevel;
 
 			device->UpdateBuffer(&constantBuffer, &cb, threadID);
 
-			// Determine relevant image rendering pixel shader:
-			IMAGE_SHADER targetShader;
-			bool NormalmapSeparate = effects.extractNormalMap;
-			bool Mask = effects.maskMap != nullptr;
-			bool Distort = effects.distortionMap != nullptr;
-			if (NormalmapSeparate)
-			{
-				targetShader = IMAGE_SHADER_SEPARATENORMALMAP;
-			}
-			else
-			{
-				if (Mask)
-				{
-					if (Distort)
-					{
-						targetShader = IMAGE_SHADER_DISTORTION_MASKED;
-					}
-					else
-					{
-						targetShader = IMAGE_SHADER_MASKED;
-					}
-				}
-				else if(Distort)
-				{
-					targetShader = IMAGE_SHADER_DISTORTION;
-				}
-				else
-				{
-					targetShader = IMAGE_SHADER_STANDARD;
-				}
-			}
-
-			device->BindGraphicsPSO(&imagePSO[targetShader][effects.blendFlag][effects.stencilComp][effects.hdr], threadID);
+			device->BindGraphicsPSO(&imagePSO[GetImageShader(effects)][effects.blendFlag][effects.stencilComp][effects.hdr], threadID);
 
 			fullScreenEffect = false;
 		}
@@ -647,6 +763,215 @@ void wiImage::Draw(Texture2D* texture, const wiImageEffects& effects,GRAPHICSTHR
 	device->EventEnd(threadID);
 }
 
+bool wiImage::Batch::Range::SharesState(const Range& other) const
+{
+	return
+		texture == other.texture &&
+		maskMap == other.maskMap &&
+		distortionMap == other.distortionMap &&
+		refractionSource == other.refractionSource &&
+		sampler == other.sampler &&
+		shader == other.shader &&
+		blendFlag == other.blendFlag &&
+		stencilComp == other.stencilComp &&
+		stencilRef == other.stencilRef &&
+		hdr == other.hdr;
+}
+
+void wiImage::BatchBegin(GRAPHICSTHREAD threadID)
+{
+	batches[threadID].depth++;
+}
+void wiImage::BatchEnd(GRAPHICSTHREAD threadID)
+{
+	Batch& batch = batches[threadID];
+	assert(batch.depth > 0 && "BatchEnd without BatchBegin!");
+	batch.depth--;
+	if (batch.depth == 0)
+	{
+		Flush(threadID);
+	}
+}
+void wiImage::Flush(GRAPHICSTHREAD threadID)
+{
+	Batch& batch = batches[threadID];
+	if (batch.instances.empty())
+	{
+		return;
+	}
+
+	GraphicsDevice* device = wiRenderer::GetDevice();
+	device->EventBegin("Image Batch", threadID);
+
+	// Only the states that differ from the previous range are bound:
+	const Batch::Range* bound = nullptr;
+	const uint32_t totalInstances = (uint32_t)batch.instances.size();
+	for (uint32_t chunkBegin = 0; chunkBegin < totalInstances; chunkBegin += MAX_BATCH_INSTANCES)
+	{
+		const uint32_t chunkInstances = min((uint32_t)MAX_BATCH_INSTANCES, totalInstances - chunkBegin);
+
+		UINT offset;
+		void* instanceData = device->AllocateFromRingBuffer(&instanceBuffer, sizeof(ImageInstance) * chunkInstances, offset, threadID);
+		if (instanceData == nullptr)
+		{
+			break;
+		}
+		memcpy(instanceData, &batch.instances[chunkBegin], sizeof(ImageInstance) * chunkInstances);
+		device->InvalidateBufferAccess(&instanceBuffer, threadID);
+
+		GPUBuffer* vbs[] = {
+			&instanceBuffer,
+		};
+		const UINT strides[] = {
+			sizeof(ImageInstance),
+		};
+		const UINT offsets[] = {
+			offset,
+		};
+		device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
+
+		for (const Batch::Range& range : batch.ranges)
+		{
+			const uint32_t begin = max(range.firstInstance, chunkBegin);
+			const uint32_t end = min(range.firstInstance + range.instanceCount, chunkBegin + chunkInstances);
+			if (begin >= end)
+			{
+				continue;
+			}
+
+			if (bound == nullptr || bound->texture != range.texture)
+			{
+				device->BindResource(PS, range.texture, TEXSLOT_ONDEMAND0, threadID);
+			}
+			if (bound == nullptr || bound->maskMap != range.maskMap)
+			{
+				device->BindResource(PS, range.maskMap, TEXSLOT_ONDEMAND1, threadID);
+			}
+			if (bound == nullptr || bound->distortionMap != range.distortionMap)
+			{
+				device->BindResource(PS, range.distortionMap, TEXSLOT_ONDEMAND2, threadID);
+			}
+			if (bound == nullptr || bound->refractionSource != range.refractionSource)
+			{
+				device->BindResource(PS, range.refractionSource, TEXSLOT_ONDEMAND3, threadID);
+			}
+			if (range.sampler != nullptr && (bound == nullptr || bound->sampler != range.sampler))
+			{
+				device->BindSampler(PS, range.sampler, SSLOT_ONDEMAND0, threadID);
+			}
+			if (bound == nullptr || bound->stencilRef != range.stencilRef)
+			{
+				device->BindStencilRef(range.stencilRef, threadID);
+			}
+			if (bound == nullptr || bound->shader != range.shader || bound->blendFlag != range.blendFlag ||
+				bound->stencilComp != range.stencilComp || bound->hdr != range.hdr)
+			{
+				device->BindGraphicsPSO(&imagePSO_instanced[range.shader][range.blendFlag][range.stencilComp][range.hdr], threadID);
+			}
+			bound = &range;
+
+			device->DrawInstanced(4, (int)(end - begin), 0, begin - chunkBegin, threadID);
+			frameDrawStats[threadID].drawCalls++;
+		}
+	}
+
+	batch.instances.clear();
+	batch.ranges.clear();
+
+	device->EventEnd(threadID);
+}
+
+void wiImage::LatchDrawStats()
+{
+	drawStats = DrawStats();
+	for (int i = 0; i < GRAPHICSTHREAD_COUNT; ++i)
+	{
+		drawStats.images += frameDrawStats[i].images;
+		drawStats.drawCalls += frameDrawStats[i].drawCalls;
+		frameDrawStats[i] = DrawStats();
+	}
+}
+
+void wiImage::Atlas::CleanUp()
+{
+	SAFE_DELETE(texture);
+	mulAdds.clear();
+}
+
+bool wiImage::BuildAtlas(const vector<Texture2D*>& textures, Atlas& atlas, GRAPHICSTHREAD threadID)
+{
+	using namespace wiRectPacker;
+
+	atlas.CleanUp();
+
+	if (textures.empty() || textures[0] == nullptr)
+	{
+		return false;
+	}
+
+	// the packed textures are kept one texel apart, so that bilinear filtering doesn't pick up the neighbours:
+	const int gap = 1;
+	const FORMAT format = textures[0]->GetDesc().Format;
+
+	vector<Texture2D*> packed;
+	vector<rect_xywhf> rects;
+	for (Texture2D* texture : textures)
+	{
+		if (texture == nullptr || texture->GetDesc().Format != format || find(packed.begin(), packed.end(), texture) != packed.end())
+		{
+			continue;
+		}
+		packed.push_back(texture);
+		rects.push_back(rect_xywhf(0, 0, (int)texture->GetDesc().Width + gap, (int)texture->GetDesc().Height + gap));
+	}
+
+	vector<rect_xywhf*> out_rects(rects.size());
+	for (size_t i = 0; i < rects.size(); ++i)
+	{
+		out_rects[i] = &rects[i];
+	}
+
+	vector<bin> bins;
+	if (!pack(out_rects.data(), (int)out_rects.size(), 16384, bins) || bins.size() != 1)
+	{
+		wiBackLog::post("Image atlas packing into single texture failed!");
+		return false;
+	}
+
+	TextureDesc desc;
+	ZeroMemory(&desc, sizeof(desc));
+	desc.Width = (UINT)bins[0].size.w;
+	desc.Height = (UINT)bins[0].size.h;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = format;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+	desc.Usage = USAGE_DEFAULT;
+	desc.BindFlags = BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+
+	GraphicsDevice* device = wiRenderer::GetDevice();
+	device->CreateTexture2D(&desc, nullptr, &atlas.texture);
+
+	for (size_t i = 0; i < packed.size(); ++i)
+	{
+		const rect_xywhf& rect = rects[i];
+		if (rect.flipped)
+		{
+			// copies can't rotate, so a texture that the packer flipped keeps being drawn from itself
+			continue;
+		}
+		const TextureDesc& src = packed[i]->GetDesc();
+		device->CopyTexture2D_Region(atlas.texture, 0, rect.x, rect.y, packed[i], 0, threadID);
+		atlas.mulAdds[packed[i]] = XMFLOAT4((float)src.Width / (float)desc.Width, (float)src.Height / (float)desc.Height,
+			(float)rect.x / (float)desc.Width, (float)rect.y / (float)desc.Height);
+	}
+
+	return true;
+}
+
 void wiImage::DrawDeferred(Texture2D* lightmap_diffuse, Texture2D* lightmap_specular, Texture2D* ao, 
 	GRAPHICSTHREAD threadID, int stencilRef)
 {
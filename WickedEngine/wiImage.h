@@ -4,6 +4,9 @@
 #include "ShaderInterop.h"
 #include "wiImageEffects.h"
 
+#include <vector>
+#include <unordered_map>
+
 enum BLENDMODE;
 
 class wiImage
@@ -84,6 +87,52 @@ protected:
 	static wiGraphicsTypes::GraphicsPSO postprocessPSO[POSTPROCESS_COUNT];
 	static wiGraphicsTypes::GraphicsPSO deferredPSO;
 
+	// Per-instance data of a batched image, read by imageVS_instanced
+	struct ImageInstance
+	{
+		XMFLOAT4X4	mTransform;
+		XMFLOAT4	mTexMulAdd;
+		XMFLOAT4	mColor;
+		XMFLOAT4	mPivot_MipLevel; // xy: pivot, z: mip level
+	};
+	static wiGraphicsTypes::VertexShader*   instancedVS;
+	static wiGraphicsTypes::VertexLayout*   instancedLayout;
+	static wiGraphicsTypes::GPURingBuffer   instanceBuffer;
+	static wiGraphicsTypes::GraphicsPSO imagePSO_instanced[IMAGE_SHADER_COUNT][BLENDMODE_COUNT][STENCILMODE_COUNT][IMAGE_HDR_COUNT];
+
+	// Images drawn on a thread inside a BatchBegin - BatchEnd block are collected here,
+	//	consecutive images that share every bound state are drawn with one instanced draw call
+	struct Batch
+	{
+		struct Range
+		{
+			wiGraphicsTypes::Texture2D* texture;
+			wiGraphicsTypes::Texture2D* maskMap;
+			wiGraphicsTypes::Texture2D* distortionMap;
+			wiGraphicsTypes::Texture2D* refractionSource;
+			wiGraphicsTypes::Sampler* sampler;
+			IMAGE_SHADER shader;
+			BLENDMODE blendFlag;
+			STENCILMODE stencilComp;
+			UINT stencilRef;
+			bool hdr;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+
+			bool SharesState(const Range& other) const;
+		};
+		std::vector<ImageInstance> instances;
+		std::vector<Range> ranges;
+		int depth = 0; // BatchBegin nesting
+	};
+	static Batch batches[GRAPHICSTHREAD_COUNT];
+
+	static wiGraphicsTypes::Sampler* GetSampler(const wiImageEffects& effects);
+	static IMAGE_SHADER GetImageShader(const wiImageEffects& effects);
+	static XMMATRIX GetTransform(const wiImageEffects& effects);
+	static XMFLOAT4 GetColor(const wiImageEffects& effects);
+	static XMFLOAT4 GetTexMulAdd(const wiImageEffects& effects);
+
 
 public:
 	static void LoadShaders();
@@ -95,8 +144,43 @@ private:
 public:
 	wiImage();
 	
+	// Inside a BatchBegin - BatchEnd block simple images (no blur or post process) are only added to the batch of the thread, otherwise they are drawn immediately
 	static void Draw(wiGraphicsTypes::Texture2D* texture, const wiImageEffects& effects,GRAPHICSTHREAD threadID);
 
+	// Images drawn between these are submitted together at BatchEnd (blocks can be nested, the outermost BatchEnd submits).
+	//	The same rules apply as for wiFont batches: render targets and scissor must not change inside the block without a Flush.
+	static void BatchBegin(GRAPHICSTHREAD threadID);
+	static void BatchEnd(GRAPHICSTHREAD threadID);
+	// Submit the images that were collected so far on the thread
+	static void Flush(GRAPHICSTHREAD threadID);
+
+	struct DrawStats
+	{
+		uint32_t images = 0;
+		uint32_t drawCalls = 0;
+	};
+	// Images drawn and draw calls issued for them in the last presented frame (without batching there is one draw call for every image)
+	static const DrawStats& GetDrawStats() { return drawStats; }
+	// Called by wiRenderer::Present at the end of the frame
+	static void LatchDrawStats();
+private:
+	static DrawStats frameDrawStats[GRAPHICSTHREAD_COUNT];
+	static DrawStats drawStats;
+public:
+
+	// Textures packed into one texture with wiRectPacker, so that images using any of them can be drawn in the same batch.
+	//	Sampling outside of the packed texture (texOffset scrolling, wrap or mirror addressing) is not possible from the atlas.
+	struct Atlas
+	{
+		wiGraphicsTypes::Texture2D* texture = nullptr;
+		// texture coordinate multiply-add of every packed texture inside the atlas
+		std::unordered_map<wiGraphicsTypes::Texture2D*, XMFLOAT4> mulAdds;
+
+		void CleanUp();
+	};
+	// Pack the textures into the atlas. Only textures with the format of the first one are packed. Returns false if packing failed.
+	static bool BuildAtlas(const std::vector<wiGraphicsTypes::Texture2D*>& textures, Atlas& atlas, GRAPHICSTHREAD threadID);
+
 	static void DrawDeferred(wiGraphicsTypes::Texture2D* lightmap_diffuse, wiGraphicsTypes::Texture2D* lightmap_specular, 
 		wiGraphicsTypes::Texture2D* ao, GRAPHICSTHREAD threadID, int stencilref = 0);
 
@@ -46,6 +46,8 @@ public:
 	XMFLOAT2 scale;
 	XMFLOAT4 drawRec;
 	XMFLOAT2 texOffset;
+	// texture coordinate multiply-add into an atlas texture (see wiImage::Atlas)
+	XMFLOAT4 atlasMulAdd;
 	XMFLOAT2 sunPos;
 	//(x,y,z) : direction, (w) :isenabled?
 	XMFLOAT4 lookAt;
@@ -137,6 +139,7 @@ public:
 		scale = XMFLOAT2(1, 1);
 		drawRec = XMFLOAT4(0, 0, 0, 0);
 		texOffset = XMFLOAT2(0, 0);
+		atlasMulAdd = XMFLOAT4(1, 1, 0, 0);
 		sunPos = XMFLOAT2(0, 0);
 		lookAt = XMFLOAT4(0, 0, 0, 0);
 		pivot = XMFLOAT2(0, 0);
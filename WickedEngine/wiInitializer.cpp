@@ -11,6 +11,9 @@
 #include "wiHelper.h"
 #include "wiWidget.h"
 #include "wiGPUSortLib.h"
+#include "wiJobSystem.h"
+#include "wiTimer.h"
+#include "wiStartupArguments.h"
 
 using namespace std;
 
@@ -19,10 +22,24 @@ namespace wiInitializer
 
 	void InitializeComponents()
 	{
+		wiJobSystem::Initialize();
 		wiBackLog::Initialize();
 		wiFrameRate::Initialize();
 		wiCpuInfo::Initialize();
 
+		// Pipeline states that were compiled by a previous run are taken from the cache. Start with "nopipelinecache" to measure a cold start.
+		if (wiStartupArguments::HasArgument("nopipelinecache"))
+		{
+			wiRenderer::PIPELINECACHEPATH = "";
+		}
+		wiGraphicsTypes::GraphicsDevice* device = wiRenderer::GetDevice();
+		if (!wiRenderer::PIPELINECACHEPATH.empty())
+		{
+			device->LoadPipelineCache(wiRenderer::PIPELINECACHEPATH);
+		}
+		device->ResetPipelineCacheStats();
+		wiTimer timer;
+
 		wiRenderer::SetUpStaticComponents();
 		wiLensFlare::Initialize();
 
@@ -37,6 +54,15 @@ namespace wiInitializer
 
 		wiGPUSortLib::LoadShaders();
 
+		wiGraphicsTypes::GraphicsDevice::PipelineCacheStats stats = device->GetPipelineCacheStats();
+		stringstream info("");
+		info << "Graphics initialized in " << (int)round(timer.elapsed()) << " ms, pipeline cache: " << stats.hits << " hits, " << stats.misses << " misses";
+		wiBackLog::post(info.str().c_str());
+		if (!wiRenderer::PIPELINECACHEPATH.empty())
+		{
+			device->SavePipelineCache(wiRenderer::PIPELINECACHEPATH);
+		}
+
 		if (FAILED(wiSoundEffect::Initialize()) || FAILED(wiMusic::Initialize()))
 		{
 			stringstream ss("");
@@ -0,0 +1,326 @@
+#include "wiJobSystem.h"
+#include "wiSpinLock.h"
+#include "wiProfiler.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <cstdlib>
+
+namespace wiJobSystem
+{
+	// A group of jobs from Execute or Dispatch, the unit of work that is scheduled to threads
+	struct Job
+	{
+		std::function<void(JobArgs)> task;
+		context* ctx = nullptr;
+		uint32_t groupID = 0;
+		uint32_t groupJobOffset = 0;
+		uint32_t groupJobEnd = 0;
+		size_t sharedmemory_size = 0;
+
+		void Execute();
+	};
+
+	// Every thread owns a queue. The owner pushes and pops at the back, so it continues with the most recently added (cache hot) work,
+	//	while idle threads steal from the front of the other queues.
+	struct JobQueue
+	{
+		std::deque<Job> jobs;
+		wiSpinLock lock;
+
+		void push_back(Job&& job)
+		{
+			lock.lock();
+			jobs.push_back(std::move(job));
+			lock.unlock();
+		}
+		bool pop_back(Job& job)
+		{
+			lock.lock();
+			if (jobs.empty())
+			{
+				lock.unlock();
+				return false;
+			}
+			job = std::move(jobs.back());
+			jobs.pop_back();
+			lock.unlock();
+			return true;
+		}
+		bool pop_front(Job& job)
+		{
+			lock.lock();
+			if (jobs.empty())
+			{
+				lock.unlock();
+				return false;
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			lock.unlock();
+			return true;
+		}
+	};
+
+	// Linear allocator for the shared memory of job groups.
+	//	A group is always finished by the thread that started it, and groups executed while waiting inside an other job
+	//	finish before that job does, so the allocations are freed in reverse order.
+	struct ScratchAllocator
+	{
+		static const size_t capacity = 64 * 1024;
+		uint8_t* buffer = nullptr;
+		size_t offset = 0;
+
+		~ScratchAllocator()
+		{
+			free(buffer);
+		}
+
+		void* allocate(size_t size)
+		{
+			size = (size + 15) & ~size_t(15);
+			if (buffer == nullptr)
+			{
+				buffer = (uint8_t*)malloc(capacity);
+			}
+			if (offset + size > capacity)
+			{
+				// Doesn't fit, fall back to the heap:
+				return malloc(size);
+			}
+			void* ptr = buffer + offset;
+			offset += size;
+			return ptr;
+		}
+		void deallocate(void* ptr, size_t size)
+		{
+			if (ptr >= buffer && ptr < buffer + capacity)
+			{
+				offset -= (size + 15) & ~size_t(15);
+			}
+			else
+			{
+				free(ptr);
+			}
+		}
+	};
+
+	struct InternalState
+	{
+		uint32_t numThreads = 1;
+		std::atomic<uint32_t> numActiveThreads{ 1 };
+		std::unique_ptr<JobQueue[]> queues;
+
+		std::atomic<int64_t> pendingJobs{ 0 };
+		std::atomic<uint32_t> sleepingThreads{ 0 };
+		std::atomic<bool> alive{ true };
+		std::mutex wakeMutex;
+		std::condition_variable wakeCondition;
+		std::vector<std::thread> threads;
+
+		// The workers must be stopped before the synchronization objects are destroyed at exit
+		~InternalState()
+		{
+			{
+				std::lock_guard<std::mutex> lock(wakeMutex);
+				alive.store(false);
+			}
+			wakeCondition.notify_all();
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+		}
+	} static state;
+
+	// Worker threads use their own queue, all other threads (main thread, loading threads, etc.) share the first queue
+	thread_local uint32_t threadIndex = 0;
+	thread_local ScratchAllocator scratch;
+
+	void Job::Execute()
+	{
+		JobArgs args;
+		args.groupID = groupID;
+		args.sharedmemory = sharedmemory_size > 0 ? scratch.allocate(sharedmemory_size) : nullptr;
+
+		for (uint32_t i = groupJobOffset; i < groupJobEnd; ++i)
+		{
+			args.jobIndex = i;
+			args.groupIndex = i - groupJobOffset;
+			args.isFirstJobInGroup = (i == groupJobOffset);
+			args.isLastJobInGroup = (i == groupJobEnd - 1);
+			task(args);
+		}
+
+		if (args.sharedmemory != nullptr)
+		{
+			scratch.deallocate(args.sharedmemory, sharedmemory_size);
+		}
+		ctx->counter.fetch_sub(1);
+	}
+
+	// Execute a job from the own queue, or steal one from an other thread. Returns false if there was nothing to do.
+	bool Work()
+	{
+		Job job;
+		bool found = state.queues[threadIndex].pop_back(job);
+		for (uint32_t i = 1; !found && i < state.numThreads; ++i)
+		{
+			found = state.queues[(threadIndex + i) % state.numThreads].pop_front(job);
+		}
+		if (!found)
+		{
+			return false;
+		}
+		state.pendingJobs.fetch_sub(1);
+		job.Execute();
+		return true;
+	}
+
+	void Submit(Job&& job)
+	{
+		state.pendingJobs.fetch_add(1);
+		state.queues[threadIndex].push_back(std::move(job));
+	}
+
+	// Wake up sleeping workers. Waking is skipped when nobody sleeps, which keeps the cost of starting jobs low while the workers are busy.
+	//	The sleeping counter is incremented before a worker checks for pending jobs, and the pending counter before checking for sleepers here,
+	//	so either the worker sees the new job, or it is found sleeping and notified.
+	void WakeUp(bool all)
+	{
+		if (state.sleepingThreads.load() > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(state.wakeMutex);
+			}
+			if (all)
+			{
+				state.wakeCondition.notify_all();
+			}
+			else
+			{
+				state.wakeCondition.notify_one();
+			}
+		}
+	}
+
+	void Initialize()
+	{
+		static bool initialized = false;
+		if (initialized)
+		{
+			return;
+		}
+		initialized = true;
+
+		state.numThreads = max(1u, std::thread::hardware_concurrency());
+		state.numActiveThreads.store(state.numThreads);
+		state.queues.reset(new JobQueue[state.numThreads]);
+
+		// The main thread is working too while waiting for jobs, so create one less worker:
+		for (uint32_t threadID = 1; threadID < state.numThreads; ++threadID)
+		{
+			state.threads.push_back(std::thread([threadID] {
+				threadIndex = threadID;
+				wiProfiler::GetInstance().SetThreadName("Job Worker " + std::to_string(threadID));
+				while (state.alive.load())
+				{
+					if (threadID >= state.numActiveThreads.load() || !Work())
+					{
+						std::unique_lock<std::mutex> lock(state.wakeMutex);
+						state.sleepingThreads.fetch_add(1);
+						state.wakeCondition.wait(lock, [threadID] {
+							return !state.alive.load() || (threadID < state.numActiveThreads.load() && state.pendingJobs.load() > 0);
+						});
+						state.sleepingThreads.fetch_sub(1);
+					}
+				}
+			}));
+		}
+	}
+
+	uint32_t GetThreadCount()
+	{
+		return state.numThreads;
+	}
+
+	void SetActiveThreadCount(uint32_t value)
+	{
+		{
+			std::lock_guard<std::mutex> lock(state.wakeMutex);
+			state.numActiveThreads.store(max(1u, min(value, state.numThreads)));
+		}
+		state.wakeCondition.notify_all();
+	}
+
+	uint32_t GetActiveThreadCount()
+	{
+		return state.numActiveThreads.load();
+	}
+
+	void Execute(context& ctx, const std::function<void(JobArgs)>& task)
+	{
+		ctx.counter.fetch_add(1);
+
+		Job job;
+		job.task = task;
+		job.ctx = &ctx;
+		job.groupID = 0;
+		job.groupJobOffset = 0;
+		job.groupJobEnd = 1;
+		Submit(std::move(job));
+
+		WakeUp(false);
+	}
+
+	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArgs)>& task, size_t sharedmemory_size)
+	{
+		if (jobCount == 0 || groupSize == 0)
+		{
+			return;
+		}
+
+		const uint32_t groupCount = DispatchGroupCount(jobCount, groupSize);
+		ctx.counter.fetch_add(groupCount);
+
+		for (uint32_t groupID = 0; groupID < groupCount; ++groupID)
+		{
+			Job job;
+			job.task = task;
+			job.ctx = &ctx;
+			job.groupID = groupID;
+			job.groupJobOffset = groupID * groupSize;
+			job.groupJobEnd = min(job.groupJobOffset + groupSize, jobCount);
+			job.sharedmemory_size = sharedmemory_size;
+			Submit(std::move(job));
+		}
+
+		WakeUp(groupCount > 1);
+	}
+
+	uint32_t DispatchGroupCount(uint32_t jobCount, uint32_t groupSize)
+	{
+		return (jobCount + groupSize - 1) / groupSize;
+	}
+
+	bool IsBusy(const context& ctx)
+	{
+		return ctx.counter.load() > 0;
+	}
+
+	void Wait(const context& ctx)
+	{
+		while (IsBusy(ctx))
+		{
+			if (!Work())
+			{
+				// Remaining jobs are running on the workers:
+				std::this_thread::yield();
+			}
+		}
+	}
+}
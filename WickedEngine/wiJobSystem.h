@@ -0,0 +1,53 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <functional>
+#include <atomic>
+
+namespace wiJobSystem
+{
+	// Create the worker threads, one less than the number of hardware threads, because the calling thread also works while waiting
+	void Initialize();
+
+	// Number of threads that can execute jobs, including the calling thread
+	uint32_t GetThreadCount();
+
+	// Limit the number of threads executing jobs (including the calling thread). Useful to measure how the workloads scale with the thread count.
+	void SetActiveThreadCount(uint32_t value);
+	uint32_t GetActiveThreadCount();
+
+	// Tracks the completion of a set of jobs. Every job started with a context increments its counter, and decrements it when finished.
+	//	Work that depends on some jobs can wait for the context that those jobs were started with.
+	struct context
+	{
+		std::atomic<uint32_t> counter{ 0 };
+	};
+
+	// Arguments that a job receives when executed
+	struct JobArgs
+	{
+		uint32_t jobIndex;		// index of the job in the whole dispatch
+		uint32_t groupID;		// index of the group that the job belongs to
+		uint32_t groupIndex;	// index of the job inside its group
+		bool isFirstJobInGroup;
+		bool isLastJobInGroup;
+		void* sharedmemory;		// thread local scratch memory, shared between the jobs of a group (nullptr if none was requested)
+	};
+
+	// Add a single job to execute asynchronously. Any idle thread will execute this job.
+	void Execute(context& ctx, const std::function<void(JobArgs)>& task);
+
+	// Divide a task into jobCount jobs and execute them in parallel.
+	//	groupSize	: number of jobs that are executed in sequence by the same thread, as one unit of work
+	//	sharedmemory_size : size of the scratch memory that is allocated for each group from the executing thread's scratch allocator
+	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArgs)>& task, size_t sharedmemory_size = 0);
+
+	// Number of job groups that a Dispatch with the given parameters would create
+	uint32_t DispatchGroupCount(uint32_t jobCount, uint32_t groupSize);
+
+	// Check if any jobs of the context are not finished yet
+	bool IsBusy(const context& ctx);
+
+	// Wait until all jobs of the context are finished. The calling thread is also executing jobs while waiting.
+	void Wait(const context& ctx);
+}
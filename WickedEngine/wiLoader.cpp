@@ -17,10 +17,12 @@
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "wiObjLoader.h"
+#include "wiJobSystem.h"
 
 #include <algorithm>
 #include <fstream>
 #include <iomanip>
+#include <atomic>
 
 using namespace std;
 using namespace wiGraphicsTypes;
@@ -1092,6 +1094,7 @@ Model* _CreateWorldNode()
 Scene::Scene()
 {
 	models.push_back(_CreateWorldNode());
+	Register(models[0]);
 }
 Scene::~Scene()
 {
@@ -1102,6 +1105,10 @@ Scene::~Scene()
 }
 void Scene::ClearWorld()
 {
+	nameIndex.clear();
+	idIndex.clear();
+	indexEntries.clear();
+
 	for (auto& x : models)
 	{
 		SAFE_DELETE(x);
@@ -1109,6 +1116,7 @@ void Scene::ClearWorld()
 	models.clear();
 
 	models.push_back(_CreateWorldNode());
+	Register(models[0]);
 }
 Model* Scene::GetWorldNode()
 {
@@ -1118,16 +1126,212 @@ void Scene::AddModel(Model* model)
 {
 	models.push_back(model);
 	model->attachTo(models[0]);
+	Register(model);
+}
+void Scene::Register(Transform* x)
+{
+	if (x == nullptr)
+	{
+		return;
+	}
+	IndexEntry entry;
+	auto it = indexEntries.find(x);
+	if (it != indexEntries.end())
+	{
+		// re-registered after renaming, it keeps its place among entities with the same name:
+		entry.order = it->second.order;
+		Unregister(x);
+	}
+	else
+	{
+		entry.order = nextIndexOrder++;
+	}
+	entry.nameHash = wiHashString(x->name).GetHash();
+	entry.ID = x->GetID();
+	NameEntry name;
+	name.transform = x;
+	name.order = entry.order;
+	nameIndex.insert(make_pair(entry.nameHash, name));
+	idIndex[entry.ID] = x;
+	indexEntries[x] = entry;
+}
+void Scene::Register(Model* model, bool includeModel)
+{
+	if (includeModel)
+	{
+		model->scene = this;
+		Register((Transform*)model);
+	}
+	for (Object* x : model->objects)
+	{
+		Register(x);
+	}
+	for (Armature* x : model->armatures)
+	{
+		Register(x);
+	}
+	for (Light* x : model->lights)
+	{
+		Register(x);
+	}
+	for (Decal* x : model->decals)
+	{
+		Register(x);
+	}
+	for (ForceField* x : model->forces)
+	{
+		Register(x);
+	}
+	for (EnvironmentProbe* x : model->environmentProbes)
+	{
+		Register(x);
+	}
+	for (Camera* x : model->cameras)
+	{
+		Register(x);
+	}
+}
+void Scene::Unregister(Transform* x)
+{
+	auto it = indexEntries.find(x);
+	if (it == indexEntries.end())
+	{
+		return;
+	}
+	auto range = nameIndex.equal_range(it->second.nameHash);
+	for (auto name = range.first; name != range.second; ++name)
+	{
+		if (name->second.transform == x)
+		{
+			nameIndex.erase(name);
+			break;
+		}
+	}
+	auto id = idIndex.find(it->second.ID);
+	if (id != idIndex.end() && id->second == x)
+	{
+		idIndex.erase(id);
+	}
+	indexEntries.erase(it);
+}
+void Scene::UpdateIndex(Transform* x)
+{
+	if (indexEntries.count(x) > 0)
+	{
+		Register(x);
+	}
+}
+Transform* Scene::FindTransform(const wiHashString& name) const
+{
+	return Find<Transform>(name);
+}
+Transform* Scene::FindTransform(uint64_t id) const
+{
+	auto it = idIndex.find(id);
+	if (it != idIndex.end() && it->second->GetID() == id)
+	{
+		return it->second;
+	}
+	return nullptr;
 }
 void Scene::Update()
 {
-	models[0]->UpdateTransform();
+	// Armatures are independent of each other, animate them in parallel before updating the transform hierarchy:
+	armatures.clear();
+	for (Model* x : models)
+	{
+		armatures.insert(armatures.end(), x->armatures.begin(), x->armatures.end());
+	}
+	Armature::AnimateArmatures(armatures);
+
+	UpdateHierarchy();
 
 	for (Model* x : models)
 	{
 		x->UpdateModel();
 	}
 }
+void Scene::FlattenHierarchy()
+{
+	hierarchy.clear();
+	hierarchyParents.clear();
+	hierarchyLevels.clear();
+
+	hierarchy.push_back(models[0]);
+	hierarchyParents.push_back(-1);
+	hierarchyLevels.push_back(0);
+
+	uint32_t levelBegin = 0;
+	uint32_t levelEnd = 1;
+	while (levelBegin < levelEnd)
+	{
+		hierarchyLevels.push_back(levelEnd);
+		for (uint32_t i = levelBegin; i < levelEnd; ++i)
+		{
+			for (Transform* child : hierarchy[i]->children)
+			{
+				hierarchy.push_back(child);
+				hierarchyParents.push_back((int)i);
+			}
+		}
+		levelBegin = levelEnd;
+		levelEnd = (uint32_t)hierarchy.size();
+	}
+
+	// Pointers could have been reused by new transforms, so everything is recomputed once:
+	for (Transform* x : hierarchy)
+	{
+		x->SetDirty();
+	}
+
+	hierarchyVersion = Transform::hierarchyVersion.load();
+}
+void Scene::UpdateHierarchy()
+{
+	if (hierarchyVersion != Transform::hierarchyVersion.load() || hierarchy.empty() || hierarchy[0] != models[0])
+	{
+		FlattenHierarchy();
+	}
+
+	auto updateRange = [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			Transform* x = hierarchy[i];
+			const int parent = hierarchyParents[i];
+			if (x->IsDirty() || (parent >= 0 && hierarchy[parent]->changed))
+			{
+				x->UpdateWorld();
+			}
+			else if (x->changed)
+			{
+				// Recomputed in the previous frame, but not moving any more:
+				x->UpdatePrev();
+				x->changed = false;
+			}
+		}
+	};
+
+	// Small levels are not worth distributing to the job system:
+	const uint32_t groupSize = 256;
+	for (size_t level = 0; level + 1 < hierarchyLevels.size(); ++level)
+	{
+		const uint32_t levelBegin = hierarchyLevels[level];
+		const uint32_t levelCount = hierarchyLevels[level + 1] - levelBegin;
+		if (levelCount <= groupSize)
+		{
+			updateRange(levelBegin, levelBegin + levelCount);
+		}
+		else
+		{
+			wiJobSystem::context ctx;
+			wiJobSystem::Dispatch(ctx, wiJobSystem::DispatchGroupCount(levelCount, groupSize), 1, [&](wiJobSystem::JobArgs args) {
+				const uint32_t begin = levelBegin + args.jobIndex * groupSize;
+				updateRange(begin, min(begin + groupSize, levelBegin + levelCount));
+			});
+			wiJobSystem::Wait(ctx);
+		}
+	}
+}
 #pragma endregion
 
 #pragma region CULLABLE
@@ -1320,32 +1524,39 @@ void Material::Serialize(wiArchive& archive)
 			archive >> alphaRef;
 		}
 
+		// The textures are loaded in parallel:
 		string texturesDir = archive.GetSourceDirectory() + "textures/";
+		wiResourceManager::LoadHandle surfaceMapHandle, textureHandle, normalMapHandle, displacementMapHandle, specularMapHandle;
 		if (!surfaceMapName.empty())
 		{
 			surfaceMapName = texturesDir + surfaceMapName;
-			surfaceMap = (Texture2D*)wiResourceManager::GetGlobal()->add(surfaceMapName);
+			surfaceMapHandle = wiResourceManager::GetGlobal()->addAsync(surfaceMapName);
 		}
 		if (!textureName.empty())
 		{
 			textureName = texturesDir + textureName;
-			texture = (Texture2D*)wiResourceManager::GetGlobal()->add(textureName);
+			textureHandle = wiResourceManager::GetGlobal()->addAsync(textureName);
 		}
 		if (!normalMapName.empty())
 		{
 			normalMapName = texturesDir + normalMapName;
-			normalMap = (Texture2D*)wiResourceManager::GetGlobal()->add(normalMapName);
+			normalMapHandle = wiResourceManager::GetGlobal()->addAsync(normalMapName);
 		}
 		if (!displacementMapName.empty())
 		{
 			displacementMapName = texturesDir + displacementMapName;
-			displacementMap = (Texture2D*)wiResourceManager::GetGlobal()->add(displacementMapName);
+			displacementMapHandle = wiResourceManager::GetGlobal()->addAsync(displacementMapName);
 		}
 		if (!specularMapName.empty())
 		{
 			specularMapName = texturesDir + specularMapName;
-			specularMap = (Texture2D*)wiResourceManager::GetGlobal()->add(specularMapName);
+			specularMapHandle = wiResourceManager::GetGlobal()->addAsync(specularMapName);
 		}
+		surfaceMap = (Texture2D*)surfaceMapHandle.Get();
+		texture = (Texture2D*)textureHandle.Get();
+		normalMap = (Texture2D*)normalMapHandle.Get();
+		displacementMap = (Texture2D*)displacementMapHandle.Get();
+		specularMap = (Texture2D*)specularMapHandle.Get();
 	}
 	else
 	{
@@ -1443,6 +1654,54 @@ MeshSubset::~MeshSubset()
 #pragma endregion
 
 #pragma region VERTEXGROUP
+void VertexGroup::addVertex(const VertexRef& vRef)
+{
+	if (indices.empty() || indices.back() < vRef.index)
+	{
+		indices.push_back(vRef.index);
+		weights.push_back(vRef.weight);
+	}
+	else
+	{
+		auto it = lower_bound(indices.begin(), indices.end(), vRef.index);
+		if (*it != vRef.index)
+		{
+			weights.insert(weights.begin() + (it - indices.begin()), vRef.weight);
+			indices.insert(it, vRef.index);
+		}
+	}
+	denseWeights.clear();
+}
+bool VertexGroup::findWeight(int vertexIndex, float& weight) const
+{
+	if (!denseWeights.empty())
+	{
+		if (vertexIndex < 0 || vertexIndex >= (int)denseWeights.size() || denseWeights[vertexIndex] == -FLT_MAX)
+		{
+			return false;
+		}
+		weight = denseWeights[vertexIndex];
+		return true;
+	}
+	auto it = lower_bound(indices.begin(), indices.end(), vertexIndex);
+	if (it == indices.end() || *it != vertexIndex)
+	{
+		return false;
+	}
+	weight = weights[it - indices.begin()];
+	return true;
+}
+void VertexGroup::buildDenseWeights(size_t vertexCount)
+{
+	denseWeights.assign(vertexCount, -FLT_MAX);
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		if (indices[i] >= 0 && indices[i] < (int)vertexCount)
+		{
+			denseWeights[indices[i]] = weights[i];
+		}
+	}
+}
 void VertexGroup::Serialize(wiArchive& archive)
 {
 	if (archive.IsReadMode())
@@ -1450,23 +1709,26 @@ void VertexGroup::Serialize(wiArchive& archive)
 		archive >> name;
 		size_t vertexCount;
 		archive >> vertexCount;
+		indices.clear();
+		weights.clear();
+		indices.reserve(vertexCount);
+		weights.reserve(vertexCount);
 		for (size_t i = 0; i < vertexCount; ++i)
 		{
-			int first;
-			float second;
-			archive >> first;
-			archive >> second;
-			vertices.insert(pair<int, float>(first, second));
+			VertexRef vRef;
+			archive >> vRef.index;
+			archive >> vRef.weight;
+			addVertex(vRef);
 		}
 	}
 	else
 	{
 		archive << name;
-		archive << vertices.size();
-		for (auto& x : vertices)
+		archive << indices.size();
+		for (size_t i = 0; i < indices.size(); ++i)
 		{
-			archive << x.first;
-			archive << x.second;
+			archive << indices[i];
+			archive << weights[i];
 		}
 	}
 }
@@ -1479,6 +1741,9 @@ GPUBuffer Mesh::impostorVB_TEX;
 
 Mesh::Mesh(const string& name) : name(name)
 {
+	static std::atomic<uint32_t> nextSortID(0);
+	sortID = nextSortID.fetch_add(1);
+
 	init();
 }
 Mesh::~Mesh() 
@@ -1901,6 +2166,16 @@ void Mesh::CreateRenderData()
 		vertices_Transformed_POS = vertices_POS;
 		vertices_Transformed_PRE = vertices_POS; // pre <- pos!! (previous positions will have the current positions initially)
 
+		// Ray picking hierarchy, deformed meshes are tested without it:
+		if (!hasDynamicVB() && !vertices_POS.empty())
+		{
+			bvh.Build(&vertices_POS[0].pos, sizeof(Vertex_POS), indices.data(), indices.size());
+		}
+		else
+		{
+			bvh.Clear();
+		}
+
 		// Map subset indices:
 		for (auto& subset : subsets)
 		{
@@ -1929,8 +2204,21 @@ void Mesh::CreateRenderData()
 		goalNormals.clear();
 		if (goalVG >= 0)
 		{
-			goalPositions.resize(vertexGroups[goalVG].vertices.size());
-			goalNormals.resize(vertexGroups[goalVG].vertices.size());
+			goalPositions.resize(vertexGroups[goalVG].size());
+			goalNormals.resize(vertexGroups[goalVG].size());
+		}
+
+		// Groups that contain a large part of the mesh get dense weights, so that they can be looked up by vertex index without searching:
+		for (auto& x : vertexGroups)
+		{
+			if (x.size() * 4 >= vertices_FULL.size())
+			{
+				x.buildDenseWeights(vertices_FULL.size());
+			}
+			else
+			{
+				x.denseWeights.clear();
+			}
 		}
 
 
@@ -2276,99 +2564,189 @@ void Mesh::ComputeNormals(bool smooth)
 	if (smooth)
 	{
 		// Compute smooth surface normals:
+		//	Every step is linear in the vertex or triangle count, the per element work is distributed with the job system
 
-		// 1.) Zero normals, they will be averaged later
-		for (size_t i = 0; i < vertices_FULL.size() - 1; i++)
-		{
-			vertices_FULL[i].nor = XMFLOAT4(0, 0, 0, 0);
-		}
+		const uint32_t vertexCount = (uint32_t)vertices_FULL.size();
+		const uint32_t triangleCount = (uint32_t)indices.size() / 3;
+		const uint32_t groupSize = 1024;
 
-		// 2.) Find identical vertices by POSITION, accumulate face normals
-		for (size_t i = 0; i < vertices_FULL.size() - 1; i++)
+		// 1.) Weld vertices by POSITION:
+		//	Positions are hashed into a grid, and only compared with the positions in the cells that their epsilon neighborhood overlaps
+		vector<uint32_t> positionIDs(vertexCount);
+		vector<XMFLOAT3> positions;
 		{
-			Vertex_FULL& v_search = vertices_FULL[i];
-
-			for (size_t ind = 0; ind < indices.size() / 3; ++ind)
-			{
-				uint32_t i0 = indices[ind * 3 + 0];
-				uint32_t i1 = indices[ind * 3 + 1];
-				uint32_t i2 = indices[ind * 3 + 2];
-
-				Vertex_FULL& v0 = vertices_FULL[i0];
-				Vertex_FULL& v1 = vertices_FULL[i1];
-				Vertex_FULL& v2 = vertices_FULL[i2];
-
-				bool match_pos0 =
-					fabs(v_search.pos.x - v0.pos.x) < FLT_EPSILON &&
-					fabs(v_search.pos.y - v0.pos.y) < FLT_EPSILON &&
-					fabs(v_search.pos.z - v0.pos.z) < FLT_EPSILON;
-
-				bool match_pos1 =
-					fabs(v_search.pos.x - v1.pos.x) < FLT_EPSILON &&
-					fabs(v_search.pos.y - v1.pos.y) < FLT_EPSILON &&
-					fabs(v_search.pos.z - v1.pos.z) < FLT_EPSILON;
-
-				bool match_pos2 =
-					fabs(v_search.pos.x - v2.pos.x) < FLT_EPSILON &&
-					fabs(v_search.pos.y - v2.pos.y) < FLT_EPSILON &&
-					fabs(v_search.pos.z - v2.pos.z) < FLT_EPSILON;
-
-				if (match_pos0 || match_pos1 || match_pos2)
-				{
-					XMVECTOR U = XMLoadFloat4(&v2.pos) - XMLoadFloat4(&v0.pos);
-					XMVECTOR V = XMLoadFloat4(&v1.pos) - XMLoadFloat4(&v0.pos);
-
-					XMVECTOR N = XMVector3Cross(U, V);
-					N = XMVector3Normalize(N);
-
-					XMFLOAT3 normal;
-					XMStoreFloat3(&normal, N);
-
-					v_search.nor.x += normal.x;
-					v_search.nor.y += normal.y;
-					v_search.nor.z += normal.z;
-				}
-
-			}
-		}
+			const float epsilon = FLT_EPSILON;
+			const float cellSize = 0.01f;
+			auto cellKey = [](int64_t x, int64_t y, int64_t z) {
+				// Different cells can share a key, that only makes the searched lists a bit longer:
+				return ((uint64_t)(x & 0x1FFFFF) << 42) | ((uint64_t)(y & 0x1FFFFF) << 21) | (uint64_t)(z & 0x1FFFFF);
+			};
 
-		// 3.) Find unique vertices by POSITION and TEXCOORD and MATERIAL and remove duplicates
-		for (size_t i = 0; i < vertices_FULL.size() - 1; i++)
-		{
-			const Vertex_FULL& v0 = vertices_FULL[i];
+			unordered_map<uint64_t, uint32_t> cellFirst; // first unique position in the cell
+			vector<uint32_t> cellNext; // next unique position in the same cell
+			cellFirst.reserve(vertexCount);
 
-			for (size_t j = i + 1; j < vertices_FULL.size(); j++)
+			for (uint32_t i = 0; i < vertexCount; ++i)
 			{
-				const Vertex_FULL& v1 = vertices_FULL[j];
-
-				bool unique_pos =
-					fabs(v0.pos.x - v1.pos.x) < FLT_EPSILON &&
-					fabs(v0.pos.y - v1.pos.y) < FLT_EPSILON &&
-					fabs(v0.pos.z - v1.pos.z) < FLT_EPSILON;
+				const XMFLOAT4& pos = vertices_FULL[i].pos;
 
-				bool unique_tex =
-					fabs(v0.tex.x - v1.tex.x) < FLT_EPSILON &&
-					fabs(v0.tex.y - v1.tex.y) < FLT_EPSILON &&
-					(int)v0.tex.z == (int)v1.tex.z;
+				const int64_t minX = (int64_t)floorf((pos.x - epsilon) / cellSize);
+				const int64_t minY = (int64_t)floorf((pos.y - epsilon) / cellSize);
+				const int64_t minZ = (int64_t)floorf((pos.z - epsilon) / cellSize);
+				const int64_t maxX = (int64_t)floorf((pos.x + epsilon) / cellSize);
+				const int64_t maxY = (int64_t)floorf((pos.y + epsilon) / cellSize);
+				const int64_t maxZ = (int64_t)floorf((pos.z + epsilon) / cellSize);
 
-				if (unique_pos && unique_tex)
+				uint32_t positionID = ~0u;
+				for (int64_t z = minZ; positionID == ~0u && z <= maxZ; ++z)
 				{
-					for (size_t ind = 0; ind < indices.size(); ++ind)
+					for (int64_t y = minY; positionID == ~0u && y <= maxY; ++y)
 					{
-						if (indices[ind] == j)
+						for (int64_t x = minX; positionID == ~0u && x <= maxX; ++x)
 						{
-							indices[ind] = static_cast<uint32_t>(i);
-						}
-						else if (indices[ind] > j && indices[ind] > 0)
-						{
-							indices[ind]--;
+							auto it = cellFirst.find(cellKey(x, y, z));
+							for (uint32_t candidate = (it == cellFirst.end() ? ~0u : it->second); candidate != ~0u; candidate = cellNext[candidate])
+							{
+								const XMFLOAT3& p = positions[candidate];
+								if (fabs(pos.x - p.x) < epsilon && fabs(pos.y - p.y) < epsilon && fabs(pos.z - p.z) < epsilon)
+								{
+									positionID = candidate;
+									break;
+								}
+							}
 						}
 					}
+				}
 
-					vertices_FULL.erase(vertices_FULL.begin() + j);
+				if (positionID == ~0u)
+				{
+					positionID = (uint32_t)positions.size();
+					positions.push_back(XMFLOAT3(pos.x, pos.y, pos.z));
+
+					const uint64_t key = cellKey((int64_t)floorf(pos.x / cellSize), (int64_t)floorf(pos.y / cellSize), (int64_t)floorf(pos.z / cellSize));
+					auto it = cellFirst.find(key);
+					if (it == cellFirst.end())
+					{
+						cellNext.push_back(~0u);
+						cellFirst[key] = positionID;
+					}
+					else
+					{
+						cellNext.push_back(it->second);
+						it->second = positionID;
+					}
 				}
+				positionIDs[i] = positionID;
+			}
+		}
+		const uint32_t positionCount = (uint32_t)positions.size();
+
+		// 2.) Compute area weighted face normals (the cross product is not normalized, its length is proportional to the triangle area)
+		vector<XMFLOAT3> faceNormals(triangleCount);
+		wiJobSystem::context ctx;
+		wiJobSystem::Dispatch(ctx, triangleCount, groupSize, [&](wiJobSystem::JobArgs args) {
+			const uint32_t face = args.jobIndex;
+			const XMFLOAT3& p0 = positions[positionIDs[indices[face * 3 + 0]]];
+			const XMFLOAT3& p1 = positions[positionIDs[indices[face * 3 + 1]]];
+			const XMFLOAT3& p2 = positions[positionIDs[indices[face * 3 + 2]]];
+
+			XMVECTOR U = XMLoadFloat3(&p2) - XMLoadFloat3(&p0);
+			XMVECTOR V = XMLoadFloat3(&p1) - XMLoadFloat3(&p0);
+			XMStoreFloat3(&faceNormals[face], XMVector3Cross(U, V));
+		});
+
+		// 3.) Gather the faces around every welded position into a compact adjacency list
+		vector<uint32_t> adjacencyOffsets(positionCount + 1, 0);
+		vector<uint32_t> adjacency(triangleCount * 3);
+		for (uint32_t i = 0; i < triangleCount * 3; ++i)
+		{
+			adjacencyOffsets[positionIDs[indices[i]] + 1]++;
+		}
+		for (uint32_t i = 0; i < positionCount; ++i)
+		{
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+		{
+			vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t i = 0; i < triangleCount * 3; ++i)
+			{
+				adjacency[cursor[positionIDs[indices[i]]]++] = i / 3;
+			}
+		}
+		wiJobSystem::Wait(ctx);
 
+		// 4.) Accumulate face normals per welded position, then normalize
+		vector<XMFLOAT3> positionNormals(positionCount);
+		wiJobSystem::Dispatch(ctx, positionCount, groupSize, [&](wiJobSystem::JobArgs args) {
+			const uint32_t positionID = args.jobIndex;
+			XMVECTOR N = XMVectorZero();
+			for (uint32_t i = adjacencyOffsets[positionID]; i < adjacencyOffsets[positionID + 1]; ++i)
+			{
+				N += XMLoadFloat3(&faceNormals[adjacency[i]]);
+			}
+			XMStoreFloat3(&positionNormals[positionID], XMVector3Normalize(N));
+		});
+		wiJobSystem::Wait(ctx);
+
+		wiJobSystem::Dispatch(ctx, vertexCount, groupSize, [&](wiJobSystem::JobArgs args) {
+			const XMFLOAT3& normal = positionNormals[positionIDs[args.jobIndex]];
+			Vertex_FULL& vert = vertices_FULL[args.jobIndex];
+			vert.nor.x = normal.x;
+			vert.nor.y = normal.y;
+			vert.nor.z = normal.z;
+		});
+		wiJobSystem::Wait(ctx);
+
+		// 5.) Find unique vertices by POSITION and TEXCOORD and MATERIAL and remove duplicates
+		struct VertexKey
+		{
+			uint32_t positionID;
+			float u, v;
+			int material;
+			bool operator==(const VertexKey& other) const
+			{
+				return positionID == other.positionID && u == other.u && v == other.v && material == other.material;
 			}
+		};
+		struct VertexKeyHasher
+		{
+			size_t operator()(const VertexKey& key) const
+			{
+				size_t h = hash<uint32_t>{}(key.positionID);
+				h ^= hash<float>{}(key.u) + 0x9e3779b9 + (h << 6) + (h >> 2);
+				h ^= hash<float>{}(key.v) + 0x9e3779b9 + (h << 6) + (h >> 2);
+				h ^= hash<int>{}(key.material) + 0x9e3779b9 + (h << 6) + (h >> 2);
+				return h;
+			}
+		};
+
+		unordered_map<VertexKey, uint32_t, VertexKeyHasher> uniqueVertices;
+		uniqueVertices.reserve(vertexCount);
+		vector<uint32_t> remap(vertexCount);
+		uint32_t uniqueCount = 0;
+		for (uint32_t i = 0; i < vertexCount; ++i)
+		{
+			const Vertex_FULL& vert = vertices_FULL[i];
+			VertexKey key = { positionIDs[i], vert.tex.x, vert.tex.y, (int)vert.tex.z };
+
+			auto it = uniqueVertices.find(key);
+			if (it == uniqueVertices.end())
+			{
+				uniqueVertices[key] = uniqueCount;
+				vertices_FULL[uniqueCount] = vert;
+				remap[i] = uniqueCount;
+				uniqueCount++;
+			}
+			else
+			{
+				remap[i] = it->second;
+			}
+		}
+		vertices_FULL.resize(uniqueCount);
+
+		for (auto& index : indices)
+		{
+			index = remap[index];
 		}
 	}
 	else
@@ -2500,6 +2878,7 @@ void Mesh::Serialize(wiArchive& archive)
 		{
 			size_t indexCount;
 			archive >> indexCount;
+			indices.reserve(indexCount);
 			unsigned int tempInd;
 			for (size_t i = 0; i < indexCount; ++i)
 			{
@@ -2511,6 +2890,7 @@ void Mesh::Serialize(wiArchive& archive)
 		{
 			size_t physicsVertCount;
 			archive >> physicsVertCount;
+			physicsverts.reserve(physicsVertCount);
 			XMFLOAT3 tempPhysicsVert;
 			for (size_t i = 0; i < physicsVertCount; ++i)
 			{
@@ -2522,6 +2902,7 @@ void Mesh::Serialize(wiArchive& archive)
 		{
 			size_t physicsIndexCount;
 			archive >> physicsIndexCount;
+			physicsindices.reserve(physicsIndexCount);
 			unsigned int tempInd;
 			for (size_t i = 0; i < physicsIndexCount; ++i)
 			{
@@ -3017,39 +3398,64 @@ void Model::FinishLoading()
 	}
 
 
+	// Index the names, so that the parents are found without comparing every transform with every other:
+	unordered_multimap<string, size_t> transformIndices;
+	transformIndices.reserve(transforms.size());
+	for (size_t i = 0; i < transforms.size(); ++i)
+	{
+		transformIndices.insert(make_pair(transforms[i]->name, i));
+	}
+	unordered_map<Armature*, unordered_map<string, Bone*>> boneIndices;
+
 	// Match loaded parenting information
 	for (Transform* x : transforms)
 	{
-		if (x->parent == nullptr)
+		if (x->parent == nullptr && !x->parentName.empty())
 		{
-			for (Transform* y : transforms)
+			// The first transform in order with a matching name is the parent, same as with a linear search:
+			Transform* y = nullptr;
+			size_t yIndex = transforms.size();
+			auto range = transformIndices.equal_range(x->parentName);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				if (it->second < yIndex && transforms[it->second] != x)
+				{
+					yIndex = it->second;
+					y = transforms[yIndex];
+				}
+			}
+
+			if (y != nullptr)
 			{
-				if (x != y && !x->parentName.empty() && !x->parentName.compare(y->name))
+				Transform* parent = y;
+				string parentName = parent->name;
+				if (!x->boneParent.empty())
 				{
-					Transform* parent = y;
-					string parentName = parent->name;
-					if (!x->boneParent.empty())
+					Armature* armature = dynamic_cast<Armature*>(y);
+					if (armature != nullptr)
 					{
-						Armature* armature = dynamic_cast<Armature*>(y);
-						if (armature != nullptr)
+						auto bones = boneIndices.find(armature);
+						if (bones == boneIndices.end())
 						{
+							bones = boneIndices.insert(make_pair(armature, unordered_map<string, Bone*>())).first;
+							bones->second.reserve(armature->boneCollection.size());
 							for (Bone* bone : armature->boneCollection)
 							{
-								if (!bone->name.compare(x->boneParent))
-								{
-									parent = bone;
-									break;
-								}
+								bones->second.insert(make_pair(bone->name, bone)); // keeps the first bone of duplicate names
 							}
 						}
+						auto bone = bones->second.find(x->boneParent);
+						if (bone != bones->second.end())
+						{
+							parent = bone->second;
+						}
 					}
-					// Match parent
-					XMFLOAT4X4 saved_parent_rest_inv = x->parent_inv_rest;
-					x->attachTo(parent);
-					x->parent_inv_rest = saved_parent_rest_inv;
-					x->parentName = parentName; // this will ensure that the bone parenting is always resolved as armature->bone
-					break;
 				}
+				// Match parent
+				XMFLOAT4X4 saved_parent_rest_inv = x->parent_inv_rest;
+				x->attachTo(parent);
+				x->parent_inv_rest = saved_parent_rest_inv;
+				x->parentName = parentName; // this will ensure that the bone parenting is always resolved as armature->bone
 			}
 		}
 
@@ -3062,6 +3468,11 @@ void Model::FinishLoading()
 
 
 	// Set up Render data
+	//	Meshes and armatures can be shared by multiple objects, so gather the unique ones first, then set them up in parallel:
+	Texture2D* trailTex = nullptr;
+	Texture2D* trailDistortTex = nullptr;
+	unordered_set<Mesh*> uniqueMeshes;
+	unordered_set<Armature*> uniqueArmatures;
 	for (Object* x : objects)
 	{
 		if (x->mesh != nullptr)
@@ -3069,20 +3480,36 @@ void Model::FinishLoading()
 			// Ribbon trails
 			if (x->mesh->trailInfo.base >= 0 && x->mesh->trailInfo.tip >= 0)
 			{
-				x->trailTex = wiTextureHelper::getInstance()->getTransparent();
-				x->trailDistortTex = wiTextureHelper::getInstance()->getNormalMapDefault();
+				if (trailTex == nullptr)
+				{
+					trailTex = wiTextureHelper::getInstance()->getTransparent();
+					trailDistortTex = wiTextureHelper::getInstance()->getNormalMapDefault();
+				}
+				x->trailTex = trailTex;
+				x->trailDistortTex = trailDistortTex;
 			}
 
-			// Mesh renderdata setup
-			x->mesh->Optimize();
-			x->mesh->CreateRenderData();
-
+			uniqueMeshes.insert(x->mesh);
 			if (x->mesh->armature != nullptr)
 			{
-				x->mesh->armature->CreateBuffers();
+				uniqueArmatures.insert(x->mesh->armature);
 			}
 		}
 	}
+	vector<Mesh*> meshesToCreate(uniqueMeshes.begin(), uniqueMeshes.end());
+	vector<Armature*> armaturesToCreate(uniqueArmatures.begin(), uniqueArmatures.end());
+
+	wiJobSystem::context ctx;
+	wiJobSystem::Dispatch(ctx, (uint32_t)meshesToCreate.size(), 1, [&meshesToCreate](wiJobSystem::JobArgs args) {
+		// Mesh renderdata setup
+		Mesh* mesh = meshesToCreate[args.jobIndex];
+		mesh->Optimize();
+		mesh->CreateRenderData();
+	});
+	wiJobSystem::Dispatch(ctx, (uint32_t)armaturesToCreate.size(), 1, [&armaturesToCreate](wiJobSystem::JobArgs args) {
+		armaturesToCreate[args.jobIndex]->CreateBuffers();
+	});
+	wiJobSystem::Wait(ctx);
 }
 void Model::UpdateModel()
 {
@@ -3115,6 +3542,10 @@ void Model::UpdateModel()
 		if (decal->life>-2) {
 			if (decal->life <= 0) {
 				decal->detach();
+				if (scene != nullptr)
+				{
+					scene->Unregister(decal);
+				}
 				decals.erase(iter++);
 				delete decal;
 				continue;
@@ -3128,6 +3559,10 @@ void Model::Add(Object* value)
 	if (value != nullptr)
 	{
 		objects.insert(value);
+		if (scene != nullptr)
+		{
+			scene->Register(value);
+		}
 		if (value->mesh != nullptr)
 		{
 			meshes.insert(pair<string, Mesh*>(value->mesh->name, value->mesh));
@@ -3144,6 +3579,10 @@ void Model::Add(Armature* value)
 	if (value != nullptr)
 	{
 		armatures.insert(value);
+		if (scene != nullptr)
+		{
+			scene->Register(value);
+		}
 	}
 }
 void Model::Add(Light* value)
@@ -3151,6 +3590,10 @@ void Model::Add(Light* value)
 	if (value != nullptr)
 	{
 		lights.insert(value);
+		if (scene != nullptr)
+		{
+			scene->Register(value);
+		}
 	}
 }
 void Model::Add(Decal* value)
@@ -3158,6 +3601,10 @@ void Model::Add(Decal* value)
 	if (value != nullptr)
 	{
 		decals.insert(value);
+		if (scene != nullptr)
+		{
+			scene->Register(value);
+		}
 	}
 }
 void Model::Add(ForceField* value)
@@ -3165,6 +3612,10 @@ void Model::Add(ForceField* value)
 	if (value != nullptr)
 	{
 		forces.insert(value);
+		if (scene != nullptr)
+		{
+			scene->Register(value);
+		}
 	}
 }
 void Model::Add(EnvironmentProbe* value)
@@ -3172,6 +3623,10 @@ void Model::Add(EnvironmentProbe* value)
 	if (value != nullptr)
 	{
 		environmentProbes.push_back(value);
+		if (scene != nullptr)
+		{
+			scene->Register(value);
+		}
 	}
 }
 void Model::Add(Camera* value)
@@ -3179,6 +3634,10 @@ void Model::Add(Camera* value)
 	if (value != nullptr)
 	{
 		cameras.push_back(value);
+		if (scene != nullptr)
+		{
+			scene->Register(value);
+		}
 	}
 }
 void Model::Add(Model* value)
@@ -3194,6 +3653,10 @@ void Model::Add(Model* value)
 		forces.insert(value->forces.begin(), value->forces.end());
 		environmentProbes.insert(environmentProbes.end(), value->environmentProbes.begin(), value->environmentProbes.end());
 		cameras.insert(cameras.end(), value->cameras.begin(), value->cameras.end());
+		if (scene != nullptr)
+		{
+			scene->Register(value, false);
+		}
 	}
 }
 void Model::Serialize(wiArchive& archive)
@@ -3424,16 +3887,9 @@ XMMATRIX Bone::getMatrix(int getTranslation, int getRotation, int getScale)
 	
 	return XMMatrixTranslation(0,0,length)*XMLoadFloat4x4(&world);
 }
-void Bone::UpdateTransform()
+void Bone::UpdateWorld()
 {
-	//Transform::UpdateTransform();
-
 	// Needs to be updated differently than regular Transforms
-
-	for (Transform* child : children)
-	{
-		child->UpdateTransform();
-	}
 }
 void Bone::Serialize(wiArchive& archive)
 {
@@ -3496,19 +3952,19 @@ void Bone::Serialize(wiArchive& archive)
 		for (auto& x : actionFrames)
 		{
 			archive << x.keyframesRot.size();
-			for (auto& y : x.keyframesRot)
+			for (size_t j = 0; j < x.keyframesRot.size(); ++j)
 			{
-				y.Serialize(archive);
+				x.keyframesRot[j].Serialize(archive);
 			}
 			archive << x.keyframesPos.size();
-			for (auto& y : x.keyframesPos)
+			for (size_t j = 0; j < x.keyframesPos.size(); ++j)
 			{
-				y.Serialize(archive);
+				x.keyframesPos[j].Serialize(archive);
 			}
 			archive << x.keyframesSca.size();
-			for (auto& y : x.keyframesSca)
+			for (size_t j = 0; j < x.keyframesSca.size(); ++j)
 			{
-				y.Serialize(archive);
+				x.keyframesSca[j].Serialize(archive);
 			}
 		}
 		archive << recursivePose;
@@ -3534,6 +3990,40 @@ void KeyFrame::Serialize(wiArchive& archive)
 		archive << frameI;
 	}
 }
+void KeyFrameTrack::push_back(const KeyFrame& keyframe)
+{
+	float time = (float)keyframe.frameI;
+	size_t pos = times.size();
+	if (!times.empty() && time < times.back())
+	{
+		pos = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+	}
+	times.insert(times.begin() + pos, time);
+	values.insert(values.begin() + pos, keyframe.data);
+}
+uint32_t KeyFrameTrack::Find(float time) const
+{
+	const uint32_t count = (uint32_t)times.size();
+
+	// Try the cached interval and the one after it first:
+	uint32_t i = cursor;
+	if (i + 1 < count && times[i] <= time)
+	{
+		if (time < times[i + 1])
+		{
+			return i;
+		}
+		if (i + 2 < count && time < times[i + 2])
+		{
+			cursor = i + 1;
+			return i + 1;
+		}
+	}
+
+	i = (uint32_t)(std::upper_bound(times.begin(), times.end(), time) - times.begin()) - 1;
+	cursor = i;
+	return i;
+}
 #pragma endregion
 
 #pragma region ANIMATIONLAYER
@@ -3629,24 +4119,27 @@ Armature::~Armature()
 	}
 	animationLayers.clear();
 }
-void Armature::UpdateTransform()
+void Armature::UpdateWorld()
 {
-	Transform::UpdateTransform();
+	Transform::UpdateWorld();
 
-	// Calculate local animation frame:
-	for (Bone* root : rootbones)
+	// The pose is computed ahead by AnimateArmatures when the whole scene is updated, otherwise animate now:
+	if (!poseAnimated)
 	{
-		RecursiveBoneTransform(this, root, XMMatrixIdentity());
+		AnimateBones();
 	}
+	poseAnimated = false;
 
 	// Local animation to world space and attachment transform:
 	XMMATRIX worldMatrix = getMatrix();
+	for (size_t i = 0; i < boneOrder.size(); ++i)
+	{
+		Bone* bone = boneOrder[i];
+		bone->worldPrev = bone->world;
+		XMStoreFloat4x4(&bone->world, XMLoadFloat4x4(&bonePose[i]) * worldMatrix);
+	}
 	for (Bone* bone : boneCollection)
 	{
-		XMMATRIX boneMatrix = XMLoadFloat4x4(&bone->world);
-		boneMatrix = boneMatrix * worldMatrix;
-		XMStoreFloat4x4(&bone->world, boneMatrix);
-
 		bone->UpdateTransform();
 	}
 }
@@ -3707,85 +4200,262 @@ void Armature::UpdateArmature()
 			anim.blendFact = 1;
 	}
 }
-void Armature::RecursiveBoneTransform(Armature* armature, Bone* bone, const XMMATRIX& parentCombinedMat)
+// Quaternion operations on 4 quaternions at once in SoA layout, they compute the same as XMQuaternionSlerp and XMQuaternionMultiply
+struct QuaternionSoA
 {
-	Bone* parent = (Bone*)bone->parent;
+	XMVECTOR x, y, z, w;
+};
+static inline QuaternionSoA QuaternionSlerpSoA(const QuaternionSoA& q0, const QuaternionSoA& q1, float t)
+{
+	const XMVECTOR one = XMVectorSplatOne();
+	const XMVECTOR oneMinusEpsilon = XMVectorReplicate(1.0f - 0.00001f);
+	const XMVECTOR T = XMVectorReplicate(t);
+	const XMVECTOR T0 = XMVectorReplicate(1 - t);
+
+	XMVECTOR cosOmega = XMVectorMultiply(q0.x, q1.x);
+	cosOmega = XMVectorMultiplyAdd(q0.y, q1.y, cosOmega);
+	cosOmega = XMVectorMultiplyAdd(q0.z, q1.z, cosOmega);
+	cosOmega = XMVectorMultiplyAdd(q0.w, q1.w, cosOmega);
+
+	XMVECTOR sign = XMVectorSelect(one, XMVectorNegate(one), XMVectorLess(cosOmega, XMVectorZero()));
+	cosOmega = XMVectorMultiply(cosOmega, sign);
+
+	// Nearly identical rotations are linearly interpolated:
+	XMVECTOR control = XMVectorLess(cosOmega, oneMinusEpsilon);
+	XMVECTOR sinOmega = XMVectorSqrt(XMVectorNegativeMultiplySubtract(cosOmega, cosOmega, one));
+	XMVECTOR omega = XMVectorATan2(sinOmega, cosOmega);
+	XMVECTOR invSinOmega = XMVectorReciprocal(sinOmega);
+
+	XMVECTOR s0 = XMVectorSelect(T0, XMVectorMultiply(XMVectorSin(XMVectorMultiply(T0, omega)), invSinOmega), control);
+	XMVECTOR s1 = XMVectorSelect(T, XMVectorMultiply(XMVectorSin(XMVectorMultiply(T, omega)), invSinOmega), control);
+	s1 = XMVectorMultiply(s1, sign);
+
+	QuaternionSoA result;
+	result.x = XMVectorMultiplyAdd(q1.x, s1, XMVectorMultiply(q0.x, s0));
+	result.y = XMVectorMultiplyAdd(q1.y, s1, XMVectorMultiply(q0.y, s0));
+	result.z = XMVectorMultiplyAdd(q1.z, s1, XMVectorMultiply(q0.z, s0));
+	result.w = XMVectorMultiplyAdd(q1.w, s1, XMVectorMultiply(q0.w, s0));
+	return result;
+}
+// Rotation q1 followed by q2
+static inline QuaternionSoA QuaternionMultiplySoA(const QuaternionSoA& q1, const QuaternionSoA& q2)
+{
+	QuaternionSoA result;
+	result.x = XMVectorSubtract(XMVectorAdd(XMVectorAdd(XMVectorMultiply(q2.w, q1.x), XMVectorMultiply(q2.x, q1.w)), XMVectorMultiply(q2.y, q1.z)), XMVectorMultiply(q2.z, q1.y));
+	result.y = XMVectorAdd(XMVectorAdd(XMVectorSubtract(XMVectorMultiply(q2.w, q1.y), XMVectorMultiply(q2.x, q1.z)), XMVectorMultiply(q2.y, q1.w)), XMVectorMultiply(q2.z, q1.x));
+	result.z = XMVectorAdd(XMVectorSubtract(XMVectorAdd(XMVectorMultiply(q2.w, q1.z), XMVectorMultiply(q2.x, q1.y)), XMVectorMultiply(q2.y, q1.x)), XMVectorMultiply(q2.z, q1.w));
+	result.w = XMVectorSubtract(XMVectorSubtract(XMVectorSubtract(XMVectorMultiply(q2.w, q1.w), XMVectorMultiply(q2.x, q1.x)), XMVectorMultiply(q2.y, q1.y)), XMVectorMultiply(q2.z, q1.z));
+	return result;
+}
+static inline float& PoseLane(std::vector<XMFLOAT4A>& channel, size_t boneIndex)
+{
+	return (&channel[boneIndex / 4].x)[boneIndex % 4];
+}
+void Armature::PoseSoA::resize(size_t groupCount)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		translation[i].resize(groupCount);
+		scale[i].resize(groupCount);
+	}
+	for (int i = 0; i < 4; ++i)
+	{
+		rotation[i].resize(groupCount);
+	}
+}
+void Armature::FlattenHierarchy()
+{
+	boneOrder.clear();
+	boneParents.clear();
+
+	// Depth first walk from the root bones, every bone is added before its children:
+	std::vector<std::pair<Bone*, int> > stack;
+	for (auto it = rootbones.rbegin(); it != rootbones.rend(); ++it)
+	{
+		stack.push_back(std::make_pair(*it, -1));
+	}
+	while (!stack.empty())
+	{
+		Bone* bone = stack.back().first;
+		int parent = stack.back().second;
+		stack.pop_back();
+
+		int index = (int)boneOrder.size();
+		boneOrder.push_back(bone);
+		boneParents.push_back(parent);
+		for (auto it = bone->childrenI.rbegin(); it != bone->childrenI.rend(); ++it)
+		{
+			stack.push_back(std::make_pair(*it, index));
+		}
+	}
+
+	bonePose.resize(boneOrder.size());
+	const size_t groupCount = (boneOrder.size() + 3) / 4;
+	poseFinal.resize(groupCount);
+	posePrev.resize(groupCount);
+	poseCurr.resize(groupCount);
+
+	flattenedBoneCount = boneCollection.size();
+}
+void Armature::SamplePose(PoseSoA& pose, int action, float frame)
+{
+	static const KeyFrameTrack emptyTrack = KeyFrameTrack();
+
+	for (size_t i = 0; i < boneOrder.size(); ++i)
+	{
+		const Bone* bone = boneOrder[i];
+		const bool valid = action < (int)bone->actionFrames.size();
+		const ActionFrames* frames = valid ? &bone->actionFrames[action] : nullptr;
+
+		XMFLOAT4 t, r, s;
+		XMStoreFloat4(&t, InterPolateKeyFrames(frame, valid ? frames->keyframesPos : emptyTrack, POSITIONKEYFRAMETYPE));
+		XMStoreFloat4(&r, InterPolateKeyFrames(frame, valid ? frames->keyframesRot : emptyTrack, ROTATIONKEYFRAMETYPE));
+		XMStoreFloat4(&s, InterPolateKeyFrames(frame, valid ? frames->keyframesSca : emptyTrack, SCALARKEYFRAMETYPE));
+
+		PoseLane(pose.translation[0], i) = t.x;
+		PoseLane(pose.translation[1], i) = t.y;
+		PoseLane(pose.translation[2], i) = t.z;
+		PoseLane(pose.rotation[0], i) = r.x;
+		PoseLane(pose.rotation[1], i) = r.y;
+		PoseLane(pose.rotation[2], i) = r.z;
+		PoseLane(pose.rotation[3], i) = r.w;
+		PoseLane(pose.scale[0], i) = s.x;
+		PoseLane(pose.scale[1], i) = s.y;
+		PoseLane(pose.scale[2], i) = s.z;
+	}
+}
+void Armature::AnimateBones()
+{
+	if (flattenedBoneCount != boneCollection.size() || boneOrder.empty())
+	{
+		FlattenHierarchy();
+	}
+
+	const size_t boneCount = boneOrder.size();
+	const size_t groupCount = (boneCount + 3) / 4;
 
 	// TRANSITION BLENDING + ADDITIVE BLENDING
-	XMVECTOR& finalTrans = XMVectorSet(0, 0, 0, 0);
-	XMVECTOR& finalRotat = XMQuaternionIdentity();
-	XMVECTOR& finalScala = XMVectorSet(1, 1, 1, 0);
+	for (size_t g = 0; g < groupCount; ++g)
+	{
+		poseFinal.translation[0][g] = poseFinal.translation[1][g] = poseFinal.translation[2][g] = XMFLOAT4A(0, 0, 0, 0);
+		poseFinal.rotation[0][g] = poseFinal.rotation[1][g] = poseFinal.rotation[2][g] = XMFLOAT4A(0, 0, 0, 0);
+		poseFinal.rotation[3][g] = XMFLOAT4A(1, 1, 1, 1);
+		poseFinal.scale[0][g] = poseFinal.scale[1][g] = poseFinal.scale[2][g] = XMFLOAT4A(1, 1, 1, 1);
+	}
 
-	for (auto& x : armature->animationLayers)
+	for (auto& x : animationLayers)
 	{
 		AnimationLayer& anim = *x;
 
-		float cf = anim.currentFrame, cfPrev = anim.currentFramePrevAction;
-		int activeAction = anim.activeAction, prevAction = anim.prevAction;
-		int maxCf = armature->actions[activeAction].frameCount, maxCfPrev = armature->actions[prevAction].frameCount;
+		SamplePose(posePrev, anim.prevAction, anim.currentFramePrevAction);
+		SamplePose(poseCurr, anim.activeAction, anim.currentFrame);
 
-		XMVECTOR& prevTrans = InterPolateKeyFrames(cfPrev, maxCfPrev, bone->actionFrames[prevAction].keyframesPos, POSITIONKEYFRAMETYPE);
-		XMVECTOR& prevRotat = InterPolateKeyFrames(cfPrev, maxCfPrev, bone->actionFrames[prevAction].keyframesRot, ROTATIONKEYFRAMETYPE);
-		XMVECTOR& prevScala = InterPolateKeyFrames(cfPrev, maxCfPrev, bone->actionFrames[prevAction].keyframesSca, SCALARKEYFRAMETYPE);
+		const float blendFact = anim.blendFact;
+		const float weight = anim.weight;
 
-		XMVECTOR& currTrans = InterPolateKeyFrames(cf, maxCf, bone->actionFrames[activeAction].keyframesPos, POSITIONKEYFRAMETYPE);
-		XMVECTOR& currRotat = InterPolateKeyFrames(cf, maxCf, bone->actionFrames[activeAction].keyframesRot, ROTATIONKEYFRAMETYPE);
-		XMVECTOR& currScala = InterPolateKeyFrames(cf, maxCf, bone->actionFrames[activeAction].keyframesSca, SCALARKEYFRAMETYPE);
+		for (size_t g = 0; g < groupCount; ++g)
+		{
+			XMVECTOR prevTrans[3], currTrans[3], finalTrans[3];
+			XMVECTOR prevScala[3], currScala[3], finalScala[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				prevTrans[c] = XMLoadFloat4A(&posePrev.translation[c][g]);
+				currTrans[c] = XMLoadFloat4A(&poseCurr.translation[c][g]);
+				finalTrans[c] = XMLoadFloat4A(&poseFinal.translation[c][g]);
+				prevScala[c] = XMLoadFloat4A(&posePrev.scale[c][g]);
+				currScala[c] = XMLoadFloat4A(&poseCurr.scale[c][g]);
+				finalScala[c] = XMLoadFloat4A(&poseFinal.scale[c][g]);
+			}
+			QuaternionSoA prevRotat = {
+				XMLoadFloat4A(&posePrev.rotation[0][g]), XMLoadFloat4A(&posePrev.rotation[1][g]),
+				XMLoadFloat4A(&posePrev.rotation[2][g]), XMLoadFloat4A(&posePrev.rotation[3][g])
+			};
+			QuaternionSoA currRotat = {
+				XMLoadFloat4A(&poseCurr.rotation[0][g]), XMLoadFloat4A(&poseCurr.rotation[1][g]),
+				XMLoadFloat4A(&poseCurr.rotation[2][g]), XMLoadFloat4A(&poseCurr.rotation[3][g])
+			};
+			QuaternionSoA finalRotat = {
+				XMLoadFloat4A(&poseFinal.rotation[0][g]), XMLoadFloat4A(&poseFinal.rotation[1][g]),
+				XMLoadFloat4A(&poseFinal.rotation[2][g]), XMLoadFloat4A(&poseFinal.rotation[3][g])
+			};
 
-		float blendFact = anim.blendFact;
+			switch (anim.type)
+			{
+			case AnimationLayer::ANIMLAYER_TYPE_PRIMARY:
+				for (int c = 0; c < 3; ++c)
+				{
+					finalTrans[c] = XMVectorLerp(prevTrans[c], currTrans[c], blendFact);
+					finalScala[c] = XMVectorLerp(prevScala[c], currScala[c], blendFact);
+				}
+				finalRotat = QuaternionSlerpSoA(prevRotat, currRotat, blendFact);
+				break;
+			case AnimationLayer::ANIMLAYER_TYPE_ADDITIVE:
+				for (int c = 0; c < 3; ++c)
+				{
+					finalTrans[c] = XMVectorLerp(finalTrans[c], XMVectorAdd(finalTrans[c], XMVectorLerp(prevTrans[c], currTrans[c], blendFact)), weight);
+					finalScala[c] = XMVectorLerp(finalScala[c], XMVectorMultiply(finalScala[c], XMVectorLerp(prevScala[c], currScala[c], blendFact)), weight);
+				}
+				finalRotat = QuaternionSlerpSoA(finalRotat, QuaternionMultiplySoA(finalRotat, QuaternionSlerpSoA(prevRotat, currRotat, blendFact)), weight); // normalize?
+				break;
+			default:
+				break;
+			}
 
-		switch (anim.type)
-		{
-		case AnimationLayer::ANIMLAYER_TYPE_PRIMARY:
-			finalTrans = XMVectorLerp(prevTrans, currTrans, blendFact);
-			finalRotat = XMQuaternionSlerp(prevRotat, currRotat, blendFact);
-			finalScala = XMVectorLerp(prevScala, currScala, blendFact);
-			break;
-		case AnimationLayer::ANIMLAYER_TYPE_ADDITIVE:
-			finalTrans = XMVectorLerp(finalTrans, XMVectorAdd(finalTrans, XMVectorLerp(prevTrans, currTrans, blendFact)), anim.weight);
-			finalRotat = XMQuaternionSlerp(finalRotat, XMQuaternionMultiply(finalRotat, XMQuaternionSlerp(prevRotat, currRotat, blendFact)), anim.weight); // normalize?
-			finalScala = XMVectorLerp(finalScala, XMVectorMultiply(finalScala, XMVectorLerp(prevScala, currScala, blendFact)), anim.weight);
-			break;
-		default:
-			break;
+			for (int c = 0; c < 3; ++c)
+			{
+				XMStoreFloat4A(&poseFinal.translation[c][g], finalTrans[c]);
+				XMStoreFloat4A(&poseFinal.scale[c][g], finalScala[c]);
+			}
+			XMStoreFloat4A(&poseFinal.rotation[0][g], finalRotat.x);
+			XMStoreFloat4A(&poseFinal.rotation[1][g], finalRotat.y);
+			XMStoreFloat4A(&poseFinal.rotation[2][g], finalRotat.z);
+			XMStoreFloat4A(&poseFinal.rotation[3][g], finalRotat.w);
 		}
 	}
-	XMVectorSetW(finalTrans, 1);
-	XMVectorSetW(finalScala, 1);
 
-	bone->worldPrev = bone->world;
-	bone->translationPrev = bone->translation;
-	bone->rotationPrev = bone->rotation;
-	XMStoreFloat3(&bone->translation, finalTrans);
-	XMStoreFloat4(&bone->rotation, finalRotat);
-	XMStoreFloat3(&bone->scale, finalScala);
-
-	XMMATRIX& anim =
-		XMMatrixScalingFromVector(finalScala)
-		* XMMatrixRotationQuaternion(finalRotat)
-		* XMMatrixTranslationFromVector(finalTrans);
+	// Parents are already computed when a bone is reached, so the hierarchy is resolved in one linear pass:
+	for (size_t i = 0; i < boneCount; ++i)
+	{
+		Bone* bone = boneOrder[i];
 
-	XMMATRIX& rest =
-		XMLoadFloat4x4(&bone->world_rest);
+		bone->translationPrev = bone->translation;
+		bone->rotationPrev = bone->rotation;
+		bone->translation = XMFLOAT3(PoseLane(poseFinal.translation[0], i), PoseLane(poseFinal.translation[1], i), PoseLane(poseFinal.translation[2], i));
+		bone->rotation = XMFLOAT4(PoseLane(poseFinal.rotation[0], i), PoseLane(poseFinal.rotation[1], i), PoseLane(poseFinal.rotation[2], i), PoseLane(poseFinal.rotation[3], i));
+		bone->scale = XMFLOAT3(PoseLane(poseFinal.scale[0], i), PoseLane(poseFinal.scale[1], i), PoseLane(poseFinal.scale[2], i));
 
-	XMMATRIX& boneMat =
-		anim * rest * parentCombinedMat
-		;
+		XMMATRIX anim =
+			XMMatrixScaling(bone->scale.x, bone->scale.y, bone->scale.z)
+			* XMMatrixRotationQuaternion(XMLoadFloat4(&bone->rotation))
+			* XMMatrixTranslation(bone->translation.x, bone->translation.y, bone->translation.z);
 
-	XMMATRIX& finalMat =
-		XMLoadFloat4x4(&bone->recursiveRestInv)*
-		boneMat
-		;
+		XMMATRIX boneMat = anim * XMLoadFloat4x4(&bone->world_rest);
+		if (boneParents[i] >= 0)
+		{
+			boneMat = boneMat * XMLoadFloat4x4(&bonePose[boneParents[i]]);
+		}
 
-	XMStoreFloat4x4(&bone->world, boneMat);
+		XMMATRIX finalMat =
+			XMLoadFloat4x4(&bone->recursiveRestInv)*
+			boneMat
+			;
 
-	XMStoreFloat4x4(&bone->boneRelativity, finalMat);
+		XMStoreFloat4x4(&bonePose[i], boneMat);
 
-	for (unsigned int i = 0; i<bone->childrenI.size(); ++i) {
-		RecursiveBoneTransform(armature, bone->childrenI[i], boneMat);
+		XMStoreFloat4x4(&bone->boneRelativity, finalMat);
 	}
+
+	poseAnimated = true;
+}
+void Armature::AnimateArmatures(const std::vector<Armature*>& armatures)
+{
+	wiJobSystem::context ctx;
+	wiJobSystem::Dispatch(ctx, (uint32_t)armatures.size(), 1, [&armatures](wiJobSystem::JobArgs args) {
+		armatures[args.jobIndex]->AnimateBones();
+	});
+	wiJobSystem::Wait(ctx);
 }
-XMVECTOR Armature::InterPolateKeyFrames(float cf, const int maxCf, const std::vector<KeyFrame>& keyframeList, KeyFrameType type)
+XMVECTOR Armature::InterPolateKeyFrames(float cf, const KeyFrameTrack& track, KeyFrameType type)
 {
 	XMVECTOR result = XMVectorSet(0, 0, 0, 0);
 
@@ -3793,73 +4463,37 @@ XMVECTOR Armature::InterPolateKeyFrames(float cf, const int maxCf, const std::ve
 	if (type == ROTATIONKEYFRAMETYPE) result = XMVectorSet(0, 0, 0, 1);
 	if (type == SCALARKEYFRAMETYPE)   result = XMVectorSet(1, 1, 1, 1);
 
-	//SEARCH 2 INTERPOLATABLE FRAMES
-	int nearest[2] = { 0,0 };
-	int first = 0, last = 0;
-	if (keyframeList.size()>1) {
-		first = keyframeList[0].frameI;
-		last = keyframeList.back().frameI;
-
-		if (cf <= first) { //BROKEN INTERVAL
-			nearest[0] = 0;
-			nearest[1] = 0;
-		}
-		else if (cf >= last) {
-			nearest[0] = (int)(keyframeList.size() - 1);
-			nearest[1] = (int)(keyframeList.size() - 1);
-		}
-		else { //IN BETWEEN TWO KEYFRAMES, DECIDE WHICH
-			for (int k = (int)keyframeList.size() - 1; k>0; k--)
-				if (keyframeList[k].frameI <= cf) {
-					nearest[0] = k;
-					break;
-				}
-			for (int k = 0; k<(int)keyframeList.size(); k++)
-				if (keyframeList[k].frameI >= cf) {
-					nearest[1] = k;
-					break;
-				}
-		}
-
-		//INTERPOLATE BETWEEN THE TWO FRAMES
-		int keyframes[2] = {
-			keyframeList[nearest[0]].frameI,
-			keyframeList[nearest[1]].frameI
-		};
-		float interframe = 0;
-		if (cf <= first || cf >= last) { //BROKEN INTERVAL
-			float intervalBegin = (float)(maxCf - keyframes[0]);
-			float intervalEnd = keyframes[1] + intervalBegin;
-			float intervalLen = abs(intervalEnd - intervalBegin);
-			float offsetCf = cf + intervalBegin;
-			if (intervalLen) interframe = offsetCf / intervalLen;
-		}
-		else {
-			float intervalBegin = (float)keyframes[0];
-			float intervalEnd = (float)keyframes[1];
-			float intervalLen = abs(intervalEnd - intervalBegin);
-			float offsetCf = cf - intervalBegin;
-			if (intervalLen) interframe = offsetCf / intervalLen;
+	const size_t count = track.size();
+	if (count > 1) {
+		//OUTSIDE THE KEYFRAMES, CLAMP TO THE BORDER
+		if (cf <= track.times[0]) {
+			result = XMLoadFloat4(&track.values[0]);
+		}
+		else if (cf >= track.times[count - 1]) {
+			result = XMLoadFloat4(&track.values[count - 1]);
+		}
+		else { //IN BETWEEN TWO KEYFRAMES, INTERPOLATE
+			uint32_t k = track.Find(cf);
+			float intervalBegin = track.times[k];
+			float intervalLen = track.times[k + 1] - intervalBegin;
+			float interframe = 0;
+			if (intervalLen > 0) interframe = (cf - intervalBegin) / intervalLen;
+
+			XMVECTOR a = XMLoadFloat4(&track.values[k]);
+			XMVECTOR b = XMLoadFloat4(&track.values[k + 1]);
+			if (type == ROTATIONKEYFRAMETYPE) {
+				return XMQuaternionNormalize(XMQuaternionSlerp(a, b, interframe));
+			}
+			return XMVectorLerp(a, b, interframe);
 		}
 
 		if (type == ROTATIONKEYFRAMETYPE) {
-			XMVECTOR quat[2] = {
-				XMLoadFloat4(&keyframeList[nearest[0]].data),
-				XMLoadFloat4(&keyframeList[nearest[1]].data)
-			};
-			result = XMQuaternionNormalize(XMQuaternionSlerp(quat[0], quat[1], interframe));
-		}
-		else {
-			XMVECTOR tran[2] = {
-				XMLoadFloat4(&keyframeList[nearest[0]].data),
-				XMLoadFloat4(&keyframeList[nearest[1]].data)
-			};
-			result = XMVectorLerp(tran[0], tran[1], interframe);
+			result = XMQuaternionNormalize(result);
 		}
 	}
 	else {
-		if (!keyframeList.empty())
-			result = XMLoadFloat4(&keyframeList.back().data);
+		if (!track.empty())
+			result = XMLoadFloat4(&track.values.back());
 	}
 
 	return result;
@@ -3951,6 +4585,8 @@ void Armature::CreateFamily()
 	for (unsigned int i = 0; i<rootbones.size(); ++i) {
 		RecursiveRest(this, rootbones[i]);
 	}
+
+	FlattenHierarchy();
 }
 void Armature::CreateBuffers()
 {
@@ -4073,9 +4709,9 @@ void Decal::addNormal(const std::string& nor){
 		normal = (Texture2D*)wiResourceManager::GetGlobal()->add(nor);
 	}
 }
-void Decal::UpdateTransform()
+void Decal::UpdateWorld()
 {
-	Transform::UpdateTransform();
+	Transform::UpdateWorld();
 
 	XMMATRIX rotMat = XMMatrixRotationQuaternion(XMLoadFloat4(&rotation));
 	XMVECTOR eye = XMLoadFloat3(&translation);
@@ -4141,9 +4777,9 @@ void Decal::Serialize(wiArchive& archive)
 #pragma endregion
 
 #pragma region CAMERA
-void Camera::UpdateTransform()
+void Camera::UpdateWorld()
 {
-	Transform::UpdateTransform();
+	Transform::UpdateWorld();
 
 	UpdateProps();
 }
@@ -4313,11 +4949,16 @@ void Object::FadeTrail() {
 		trail.pop_front();
 	}
 }
-void Object::UpdateTransform()
+void Object::UpdateWorld()
 {
-	Transform::UpdateTransform();
+	Transform::UpdateWorld();
 
 }
+bool Object::IsDirty() const
+{
+	// Billboards overwrite the world matrix in UpdateObject, so it must be recomputed every frame:
+	return Transform::IsDirty() || (mesh != nullptr && mesh->isBillboarded);
+}
 void Object::UpdateObject()
 {
 	XMMATRIX world = getMatrix();
@@ -4564,9 +5205,9 @@ float Light::GetRange() const
 	}
 	return 0;
 }
-void Light::UpdateTransform()
+void Light::UpdateWorld()
 {
-	Transform::UpdateTransform();
+	Transform::UpdateWorld();
 }
 
 void Light::UpdateLight()
@@ -8,10 +8,13 @@
 #include "wiFrustum.h"
 #include "wiTransform.h"
 #include "wiIntersectables.h"
+#include "wiMeshBVH.h"
+#include "wiHashString.h"
 #include "ShaderInterop.h"
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <unordered_set>
 #include <list>
 #include <deque>
@@ -28,6 +31,7 @@ struct Bone;
 struct Mesh;
 struct Material;
 struct Object;
+struct Scene;
 
 typedef std::map<std::string,Mesh*> MeshCollection;
 typedef std::map<std::string,Material*> MaterialCollection;
@@ -283,12 +287,21 @@ struct VertexRef{
 	VertexRef(){index=0;weight=0;}
 	VertexRef(int i, float w){index=i;weight=w;}
 };
+// The vertices of the group are stored sorted by their index, with the weights in a parallel array, so they can be iterated linearly.
+//	Large groups can also have a dense array of weights for every vertex of the mesh, for constant time lookups.
 struct VertexGroup{
 	std::string name;
-	std::map<int,float> vertices;
+	std::vector<int> indices;
+	std::vector<float> weights;
+	std::vector<float> denseWeights; // optional, indexed by the vertex index of the mesh, -FLT_MAX for the vertices that are not in the group
 	VertexGroup(){name="";}
 	VertexGroup(const std::string& n){name=n;}
-	void addVertex(const VertexRef& vRef){vertices.insert(std::pair<int,float>(vRef.index,vRef.weight));}
+	// Adding the vertices in increasing index order is the fast path, the rest is inserted in place. A vertex that is already in the group keeps its weight.
+	void addVertex(const VertexRef& vRef);
+	size_t size() const { return indices.size(); }
+	// Returns false if the vertex is not in the group
+	bool findWeight(int vertexIndex, float& weight) const;
+	void buildDenseWeights(size_t vertexCount);
 	void Serialize(wiArchive& archive);
 };
 struct MeshSubset
@@ -433,6 +446,7 @@ public:
 
 	std::string name;
 	std::string parent;
+	uint32_t sortID; // unique runtime identifier, used to batch instances by sort keys
 	std::vector<Vertex_FULL>	vertices_FULL;
 	std::vector<Vertex_POS>		vertices_POS; // position(xyz), normal+wind(w as uint)
 	std::vector<Vertex_TEX>		vertices_TEX; // texcoords
@@ -487,6 +501,9 @@ public:
 
 	float tessellationFactor;
 
+	// Triangle hierarchy of the static vertex positions for ray picking, built with the render data
+	wiMeshBVH bvh;
+
 	bool optimized;
 	bool renderDataComplete;
 
@@ -573,7 +590,8 @@ struct Object : public Cullable, public Transform
 	bool IsReflector() const;
 	int GetRenderTypes() const;
 	bool IsOccluded() const;
-	virtual void UpdateTransform();
+	virtual void UpdateWorld();
+	virtual bool IsDirty() const;
 	void UpdateObject();
 	XMMATRIX GetOBB() const;
 	void Serialize(wiArchive& archive);
@@ -606,11 +624,29 @@ struct Action
 		frameCount=0;
 	}
 };
+// Keyframes of a single animation channel in SoA layout, sorted by time.
+//	Sampling locates the keyframes with a cached cursor, because consecutive samples are usually close in time,
+//	and falls back to binary search when the cursor is not usable (jumps, action change, layers playing the same action).
+struct KeyFrameTrack
+{
+	std::vector<float> times;
+	std::vector<XMFLOAT4> values;
+	mutable uint32_t cursor = 0;
+
+	// Add a keyframe while keeping the track sorted. Appending in time order is O(1).
+	void push_back(const KeyFrame& keyframe);
+	size_t size() const { return times.size(); }
+	bool empty() const { return times.empty(); }
+	KeyFrame operator[](size_t i) const { return KeyFrame((int)times[i], values[i].x, values[i].y, values[i].z, values[i].w); }
+	// Index of the last keyframe whose time is not greater than the given time. The track must have at least 2 keyframes
+	//	and time must be inside the [first, last) interval.
+	uint32_t Find(float time) const;
+};
 struct ActionFrames
 {
-	std::vector< KeyFrame > keyframesRot;
-	std::vector< KeyFrame > keyframesPos;
-	std::vector< KeyFrame > keyframesSca;
+	KeyFrameTrack keyframesRot;
+	KeyFrameTrack keyframesPos;
+	KeyFrameTrack keyframesSca;
 
 	ActionFrames(){
 	}
@@ -647,7 +683,8 @@ struct Bone : public Transform
 	}
 
 	XMMATRIX getMatrix(int getTranslation = 1, int getRotation = 1, int getScale = 1);
-	virtual void UpdateTransform();
+	// The world matrix is computed by the armature, only the children are updated here
+	virtual void UpdateWorld();
 	void Serialize(wiArchive& archive);
 };
 struct AnimationLayer
@@ -717,6 +754,12 @@ public:
 	std::vector<ShaderBoneType> boneData;
 	wiGraphicsTypes::GPUBuffer boneBuffer;
 
+	// Flattened bone hierarchy: parents always come before their children, so the pose is computed in a single linear pass
+	std::vector<Bone*> boneOrder;
+	std::vector<int> boneParents; // index of the parent in boneOrder, -1 for root bones
+	// Animated bone matrices in armature space, in the order of boneOrder
+	std::vector<XMFLOAT4X4> bonePose;
+
 	Armature() :Transform(){
 		init();
 	};
@@ -751,11 +794,19 @@ public:
 	AnimationLayer* GetAnimLayer(const std::string& name);
 	void AddAnimLayer(const std::string& name);
 	void DeleteAnimLayer(const std::string& name);
-	virtual void UpdateTransform();
+	virtual void UpdateWorld();
+	// The bones are animated every frame
+	virtual bool IsDirty() const { return true; }
 	void UpdateArmature();
 	void CreateFamily();
 	void CreateBuffers();
 	Bone* GetBone(const std::string& name);
+	// Rebuild the flattened hierarchy from the bone family
+	void FlattenHierarchy();
+	// Evaluate the animation layers and compute the armature space pose of the bones
+	void AnimateBones();
+	// Animate the armatures in parallel on the job system. UpdateWorld will use the computed poses.
+	static void AnimateArmatures(const std::vector<Armature*>& armatures);
 	void Serialize(wiArchive& archive);
 
 	ALIGN_16
@@ -766,8 +817,21 @@ private:
 		POSITIONKEYFRAMETYPE,
 		SCALARKEYFRAMETYPE,
 	};
-	static void RecursiveBoneTransform(Armature* armature, Bone* bone, const XMMATRIX& parentCombinedMat);
-	static XMVECTOR InterPolateKeyFrames(float currentFrame, const int frameCount, const std::vector<KeyFrame>& keyframes, KeyFrameType type);
+	// Local pose of the bones in SoA layout, so that blending processes 4 bones at once. Lane i of element j belongs to bone 4*j+i.
+	struct PoseSoA
+	{
+		std::vector<XMFLOAT4A> translation[3];
+		std::vector<XMFLOAT4A> rotation[4];
+		std::vector<XMFLOAT4A> scale[3];
+
+		void resize(size_t groupCount);
+	};
+	PoseSoA poseFinal, posePrev, poseCurr;
+	size_t flattenedBoneCount = 0;
+	bool poseAnimated = false;
+
+	void SamplePose(PoseSoA& pose, int action, float frame);
+	static XMVECTOR InterPolateKeyFrames(float currentFrame, const KeyFrameTrack& keyframes, KeyFrameType type);
 };
 struct SHCAM{	
 	XMFLOAT4X4 View,Projection;
@@ -894,7 +958,7 @@ struct Light : public Cullable , public Transform
 
 	Light();
 	virtual ~Light();
-	virtual void UpdateTransform();
+	virtual void UpdateWorld();
 	void UpdateLight();
 	void SetType(LightType type);
 	LightType GetType() const { return type; }
@@ -920,7 +984,7 @@ struct Decal : public Cullable, public Transform
 	
 	void addTexture(const std::string& tex);
 	void addNormal(const std::string& nor);
-	virtual void UpdateTransform();
+	virtual void UpdateWorld();
 	void UpdateDecal();
 	float GetOpacity() const;
 	void Serialize(wiArchive& archive);
@@ -1126,7 +1190,9 @@ struct Camera:public Transform{
 	{
 		return XMLoadFloat4x4(&realProjection);
 	}
-	virtual void UpdateTransform();
+	virtual void UpdateWorld();
+	// The view can also change from projection parameters, so it is always updated
+	virtual bool IsDirty() const { return true; }
 
 	void Serialize(wiArchive& archive);
 };
@@ -1170,6 +1236,9 @@ struct Model : public Transform
 	std::list<EnvironmentProbe*> environmentProbes;
 	std::list<Camera*> cameras;
 
+	// The scene that the model was added to, its lookup index is kept up to date when entities are added or expire
+	Scene* scene = nullptr;
+
 	Model();
 	virtual ~Model();
 	void CleanUp();
@@ -1202,6 +1271,68 @@ struct Scene
 	Model* GetWorldNode();
 	void AddModel(Model* model);
 	void Update();
+
+	// Index of the entities by name and ID. Models added to the scene register their contents,
+	//	entities that are removed from the scene must be unregistered.
+	void Register(Transform* x);
+	void Register(Model* model, bool includeModel = true);
+	void Unregister(Transform* x);
+	// Call after an entity was renamed or its ID changed
+	void UpdateIndex(Transform* x);
+
+	// O(1) lookups through the index, the name is verified so hash collisions are never returned.
+	//	If more entities have the same name, the one that was registered first is returned (renaming keeps the original registration)
+	Transform* FindTransform(const wiHashString& name) const;
+	Transform* FindTransform(uint64_t id) const;
+	template<typename T>
+	T* Find(const wiHashString& name) const
+	{
+		T* result = nullptr;
+		uint64_t resultOrder = ~0ull;
+		auto range = nameIndex.equal_range(name.GetHash());
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second.order < resultOrder && it->second.transform->name == name.GetString())
+			{
+				T* x = dynamic_cast<T*>(it->second.transform);
+				if (x != nullptr)
+				{
+					result = x;
+					resultOrder = it->second.order;
+				}
+			}
+		}
+		return result;
+	}
+
+private:
+	std::vector<Armature*> armatures; // armatures of all models, gathered for the parallel animation
+
+	struct IndexEntry
+	{
+		size_t nameHash;
+		uint64_t ID;
+		uint64_t order; // registration order, duplicate names resolve to the lowest
+	};
+	struct NameEntry
+	{
+		Transform* transform;
+		uint64_t order;
+	};
+	std::unordered_multimap<size_t, NameEntry> nameIndex;
+	uint64_t nextIndexOrder = 0;
+	std::unordered_map<uint64_t, Transform*> idIndex;
+	std::unordered_map<Transform*, IndexEntry> indexEntries; // the keys that every entity was registered with, for removal after renaming
+
+	// The transform tree flattened in breadth first order, so every level can be updated in parallel after the previous one:
+	std::vector<Transform*> hierarchy;
+	std::vector<int> hierarchyParents;		// index of the parent in the hierarchy, -1 for the root
+	std::vector<uint32_t> hierarchyLevels;	// offset of the first transform of every level, plus the total count at the end
+	uint32_t hierarchyVersion = ~0u;
+
+	void FlattenHierarchy();
+	// Recompute the world state of the transforms that are dirty, or whose parent was recomputed
+	void UpdateHierarchy();
 };
 
 
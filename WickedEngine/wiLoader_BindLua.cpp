@@ -3,6 +3,7 @@
 #include "Matrix_BindLua.h"
 #include "wiEmittedParticle.h"
 #include "Texture_BindLua.h"
+#include "wiRenderer.h"
 
 using namespace std;
 
@@ -73,6 +74,11 @@ int Node_BindLua::SetName(lua_State* L)
 	if (argc > 0)
 	{
 		node->name = wiLua::SGetString(L, 1);
+		Transform* transform = wiRenderer::GetScene().FindTransform(node->GetID());
+		if (transform == node)
+		{
+			wiRenderer::GetScene().UpdateIndex(transform);
+		}
 	}
 	else
 	{
@@ -0,0 +1,506 @@
+#include "wiMeshBVH.h"
+#include "wiIntersectables.h"
+#include "wiJobSystem.h"
+
+#include <algorithm>
+
+#define MESH_BVH_LEAF_SIZE 4
+#define MESH_BVH_SAH_BINS 16
+#define MESH_BVH_MAX_SAH_DEPTH 20
+#define MESH_BVH_STACK_SIZE 256
+#define MESH_BVH_RAY_EPSILON 1e-20f
+#define MESH_BVH_SLAB_ROUNDING 1.0000004f
+
+using namespace std;
+
+namespace wiMeshBVH_Internal
+{
+	inline float HalfArea(const XMFLOAT3& _min, const XMFLOAT3& _max)
+	{
+		if (_min.x > _max.x || _min.y > _max.y || _min.z > _max.z)
+		{
+			return 0;
+		}
+		const float x = _max.x - _min.x;
+		const float y = _max.y - _min.y;
+		const float z = _max.z - _min.z;
+		return x * y + y * z + z * x;
+	}
+	inline float GetAxis(const XMFLOAT3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+	inline float GetLane(const XMFLOAT4A& v, int lane)
+	{
+		return (&v.x)[lane];
+	}
+	inline void SetLane(XMFLOAT4A& v, int lane, float value)
+	{
+		(&v.x)[lane] = value;
+	}
+	inline XMFLOAT3 Min(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(min(a.x, b.x), min(a.y, b.y), min(a.z, b.z));
+	}
+	inline XMFLOAT3 Max(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(max(a.x, b.x), max(a.y, b.y), max(a.z, b.z));
+	}
+
+	struct StackEntry
+	{
+		uint32_t child;
+		float distance; // entry distance of the ray into the child bounds
+	};
+}
+using namespace wiMeshBVH_Internal;
+
+
+void wiMeshBVH::Clear()
+{
+	nodes.clear();
+	blocks.clear();
+}
+
+void wiMeshBVH::Build(const XMFLOAT3* positions, size_t positionStride, const uint32_t* indices, size_t indexCount)
+{
+	Clear();
+
+	const uint32_t triangleCount = (uint32_t)(indexCount / 3);
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	auto position = [&](uint32_t index) -> const XMFLOAT3& {
+		return *(const XMFLOAT3*)((const uint8_t*)positions + index * positionStride);
+	};
+
+	std::vector<XMFLOAT3> boundsMin(triangleCount);
+	std::vector<XMFLOAT3> boundsMax(triangleCount);
+	std::vector<XMFLOAT3> centers(triangleCount);
+	std::vector<uint32_t> triangles(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		const XMFLOAT3& p0 = position(indices[i * 3 + 0]);
+		const XMFLOAT3& p1 = position(indices[i * 3 + 1]);
+		const XMFLOAT3& p2 = position(indices[i * 3 + 2]);
+		boundsMin[i] = Min(p0, Min(p1, p2));
+		boundsMax[i] = Max(p0, Max(p1, p2));
+		centers[i] = XMFLOAT3((boundsMin[i].x + boundsMax[i].x) * 0.5f, (boundsMin[i].y + boundsMax[i].y) * 0.5f, (boundsMin[i].z + boundsMax[i].z) * 0.5f);
+		triangles[i] = i;
+	}
+
+	nodes.reserve(triangleCount / (MESH_BVH_LEAF_SIZE * 2) + 1);
+	blocks.reserve(triangleCount / (MESH_BVH_LEAF_SIZE / 2) + 1);
+	BuildNode(triangles, boundsMin, boundsMax, centers, 0, triangleCount, 0);
+
+	// Fill the triangle blocks:
+	for (TriangleBlock& block : blocks)
+	{
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			XMFLOAT3 v0 = XMFLOAT3(0, 0, 0), e1 = XMFLOAT3(0, 0, 0), e2 = XMFLOAT3(0, 0, 0);
+			const uint32_t triangle = block.triangles[lane];
+			if (triangle != TRIANGLE_INVALID)
+			{
+				const XMFLOAT3& p0 = position(indices[triangle * 3 + 0]);
+				const XMFLOAT3& p1 = position(indices[triangle * 3 + 1]);
+				const XMFLOAT3& p2 = position(indices[triangle * 3 + 2]);
+				v0 = p0;
+				e1 = XMFLOAT3(p1.x - p0.x, p1.y - p0.y, p1.z - p0.z);
+				e2 = XMFLOAT3(p2.x - p0.x, p2.y - p0.y, p2.z - p0.z);
+			}
+			SetLane(block.v0X, lane, v0.x);
+			SetLane(block.v0Y, lane, v0.y);
+			SetLane(block.v0Z, lane, v0.z);
+			SetLane(block.e1X, lane, e1.x);
+			SetLane(block.e1Y, lane, e1.y);
+			SetLane(block.e1Z, lane, e1.z);
+			SetLane(block.e2X, lane, e2.x);
+			SetLane(block.e2Y, lane, e2.y);
+			SetLane(block.e2Z, lane, e2.z);
+		}
+	}
+
+	// Children are always placed after their parents, so a reverse iteration computes the node bounds bottom-up:
+	for (size_t i = nodes.size(); i > 0; --i)
+	{
+		Node& node = nodes[i - 1];
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			XMFLOAT3 _min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+			XMFLOAT3 _max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+			const uint32_t child = node.children[lane];
+			if (child == CHILD_INVALID)
+			{
+				// empty lane
+			}
+			else if (child & CHILD_LEAF)
+			{
+				const TriangleBlock& block = blocks[child & ~CHILD_LEAF];
+				for (int j = 0; j < 4; ++j)
+				{
+					if (block.triangles[j] != TRIANGLE_INVALID)
+					{
+						_min = Min(_min, boundsMin[block.triangles[j]]);
+						_max = Max(_max, boundsMax[block.triangles[j]]);
+					}
+				}
+			}
+			else
+			{
+				const Node& childNode = nodes[child];
+				for (int j = 0; j < 4; ++j)
+				{
+					if (childNode.children[j] != CHILD_INVALID)
+					{
+						_min = Min(_min, XMFLOAT3(GetLane(childNode.minX, j), GetLane(childNode.minY, j), GetLane(childNode.minZ, j)));
+						_max = Max(_max, XMFLOAT3(GetLane(childNode.maxX, j), GetLane(childNode.maxY, j), GetLane(childNode.maxZ, j)));
+					}
+				}
+			}
+
+			SetLane(node.minX, lane, _min.x);
+			SetLane(node.minY, lane, _min.y);
+			SetLane(node.minZ, lane, _min.z);
+			SetLane(node.maxX, lane, _max.x);
+			SetLane(node.maxY, lane, _max.y);
+			SetLane(node.maxZ, lane, _max.z);
+		}
+	}
+}
+
+uint32_t wiMeshBVH::BuildNode(std::vector<uint32_t>& triangles, const std::vector<XMFLOAT3>& boundsMin, const std::vector<XMFLOAT3>& boundsMax,
+	const std::vector<XMFLOAT3>& centers, uint32_t first, uint32_t count, int depth)
+{
+	const uint32_t nodeIndex = (uint32_t)nodes.size();
+	nodes.emplace_back();
+
+	// Split the range into up to 4 groups, one for each child:
+	uint32_t groupFirst[4];
+	uint32_t groupCount[4];
+	int groupNum = 0;
+	if (count <= MESH_BVH_LEAF_SIZE)
+	{
+		groupFirst[groupNum] = first;
+		groupCount[groupNum] = count;
+		groupNum++;
+	}
+	else
+	{
+		const uint32_t left = Split(triangles, boundsMin, boundsMax, centers, first, count, depth);
+		const uint32_t halfFirst[2] = { first, first + left };
+		const uint32_t halfCount[2] = { left, count - left };
+		for (int i = 0; i < 2; ++i)
+		{
+			if (halfCount[i] > MESH_BVH_LEAF_SIZE)
+			{
+				const uint32_t quarter = Split(triangles, boundsMin, boundsMax, centers, halfFirst[i], halfCount[i], depth);
+				groupFirst[groupNum] = halfFirst[i];
+				groupCount[groupNum] = quarter;
+				groupNum++;
+				groupFirst[groupNum] = halfFirst[i] + quarter;
+				groupCount[groupNum] = halfCount[i] - quarter;
+				groupNum++;
+			}
+			else
+			{
+				groupFirst[groupNum] = halfFirst[i];
+				groupCount[groupNum] = halfCount[i];
+				groupNum++;
+			}
+		}
+	}
+
+	uint32_t children[4] = { CHILD_INVALID, CHILD_INVALID, CHILD_INVALID, CHILD_INVALID };
+	for (int i = 0; i < groupNum; ++i)
+	{
+		if (groupCount[i] <= MESH_BVH_LEAF_SIZE)
+		{
+			children[i] = CHILD_LEAF | (uint32_t)blocks.size();
+			blocks.emplace_back();
+			TriangleBlock& block = blocks.back();
+			for (uint32_t j = 0; j < 4; ++j)
+			{
+				block.triangles[j] = j < groupCount[i] ? triangles[groupFirst[i] + j] : TRIANGLE_INVALID;
+			}
+		}
+		else
+		{
+			children[i] = BuildNode(triangles, boundsMin, boundsMax, centers, groupFirst[i], groupCount[i], depth + 1);
+		}
+	}
+
+	// The node array could have been reallocated by the recursion, so only write the node now:
+	Node& node = nodes[nodeIndex];
+	for (int i = 0; i < 4; ++i)
+	{
+		node.children[i] = children[i];
+	}
+
+	return nodeIndex;
+}
+
+uint32_t wiMeshBVH::Split(std::vector<uint32_t>& triangles, const std::vector<XMFLOAT3>& boundsMin, const std::vector<XMFLOAT3>& boundsMax,
+	const std::vector<XMFLOAT3>& centers, uint32_t first, uint32_t count, int depth)
+{
+	assert(count > 1);
+
+	XMFLOAT3 centerMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 centerMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		centerMin = Min(centerMin, centers[triangles[i]]);
+		centerMax = Max(centerMax, centers[triangles[i]]);
+	}
+
+	int axis = 0;
+	XMFLOAT3 extent = XMFLOAT3(centerMax.x - centerMin.x, centerMax.y - centerMin.y, centerMax.z - centerMin.z);
+	if (extent.y > extent.x && extent.y > extent.z)
+	{
+		axis = 1;
+	}
+	else if (extent.z > extent.x && extent.z > extent.y)
+	{
+		axis = 2;
+	}
+	const float axisMin = GetAxis(centerMin, axis);
+	const float axisExtent = GetAxis(extent, axis);
+
+	auto median = [&]() {
+		const uint32_t half = count / 2;
+		std::nth_element(triangles.begin() + first, triangles.begin() + first + half, triangles.begin() + first + count, [&](uint32_t a, uint32_t b) {
+			return GetAxis(centers[a], axis) < GetAxis(centers[b], axis);
+		});
+		return half;
+	};
+
+	// Deep trees are finished with median splits to keep the traversal stack bounded:
+	if (axisExtent <= 0 || depth > MESH_BVH_MAX_SAH_DEPTH)
+	{
+		return median();
+	}
+
+	// Binned surface area heuristic:
+	struct Bin
+	{
+		XMFLOAT3 _min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 _max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		uint32_t count = 0;
+	};
+	Bin bins[MESH_BVH_SAH_BINS];
+	const float binScale = MESH_BVH_SAH_BINS / axisExtent;
+	auto binOf = [&](uint32_t triangle) {
+		int bin = (int)((GetAxis(centers[triangle], axis) - axisMin) * binScale);
+		return max(0, min(MESH_BVH_SAH_BINS - 1, bin));
+	};
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		Bin& bin = bins[binOf(triangles[i])];
+		bin._min = Min(bin._min, boundsMin[triangles[i]]);
+		bin._max = Max(bin._max, boundsMax[triangles[i]]);
+		bin.count++;
+	}
+
+	// Sweep from the right to gather the right side costs, then from the left to evaluate the split planes:
+	float rightCost[MESH_BVH_SAH_BINS];
+	{
+		Bin acc;
+		for (int i = MESH_BVH_SAH_BINS - 1; i > 0; --i)
+		{
+			acc._min = Min(acc._min, bins[i]._min);
+			acc._max = Max(acc._max, bins[i]._max);
+			acc.count += bins[i].count;
+			rightCost[i] = HalfArea(acc._min, acc._max) * acc.count;
+		}
+	}
+	int bestSplit = -1;
+	float bestCost = FLT_MAX;
+	{
+		Bin acc;
+		for (int i = 0; i < MESH_BVH_SAH_BINS - 1; ++i)
+		{
+			acc._min = Min(acc._min, bins[i]._min);
+			acc._max = Max(acc._max, bins[i]._max);
+			acc.count += bins[i].count;
+			const float cost = HalfArea(acc._min, acc._max) * acc.count + rightCost[i + 1];
+			if (acc.count > 0 && acc.count < count && cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+	}
+	if (bestSplit < 0)
+	{
+		return median();
+	}
+
+	auto it = std::partition(triangles.begin() + first, triangles.begin() + first + count, [&](uint32_t triangle) {
+		return binOf(triangle) <= bestSplit;
+	});
+	return (uint32_t)(it - (triangles.begin() + first));
+}
+
+bool wiMeshBVH::Intersects(const XMFLOAT3& origin, const XMFLOAT3& direction, Hit& hit, float maxDistance, bool anyHit) const
+{
+	if (IsEmpty())
+	{
+		return false;
+	}
+
+	const XMVECTOR oX = XMVectorReplicate(origin.x);
+	const XMVECTOR oY = XMVectorReplicate(origin.y);
+	const XMVECTOR oZ = XMVectorReplicate(origin.z);
+	const XMVECTOR dX = XMVectorReplicate(direction.x);
+	const XMVECTOR dY = XMVectorReplicate(direction.y);
+	const XMVECTOR dZ = XMVectorReplicate(direction.z);
+	const XMVECTOR invX = XMVectorReplicate(1.0f / direction.x);
+	const XMVECTOR invY = XMVectorReplicate(1.0f / direction.y);
+	const XMVECTOR invZ = XMVectorReplicate(1.0f / direction.z);
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR one = XMVectorSplatOne();
+	const XMVECTOR epsilon = XMVectorReplicate(MESH_BVH_RAY_EPSILON);
+
+	float best = maxDistance;
+	uint32_t bestTriangle = TRIANGLE_INVALID;
+
+	StackEntry stack[MESH_BVH_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { 0, 0 };
+
+	while (stackSize > 0)
+	{
+		const StackEntry entry = stack[--stackSize];
+		if (entry.distance > best)
+		{
+			// A closer hit was found since this child was pushed
+			continue;
+		}
+
+		if (entry.child & CHILD_LEAF)
+		{
+			// Ray-triangle test (Moller-Trumbore) with 4 triangles at once:
+			const TriangleBlock& block = blocks[entry.child & ~CHILD_LEAF];
+			const XMVECTOR e1X = XMLoadFloat4A(&block.e1X);
+			const XMVECTOR e1Y = XMLoadFloat4A(&block.e1Y);
+			const XMVECTOR e1Z = XMLoadFloat4A(&block.e1Z);
+			const XMVECTOR e2X = XMLoadFloat4A(&block.e2X);
+			const XMVECTOR e2Y = XMLoadFloat4A(&block.e2Y);
+			const XMVECTOR e2Z = XMLoadFloat4A(&block.e2Z);
+
+			// p = direction x e2
+			const XMVECTOR pX = XMVectorSubtract(XMVectorMultiply(dY, e2Z), XMVectorMultiply(dZ, e2Y));
+			const XMVECTOR pY = XMVectorSubtract(XMVectorMultiply(dZ, e2X), XMVectorMultiply(dX, e2Z));
+			const XMVECTOR pZ = XMVectorSubtract(XMVectorMultiply(dX, e2Y), XMVectorMultiply(dY, e2X));
+			const XMVECTOR det = XMVectorMultiplyAdd(e1Z, pZ, XMVectorMultiplyAdd(e1Y, pY, XMVectorMultiply(e1X, pX)));
+			const XMVECTOR invDet = XMVectorReciprocal(det);
+
+			// s = origin - v0
+			const XMVECTOR sX = XMVectorSubtract(oX, XMLoadFloat4A(&block.v0X));
+			const XMVECTOR sY = XMVectorSubtract(oY, XMLoadFloat4A(&block.v0Y));
+			const XMVECTOR sZ = XMVectorSubtract(oZ, XMLoadFloat4A(&block.v0Z));
+			const XMVECTOR u = XMVectorMultiply(XMVectorMultiplyAdd(sZ, pZ, XMVectorMultiplyAdd(sY, pY, XMVectorMultiply(sX, pX))), invDet);
+
+			// q = s x e1
+			const XMVECTOR qX = XMVectorSubtract(XMVectorMultiply(sY, e1Z), XMVectorMultiply(sZ, e1Y));
+			const XMVECTOR qY = XMVectorSubtract(XMVectorMultiply(sZ, e1X), XMVectorMultiply(sX, e1Z));
+			const XMVECTOR qZ = XMVectorSubtract(XMVectorMultiply(sX, e1Y), XMVectorMultiply(sY, e1X));
+			const XMVECTOR v = XMVectorMultiply(XMVectorMultiplyAdd(dZ, qZ, XMVectorMultiplyAdd(dY, qY, XMVectorMultiply(dX, qX))), invDet);
+			const XMVECTOR t = XMVectorMultiply(XMVectorMultiplyAdd(e2Z, qZ, XMVectorMultiplyAdd(e2Y, qY, XMVectorMultiply(e2X, qX))), invDet);
+
+			XMVECTOR valid = XMVectorGreater(XMVectorAbs(det), epsilon);
+			valid = XMVectorAndInt(valid, XMVectorGreaterOrEqual(u, zero));
+			valid = XMVectorAndInt(valid, XMVectorGreaterOrEqual(v, zero));
+			valid = XMVectorAndInt(valid, XMVectorLessOrEqual(XMVectorAdd(u, v), one));
+			valid = XMVectorAndInt(valid, XMVectorGreaterOrEqual(t, zero));
+			valid = XMVectorAndInt(valid, XMVectorLess(t, XMVectorReplicate(best)));
+
+			uint32_t mask[4];
+			XMStoreInt4(mask, valid);
+			if ((mask[0] | mask[1] | mask[2] | mask[3]) == 0)
+			{
+				continue;
+			}
+			XMFLOAT4A distances;
+			XMStoreFloat4A(&distances, t);
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				const float distance = GetLane(distances, lane);
+				if (mask[lane] && distance < best)
+				{
+					best = distance;
+					bestTriangle = block.triangles[lane];
+				}
+			}
+			if (anyHit)
+			{
+				break;
+			}
+			continue;
+		}
+
+		// Slab test with the 4 child boxes at once:
+		const Node& node = nodes[entry.child];
+		const XMVECTOR tx1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4A(&node.minX), oX), invX);
+		const XMVECTOR tx2 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4A(&node.maxX), oX), invX);
+		const XMVECTOR ty1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4A(&node.minY), oY), invY);
+		const XMVECTOR ty2 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4A(&node.maxY), oY), invY);
+		const XMVECTOR tz1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4A(&node.minZ), oZ), invZ);
+		const XMVECTOR tz2 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4A(&node.maxZ), oZ), invZ);
+
+		XMVECTOR tmin = XMVectorMax(XMVectorMax(XMVectorMin(tx1, tx2), XMVectorMin(ty1, ty2)), XMVectorMax(XMVectorMin(tz1, tz2), zero));
+		XMVECTOR tmax = XMVectorMin(XMVectorMin(XMVectorMax(tx1, tx2), XMVectorMax(ty1, ty2)), XMVectorMin(XMVectorMax(tz1, tz2), XMVectorReplicate(best)));
+
+		// The exit distance is scaled up by the maximum rounding error, so rays that graze a box (or a flat box of a single triangle) don't miss it:
+		tmax = XMVectorMultiply(tmax, XMVectorReplicate(MESH_BVH_SLAB_ROUNDING));
+
+		uint32_t mask[4];
+		XMStoreInt4(mask, XMVectorLessOrEqual(tmin, tmax));
+		XMFLOAT4A distances;
+		XMStoreFloat4A(&distances, tmin);
+
+		// Push the intersected children so that the closest one is popped first:
+		StackEntry intersected[4];
+		int intersectedCount = 0;
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			if (mask[lane] && node.children[lane] != CHILD_INVALID)
+			{
+				StackEntry child = { node.children[lane], GetLane(distances, lane) };
+				int j = intersectedCount++;
+				for (; j > 0 && intersected[j - 1].distance < child.distance; --j)
+				{
+					intersected[j] = intersected[j - 1];
+				}
+				intersected[j] = child;
+			}
+		}
+		assert(stackSize + intersectedCount <= MESH_BVH_STACK_SIZE);
+		for (int i = 0; i < intersectedCount; ++i)
+		{
+			stack[stackSize++] = intersected[i];
+		}
+	}
+
+	if (bestTriangle == TRIANGLE_INVALID)
+	{
+		return false;
+	}
+	hit.distance = best;
+	hit.triangle = bestTriangle;
+	return true;
+}
+
+void wiMeshBVH::Intersects(const RAY* rays, uint32_t rayCount, Hit* hits, bool anyHit) const
+{
+	wiJobSystem::context ctx;
+	wiJobSystem::Dispatch(ctx, rayCount, 64, [&](wiJobSystem::JobArgs args) {
+		Hit& hit = hits[args.jobIndex];
+		hit = Hit();
+		Intersects(rays[args.jobIndex].origin, rays[args.jobIndex].direction, hit, FLT_MAX, anyHit);
+	});
+	wiJobSystem::Wait(ctx);
+}
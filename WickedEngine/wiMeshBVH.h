@@ -0,0 +1,63 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <vector>
+#include <cfloat>
+
+struct RAY;
+
+// Bounding volume hierarchy of the triangles of a mesh, for ray queries in the local space of the mesh.
+//	Nodes hold the bounds of their 4 children in SoA layout like wiSPTree, and leaves reference blocks of up to 4 triangles
+//	which are also stored in SoA layout, so a single traversal step tests either 4 boxes or 4 triangles at once.
+class wiMeshBVH
+{
+public:
+	static const uint32_t CHILD_INVALID = 0xFFFFFFFF;
+	static const uint32_t CHILD_LEAF = 0x80000000;
+	static const uint32_t TRIANGLE_INVALID = 0xFFFFFFFF;
+
+	struct Node
+	{
+		// Child bounds in SoA layout: lane i holds the bounds of child i
+		XMFLOAT4A minX, minY, minZ;
+		XMFLOAT4A maxX, maxY, maxZ;
+		// Child references: CHILD_INVALID for empty lane, CHILD_LEAF flag set for triangle block index, otherwise node index
+		uint32_t children[4];
+	};
+	struct TriangleBlock
+	{
+		// Lane i holds the first vertex and the two edges of triangle i, empty lanes have zero edges
+		XMFLOAT4A v0X, v0Y, v0Z;
+		XMFLOAT4A e1X, e1Y, e1Z;
+		XMFLOAT4A e2X, e2Y, e2Z;
+		// Index of the triangle in the mesh (first index of the triangle / 3), or TRIANGLE_INVALID for empty lanes
+		uint32_t triangles[4];
+	};
+	std::vector<Node> nodes; // nodes[0] is the root, children are always placed after their parent
+	std::vector<TriangleBlock> blocks;
+
+	struct Hit
+	{
+		float distance = FLT_MAX; // along the ray direction, in units of the direction length
+		uint32_t triangle = TRIANGLE_INVALID;
+
+		bool IsValid() const { return triangle != TRIANGLE_INVALID; }
+	};
+
+	// Build the hierarchy from an indexed triangle list. Positions are read with the given byte stride, so interleaved vertices can be used directly.
+	void Build(const XMFLOAT3* positions, size_t positionStride, const uint32_t* indices, size_t indexCount);
+	void Clear();
+	bool IsEmpty() const { return nodes.empty(); }
+
+	// Find the closest hit along the ray closer than maxDistance. With anyHit, the traversal stops at the first hit that is found,
+	//	which is enough for occlusion and line of sight tests. Triangles are double sided.
+	bool Intersects(const XMFLOAT3& origin, const XMFLOAT3& direction, Hit& hit, float maxDistance = FLT_MAX, bool anyHit = false) const;
+	// Intersect many rays at once, they are processed in parallel on the job system. Missed rays get an invalid hit.
+	void Intersects(const RAY* rays, uint32_t rayCount, Hit* hits, bool anyHit = false) const;
+
+private:
+	uint32_t BuildNode(std::vector<uint32_t>& triangles, const std::vector<XMFLOAT3>& boundsMin, const std::vector<XMFLOAT3>& boundsMax,
+		const std::vector<XMFLOAT3>& centers, uint32_t first, uint32_t count, int depth);
+	uint32_t Split(std::vector<uint32_t>& triangles, const std::vector<XMFLOAT3>& boundsMin, const std::vector<XMFLOAT3>& boundsMax,
+		const std::vector<XMFLOAT3>& centers, uint32_t first, uint32_t count, int depth);
+};
@@ -0,0 +1,201 @@
+#include "wiPHYSICS.h"
+#include "wiLoader.h"
+#include "wiTimer.h"
+#include "wiProfiler.h"
+
+#include <chrono>
+
+using namespace std;
+
+void PHYSICS::AddObjectID(Object* object)
+{
+	if (object->physicsObjectID < 0)
+	{
+		return;
+	}
+	if ((int)objects.size() <= object->physicsObjectID)
+	{
+		objects.resize(object->physicsObjectID + 1, nullptr);
+	}
+	objects[object->physicsObjectID] = object;
+}
+void PHYSICS::RemoveObjectID(int id)
+{
+	// The simulation moves its last object into the place of the removed one, the ids follow that:
+	if (id < 0 || id >= (int)objects.size())
+	{
+		return;
+	}
+	const int last = (int)objects.size() - 1;
+	if (id != last)
+	{
+		objects[id] = objects[last];
+		if (objects[id] != nullptr)
+		{
+			objects[id]->physicsObjectID = id;
+		}
+	}
+	objects.pop_back();
+
+	// The results still refer to the old ids:
+	ClearSnapshots();
+}
+void PHYSICS::ClearSnapshots()
+{
+	lock_guard<mutex> lock(resultLock);
+	for (auto& x : snapshots)
+	{
+		x.bodies.clear();
+		x.softBodies.clear();
+	}
+	pendingInput = Input();
+	inputPending = false;
+	currentInput = Input();
+}
+
+void PHYSICS::StartThread(float fixedTimeStep)
+{
+	if (threadRunning.load())
+	{
+		return;
+	}
+	tickDelta = fixedTimeStep;
+	threadRunning.store(true);
+	thread = std::thread(&PHYSICS::ThreadLoop, this);
+}
+void PHYSICS::StopThread()
+{
+	if (!threadRunning.load())
+	{
+		return;
+	}
+	threadRunning.store(false);
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+void PHYSICS::ThreadLoop()
+{
+	wiProfiler::GetInstance().SetThreadName("Physics");
+
+	const double tickMilliseconds = tickDelta * 1000.0;
+	double nextTick = wiTimer::TotalTime();
+	while (threadRunning.load())
+	{
+		const double now = wiTimer::TotalTime();
+		if (now < nextTick)
+		{
+			this_thread::sleep_for(chrono::microseconds((long long)((nextTick - now) * 1000.0)));
+			continue;
+		}
+
+		// After a long hitch the simulation continues from now instead of trying to catch up with every missed tick:
+		nextTick += tickMilliseconds;
+		if (now - nextTick > tickMilliseconds * 4)
+		{
+			nextTick = now + tickMilliseconds;
+		}
+
+		WIPROFILER_SCOPE("Physics Tick");
+		Tick(tickDelta);
+	}
+}
+void PHYSICS::Tick(float dt)
+{
+	{
+		lock_guard<mutex> lock(resultLock);
+		if (inputPending)
+		{
+			swap(currentInput, pendingInput);
+			inputPending = false;
+		}
+	}
+
+	{
+		lock_guard<recursive_mutex> lock(worldLock);
+
+		ApplyInput(currentInput);
+		if (!currentInput.paused)
+		{
+			Update(dt);
+		}
+		WriteSnapshot(*buildSnapshot);
+		NextRunWorld();
+	}
+	buildSnapshot->time = wiTimer::TotalTime();
+
+	lock_guard<mutex> lock(resultLock);
+	Snapshot* oldest = previousSnapshot;
+	previousSnapshot = latestSnapshot;
+	latestSnapshot = buildSnapshot;
+	buildSnapshot = oldest;
+}
+
+void PHYSICS::SetInput(Input&& input)
+{
+	lock_guard<mutex> lock(resultLock);
+	pendingInput = move(input);
+	inputPending = true;
+}
+
+float PHYSICS::GetInterpolationFactor() const
+{
+	if (!threadRunning.load() || previousSnapshot->time <= 0)
+	{
+		// stepped synchronously, the latest state is the current one
+		return 1;
+	}
+	// The rendered state lags at most one tick behind the simulation
+	const double tickMilliseconds = tickDelta * 1000.0;
+	return (float)max(0.0, min(1.0, (wiTimer::TotalTime() - latestSnapshot->time) / tickMilliseconds));
+}
+bool PHYSICS::GetInterpolatedTransform(int objectID, PhysicsTransform& result) const
+{
+	const Snapshot& latest = *latestSnapshot;
+	const Snapshot& previous = *previousSnapshot;
+	if (objectID < 0 || objectID >= (int)latest.bodies.size())
+	{
+		return false;
+	}
+	const PhysicsTransform& b = latest.bodies[objectID];
+	if (objectID >= (int)previous.bodies.size())
+	{
+		result = b;
+		return true;
+	}
+	const PhysicsTransform& a = previous.bodies[objectID];
+	const float t = GetInterpolationFactor();
+
+	XMStoreFloat3(&result.position, XMVectorLerp(XMLoadFloat3(&a.position), XMLoadFloat3(&b.position), t));
+	XMStoreFloat4(&result.rotation, XMQuaternionSlerp(XMLoadFloat4(&a.rotation), XMLoadFloat4(&b.rotation), t));
+	return true;
+}
+bool PHYSICS::GetInterpolatedSoftBody(int objectID, const SoftBodyState*& previous, const SoftBodyState*& latest) const
+{
+	previous = nullptr;
+	latest = nullptr;
+	for (const SoftBodyState& state : latestSnapshot->softBodies)
+	{
+		if (state.objectID == objectID)
+		{
+			latest = &state;
+			break;
+		}
+	}
+	if (latest == nullptr)
+	{
+		return false;
+	}
+	previous = latest;
+	for (const SoftBodyState& state : previousSnapshot->softBodies)
+	{
+		if (state.objectID == objectID && state.positions.size() == latest->positions.size())
+		{
+			previous = &state;
+			break;
+		}
+	}
+	return true;
+}
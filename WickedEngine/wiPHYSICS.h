@@ -2,6 +2,10 @@
 #include "CommonInclude.h"
 
 #include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 struct Mesh;
 struct Object;
@@ -21,17 +25,103 @@ public:
 			position=newPos;
 		}
 	};
+
+	// Data that the main thread hands over to the simulation for the next tick(s)
+	struct Input
+	{
+		bool paused = false;
+		XMFLOAT3 wind = XMFLOAT3(0, 0, 0);
+		std::vector<std::pair<int, PhysicsTransform>> kinematicBodies;	// physicsObjectID, transform
+		std::vector<std::pair<int, std::vector<XMFLOAT3>>> softBodyGoals;	// physicsObjectID, goal position for every vertex of the goal vertex group
+	};
+	// Result of a simulation tick
+	struct SoftBodyState
+	{
+		int objectID = -1;
+		std::vector<XMFLOAT3> positions, normals; // for every physics node
+		XMFLOAT3 aabbMin, aabbMax;
+	};
+	struct Snapshot
+	{
+		double time = 0; // wiTimer::TotalTime() at the end of the tick
+		std::vector<PhysicsTransform> bodies; // indexed by physicsObjectID
+		std::vector<SoftBodyState> softBodies;
+	};
+
 	static int softBodyIterationCount;
 	static bool rigidBodyPhysicsEnabled, softBodyPhysicsEnabled;
 protected:
 	std::vector<PhysicsTransform*> transforms;
-	bool firstRunWorld;
+	bool firstRunWorld = true;
 	int registeredObjects;
+
+	// The registered objects, indexed by physicsObjectID. Only these are visited when data is exchanged with the simulation.
+	std::vector<Object*> objects;
+
+	// MarkForWrite locks the simulation world: it must be held while objects are added or removed, because the world might be stepped on the physics thread
+	std::recursive_mutex worldLock;
+	// MarkForRead locks the results: the input and the snapshots
+	std::mutex resultLock;
+
+	// Apply the input to the world and write the state of the world into a snapshot. Called while the world is locked.
+	virtual void ApplyInput(const Input& input) = 0;
+	virtual void WriteSnapshot(Snapshot& snapshot) = 0;
+
+	// These must be called while the world is locked:
+	void AddObjectID(Object* object);
+	void RemoveObjectID(int id);
+	void ClearSnapshots();
+private:
+	// Asynchronous simulation: the world is stepped at a fixed tick on its own thread, and only the inputs and the results are exchanged with the main thread
+	std::thread thread;
+	std::atomic<bool> threadRunning{ false };
+	std::atomic<bool> registrationRequested{ true };
+	float tickDelta = 1.0f / 60.0f;
+
+	Input pendingInput;	// written by the main thread
+	bool inputPending = false;
+	Input currentInput;	// owned by the simulation
+	Snapshot snapshots[3];
+	Snapshot* previousSnapshot = &snapshots[0];
+	Snapshot* latestSnapshot = &snapshots[1];
+	Snapshot* buildSnapshot = &snapshots[2]; // owned by the simulation
+
+	void ThreadLoop();
+	// Apply the latest input, step the world and publish the snapshot
+	void Tick(float dt);
 public:
 	void FirstRunWorld(){firstRunWorld=true;}
 	void NextRunWorld(){firstRunWorld=false;}
 	int getObjectCount(){return registeredObjects+1;}
 
+	// Start stepping the simulation on a dedicated thread with the given fixed time step. Without the thread, Step() must be called by the user.
+	void StartThread(float fixedTimeStep = 1.0f / 60.0f);
+	void StopThread();
+	bool IsThreaded() const { return threadRunning.load(); }
+
+	// Hand over the input for the next tick. The latest input is used until a new one is set.
+	void SetInput(Input&& input);
+	// Run one tick synchronously (when the simulation isn't threaded)
+	void Step(float dt) { Tick(dt); }
+
+	// The last two snapshots are only valid between MarkForRead() and UnMarkForRead()
+	const Snapshot& GetPreviousSnapshot() const { return *previousSnapshot; }
+	const Snapshot& GetLatestSnapshot() const { return *latestSnapshot; }
+	// Blend factor from the previous to the latest snapshot, so that the rendered state advances smoothly between the ticks
+	float GetInterpolationFactor() const;
+	// Interpolated results for an object, return false if there is no result for it
+	bool GetInterpolatedTransform(int objectID, PhysicsTransform& result) const;
+	bool GetInterpolatedSoftBody(int objectID, const SoftBodyState*& previous, const SoftBodyState*& latest) const;
+
+	const std::vector<Object*>& GetObjects() const { return objects; }
+
+	// Objects were added to the scene, or their simulation type might have changed, so the scene must be searched for objects to register.
+	//	removeObject requests it too, because an object is taken out of the simulation to change its simulation type.
+	void RequestRegistration() { registrationRequested.store(true); }
+	bool ConsumeRegistrationRequest() { return registrationRequested.exchange(false); }
+
+	virtual ~PHYSICS() { StopThread(); }
+
 	virtual void Update(float dt)=0;
 	virtual void MarkForRead()=0;
 	virtual void UnMarkForRead()=0;
@@ -41,7 +131,7 @@ public:
 	virtual void CleanUp()=0;
 
 	virtual void addWind(const XMFLOAT3& wind)=0;
-	
+
 	virtual void addBox(const XMFLOAT3& sca, const XMFLOAT4& rot, const XMFLOAT3& pos
 		, float newMass=1, float newFriction=1, float newRestitution=1, float newDamping=1, bool kinematic=false)=0;
 	virtual void addSphere(float rad, const XMFLOAT3& pos
@@ -53,16 +143,20 @@ public:
 	virtual void addTriangleMesh(const std::vector<XMFLOAT4>& vertices, const std::vector<unsigned int>& indices, const XMFLOAT3& sca, const XMFLOAT4& rot, const XMFLOAT3& pos
 		, float newMass=1, float newFriction=1, float newRestitution=1, float newDamping=1, bool kinematic=false)=0;
 
-	
+
 	virtual void addSoftBodyTriangleMesh(const Mesh* mesh, const XMFLOAT3& sca, const XMFLOAT4& rot, const XMFLOAT3& pos
 		, float newMass=1, float newFriction=1, float newRestitution=1, float newDamping=1)=0;
-	
-	virtual void connectVerticesToSoftBody(Mesh* const mesh, int objectI)=0;
-	virtual void connectSoftBodyToVertices(const Mesh* const mesh, int objectI)=0;
+
+	virtual void connectVerticesToSoftBody(int objectI, SoftBodyState& state)=0;
+	virtual void connectSoftBodyToVertices(const Mesh* const mesh, const std::vector<XMFLOAT3>& goalPositions, int objectI)=0;
 	virtual void transformBody(const XMFLOAT4& rot, const XMFLOAT3& pos, int objectI)=0;
 
 	virtual PhysicsTransform* getObject(int index)=0;
 
+	// Store the expensive parts of the collision shapes (convex hulls, triangle mesh BVHs) in a file, and load them back so that they are not computed again
+	virtual bool SaveShapeCache(const std::string& fileName) { return false; }
+	virtual bool LoadShapeCache(const std::string& fileName) { return false; }
+
 	// add object to the simulation
 	virtual void registerObject(Object* object) = 0;
 	// remove object from simulation
@@ -3,16 +3,21 @@
 #include "wiRenderer.h"
 #include "wiFont.h"
 
+#include <fstream>
+#include <algorithm>
+
 using namespace std;
 using namespace wiGraphicsTypes;
 
+thread_local wiProfiler::ThreadData* wiProfiler::threadData = nullptr;
+
 void wiProfiler::BeginFrame()
 {
 	if (!ENABLED)
 		return;
 
 	wiRenderer::GetDevice()->LOCK();
-	wiRenderer::GetDevice()->QueryBegin(&disjoint, GRAPHICSTHREAD_IMMEDIATE);
+	wiRenderer::GetDevice()->QueryBegin(&disjoint[frameCount % GPU_READBACK_FRAMES], GRAPHICSTHREAD_IMMEDIATE);
 	wiRenderer::GetDevice()->UNLOCK();
 }
 void wiProfiler::EndFrame()
@@ -20,118 +25,407 @@ void wiProfiler::EndFrame()
 	if (!ENABLED)
 		return;
 
+	// CPU: collect the events that were closed since the previous frame from every thread
+	{
+		lock_guard<mutex> lock(locker);
+
+		for (ThreadData* thread : threads)
+		{
+			const uint64_t head = thread->head.load(memory_order_acquire);
+			const uint64_t oldest = head > THREAD_EVENT_CAPACITY ? head - THREAD_EVENT_CAPACITY : 0;
+
+			// Ranges that were still open at the end of the previous frame are checked again:
+			vector<uint64_t> stillOpen;
+			for (uint64_t index : thread->openEvents)
+			{
+				if (index < oldest)
+				{
+					continue;
+				}
+				const Event& event = thread->events[index % THREAD_EVENT_CAPACITY];
+				if (event.end.load(memory_order_acquire) < 0)
+				{
+					stillOpen.push_back(index);
+				}
+				else
+				{
+					Aggregate(event);
+				}
+			}
+
+			for (uint64_t index = max(thread->aggregated, oldest); index < head; ++index)
+			{
+				const Event& event = thread->events[index % THREAD_EVENT_CAPACITY];
+				if (event.end.load(memory_order_acquire) < 0)
+				{
+					stillOpen.push_back(index);
+				}
+				else
+				{
+					Aggregate(event);
+				}
+			}
+
+			thread->openEvents = move(stillOpen);
+			thread->aggregated = head;
+		}
+	}
+
+	// GPU: the timestamps of the oldest frame in the readback ring. Every query is polled once,
+	//	if a result is not available yet, that frame is skipped instead of waiting for it.
+	wiTimer readbackTimer;
+	uint32_t skipped = 0;
+	const uint32_t writeFrame = frameCount % GPU_READBACK_FRAMES;
+	const uint32_t readFrame = (frameCount + 1) % GPU_READBACK_FRAMES;
+
 	wiRenderer::GetDevice()->LOCK();
-	wiRenderer::GetDevice()->QueryEnd(&disjoint, GRAPHICSTHREAD_IMMEDIATE);
-	while(!wiRenderer::GetDevice()->QueryRead(&disjoint, GRAPHICSTHREAD_IMMEDIATE));
+	wiRenderer::GetDevice()->QueryEnd(&disjoint[writeFrame], GRAPHICSTHREAD_IMMEDIATE);
+	disjointIssued[writeFrame] = true;
 
-	assert(rangeStack.empty() && "There was a range which was not ended!");
+	const bool disjointAvailable = disjointIssued[readFrame] && wiRenderer::GetDevice()->QueryRead(&disjoint[readFrame], GRAPHICSTHREAD_IMMEDIATE);
+	const bool timestampsValid = disjointAvailable && disjoint[readFrame].result_disjoint == FALSE;
+	disjointIssued[readFrame] = false;
 
-	if (disjoint.result_disjoint == FALSE)
+	for (Name& name : names)
 	{
-		for (auto& x : ranges)
+		if (name.domain != DOMAIN_GPU)
 		{
-			x.second->time = 0;
-			switch (x.second->domain)
-			{
-			case wiProfiler::DOMAIN_CPU:
-				x.second->time = (float)abs(x.second->cpuEnd.elapsed() - x.second->cpuBegin.elapsed());
-				break;
-			case wiProfiler::DOMAIN_GPU:
-				while (!wiRenderer::GetDevice()->QueryRead(&x.second->gpuBegin, GRAPHICSTHREAD_IMMEDIATE));
-				while (!wiRenderer::GetDevice()->QueryRead(&x.second->gpuEnd, GRAPHICSTHREAD_IMMEDIATE));
-				x.second->time = abs((float)(x.second->gpuEnd.result_timestamp - x.second->gpuBegin.result_timestamp) / disjoint.result_timestamp_frequency * 1000.0f);
-				break;
-			default:
-				assert(0);
-				break;
-			}
+			continue;
 		}
+		Name::GPURange& range = name.gpu[readFrame];
+		if (!range.issued)
+		{
+			continue;
+		}
+		range.issued = false;
+
+		if (!timestampsValid ||
+			!wiRenderer::GetDevice()->QueryRead(&range.begin, GRAPHICSTHREAD_IMMEDIATE) ||
+			!wiRenderer::GetDevice()->QueryRead(&range.end, GRAPHICSTHREAD_IMMEDIATE))
+		{
+			skipped++;
+			continue;
+		}
+
+		name.frameTime = abs((float)(range.end.result_timestamp - range.begin.result_timestamp) / disjoint[readFrame].result_timestamp_frequency * 1000.0f);
+		name.frameRecorded = true;
+		name.parentID = range.parentID;
+		name.depth = range.depth;
 	}
 	wiRenderer::GetDevice()->UNLOCK();
+
+	frameCount++;
+
+	for (Name& name : names)
+	{
+		if (name.frameRecorded)
+		{
+			AddSample(name, name.frameTime);
+			name.frameRecorded = false;
+			name.frameTime = 0;
+		}
+	}
+
+	SetCounter("Profiler GPU readback (us)", (uint64_t)(readbackTimer.elapsed() * 1000.0));
+	SetCounter("Profiler GPU ranges skipped", skipped);
 }
 
-void wiProfiler::BeginRange(const std::string& name, PROFILER_DOMAIN domain, GRAPHICSTHREAD threadID)
+void wiProfiler::Aggregate(const Event& event)
+{
+	Name& name = names[event.nameID];
+	const float time = (float)(event.end.load(memory_order_relaxed) - event.begin);
+	if (!name.frameRecorded || event.begin < name.frameBegin)
+	{
+		name.frameBegin = event.begin;
+		name.parentID = event.parentID;
+		name.depth = event.depth;
+	}
+	name.frameTime += time;
+	name.frameRecorded = true;
+}
+void wiProfiler::AddSample(Name& name, float time)
+{
+	name.history[name.historyNext] = time;
+	name.historyNext = (name.historyNext + 1) % STATS_FRAMES;
+	name.historyCount = min(name.historyCount + 1, STATS_FRAMES);
+	name.lastFrame = frameCount;
+
+	RangeStats& stats = name.stats;
+	stats.last = time;
+	stats.min = FLT_MAX;
+	stats.max = 0;
+	stats.avg = 0;
+	for (uint32_t i = 0; i < name.historyCount; ++i)
+	{
+		stats.min = min(stats.min, name.history[i]);
+		stats.max = max(stats.max, name.history[i]);
+		stats.avg += name.history[i];
+	}
+	stats.avg /= (float)name.historyCount;
+}
+
+wiProfiler::ThreadData* wiProfiler::GetThreadData()
+{
+	if (threadData == nullptr)
+	{
+		ThreadData* data = new ThreadData;
+		data->stack.reserve(64);
+
+		lock_guard<mutex> lock(locker);
+		data->index = (uint32_t)threads.size();
+		data->name = "Thread " + to_string(data->index);
+		data->aggregated = 0;
+		threads.push_back(data);
+		threadData = data;
+	}
+	return threadData;
+}
+uint32_t wiProfiler::RegisterName(const char* name, PROFILER_DOMAIN domain)
+{
+	// The same text from different call sites gets the same id, the cache of the calling thread is filled by the caller
+	lock_guard<mutex> lock(locker);
+
+	auto it = nameLookup[domain].find(name);
+	if (it != nameLookup[domain].end())
+	{
+		return it->second;
+	}
+	if (names.size() >= MAX_NAMES)
+	{
+		assert(0 && "Too many profiler range names!");
+		return INVALID_NAME;
+	}
+
+	Name entry;
+	entry.name = name;
+	entry.domain = domain;
+	if (domain == DOMAIN_GPU)
+	{
+		// The readback ring is managed by the profiler, so the queries themselves don't need latency:
+		GPUQueryDesc desc;
+		desc.async_latency = 0;
+		desc.MiscFlags = 0;
+		desc.Type = GPU_QUERY_TYPE_TIMESTAMP;
+		entry.gpu = new Name::GPURange[GPU_READBACK_FRAMES];
+		for (uint32_t i = 0; i < GPU_READBACK_FRAMES; ++i)
+		{
+			wiRenderer::GetDevice()->CreateQuery(&desc, &entry.gpu[i].begin);
+			wiRenderer::GetDevice()->CreateQuery(&desc, &entry.gpu[i].end);
+		}
+	}
+
+	const uint32_t id = (uint32_t)names.size();
+	names.push_back(entry);
+	nameLookup[domain][entry.name] = id;
+	return id;
+}
+
+#ifndef WICKEDENGINE_DISABLE_PROFILER
+void wiProfiler::BeginRange(const char* name, PROFILER_DOMAIN domain, GRAPHICSTHREAD threadID)
 {
 	if (!ENABLED)
 		return;
 
-	if (ranges.find(name) == ranges.end())
+	ThreadData& thread = *GetThreadData();
+
+	uint32_t nameID;
+	auto it = thread.nameCache[domain].find(name);
+	if (it != thread.nameCache[domain].end())
+	{
+		nameID = it->second;
+	}
+	else
+	{
+		nameID = RegisterName(name, domain);
+		thread.nameCache[domain][name] = nameID;
+	}
+
+	// The enclosing range of the same domain on this thread is the parent:
+	uint32_t parentID = INVALID_NAME;
+	uint32_t depth = 0;
+	for (auto entry = thread.stack.rbegin(); entry != thread.stack.rend(); ++entry)
 	{
-		Range* range = new Range;
-		range->name = name;
-		range->domain = domain;
-		range->time = 0;
+		if (entry->domain == domain)
+		{
+			if (parentID == INVALID_NAME)
+			{
+				parentID = entry->nameID;
+			}
+			depth++;
+		}
+	}
+
+	ThreadData::StackEntry entry;
+	entry.domain = domain;
+	entry.nameID = nameID;
+	entry.eventIndex = 0;
 
+	if (nameID != INVALID_NAME)
+	{
 		switch (domain)
 		{
 		case wiProfiler::DOMAIN_CPU:
-			range->cpuBegin.Start();
-			range->cpuEnd.Start();
+			{
+				entry.eventIndex = thread.head.load(memory_order_relaxed);
+				Event& event = thread.events[entry.eventIndex % THREAD_EVENT_CAPACITY];
+				event.nameID = nameID;
+				event.parentID = parentID;
+				event.depth = depth;
+				event.end.store(-1, memory_order_relaxed);
+				event.begin = wiTimer::TotalTime();
+				thread.head.store(entry.eventIndex + 1, memory_order_release);
+			}
 			break;
 		case wiProfiler::DOMAIN_GPU:
 			{
-				GPUQueryDesc desc;
-				desc.async_latency = 4;
-				desc.MiscFlags = 0;
-				desc.Type = GPU_QUERY_TYPE_TIMESTAMP;
-				wiRenderer::GetDevice()->CreateQuery(&desc, &range->gpuBegin);
-				wiRenderer::GetDevice()->CreateQuery(&desc, &range->gpuEnd);
+				Name::GPURange& range = names[nameID].gpu[frameCount % GPU_READBACK_FRAMES];
+				range.parentID = parentID;
+				range.depth = depth;
+				wiRenderer::GetDevice()->QueryEnd(&range.begin, threadID);
 			}
 			break;
 		default:
 			assert(0);
 			break;
 		}
+	}
 
+	thread.stack.push_back(entry);
+}
+void wiProfiler::EndRange(GRAPHICSTHREAD threadID)
+{
+	if (!ENABLED)
+		return;
 
-		ranges.insert(make_pair(name, range));
-	}
+	ThreadData& thread = *GetThreadData();
 
-	switch (domain)
+	assert(!thread.stack.empty() && "There is no range to end!");
+	if (thread.stack.empty())
+		return;
+
+	const ThreadData::StackEntry entry = thread.stack.back();
+	thread.stack.pop_back();
+
+	if (entry.nameID == INVALID_NAME)
+		return;
+
+	switch (entry.domain)
 	{
 	case wiProfiler::DOMAIN_CPU:
-		ranges[name]->cpuBegin.record();
+		// The event could have been overwritten if a lot of ranges were recorded while it was open:
+		if (thread.head.load(memory_order_relaxed) - entry.eventIndex <= THREAD_EVENT_CAPACITY)
+		{
+			thread.events[entry.eventIndex % THREAD_EVENT_CAPACITY].end.store(wiTimer::TotalTime(), memory_order_release);
+		}
 		break;
 	case wiProfiler::DOMAIN_GPU:
-		wiRenderer::GetDevice()->QueryEnd(&ranges[name]->gpuBegin, threadID);
+		{
+			Name::GPURange& range = names[entry.nameID].gpu[frameCount % GPU_READBACK_FRAMES];
+			wiRenderer::GetDevice()->QueryEnd(&range.end, threadID);
+			range.issued = true;
+		}
 		break;
 	default:
 		assert(0);
 		break;
 	}
+}
+#endif // WICKEDENGINE_DISABLE_PROFILER
 
-	rangeStack.push(name);
+wiProfiler::RangeStats wiProfiler::GetRangeStats(const std::string& name, PROFILER_DOMAIN domain) const
+{
+	auto it = nameLookup[domain].find(name);
+	if (it != nameLookup[domain].end())
+	{
+		return names[it->second].stats;
+	}
+	return RangeStats();
 }
-void wiProfiler::EndRange(GRAPHICSTHREAD threadID)
+
+void wiProfiler::SetCounter(const std::string& name, uint64_t value)
 {
 	if (!ENABLED)
 		return;
 
-	assert(!rangeStack.empty() && "There is no range to end!");
-	const std::string& top = rangeStack.top();
+	counters[name] = value;
+}
+uint64_t wiProfiler::GetCounter(const std::string& name) const
+{
+	auto it = counters.find(name);
+	if (it != counters.end())
+	{
+		return it->second;
+	}
+	return 0;
+}
+
+void wiProfiler::SetThreadName(const std::string& name)
+{
+	ThreadData* thread = GetThreadData();
+	lock_guard<mutex> lock(locker);
+	thread->name = name;
+}
 
-	auto& it = ranges.find(top);
-	if (it != ranges.end())
+static string EscapeJSON(const string& text)
+{
+	string result;
+	result.reserve(text.length());
+	for (char c : text)
 	{
-		switch (it->second->domain)
+		switch (c)
 		{
-		case wiProfiler::DOMAIN_CPU:
-			it->second->cpuEnd.record();
-			break;
-		case wiProfiler::DOMAIN_GPU:
-			wiRenderer::GetDevice()->QueryEnd(&it->second->gpuEnd, threadID);
-			break;
+		case '"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\n': result += "\\n"; break;
+		case '\t': result += "\\t"; break;
 		default:
-			assert(0);
+			if ((unsigned char)c >= 0x20)
+			{
+				result += c;
+			}
 			break;
 		}
 	}
-	else
+	return result;
+}
+bool wiProfiler::ExportChromeTrace(const std::string& fileName)
+{
+	ofstream file(fileName);
+	if (!file.is_open())
 	{
-		assert(0);
+		return false;
+	}
+
+	lock_guard<mutex> lock(locker);
+
+	// Complete events ("ph":"X") with microsecond timestamps, one track for every thread:
+	file << "{\"traceEvents\":[" << endl;
+	file.precision(3);
+	file << fixed;
+	bool first = true;
+	for (ThreadData* thread : threads)
+	{
+		file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread->index
+			<< ",\"args\":{\"name\":\"" << EscapeJSON(thread->name) << "\"}}";
+		first = false;
+
+		const uint64_t head = thread->head.load(memory_order_acquire);
+		const uint64_t oldest = head > THREAD_EVENT_CAPACITY ? head - THREAD_EVENT_CAPACITY : 0;
+		for (uint64_t index = oldest; index < head; ++index)
+		{
+			const Event& event = thread->events[index % THREAD_EVENT_CAPACITY];
+			const double end = event.end.load(memory_order_acquire);
+			if (end < 0)
+			{
+				continue;
+			}
+			file << ",\n{\"name\":\"" << EscapeJSON(names[event.nameID].name) << "\",\"cat\":\"CPU\",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread->index
+				<< ",\"ts\":" << event.begin * 1000.0 << ",\"dur\":" << (end - event.begin) * 1000.0 << "}";
+		}
 	}
+	file << endl << "],\"displayTimeUnit\":\"ms\"}" << endl;
 
-	rangeStack.pop();
+	return file.good();
 }
 
 void wiProfiler::DrawData(int x, int y, GRAPHICSTHREAD threadID)
@@ -141,40 +435,83 @@ void wiProfiler::DrawData(int x, int y, GRAPHICSTHREAD threadID)
 
 	stringstream ss("");
 	ss.precision(2);
-	ss << "Frame Profiler Ranges:" << endl << "----------------------------" << endl;
-	
-	for (int domain = DOMAIN_CPU; domain < DOMAIN_COUNT; ++domain)
+	ss << "Frame Profiler Ranges (last / min / avg / max):" << endl << "----------------------------" << endl;
+
+	// Ranges are listed as a tree, the children are ordered by their start time in the frame:
+	vector<vector<uint32_t>> children(names.size() + 1);
+	for (uint32_t i = 0; i < (uint32_t)names.size(); ++i)
 	{
-		for (auto& x : ranges)
+		const Name& name = names[i];
+		if (name.historyCount == 0 || name.lastFrame + STATS_FRAMES < frameCount)
 		{
-			if (x.second->domain == domain)
+			continue;
+		}
+		const uint32_t parent = name.parentID < names.size() ? name.parentID : (uint32_t)names.size();
+		children[parent].push_back(i);
+	}
+	for (auto& list : children)
+	{
+		sort(list.begin(), list.end(), [&](uint32_t a, uint32_t b) {
+			return names[a].frameBegin < names[b].frameBegin;
+		});
+	}
+
+	function<void(uint32_t, PROFILER_DOMAIN, int)> print = [&](uint32_t parent, PROFILER_DOMAIN domain, int indent) {
+		for (uint32_t i : children[parent])
+		{
+			const Name& name = names[i];
+			if (name.domain != domain || indent > 16)
 			{
-				ss << x.first << ": " << fixed << x.second->time << " ms" << endl;
+				continue;
 			}
+			ss << string(indent * 2, ' ') << name.name << ": " << fixed << name.stats.last << " / " << name.stats.min << " / "
+				<< name.stats.avg << " / " << name.stats.max << " ms" << endl;
+			print(i, domain, indent + 1);
 		}
+	};
+	for (int domain = DOMAIN_CPU; domain < DOMAIN_COUNT; ++domain)
+	{
+		print((uint32_t)names.size(), (PROFILER_DOMAIN)domain, 0);
 		ss << endl;
 	}
 
+	if (!counters.empty())
+	{
+		ss << "Frame Profiler Counters:" << endl << "----------------------------" << endl;
+		for (auto& x : counters)
+		{
+			ss << x.first << ": " << x.second << endl;
+		}
+	}
+
 	wiFont(ss.str(), wiFontProps(x, y, -1, WIFALIGN_LEFT, WIFALIGN_TOP, 2, 1, wiColor(255,255,255,255), wiColor(0,0,0,255))).Draw(threadID);
 }
 
 
 wiProfiler::wiProfiler()
 {
-	ranges.reserve(100);
+	names.reserve(MAX_NAMES);
 
 	GPUQueryDesc desc;
-	desc.async_latency = 4;
+	desc.async_latency = 0;
 	desc.MiscFlags = 0;
 	desc.Type = GPU_QUERY_TYPE_TIMESTAMP_DISJOINT;
-	wiRenderer::GetDevice()->CreateQuery(&desc, &disjoint);
+	for (uint32_t i = 0; i < GPU_READBACK_FRAMES; ++i)
+	{
+		wiRenderer::GetDevice()->CreateQuery(&desc, &disjoint[i]);
+		disjointIssued[i] = false;
+	}
 
 	ENABLED = false;
 }
 wiProfiler::~wiProfiler()
 {
-	for (auto& x : ranges)
+	for (auto& x : names)
+	{
+		SAFE_DELETE_ARRAY(x.gpu);
+	}
+	for (auto& x : threads)
 	{
-		SAFE_DELETE(x.second);
+		SAFE_DELETE(x);
 	}
 }
@@ -1,12 +1,25 @@
 #pragma once
 #include <string>
 #include <unordered_map>
-#include <stack>
+#include <vector>
+#include <atomic>
+#include <mutex>
 
 #include "wiEnums.h"
 #include "wiTimer.h"
 #include "wiGraphicsResource.h"
 
+// Define WICKEDENGINE_DISABLE_PROFILER to compile the range recording out of the engine.
+//	BeginRange and EndRange become empty inline functions then, so the instrumented code costs (close to) nothing.
+#ifndef WICKEDENGINE_DISABLE_PROFILER
+#define WIPROFILER_CONCAT_IMPL(a, b) a##b
+#define WIPROFILER_CONCAT(a, b) WIPROFILER_CONCAT_IMPL(a, b)
+// Measure the enclosing scope on the CPU. The name should be a string literal.
+#define WIPROFILER_SCOPE(name) wiProfiler::ScopedRange WIPROFILER_CONCAT(wiProfilerScope_, __LINE__)(name)
+#else
+#define WIPROFILER_SCOPE(name)
+#endif
+
 class wiProfiler
 {
 public:
@@ -18,26 +31,62 @@ public:
 		DOMAIN_GPU,
 		DOMAIN_COUNT
 	};
-	struct Range
-	{
-		PROFILER_DOMAIN domain;
-		std::string name;
-		float time;
 
-		wiTimer cpuBegin, cpuEnd;
-		wiGraphicsTypes::GPUQuery gpuBegin, gpuEnd;
-
-		Range() :time(0), domain(DOMAIN_CPU) {}
-		~Range() {}
+	// Statistics of a range over the last STATS_FRAMES frames in which it was recorded, in milliseconds.
+	//	A range that is recorded multiple times in a frame (on one or more threads) counts with the sum of its times.
+	struct RangeStats
+	{
+		float last = 0;
+		float min = 0;
+		float avg = 0;
+		float max = 0;
 	};
+	static const uint32_t STATS_FRAMES = 120;
+
+	// Every thread records its CPU ranges into its own ring buffer of this many events, without locking.
+	//	The events that are still in the buffers can be exported as a trace.
+	static const uint32_t THREAD_EVENT_CAPACITY = 16384;
+	static const uint32_t MAX_NAMES = 1024;
+	// GPU timestamps are read back this many frames after they were recorded, so EndFrame never waits for the GPU.
+	//	A frame whose results are not available by then is skipped.
+	static const uint32_t GPU_READBACK_LATENCY = 4;
+	static const uint32_t GPU_READBACK_FRAMES = GPU_READBACK_LATENCY + 1;
+	static const uint32_t INVALID_NAME = ~0u;
 
 	void BeginFrame();
 	void EndFrame();
-	void BeginRange(const std::string& name, PROFILER_DOMAIN domain, GRAPHICSTHREAD threadID = GRAPHICSTHREAD_IMMEDIATE);
+
+	// Ranges can be nested, and they are tracked separately for every thread. A range must be ended on the thread that began it.
+	//	The name is expected to be a string literal (or an other string that outlives the profiler), because it is cached by address.
+#ifndef WICKEDENGINE_DISABLE_PROFILER
+	void BeginRange(const char* name, PROFILER_DOMAIN domain, GRAPHICSTHREAD threadID = GRAPHICSTHREAD_IMMEDIATE);
 	void EndRange(GRAPHICSTHREAD threadID = GRAPHICSTHREAD_IMMEDIATE);
+#else
+	void BeginRange(const char* name, PROFILER_DOMAIN domain, GRAPHICSTHREAD threadID = GRAPHICSTHREAD_IMMEDIATE) {}
+	void EndRange(GRAPHICSTHREAD threadID = GRAPHICSTHREAD_IMMEDIATE) {}
+#endif
 
-	float GetRangeTime(const std::string& name) { return ranges[name]->time; }
-	const std::unordered_map<std::string, Range*>& GetRanges() { return ranges; }
+	struct ScopedRange
+	{
+		ScopedRange(const char* name) { wiProfiler::GetInstance().BeginRange(name, DOMAIN_CPU); }
+		~ScopedRange() { wiProfiler::GetInstance().EndRange(); }
+	};
+
+	// The time of the range in the last frame in which it was recorded
+	float GetRangeTime(const std::string& name, PROFILER_DOMAIN domain = DOMAIN_CPU) const { return GetRangeStats(name, domain).last; }
+	RangeStats GetRangeStats(const std::string& name, PROFILER_DOMAIN domain = DOMAIN_CPU) const;
+
+	// Counters are plain values reported once per frame, for example the number of draw calls of a pass
+	void SetCounter(const std::string& name, uint64_t value);
+	uint64_t GetCounter(const std::string& name) const;
+	const std::unordered_map<std::string, uint64_t>& GetCounters() { return counters; }
+
+	// Name of the calling thread in the exported traces
+	void SetThreadName(const std::string& name);
+
+	// Write the CPU events that are still in the ring buffers to a Chrome trace_event JSON file (open with chrome://tracing)
+	//	Should be called between frames, when no thread is recording.
+	bool ExportChromeTrace(const std::string& fileName);
 
 	// Renders a basic text of the Profiling results to the (x,y) screen coordinate
 	void DrawData(int x, int y, GRAPHICSTHREAD threadID);
@@ -48,8 +97,77 @@ private:
 	wiProfiler();
 	~wiProfiler();
 
-	std::unordered_map<std::string, Range*> ranges;
-	std::stack<std::string> rangeStack;
-	wiGraphicsTypes::GPUQuery disjoint;
+	struct Event
+	{
+		double begin;
+		std::atomic<double> end; // negative while the range is open
+		uint32_t nameID;
+		uint32_t parentID;
+		uint32_t depth;
+	};
+	struct ThreadData
+	{
+		struct StackEntry
+		{
+			PROFILER_DOMAIN domain;
+			uint32_t nameID;
+			uint64_t eventIndex;
+		};
+
+		// Written only by the owner thread:
+		Event events[THREAD_EVENT_CAPACITY];
+		std::atomic<uint64_t> head{ 0 };
+		std::vector<StackEntry> stack;
+		std::unordered_map<const char*, uint32_t> nameCache[DOMAIN_COUNT];
+
+		// Used only when the frame is finished:
+		uint32_t index = 0;
+		std::string name;
+		uint64_t aggregated = 0;
+		std::vector<uint64_t> openEvents;
+	};
+	struct Name
+	{
+		std::string name;
+		PROFILER_DOMAIN domain;
+
+		// Written by the thread that records it, one for every frame of the GPU readback ring:
+		struct GPURange
+		{
+			wiGraphicsTypes::GPUQuery begin, end;
+			bool issued = false;
+			uint32_t parentID = INVALID_NAME;
+			uint32_t depth = 0;
+		};
+		GPURange* gpu = nullptr;
+
+		// Aggregated when the frame is finished:
+		float history[STATS_FRAMES];
+		uint32_t historyCount = 0;
+		uint32_t historyNext = 0;
+		RangeStats stats;
+		float frameTime = 0;
+		bool frameRecorded = false;
+		double frameBegin = 0;
+		uint32_t parentID = INVALID_NAME;
+		uint32_t depth = 0;
+		uint64_t lastFrame = 0;
+	};
+
+	static thread_local ThreadData* threadData;
+	ThreadData* GetThreadData();
+	uint32_t RegisterName(const char* name, PROFILER_DOMAIN domain);
+	void Aggregate(const Event& event);
+	void AddSample(Name& name, float time);
+
+	std::mutex locker; // guards the thread and name registration, the recording itself is lock free
+	std::vector<ThreadData*> threads;
+	std::vector<Name> names; // reserved to MAX_NAMES so that the elements never move
+	std::unordered_map<std::string, uint32_t> nameLookup[DOMAIN_COUNT];
+	uint64_t frameCount = 0;
+
+	std::unordered_map<std::string, uint64_t> counters;
+	wiGraphicsTypes::GPUQuery disjoint[GPU_READBACK_FRAMES];
+	bool disjointIssued[GPU_READBACK_FRAMES];
 };
 
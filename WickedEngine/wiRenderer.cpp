@@ -20,22 +20,31 @@
 #include "wiRandom.h"
 #include "wiFont.h"
 #include "wiTranslator.h"
-#include "wiRectPacker.h"
+#include "wiAtlasAllocator.h"
 #include "wiBackLog.h"
 #include "wiProfiler.h"
+#include "wiJobSystem.h"
 #include "wiOcean.h"
 #include "ShaderInterop_CloudGenerator.h"
 #include "ShaderInterop_Skinning.h"
 #include "wiWidget.h"
+#include "wiTimer.h"
 #include "wiGPUSortLib.h"
 
 #include <algorithm>
+#include <atomic>
 
 #include <DirectXCollision.h>
 
 using namespace std;
 using namespace wiGraphicsTypes;
 
+#define DECAL_ATLAS_MIPS 6
+#define DECAL_ATLAS_GRANULARITY (1 << (DECAL_ATLAS_MIPS - 1)) // allocations are aligned so that every atlas mip starts them on whole texels
+#define DECAL_ATLAS_INITIAL_SIZE 1024
+#define DECAL_ATLAS_MAX_SIZE 8192
+#define DECAL_ATLAS_STALE_FRAMES 60 // textures that were not used for this many frames are evicted before the atlas is grown
+
 #pragma region STATICS
 GraphicsDevice* wiRenderer::graphicsDevice = nullptr;
 Sampler				*wiRenderer::samplers[SSLOT_COUNT];
@@ -69,7 +78,8 @@ float wiRenderer::SPECULARAA = 0.0f;
 float wiRenderer::renderTime = 0, wiRenderer::renderTime_Prev = 0, wiRenderer::deltaTime = 0;
 XMFLOAT2 wiRenderer::temporalAAJitter = XMFLOAT2(0, 0), wiRenderer::temporalAAJitterPrev = XMFLOAT2(0, 0);
 float wiRenderer::RESOLUTIONSCALE = 1.0f;
-GPUQuery wiRenderer::occlusionQueries[];
+wiRenderer::OcclusionQueryFrame wiRenderer::occlusionQueryFrames[];
+int wiRenderer::occlusionQueryFrame = 0;
 UINT wiRenderer::entityArrayOffset_Lights = 0, wiRenderer::entityArrayCount_Lights = 0;
 UINT wiRenderer::entityArrayOffset_Decals = 0, wiRenderer::entityArrayCount_Decals = 0;
 UINT wiRenderer::entityArrayOffset_ForceFields = 0, wiRenderer::entityArrayCount_ForceFields = 0;
@@ -79,6 +89,7 @@ Texture2D* wiRenderer::enviroMap,*wiRenderer::colorGrading;
 float wiRenderer::GameSpeed=1,wiRenderer::overrideGameSpeed=1;
 bool wiRenderer::debugLightCulling = false;
 bool wiRenderer::occlusionCulling = false;
+bool wiRenderer::physicsThreadEnabled = true;
 bool wiRenderer::temporalAA = false, wiRenderer::temporalAADEBUG = false;
 wiRenderer::VoxelizedSceneData wiRenderer::voxelSceneData = VoxelizedSceneData();
 int wiRenderer::visibleCount;
@@ -88,6 +99,7 @@ PHYSICS* wiRenderer::physicsEngine = nullptr;
 wiOcean* wiRenderer::ocean = nullptr;
 
 string wiRenderer::SHADERPATH = "shaders/";
+string wiRenderer::PIPELINECACHEPATH = "pipelinecache.bin";
 #pragma endregion
 
 #pragma region STATIC TEMP
@@ -112,6 +124,16 @@ std::vector<wiTranslator*> wiRenderer::renderableTranslators;
 std::vector<pair<XMFLOAT4X4, XMFLOAT4>> wiRenderer::renderableBoxes;
 
 std::unordered_map<Camera*, wiRenderer::FrameCulling> wiRenderer::frameCullings;
+wiRenderer::DrawCallStats wiRenderer::drawCallStats[SHADERTYPE_COUNT];
+wiRenderer::DecalAtlasStats wiRenderer::decalAtlasStats;
+std::vector<std::pair<Texture2D*, uint64_t>> wiRenderer::decalAtlasEvictions;
+// Accumulated by RenderMeshes from multiple threads, latched into drawCallStats when the frame is presented
+struct DrawCallCounters
+{
+	std::atomic<uint32_t> drawsIssued;
+	std::atomic<uint32_t> bindsIssued;
+	std::atomic<uint32_t> bindsSaved;
+} static drawCallCounters[SHADERTYPE_COUNT];
 
 wiWaterPlane wiRenderer::waterPlane;
 
@@ -135,6 +157,36 @@ void wiRenderer::Present(function<void()> drawToScreen1,function<void()> drawToS
 
 	GetDevice()->PresentEnd();
 
+	static const char* passNames[SHADERTYPE_COUNT] = {
+		"Texture", "Deferred", "Forward", "TiledForward", "DepthOnly", "EnvmapCapture", "Shadow", "ShadowCube", "Voxelize",
+	};
+	for (int i = 0; i < SHADERTYPE_COUNT; ++i)
+	{
+		DrawCallStats& stats = drawCallStats[i];
+		stats.drawsIssued = drawCallCounters[i].drawsIssued.exchange(0);
+		stats.bindsIssued = drawCallCounters[i].bindsIssued.exchange(0);
+		stats.bindsSaved = drawCallCounters[i].bindsSaved.exchange(0);
+		if (stats.drawsIssued > 0)
+		{
+			wiProfiler::GetInstance().SetCounter(string("RenderMeshes ") + passNames[i] + " draws", stats.drawsIssued);
+			wiProfiler::GetInstance().SetCounter(string("RenderMeshes ") + passNames[i] + " binds saved", stats.bindsSaved);
+		}
+	}
+	const GraphicsDevice::UploadStats& uploadStats = GetDevice()->GetUploadStats();
+	if (uploadStats.uploads > 0)
+	{
+		wiProfiler::GetInstance().SetCounter("Buffer uploads", uploadStats.uploads);
+		wiProfiler::GetInstance().SetCounter("Buffer upload barriers", uploadStats.barriers);
+	}
+
+	wiImage::LatchDrawStats();
+	const wiImage::DrawStats& imageStats = wiImage::GetDrawStats();
+	if (imageStats.images > 0)
+	{
+		wiProfiler::GetInstance().SetCounter("Images", imageStats.images);
+		wiProfiler::GetInstance().SetCounter("Image draws", imageStats.drawCalls);
+	}
+
 	OcclusionCulling_Read();
 
 	*prevFrameCam = *cam;
@@ -340,7 +392,10 @@ void wiRenderer::ClearWorld()
 	emitterSystems.clear();
 	
 	if (physicsEngine)
+	{
 		physicsEngine->ClearWorld();
+		physicsEngine->RequestRegistration();
+	}
 
 	enviroMap = nullptr;
 	colorGrading = nullptr;
@@ -453,33 +508,20 @@ void wiRenderer::UpdateBoneLines()
 		}
 	}
 }
-void iterateSPTree2(wiSPTree::Node* n, std::vector<Cube>& cubes, const XMFLOAT4A& col);
-void iterateSPTree(wiSPTree::Node* n, std::vector<Cube>& cubes, const XMFLOAT4A& col){
-	if(!n) return;
-	if(n->count){
-		for (unsigned int i = 0; i<n->children.size(); ++i)
-			iterateSPTree(n->children[i],cubes,col);
-	}
-	if(!n->objects.empty()){
-		cubes.push_back(Cube(n->box.getCenter(),n->box.getHalfWidth(),col));
-		for(Cullable* object:n->objects){
-			cubes.push_back(Cube(object->bounds.getCenter(),object->bounds.getHalfWidth(),XMFLOAT4A(1,0,0,1)));
-			//Object* o = (Object*)object;
-			//for(wiHairParticle& hps : o->hParticleSystems)
-			//	iterateSPTree2(hps.spTree->root,cubes,XMFLOAT4A(0,1,0,1));
+void iterateSPTree(wiSPTree* tree, std::vector<Cube>& cubes, const XMFLOAT4A& col){
+	if(!tree) return;
+	for (const wiSPTree::Node& node : tree->nodes)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			const uint32_t child = node.children[i];
+			if (child == wiSPTree::CHILD_INVALID)
+				continue;
+			AABB box(XMFLOAT3((&node.minX.x)[i], (&node.minY.x)[i], (&node.minZ.x)[i]), XMFLOAT3((&node.maxX.x)[i], (&node.maxY.x)[i], (&node.maxZ.x)[i]));
+			cubes.push_back(Cube(box.getCenter(), box.getHalfWidth(), (child & wiSPTree::CHILD_LEAF) ? XMFLOAT4A(1, 0, 0, 1) : col));
 		}
 	}
 }
-void iterateSPTree2(wiSPTree::Node* n, std::vector<Cube>& cubes, const XMFLOAT4A& col){
-	if(!n) return;
-	if(n->count){
-		for (unsigned int i = 0; i<n->children.size(); ++i)
-			iterateSPTree2(n->children[i],cubes,col);
-	}
-	if(!n->objects.empty()){
-		cubes.push_back(Cube(n->box.getCenter(),n->box.getHalfWidth(),col));
-	}
-}
 void wiRenderer::SetUpCubes(){
 	/*if(debugBoxes){
 		cubes.resize(0);
@@ -490,7 +532,7 @@ void wiRenderer::SetUpCubes(){
 	cubes.clear();
 }
 void wiRenderer::UpdateCubes(){
-	if(debugPartitionTree && spTree && spTree->root){
+	if(debugPartitionTree && spTree && !spTree->IsEmpty()){
 		/*int num=0;
 		iterateSPTreeUpdate(spTree->root,cubes,num);
 		for(Object* object:objects){
@@ -501,8 +543,8 @@ void wiRenderer::UpdateCubes(){
 			num+=1;
 		}*/
 		cubes.clear();
-		if(spTree) iterateSPTree(spTree->root,cubes,XMFLOAT4A(1,1,0,1));
-		if(spTree_lights) iterateSPTree(spTree_lights->root,cubes,XMFLOAT4A(1,1,1,1));
+		iterateSPTree(spTree,cubes,XMFLOAT4A(1,1,0,1));
+		iterateSPTree(spTree_lights,cubes,XMFLOAT4A(1,1,1,1));
 	}
 	//if(debugBoxes){
 	//	for(Decal* decal : decals){
@@ -1203,10 +1245,142 @@ enum TILEDLIGHTING_DEBUG
 ComputePSO* CPSO_tiledlighting[TILEDLIGHTING_TYPE_COUNT][TILEDLIGHTING_CULLING_COUNT][TILEDLIGHTING_DEBUG_COUNT] = {};
 ComputePSO* CPSO[CSTYPE_LAST] = {};
 
+// The shaders that have no input layout, loaded by LoadShaders:
+struct ShaderLoadDesc
+{
+	wiResourceManager::Data_Type type;
+	int slot;
+	const char* fileName;
+};
+static const ShaderLoadDesc shaderLoadDescs[] = {
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_SHADOW_TRANSPARENT, "shadowVS_transparent.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_OBJECT_COMMON_TESSELLATION, "objectVS_common_tessellation.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_OBJECT_SIMPLE_TESSELLATION, "objectVS_simple_tessellation.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_DIRLIGHT, "dirLightVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_POINTLIGHT, "pointLightVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_SPOTLIGHT, "spotLightVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_LIGHTVISUALIZER_SPOTLIGHT, "vSpotLightVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_LIGHTVISUALIZER_POINTLIGHT, "vPointLightVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_LIGHTVISUALIZER_SPHERELIGHT, "vSphereLightVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_LIGHTVISUALIZER_DISCLIGHT, "vDiscLightVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_LIGHTVISUALIZER_RECTANGLELIGHT, "vRectangleLightVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_LIGHTVISUALIZER_TUBELIGHT, "vTubeLightVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_DECAL, "decalVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_ENVMAP, "envMapVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_ENVMAP_SKY, "envMap_skyVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_SPHERE, "sphereVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_CUBE, "cubeVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_SHADOWCUBEMAPRENDER, "cubeShadowVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST, "cubeShadowVS_alphatest.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_SKY, "skyVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_WATER, "waterVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_VOXELIZER, "objectVS_voxelizer.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_VOXEL, "voxelVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_FORCEFIELDVISUALIZER_POINT, "forceFieldPointVisualizerVS.cso" },
+	{ wiResourceManager::VERTEXSHADER, VSTYPE_FORCEFIELDVISUALIZER_PLANE, "forceFieldPlaneVisualizerVS.cso" },
+
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_DEFERRED, "objectPS_deferred.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_DEFERRED_NORMALMAP, "objectPS_deferred_normalmap.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_DEFERRED_POM, "objectPS_deferred_pom.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_DEFERRED_NORMALMAP_POM, "objectPS_deferred_normalmap_pom.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD, "objectPS_forward.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_NORMALMAP, "objectPS_forward_normalmap.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_TRANSPARENT, "objectPS_forward_transparent.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_TRANSPARENT_NORMALMAP, "objectPS_forward_transparent_normalmap.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_PLANARREFLECTION, "objectPS_forward_planarreflection.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_NORMALMAP_PLANARREFLECTION, "objectPS_forward_normalmap_planarreflection.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_TRANSPARENT_PLANARREFLECTION, "objectPS_forward_transparent_planarreflection.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_TRANSPARENT_NORMALMAP_PLANARREFLECTION, "objectPS_forward_transparent_normalmap_planarreflection.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_POM, "objectPS_forward_pom.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_NORMALMAP_POM, "objectPS_forward_normalmap_pom.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_TRANSPARENT_POM, "objectPS_forward_transparent_pom.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_TRANSPARENT_NORMALMAP_POM, "objectPS_forward_transparent_normalmap_pom.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_FORWARD_WATER, "objectPS_forward_water.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD, "objectPS_tiledforward.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP, "objectPS_tiledforward_normalmap.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT, "objectPS_tiledforward_transparent.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP, "objectPS_tiledforward_transparent_normalmap.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_PLANARREFLECTION, "objectPS_tiledforward_planarreflection.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP_PLANARREFLECTION, "objectPS_tiledforward_normalmap_planarreflection.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_PLANARREFLECTION, "objectPS_tiledforward_transparent_planarreflection.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP_PLANARREFLECTION, "objectPS_tiledforward_transparent_normalmap_planarreflection.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_POM, "objectPS_tiledforward_pom.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP_POM, "objectPS_tiledforward_normalmap_pom.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_POM, "objectPS_tiledforward_transparent_pom.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP_POM, "objectPS_tiledforward_transparent_normalmap_pom.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TILEDFORWARD_WATER, "objectPS_tiledforward_water.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_HOLOGRAM, "objectPS_hologram.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_DEBUG, "objectPS_debug.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_SIMPLEST, "objectPS_simplest.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_BLACKOUT, "objectPS_blackout.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_TEXTUREONLY, "objectPS_textureonly.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_OBJECT_ALPHATESTONLY, "objectPS_alphatestonly.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_ENVIRONMENTALLIGHT, "environmentalLightPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_DIRLIGHT, "dirLightPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_POINTLIGHT, "pointLightPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_SPOTLIGHT, "spotLightPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_SPHERELIGHT, "sphereLightPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_DISCLIGHT, "discLightPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_RECTANGLELIGHT, "rectangleLightPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_TUBELIGHT, "tubeLightPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_LIGHTVISUALIZER, "lightVisualizerPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_VOLUMETRICLIGHT_DIRECTIONAL, "volumetricLight_DirectionalPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_VOLUMETRICLIGHT_POINT, "volumetricLight_PointPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_VOLUMETRICLIGHT_SPOT, "volumetricLight_SpotPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_DECAL, "decalPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_ENVMAP, "envMapPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_ENVMAP_SKY_STATIC, "envMap_skyPS_static.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_ENVMAP_SKY_DYNAMIC, "envMap_skyPS_dynamic.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_CAPTUREIMPOSTOR, "captureImpostorPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_CUBEMAP, "cubemapPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_LINE, "linesPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_SKY_STATIC, "skyPS_static.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_SKY_DYNAMIC, "skyPS_dynamic.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_SUN, "sunPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_SHADOW_ALPHATEST, "shadowPS_alphatest.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_SHADOW_TRANSPARENT, "shadowPS_transparent.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_SHADOW_WATER, "shadowPS_water.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_SHADOWCUBEMAPRENDER, "cubeShadowPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST, "cubeShadowPS_alphatest.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_TRAIL, "trailPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_VOXELIZER, "objectPS_voxelizer.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_VOXEL, "voxelPS.cso" },
+	{ wiResourceManager::PIXELSHADER, PSTYPE_FORCEFIELDVISUALIZER, "forceFieldVisualizerPS.cso" },
+
+	{ wiResourceManager::GEOMETRYSHADER, GSTYPE_ENVMAP, "envMapGS.cso" },
+	{ wiResourceManager::GEOMETRYSHADER, GSTYPE_ENVMAP_SKY, "envMap_skyGS.cso" },
+	{ wiResourceManager::GEOMETRYSHADER, GSTYPE_SHADOWCUBEMAPRENDER, "cubeShadowGS.cso" },
+	{ wiResourceManager::GEOMETRYSHADER, GSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST, "cubeShadowGS_alphatest.cso" },
+	{ wiResourceManager::GEOMETRYSHADER, GSTYPE_VOXELIZER, "objectGS_voxelizer.cso" },
+	{ wiResourceManager::GEOMETRYSHADER, GSTYPE_VOXEL, "voxelGS.cso" },
+
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_LUMINANCE_PASS1, "luminancePass1CS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_LUMINANCE_PASS2, "luminancePass2CS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_TILEFRUSTUMS, "tileFrustumsCS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_RESOLVEMSAADEPTHSTENCIL, "resolveMSAADepthStencilCS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_VOXELSCENECOPYCLEAR, "voxelSceneCopyClearCS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_VOXELSCENECOPYCLEAR_TEMPORALSMOOTHING, "voxelSceneCopyClear_TemporalSmoothing.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_VOXELRADIANCESECONDARYBOUNCE, "voxelRadianceSecondaryBounceCS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_VOXELCLEARONLYNORMAL, "voxelClearOnlyNormalCS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_GENERATEMIPCHAIN2D_SIMPLEFILTER, "generateMIPChain2D_SimpleFilterCS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_GENERATEMIPCHAIN2D_GAUSSIAN, "generateMIPChain2D_GaussianCS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_GENERATEMIPCHAIN3D_SIMPLEFILTER, "generateMIPChain3D_SimpleFilterCS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_GENERATEMIPCHAIN3D_GAUSSIAN, "generateMIPChain3D_GaussianCS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_SKINNING, "skinningCS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_SKINNING_LDS, "skinningCS_LDS.cso" },
+	{ wiResourceManager::COMPUTESHADER, CSTYPE_CLOUDGENERATOR, "cloudGeneratorCS.cso" },
+
+	{ wiResourceManager::HULLSHADER, HSTYPE_OBJECT, "objectHS.cso" },
+
+	{ wiResourceManager::DOMAINSHADER, DSTYPE_OBJECT, "objectDS.cso" },
+};
+
 void wiRenderer::LoadShaders()
 {
+	// The shaders are loaded in parallel, every job writes to its own slots of the shader arrays:
+	wiJobSystem::context ctx;
 
-	{
+	wiJobSystem::Execute(ctx, [](wiJobSystem::JobArgs args) {
 		VertexLayoutDesc layout[] =
 		{
 			{ "POSITION_NORMAL_WIND",	0, Mesh::Vertex_POS::FORMAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
@@ -1217,8 +1391,8 @@ void wiRenderer::LoadShaders()
 			vertexShaders[VSTYPE_OBJECT_DEBUG] = vsinfo->vertexShader;
 			vertexLayouts[VLTYPE_OBJECT_DEBUG] = vsinfo->vertexLayout;
 		}
-	}
-	{
+	});
+	wiJobSystem::Execute(ctx, [](wiJobSystem::JobArgs args) {
 		VertexLayoutDesc layout[] =
 		{
 			{ "POSITION_NORMAL_WIND",	0, Mesh::Vertex_POS::FORMAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
@@ -1239,8 +1413,8 @@ void wiRenderer::LoadShaders()
 			vertexShaders[VSTYPE_OBJECT_COMMON] = vsinfo->vertexShader;
 			vertexLayouts[VLTYPE_OBJECT_ALL] = vsinfo->vertexLayout;
 		}
-	}
-	{
+	});
+	wiJobSystem::Execute(ctx, [](wiJobSystem::JobArgs args) {
 		VertexLayoutDesc layout[] =
 		{
 			{ "POSITION_NORMAL_WIND",	0, Mesh::Vertex_POS::FORMAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
@@ -1256,8 +1430,8 @@ void wiRenderer::LoadShaders()
 			vertexShaders[VSTYPE_OBJECT_POSITIONSTREAM] = vsinfo->vertexShader;
 			vertexLayouts[VLTYPE_OBJECT_POS] = vsinfo->vertexLayout;
 		}
-	}
-	{
+	});
+	wiJobSystem::Execute(ctx, [](wiJobSystem::JobArgs args) {
 		VertexLayoutDesc layout[] =
 		{
 			{ "POSITION_NORMAL_WIND",	0, Mesh::Vertex_POS::FORMAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
@@ -1274,8 +1448,8 @@ void wiRenderer::LoadShaders()
 			vertexShaders[VSTYPE_OBJECT_SIMPLE] = vsinfo->vertexShader;
 			vertexLayouts[VLTYPE_OBJECT_POS_TEX] = vsinfo->vertexLayout;
 		}
-	}
-	{
+	});
+	wiJobSystem::Execute(ctx, [](wiJobSystem::JobArgs args) {
 		VertexLayoutDesc layout[] =
 		{
 			{ "POSITION_NORMAL_WIND",	0, Mesh::Vertex_POS::FORMAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
@@ -1291,8 +1465,8 @@ void wiRenderer::LoadShaders()
 			vertexShaders[VSTYPE_SHADOW] = vsinfo->vertexShader;
 			vertexLayouts[VLTYPE_SHADOW_POS] = vsinfo->vertexLayout;
 		}
-	}
-	{
+	});
+	wiJobSystem::Execute(ctx, [](wiJobSystem::JobArgs args) {
 		VertexLayoutDesc layout[] =
 		{
 			{ "POSITION_NORMAL_WIND",	0, Mesh::Vertex_POS::FORMAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
@@ -1309,12 +1483,9 @@ void wiRenderer::LoadShaders()
 			vertexShaders[VSTYPE_SHADOW_ALPHATEST] = vsinfo->vertexShader;
 			vertexLayouts[VLTYPE_SHADOW_POS_TEX] = vsinfo->vertexLayout;
 		}
+	});
 
-		vertexShaders[VSTYPE_SHADOW_TRANSPARENT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "shadowVS_transparent.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-
-	}
-
-	{
+	wiJobSystem::Execute(ctx, [](wiJobSystem::JobArgs args) {
 		VertexLayoutDesc layout[] =
 		{
 			{ "POSITION", 0, FORMAT_R32G32B32A32_FLOAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
@@ -1327,9 +1498,9 @@ void wiRenderer::LoadShaders()
 			vertexShaders[VSTYPE_LINE] = vsinfo->vertexShader;
 			vertexLayouts[VLTYPE_LINE] = vsinfo->vertexLayout;
 		}
-	}
+	});
 
-	{
+	wiJobSystem::Execute(ctx, [](wiJobSystem::JobArgs args) {
 		VertexLayoutDesc layout[] =
 		{
 			{ "POSITION", 0, FORMAT_R32G32B32_FLOAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
@@ -1343,136 +1514,39 @@ void wiRenderer::LoadShaders()
 			vertexShaders[VSTYPE_TRAIL] = vsinfo->vertexShader;
 			vertexLayouts[VLTYPE_TRAIL] = vsinfo->vertexLayout;
 		}
-	}
+	});
+
+	wiJobSystem::Dispatch(ctx, ARRAYSIZE(shaderLoadDescs), 1, [](wiJobSystem::JobArgs args) {
+		const ShaderLoadDesc& desc = shaderLoadDescs[args.jobIndex];
+		void* shader = wiResourceManager::GetShaderManager()->add(SHADERPATH + desc.fileName, desc.type);
+		switch (desc.type)
+		{
+		case wiResourceManager::VERTEXSHADER:
+			vertexShaders[desc.slot] = shader == nullptr ? nullptr : static_cast<VertexShaderInfo*>(shader)->vertexShader;
+			break;
+		case wiResourceManager::PIXELSHADER:
+			pixelShaders[desc.slot] = static_cast<PixelShader*>(shader);
+			break;
+		case wiResourceManager::GEOMETRYSHADER:
+			geometryShaders[desc.slot] = static_cast<GeometryShader*>(shader);
+			break;
+		case wiResourceManager::HULLSHADER:
+			hullShaders[desc.slot] = static_cast<HullShader*>(shader);
+			break;
+		case wiResourceManager::DOMAINSHADER:
+			domainShaders[desc.slot] = static_cast<DomainShader*>(shader);
+			break;
+		case wiResourceManager::COMPUTESHADER:
+			computeShaders[desc.slot] = static_cast<ComputeShader*>(shader);
+			break;
+		default:
+			assert(0);
+			break;
+		}
+	});
 
-	vertexShaders[VSTYPE_OBJECT_COMMON_TESSELLATION] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectVS_common_tessellation.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_OBJECT_SIMPLE_TESSELLATION] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectVS_simple_tessellation.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_DIRLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "dirLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_POINTLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "pointLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_SPOTLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "spotLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_LIGHTVISUALIZER_SPOTLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vSpotLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_LIGHTVISUALIZER_POINTLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vPointLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_LIGHTVISUALIZER_SPHERELIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vSphereLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_LIGHTVISUALIZER_DISCLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vDiscLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_LIGHTVISUALIZER_RECTANGLELIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vRectangleLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_LIGHTVISUALIZER_TUBELIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vTubeLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_DECAL] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "decalVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_ENVMAP] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMapVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_ENVMAP_SKY] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMap_skyVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_SPHERE] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "sphereVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_CUBE] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_SHADOWCUBEMAPRENDER] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowVS_alphatest.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_SKY] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "skyVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_WATER] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "waterVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_VOXELIZER] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectVS_voxelizer.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_VOXEL] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_FORCEFIELDVISUALIZER_POINT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "forceFieldPointVisualizerVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_FORCEFIELDVISUALIZER_PLANE] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "forceFieldPlaneVisualizerVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-
-
-	pixelShaders[PSTYPE_OBJECT_DEFERRED] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_deferred.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_DEFERRED_NORMALMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_deferred_normalmap.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_DEFERRED_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_deferred_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_DEFERRED_NORMALMAP_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_deferred_normalmap_pom.cso", wiResourceManager::PIXELSHADER));
-
-	pixelShaders[PSTYPE_OBJECT_FORWARD] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_NORMALMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_normalmap.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_TRANSPARENT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_transparent.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_TRANSPARENT_NORMALMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_transparent_normalmap.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_NORMALMAP_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_normalmap_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_TRANSPARENT_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_transparent_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_TRANSPARENT_NORMALMAP_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_transparent_normalmap_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_NORMALMAP_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_normalmap_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_TRANSPARENT_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_transparent_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_TRANSPARENT_NORMALMAP_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_transparent_normalmap_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_WATER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_water.cso", wiResourceManager::PIXELSHADER));
-
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_normalmap.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent_normalmap.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_normalmap_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent_normalmap_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_normalmap_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent_normalmap_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_WATER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_water.cso", wiResourceManager::PIXELSHADER));
-
-	pixelShaders[PSTYPE_OBJECT_HOLOGRAM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_hologram.cso", wiResourceManager::PIXELSHADER));
-
-
-	pixelShaders[PSTYPE_OBJECT_DEBUG] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_debug.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_SIMPLEST] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_simplest.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_BLACKOUT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_blackout.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TEXTUREONLY] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_textureonly.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_ALPHATESTONLY] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_alphatestonly.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_ENVIRONMENTALLIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "environmentalLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_DIRLIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "dirLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_POINTLIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "pointLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SPOTLIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "spotLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SPHERELIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "sphereLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_DISCLIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "discLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_RECTANGLELIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "rectangleLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_TUBELIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "tubeLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_LIGHTVISUALIZER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "lightVisualizerPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_VOLUMETRICLIGHT_DIRECTIONAL] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "volumetricLight_DirectionalPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_VOLUMETRICLIGHT_POINT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "volumetricLight_PointPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_VOLUMETRICLIGHT_SPOT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "volumetricLight_SpotPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_DECAL] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "decalPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_ENVMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMapPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_ENVMAP_SKY_STATIC] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMap_skyPS_static.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_ENVMAP_SKY_DYNAMIC] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMap_skyPS_dynamic.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_CAPTUREIMPOSTOR] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "captureImpostorPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_CUBEMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubemapPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_LINE] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "linesPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SKY_STATIC] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "skyPS_static.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SKY_DYNAMIC] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "skyPS_dynamic.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SUN] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "sunPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SHADOW_ALPHATEST] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "shadowPS_alphatest.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SHADOW_TRANSPARENT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "shadowPS_transparent.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SHADOW_WATER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "shadowPS_water.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SHADOWCUBEMAPRENDER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowPS_alphatest.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_TRAIL] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "trailPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_VOXELIZER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_voxelizer.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_VOXEL] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_FORCEFIELDVISUALIZER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "forceFieldVisualizerPS.cso", wiResourceManager::PIXELSHADER));
-
-	geometryShaders[GSTYPE_ENVMAP] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMapGS.cso", wiResourceManager::GEOMETRYSHADER));
-	geometryShaders[GSTYPE_ENVMAP_SKY] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMap_skyGS.cso", wiResourceManager::GEOMETRYSHADER));
-	geometryShaders[GSTYPE_SHADOWCUBEMAPRENDER] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowGS.cso", wiResourceManager::GEOMETRYSHADER));
-	geometryShaders[GSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowGS_alphatest.cso", wiResourceManager::GEOMETRYSHADER));
-	geometryShaders[GSTYPE_VOXELIZER] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectGS_voxelizer.cso", wiResourceManager::GEOMETRYSHADER));
-	geometryShaders[GSTYPE_VOXEL] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelGS.cso", wiResourceManager::GEOMETRYSHADER));
-
-
-	computeShaders[CSTYPE_LUMINANCE_PASS1] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "luminancePass1CS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_LUMINANCE_PASS2] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "luminancePass2CS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_TILEFRUSTUMS] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "tileFrustumsCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_RESOLVEMSAADEPTHSTENCIL] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "resolveMSAADepthStencilCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_VOXELSCENECOPYCLEAR] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelSceneCopyClearCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_VOXELSCENECOPYCLEAR_TEMPORALSMOOTHING] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelSceneCopyClear_TemporalSmoothing.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_VOXELRADIANCESECONDARYBOUNCE] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelRadianceSecondaryBounceCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_VOXELCLEARONLYNORMAL] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelClearOnlyNormalCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_GENERATEMIPCHAIN2D_SIMPLEFILTER] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "generateMIPChain2D_SimpleFilterCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_GENERATEMIPCHAIN2D_GAUSSIAN] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "generateMIPChain2D_GaussianCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_GENERATEMIPCHAIN3D_SIMPLEFILTER] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "generateMIPChain3D_SimpleFilterCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_GENERATEMIPCHAIN3D_GAUSSIAN] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "generateMIPChain3D_GaussianCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_SKINNING] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "skinningCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_SKINNING_LDS] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "skinningCS_LDS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_CLOUDGENERATOR] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cloudGeneratorCS.cso", wiResourceManager::COMPUTESHADER));
-
-
-	hullShaders[HSTYPE_OBJECT] = static_cast<HullShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectHS.cso", wiResourceManager::HULLSHADER));
-
-
-	domainShaders[DSTYPE_OBJECT] = static_cast<DomainShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectDS.cso", wiResourceManager::DOMAINSHADER));
+	// The pipeline states need all the shaders:
+	wiJobSystem::Wait(ctx);
 
 
 	GraphicsDevice* device = GetDevice();
@@ -2233,6 +2307,7 @@ void wiRenderer::ReloadShaders(const std::string& path)
 	GetDevice()->WaitForGPU();
 
 	wiResourceManager::GetShaderManager()->CleanUp();
+	GetDevice()->ResetPipelineCacheUsage();
 	LoadShaders();
 	wiHairParticle::LoadShaders();
 	wiEmittedParticle::LoadShaders();
@@ -2244,6 +2319,14 @@ void wiRenderer::ReloadShaders(const std::string& path)
 	wiWidget::LoadShaders();
 	wiGPUSortLib::LoadShaders();
 
+	// The pipeline states of the replaced shaders are gone:
+	GetDevice()->EvictUnusedPipelineCacheEntries();
+
+	if (!PIPELINECACHEPATH.empty())
+	{
+		GetDevice()->SavePipelineCache(PIPELINECACHEPATH);
+	}
+
 	GetDevice()->UNLOCK();
 }
 
@@ -2792,18 +2875,25 @@ void wiRenderer::BindPersistentState(GRAPHICSTHREAD threadID)
 
 Transform* wiRenderer::getTransformByName(const std::string& get)
 {
-	//auto transf = transforms.find(get);
-	//if (transf != transforms.end())
-	//{
-	//	return transf->second;
-	//}
+	Transform* found = GetScene().FindTransform(wiHashString(get));
+	if (found != nullptr)
+	{
+		return found;
+	}
+	// Transforms that are not scene entities are not indexed:
 	return GetScene().GetWorldNode()->find(get);
 }
 Transform* wiRenderer::getTransformByID(uint64_t id)
 {
+	Transform* found = GetScene().FindTransform(id);
+	if (found != nullptr)
+	{
+		return found;
+	}
+	// Transforms that are not scene entities are not indexed:
 	for (Model* model : GetScene().models)
 	{
-		Transform* found = model->find(id);
+		found = model->find(id);
 		if (found != nullptr)
 		{
 			return found;
@@ -2813,13 +2903,7 @@ Transform* wiRenderer::getTransformByID(uint64_t id)
 }
 Armature* wiRenderer::getArmatureByName(const std::string& get)
 {
-	for (Model* model : GetScene().models)
-	{
-		for (Armature* armature : model->armatures)
-			if (!armature->name.compare(get))
-				return armature;
-	}
-	return nullptr;
+	return GetScene().Find<Armature>(wiHashString(get));
 }
 int wiRenderer::getActionByName(Armature* armature, const std::string& get)
 {
@@ -2852,47 +2936,15 @@ Material* wiRenderer::getMaterialByName(const std::string& get)
 }
 Object* wiRenderer::getObjectByName(const std::string& name)
 {
-	for (Model* model : GetScene().models)
-	{
-		for (auto& x : model->objects)
-		{
-			if (!x->name.compare(name))
-			{
-				return x;
-			}
-		}
-	}
-
-	return nullptr;
+	return GetScene().Find<Object>(wiHashString(name));
 }
 Camera* wiRenderer::getCameraByName(const std::string& name)
 {
-	for (Model* model : GetScene().models)
-	{
-		for (auto& x : model->cameras)
-		{
-			if (!x->name.compare(name))
-			{
-				return x;
-			}
-		}
-	}
-
-	return nullptr;
+	return GetScene().Find<Camera>(wiHashString(name));
 }
 Light* wiRenderer::getLightByName(const std::string& name)
 {
-	for (Model* model : GetScene().models)
-	{
-		for (auto& x : model->lights)
-		{
-			if (!x->name.compare(name))
-			{
-				return x;
-			}
-		}
-	}
-	return nullptr;
+	return GetScene().Find<Light>(wiHashString(name));
 }
 
 Mesh::Vertex_FULL wiRenderer::TransformVertex(const Mesh* mesh, int vertexI, const XMMATRIX& mat)
@@ -2965,23 +3017,13 @@ void wiRenderer::UpdatePerFrameData(float dt)
 	wiProfiler::GetInstance().BeginRange("SPTree Update", wiProfiler::DOMAIN_CPU);
 	if (GetGameSpeed() > 0)
 	{
-		if (spTree != nullptr && spTree->root != nullptr)
+		if (spTree != nullptr)
 		{
-			wiSPTree* newTree = spTree->updateTree();
-			if (newTree != nullptr)
-			{
-				SAFE_DELETE(spTree);
-				spTree = newTree;
-			}
+			spTree->updateTree();
 		}
-		if (spTree_lights != nullptr && spTree_lights->root != nullptr)
+		if (spTree_lights != nullptr)
 		{
-			wiSPTree* newTree = spTree_lights->updateTree();
-			if (newTree != nullptr)
-			{
-				SAFE_DELETE(spTree_lights);
-				spTree_lights = newTree;
-			}
+			spTree_lights->updateTree();
 		}
 	}
 	wiProfiler::GetInstance().EndRange(); // SPTree Update
@@ -3005,9 +3047,12 @@ void wiRenderer::UpdatePerFrameData(float dt)
 	}
 
 	// Perform culling and obtain closest reflector:
+	//	Every camera is culled on a separate job, and the light assignment of the main camera is an other job.
+	//	Jobs only write into their own FrameCulling (and only the main camera's job writes the reflector), so the results are deterministic.
 	requestReflectionRendering = false;
 	wiProfiler::GetInstance().BeginRange("SPTree Culling", wiProfiler::DOMAIN_CPU);
 	{
+		wiJobSystem::context ctx;
 		for (auto& x : frameCullings)
 		{
 			Camera* camera = x.first;
@@ -3021,126 +3066,131 @@ void wiRenderer::UpdatePerFrameData(float dt)
 
 			if (spTree != nullptr)
 			{
-				CulledList culledObjects;
-				spTree->getVisible(culling.frustum, culledObjects, wiSPTree::SortType::SP_TREE_SORT_FRONT_TO_BACK);
-				for (Cullable* x : culledObjects)
-				{
-					Object* object = (Object*)x;
-					culling.culledRenderer[object->mesh].push_front(object);
-					for (wiHairParticle* hair : object->hParticleSystems)
-					{
-						culling.culledHairParticleSystems.push_back(hair);
-					}
-					if (object->GetRenderTypes() & RENDERTYPE_OPAQUE)
+				wiJobSystem::Execute(ctx, [camera, &culling](wiJobSystem::JobArgs args) {
+					culling.culledObjects.clear();
+					spTree->getVisible(culling.frustum, culling.culledObjects, wiSPTree::SortType::SP_TREE_SORT_NONE);
+					for (Cullable* x : culling.culledObjects)
 					{
-						culling.culledRenderer_opaque[object->mesh].push_front(object);
-					}
-					if (!requestReflectionRendering && camera == getCamera() && object->IsReflector())
-					{
-						// If it is the main camera's culling, then obtain the reflectors:
-						XMVECTOR _refPlane = XMPlaneFromPointNormal(XMLoadFloat3(&object->/*bounds.getCenter()*/translation), XMVectorSet(0, 1, 0, 0));
-						XMFLOAT4 plane;
-						XMStoreFloat4(&plane, _refPlane);
-						waterPlane = wiWaterPlane(plane.x, plane.y, plane.z, plane.w);
-						requestReflectionRendering = true;
-					}
-				}
-				wiSPTree::Sort(camera->translation, culledObjects, wiSPTree::SortType::SP_TREE_SORT_BACK_TO_FRONT);
-				for (Cullable* x : culledObjects)
-				{
-					Object* object = (Object*)x;
-					if (object->GetRenderTypes() & RENDERTYPE_TRANSPARENT || object->GetRenderTypes() & RENDERTYPE_WATER)
-					{
-						culling.culledRenderer_transparent[object->mesh].push_front(object);
+						Object* object = (Object*)x;
+						const float distance = wiMath::DistanceSquared(camera->translation, object->bounds.getCenter());
+						culling.culledRenderer.Add(object, distance);
+						for (wiHairParticle* hair : object->hParticleSystems)
+						{
+							culling.culledHairParticleSystems.push_back(hair);
+						}
+						if (object->GetRenderTypes() & RENDERTYPE_OPAQUE)
+						{
+							culling.culledRenderer_opaque.Add(object, distance);
+						}
+						if (object->GetRenderTypes() & RENDERTYPE_TRANSPARENT || object->GetRenderTypes() & RENDERTYPE_WATER)
+						{
+							culling.culledRenderer_transparent.Add(object, distance);
+						}
+						// Only the main camera's job reads and writes the flag, the other cameras are culled in parallel:
+						if (camera == getCamera() && !requestReflectionRendering && object->IsReflector())
+						{
+							// If it is the main camera's culling, then obtain the reflectors:
+							XMVECTOR _refPlane = XMPlaneFromPointNormal(XMLoadFloat3(&object->/*bounds.getCenter()*/translation), XMVectorSet(0, 1, 0, 0));
+							XMFLOAT4 plane;
+							XMStoreFloat4(&plane, _refPlane);
+							waterPlane = wiWaterPlane(plane.x, plane.y, plane.z, plane.w);
+							requestReflectionRendering = true;
+						}
 					}
-				}
+					culling.culledRenderer.Finalize();
+					culling.culledRenderer_opaque.Finalize();
+					culling.culledRenderer_transparent.Finalize(true);
+				});
 			}
 			if (camera==getCamera() && spTree_lights != nullptr) // only the main camera can render lights and write light array properties (yet)!
 			{
-				for (Model* model : GetScene().models)
-				{
-					for (Decal* decal : model->decals)
+				wiJobSystem::Execute(ctx, [camera, &culling](wiJobSystem::JobArgs args) {
+					for (Model* model : GetScene().models)
 					{
-						if ((decal->texture || decal->normal) && culling.frustum.CheckBox(decal->bounds))
+						for (Decal* decal : model->decals)
 						{
-							x.second.culledDecals.push_back(decal);
+							if ((decal->texture || decal->normal) && culling.frustum.CheckBox(decal->bounds))
+							{
+								culling.culledDecals.push_back(decal);
+							}
 						}
-					}
 
-					for (EnvironmentProbe* probe : model->environmentProbes)
-					{
-						if (probe->textureIndex >= 0 && culling.frustum.CheckBox(probe->bounds))
+						for (EnvironmentProbe* probe : model->environmentProbes)
 						{
-							x.second.culledEnvProbes.push_back(probe);
+							if (probe->textureIndex >= 0 && culling.frustum.CheckBox(probe->bounds))
+							{
+								culling.culledEnvProbes.push_back(probe);
+							}
 						}
 					}
-				}
 
-				spTree_lights->getVisible(culling.frustum, culling.culledLights, wiSPTree::SortType::SP_TREE_SORT_NONE);
+					spTree_lights->getVisible(culling.frustum, culling.culledLights, wiSPTree::SortType::SP_TREE_SORT_NONE);
 
-				if (GetVoxelRadianceEnabled())
-				{
-					// Inject lights which are inside the voxel grid too
-					AABB box;
-					box.createFromHalfWidth(voxelSceneData.center, voxelSceneData.extents);
-					spTree_lights->getVisible(box, culling.culledLights, wiSPTree::SortType::SP_TREE_SORT_NONE);
-				}
+					if (GetVoxelRadianceEnabled())
+					{
+						// Inject lights which are inside the voxel grid too
+						AABB box;
+						box.createFromHalfWidth(voxelSceneData.center, voxelSceneData.extents);
+						spTree_lights->getVisible(box, culling.culledLights, wiSPTree::SortType::SP_TREE_SORT_NONE);
+					}
 
-				// We sort lights so that closer lights will have more priority for shadows!
-				spTree_lights->Sort(camera->translation, culling.culledLights, wiSPTree::SortType::SP_TREE_SORT_FRONT_TO_BACK);
+					// We sort lights so that closer lights will have more priority for shadows!
+					spTree_lights->Sort(camera->translation, culling.culledLights, wiSPTree::SortType::SP_TREE_SORT_FRONT_TO_BACK);
 
-				int i = 0;
-				int shadowCounter_2D = 0;
-				int shadowCounter_Cube = 0;
-				for (auto& c : culling.culledLights)
-				{
-					Light* l = (Light*)c;
-					l->entityArray_index = i;
+					int i = 0;
+					int shadowCounter_2D = 0;
+					int shadowCounter_Cube = 0;
+					for (auto& c : culling.culledLights)
+					{
+						Light* l = (Light*)c;
+						l->entityArray_index = i;
 
-					l->UpdateLight();
+						l->UpdateLight();
 
-					// Link shadowmaps to lights till there are free slots
+						// Link shadowmaps to lights till there are free slots
 
-					l->shadowMap_index = -1;
+						l->shadowMap_index = -1;
 
-					if (l->shadow)
-					{
-						switch (l->GetType())
+						if (l->shadow)
 						{
-						case Light::DIRECTIONAL:
-							if (!l->shadowCam_dirLight.empty() && (shadowCounter_2D + 2) < SHADOWCOUNT_2D)
-							{
-								l->shadowMap_index = shadowCounter_2D;
-								shadowCounter_2D += 3;
-							}
-							break;
-						case Light::SPOT:
-							if (!l->shadowCam_spotLight.empty() && shadowCounter_2D < SHADOWCOUNT_2D)
-							{
-								l->shadowMap_index = shadowCounter_2D;
-								shadowCounter_2D++;
-							}
-							break;
-						case Light::POINT:
-						case Light::SPHERE:
-						case Light::DISC:
-						case Light::RECTANGLE:
-						case Light::TUBE:
-							if (!l->shadowCam_pointLight.empty() && shadowCounter_Cube < SHADOWCOUNT_CUBE)
+							switch (l->GetType())
 							{
-								l->shadowMap_index = shadowCounter_Cube;
-								shadowCounter_Cube++;
+							case Light::DIRECTIONAL:
+								if (!l->shadowCam_dirLight.empty() && (shadowCounter_2D + 2) < SHADOWCOUNT_2D)
+								{
+									l->shadowMap_index = shadowCounter_2D;
+									shadowCounter_2D += 3;
+								}
+								break;
+							case Light::SPOT:
+								if (!l->shadowCam_spotLight.empty() && shadowCounter_2D < SHADOWCOUNT_2D)
+								{
+									l->shadowMap_index = shadowCounter_2D;
+									shadowCounter_2D++;
+								}
+								break;
+							case Light::POINT:
+							case Light::SPHERE:
+							case Light::DISC:
+							case Light::RECTANGLE:
+							case Light::TUBE:
+								if (!l->shadowCam_pointLight.empty() && shadowCounter_Cube < SHADOWCOUNT_CUBE)
+								{
+									l->shadowMap_index = shadowCounter_Cube;
+									shadowCounter_Cube++;
+								}
+								break;
+							default:
+								break;
 							}
-							break;
-						default:
-							break;
 						}
-					}
 
-					i++;
-				}
+						i++;
+					}
+				});
 			}
 		}
+		wiJobSystem::Wait(ctx);
 	}
 	wiProfiler::GetInstance().EndRange(); // SPTree Culling
 
@@ -3189,6 +3239,9 @@ void wiRenderer::UpdateRenderData(GRAPHICSTHREAD threadID)
 {
 	const FrameCulling& mainCameraCulling = frameCullings[getCamera()];
 
+	// The decal atlas placements are needed for the decals in the light array:
+	ManageDecalAtlas(threadID);
+
 	// Fill Light Array with lights + envprobes + decals in the frustum:
 	{
 		const CulledList& culledLights = mainCameraCulling.culledLights;
@@ -3327,6 +3380,10 @@ void wiRenderer::UpdateRenderData(GRAPHICSTHREAD threadID)
 		entityArrayOffset_Decals = entityCounter;
 		for (Decal* decal : mainCameraCulling.culledDecals)
 		{
+			if (decal->texture != nullptr && decal->atlasMulAdd.x <= 0)
+			{
+				continue; // didn't fit into the decal atlas
+			}
 			if (entityCounter == MAX_SHADER_ENTITY_COUNT)
 			{
 				assert(0); // too many entities!
@@ -3397,8 +3454,6 @@ void wiRenderer::UpdateRenderData(GRAPHICSTHREAD threadID)
 	UpdateFrameCB(threadID);
 	BindPersistentState(threadID);
 
-	ManageDecalAtlas(threadID);
-
 	wiProfiler::GetInstance().BeginRange("Skinning", wiProfiler::DOMAIN_GPU, threadID);
 	GetDevice()->EventBegin("Skinning", threadID);
 	{
@@ -3564,7 +3619,8 @@ void wiRenderer::OcclusionCulling_Render(GRAPHICSTHREAD threadID)
 
 	wiProfiler::GetInstance().BeginRange("Occlusion Culling Render", wiProfiler::DOMAIN_GPU, threadID);
 
-	int queryID = 0;
+	OcclusionQueryFrame& frame = occlusionQueryFrames[occlusionQueryFrame];
+	frame.count = 0;
 
 	if (!culledRenderer.empty())
 	{
@@ -3579,28 +3635,26 @@ void wiRenderer::OcclusionCulling_Render(GRAPHICSTHREAD threadID)
 
 		GetDevice()->BindGraphicsPSO(PSO_occlusionquery, threadID);
 
-		int queryID = 0;
-
-		for (CulledCollection::const_iterator iter = culledRenderer.begin(); iter != culledRenderer.end(); ++iter)
+		for (const CulledCollection::Batch& batch : culledRenderer.batches)
 		{
-			Mesh* mesh = iter->first;
+			Mesh* mesh = batch.mesh;
 			if (!mesh->renderable)
 			{
 				continue;
 			}
-			const CulledObjectList& visibleInstances = iter->second;
 
 			MiscCB cb;
-			for (Object* instance : visibleInstances)
+			for (uint32_t i = 0; i < batch.count; ++i)
 			{
-				if(queryID >= ARRAYSIZE(occlusionQueries))
+				Object* instance = culledRenderer.instances[batch.offset + i];
+				if(frame.count >= OCCLUSION_QUERY_COUNT)
 				{
 					instance->occlusionQueryID = -1; // assign an invalid id from the pool
 					continue;
 				}
 				
 				// If a query could be retrieved from the pool for the instance, the instance can be occluded, so render it
-				GPUQuery& query = occlusionQueries[queryID];
+				GPUQuery& query = frame.queries[frame.count];
 				if (!query.IsValid())
 				{
 					continue;
@@ -3614,8 +3668,9 @@ void wiRenderer::OcclusionCulling_Render(GRAPHICSTHREAD threadID)
 				else
 				{
 					// only query for occlusion if the camera is outside the instance
-					instance->occlusionQueryID = queryID; // just assign the id from the pool
-					queryID++;
+					instance->occlusionQueryID = frame.count; // just assign the id from the pool
+					frame.owners[frame.count] = instance; // the result is matched with the instance by this when it is read back
+					frame.count++;
 
 					// previous frame view*projection because these are drawn against the previous depth buffer:
 					cb.mTransform = XMMatrixTranspose(instance->GetOBB()*prevFrameCam->GetViewProjection()); 
@@ -3643,54 +3698,63 @@ void wiRenderer::OcclusionCulling_Read()
 
 	wiProfiler::GetInstance().BeginRange("Occlusion Culling Read", wiProfiler::DOMAIN_CPU);
 
+	// The oldest frame of the ring is read, its queries were issued OCCLUSION_QUERY_LATENCY frames ago.
+	//	Every query is polled once, a result that is not available yet is dropped instead of waiting for it:
+	const int readFrame = (occlusionQueryFrame + 1) % ARRAYSIZE(occlusionQueryFrames);
+	OcclusionQueryFrame& frame = occlusionQueryFrames[readFrame];
+
+	static unordered_map<const Object*, bool> results;
+	results.clear();
+	uint32_t pending = 0;
+	for (int i = 0; i < frame.count; ++i)
+	{
+		GPUQuery& query = frame.queries[i];
+		if (GetDevice()->QueryRead(&query, GRAPHICSTHREAD_IMMEDIATE))
+		{
+			results[frame.owners[i]] = query.result_passed == TRUE;
+		}
+		else
+		{
+			pending++;
+		}
+	}
+	const uint32_t issued = (uint32_t)frame.count;
+	frame.count = 0;
+
+	occlusionQueryFrame = (occlusionQueryFrame + 1) % ARRAYSIZE(occlusionQueryFrames);
+
 	const FrameCulling& culling = frameCullings[getCamera()];
 	const CulledCollection& culledRenderer = culling.culledRenderer;
 
 	if (!culledRenderer.empty())
 	{
-		GetDevice()->EventBegin("Occlusion Culling Read", GRAPHICSTHREAD_IMMEDIATE);
-
-		for (CulledCollection::const_iterator iter = culledRenderer.begin(); iter != culledRenderer.end(); ++iter)
+		for (const CulledCollection::Batch& batch : culledRenderer.batches)
 		{
-			Mesh* mesh = iter->first;
+			Mesh* mesh = batch.mesh;
 			if (!mesh->renderable || mesh->softBody) // todo: correct softbody
 			{
 				continue;
 			}
 
-			const CulledObjectList& visibleInstances = iter->second;
-
-			for (Object* instance : visibleInstances)
+			for (uint32_t i = 0; i < batch.count; ++i)
 			{
+				Object* instance = culledRenderer.instances[batch.offset + i];
 				instance->occlusionHistory <<= 1; // advance history by 1 frame
-				if (instance->occlusionQueryID < 0)
-				{
-					instance->occlusionHistory |= 1; // mark this frame as visible
-					continue;
-				}
-				GPUQuery& query = occlusionQueries[instance->occlusionQueryID];
-				if (!query.IsValid())
-				{
-					instance->occlusionHistory |= 1; // mark this frame as visible
-					continue;
-				}
 
-				while (!GetDevice()->QueryRead(&query, GRAPHICSTHREAD_IMMEDIATE)) {}
-
-				if (query.result_passed == TRUE)
+				// Only an available, failed query leaves this frame as occluded. Instances without a result
+				//	(not queried back then, camera was inside, result not ready yet) are conservatively visible:
+				auto it = results.find(instance);
+				if (it == results.end() || it->second)
 				{
 					instance->occlusionHistory |= 1; // mark this frame as visible
 				}
-				else
-				{
-					// leave this frame as occluded
-				}
 			}
 		}
-
-		GetDevice()->EventEnd(GRAPHICSTHREAD_IMMEDIATE);
 	}
 
+	wiProfiler::GetInstance().SetCounter("Occlusion queries", issued);
+	wiProfiler::GetInstance().SetCounter("Occlusion results pending", pending);
+
 	wiProfiler::GetInstance().EndRange(); // Occlusion Culling Read
 }
 void wiRenderer::UpdateImages()
@@ -4361,7 +4425,7 @@ void wiRenderer::DrawTrails(GRAPHICSTHREAD threadID, Texture2D* refracRes)
 }
 void wiRenderer::DrawImagesAdd(GRAPHICSTHREAD threadID, Texture2D* refracRes){
 	imagesRTAdd.Activate(threadID,0,0,0,1);
-	//wiImage::BatchBegin(threadID);
+	wiImage::BatchBegin(threadID);
 	for(wiSprite* x : images){
 		if(x->effects.blendFlag==BLENDMODE_ADDITIVE){
 			/*Texture2D* nor = x->effects.normalMap;
@@ -4377,10 +4441,11 @@ void wiRenderer::DrawImagesAdd(GRAPHICSTHREAD threadID, Texture2D* refracRes){
 			x->effects.setNormalMap(nor);*/
 		}
 	}
+	wiImage::BatchEnd(threadID);
 }
 void wiRenderer::DrawImages(GRAPHICSTHREAD threadID, Texture2D* refracRes){
 	imagesRT.Activate(threadID,0,0,0,0);
-	//wiImage::BatchBegin(threadID);
+	wiImage::BatchBegin(threadID);
 	for(wiSprite* x : images){
 		if(x->effects.blendFlag==BLENDMODE_ALPHA || x->effects.blendFlag==BLENDMODE_OPAQUE){
 			/*Texture2D* nor = x->effects.normalMap;
@@ -4396,13 +4461,15 @@ void wiRenderer::DrawImages(GRAPHICSTHREAD threadID, Texture2D* refracRes){
 			x->effects.setNormalMap(nor);*/
 		}
 	}
+	wiImage::BatchEnd(threadID);
 }
 void wiRenderer::DrawImagesNormals(GRAPHICSTHREAD threadID, Texture2D* refracRes){
 	normalMapRT.Activate(threadID,0,0,0,0);
-	//wiImage::BatchBegin(threadID);
+	wiImage::BatchBegin(threadID);
 	for(wiSprite* x : images){
 		x->DrawNormal(threadID);
 	}
+	wiImage::BatchEnd(threadID);
 }
 void wiRenderer::DrawLights(Camera* camera, GRAPHICSTHREAD threadID)
 {
@@ -4785,6 +4852,10 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 		const FrameCulling& culling = frameCullings[getCamera()];
 		const CulledList& culledLights = culling.culledLights;
 
+		// Scratch lists, reused for every shadow camera, and they keep their memory between frames:
+		static thread_local CulledList culledObjects;
+		static thread_local CulledCollection culledRenderer;
+
 		ViewPort vp;
 
 		// RGB: Shadow tint (multiplicative), A: Refraction caustics(additive)
@@ -4859,8 +4930,8 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 							boundingbox.createFromHalfWidth(XMFLOAT3(0, 0, 0), XMFLOAT3(siz, siz, f));
 							if (spTree != nullptr)
 							{
-								CulledList culledObjects;
-								CulledCollection culledRenderer;
+								culledObjects.clear();
+								culledRenderer.Clear();
 								spTree->getVisible(boundingbox.get(XMMatrixInverse(0, XMLoadFloat4x4(&l->shadowCam_dirLight[cascade].View))), culledObjects);
 								bool transparentShadowsRequested = false;
 								for (Cullable* x : culledObjects)
@@ -4872,7 +4943,7 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 									}
 									if (object->IsCastingShadow())
 									{
-										culledRenderer[object->mesh].push_front(object);
+										culledRenderer.Add(object, wiMath::DistanceSquared(l->shadowCam_dirLight[cascade].Eye, object->bounds.getCenter()));
 
 										if (object->GetRenderTypes() & RENDERTYPE_TRANSPARENT || object->GetRenderTypes() & RENDERTYPE_WATER)
 										{
@@ -4880,6 +4951,7 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 										}
 									}
 								}
+								culledRenderer.Finalize();
 								if (!culledRenderer.empty())
 								{
 									CameraCB cb;
@@ -4919,8 +4991,8 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 						frustum.ConstructFrustum(l->shadowCam_spotLight[0].farplane, l->shadowCam_spotLight[0].realProjection, l->shadowCam_spotLight[0].View);
 						if (spTree != nullptr)
 						{
-							CulledList culledObjects;
-							CulledCollection culledRenderer;
+							culledObjects.clear();
+							culledRenderer.Clear();
 							spTree->getVisible(frustum, culledObjects);
 							bool transparentShadowsRequested = false;
 							for (Cullable* x : culledObjects)
@@ -4928,7 +5000,7 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 								Object* object = (Object*)x;
 								if (object->IsCastingShadow())
 								{
-									culledRenderer[object->mesh].push_front(object);
+									culledRenderer.Add(object, wiMath::DistanceSquared(l->translation, object->bounds.getCenter()));
 
 									if (object->GetRenderTypes() & RENDERTYPE_TRANSPARENT || object->GetRenderTypes() & RENDERTYPE_WATER)
 									{
@@ -4936,6 +5008,7 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 									}
 								}
 							}
+							culledRenderer.Finalize();
 							if (!culledRenderer.empty())
 							{
 								CameraCB cb;
@@ -4976,17 +5049,18 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 
 						if (spTree != nullptr)
 						{
-							CulledList culledObjects;
-							CulledCollection culledRenderer;
+							culledObjects.clear();
+							culledRenderer.Clear();
 							spTree->getVisible(l->bounds, culledObjects);
 							for (Cullable* x : culledObjects)
 							{
 								Object* object = (Object*)x;
 								if (object->IsCastingShadow())
 								{
-									culledRenderer[object->mesh].push_front(object);
+									culledRenderer.Add(object, wiMath::DistanceSquared(l->translation, object->bounds.getCenter()));
 								}
 							}
+							culledRenderer.Finalize();
 							if (!culledRenderer.empty())
 							{
 								GetDevice()->BindRenderTargets(0, nullptr, Light::shadowMapArray_Cube, threadID, l->shadowMap_index);
@@ -5031,11 +5105,10 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culledRenderer, SHADERTYPE shaderType, UINT renderTypeFlags, GRAPHICSTHREAD threadID,
 	bool tessellation, bool occlusionCulling)
 {
-	// Intensive section, refactor and optimize!
-
 	if (!culledRenderer.empty())
 	{
 		GraphicsDevice* device = GetDevice();
+		DrawCallStats stats;
 
 		device->EventBegin("RenderMeshes", threadID);
 
@@ -5070,24 +5143,23 @@ void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culle
 		{
 			bool impostorGraphicsStateComplete = false;
 
-			for (CulledCollection::const_iterator iter = culledRenderer.begin(); iter != culledRenderer.end(); ++iter)
+			for (const CulledCollection::Batch& batch : culledRenderer.batches)
 			{
-				Mesh* mesh = iter->first;
+				Mesh* mesh = batch.mesh;
 				if (!mesh->renderable || !mesh->hasImpostor() || !(mesh->GetRenderTypes() & renderTypeFlags))
 				{
 					continue;
 				}
 
-				const CulledObjectList& visibleInstances = iter->second;
-
 				UINT instancesOffset;
-				size_t alloc_size = visibleInstances.size();
+				size_t alloc_size = batch.count;
 				alloc_size *= advancedVBRequest ? sizeof(InstBuf) : sizeof(Instance);
 				void* instances = device->AllocateFromRingBuffer(dynamicVertexBufferPool, alloc_size, instancesOffset, threadID);
 
 				int k = 0;
-				for (const Object* instance : visibleInstances)
+				for (uint32_t i = 0; i < batch.count; ++i)
 				{
+					const Object* instance = culledRenderer.instances[batch.offset + i];
 					if (occlusionCulling && instance->IsOccluded())
 						continue;
 
@@ -5180,102 +5252,366 @@ void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culle
 				}
 
 				device->DrawInstanced(6 * 6, k, 0, 0, threadID); // 6 * 6: see Mesh::CreateImpostorVB function
+				stats.drawsIssued++;
 
 			}
 		}
 
 
-		PRIMITIVETOPOLOGY prevTOPOLOGY = TRIANGLELIST;
+		enum class BOUNDVERTEXBUFFERTYPE
+		{
+			NOTHING,
+			POSITION,
+			POSITION_TEXCOORD,
+			EVERYTHING,
+		};
 
-		// Render meshes:
-		for (CulledCollection::const_iterator iter = culledRenderer.begin(); iter != culledRenderer.end(); ++iter) 
+		// Gather the mesh subset draws into a flat array first, then sort them by state, so that consecutive draws can share bindings:
+		struct MeshDraw
 		{
-			Mesh* mesh = iter->first;
-			if (!mesh->renderable || !(mesh->GetRenderTypes() & renderTypeFlags))
+			Mesh* mesh;
+			const MeshSubset* subset;
+			Material* material;
+			GraphicsPSO* pso;
+			UINT instancesOffset;
+			UINT instanceCount;
+			BOUNDVERTEXBUFFERTYPE boundVBType;
+			float tessF; // 0 when the tessellator is not used
+		};
+		static thread_local vector<MeshDraw> draws;
+		static thread_local vector<CulledCollection::SortEntry> drawEntries;
+		static thread_local vector<CulledCollection::SortEntry> drawEntries_temp;
+		static thread_local unordered_map<const void*, uint64_t> sortIDs;
+		draws.clear();
+		drawEntries.clear();
+		sortIDs.clear();
+
+		// Compact identifiers of the PSOs and materials for this call, so they fit into the few bits of the sort key:
+		auto getSortID = [](const void* ptr) {
+			auto it = sortIDs.find(ptr);
+			if (it != sortIDs.end())
 			{
-				continue;
+				return it->second;
 			}
+			uint64_t id = (uint64_t)sortIDs.size() & 0x3FFF;
+			sortIDs.insert(make_pair(ptr, id));
+			return id;
+		};
 
-			const CulledObjectList& visibleInstances = iter->second;
-
-			const float tessF = mesh->getTessellationFactor();
-			const bool tessellatorRequested = tessF > 0 && tessellation;
-
-			if (tessellatorRequested)
+		// Bindings of the previous draw:
+		struct StateCache
+		{
+			const GraphicsPSO* pso = nullptr;
+			const GPUBuffer* materialCB = nullptr;
+			UINT stencilRef = ~0u;
+			const GPUResource* textures[4] = {};
+			const Mesh* indexBufferMesh = nullptr;
+			const Mesh* vertexBufferMesh = nullptr;
+			BOUNDVERTEXBUFFERTYPE boundVBType = BOUNDVERTEXBUFFERTYPE::NOTHING;
+			UINT instancesOffset = ~0u;
+			float tessF = 0;
+		} state;
+
+		// The instance data of the gathered draws is written into one allocation of the ring buffer per round of batches, and every round
+		//	is submitted before the next allocation. An allocation can wrap the ring buffer (discarding its contents on DX11),
+		//	which must not happen while gathered draws still wait for their data.
+		auto getInstanceDataSize = [&](const CulledCollection::Batch& batch) -> size_t {
+			Mesh* mesh = batch.mesh;
+			if (!mesh->renderable || !(mesh->GetRenderTypes() & renderTypeFlags))
+			{
+				return 0;
+			}
+			const bool tessellatorRequested = mesh->getTessellationFactor() > 0 && tessellation;
+			return batch.count * ((advancedVBRequest || tessellatorRequested) ? sizeof(InstBuf) : sizeof(Instance));
+		};
+		uint8_t* roundData = nullptr;
+		UINT roundOffset = 0;
+		size_t roundSize = 0;
+		size_t roundPosition = 0;
+		auto beginRound = [&](size_t firstBatch) {
+			const size_t capacity = dynamicVertexBufferPool->GetDesc().ByteWidth;
+			roundSize = 0;
+			for (size_t i = firstBatch; i < culledRenderer.batches.size(); ++i)
 			{
-				TessellationCB tessCB;
-				tessCB.tessellationFactors = XMFLOAT4(tessF, tessF, tessF, tessF);
-				device->UpdateBuffer(constantBuffers[CBTYPE_TESSELLATION], &tessCB, threadID);
-				device->BindConstantBuffer(HS, constantBuffers[CBTYPE_TESSELLATION], CBSLOT_RENDERER_TESSELLATION, threadID);
+				const size_t size = getInstanceDataSize(culledRenderer.batches[i]);
+				if (i > firstBatch && roundSize + size >= capacity)
+				{
+					break;
+				}
+				roundSize += size;
 			}
+			roundData = (uint8_t*)device->AllocateFromRingBuffer(dynamicVertexBufferPool, roundSize, roundOffset, threadID);
+			roundPosition = 0;
+		};
 
-			bool forceAlphaTestForDithering = false;
+		// Sort and submit the draws of the round, only binding the state that differs from the previous draw:
+		auto submitRound = [&]() {
+			if (roundData != nullptr)
+			{
+				device->InvalidateBufferAccess(dynamicVertexBufferPool, threadID);
+				roundData = nullptr;
+			}
 
-			UINT instancesOffset;
-			size_t alloc_size = visibleInstances.size();
-			alloc_size *= advancedVBRequest ? sizeof(InstBuf) : sizeof(Instance);
-			void* instances = device->AllocateFromRingBuffer(dynamicVertexBufferPool, alloc_size, instancesOffset, threadID);
+			// The draws array is complete now, so pointers into it stay valid:
+			for (size_t i = 0; i < drawEntries.size(); ++i)
+			{
+				drawEntries[i].value = &draws[i];
+			}
+			CulledCollection::RadixSort(drawEntries, drawEntries_temp);
 
-			int k = 0;
-			for (const Object* instance : visibleInstances) 
+			for (const CulledCollection::SortEntry& entry : drawEntries)
 			{
-				if (occlusionCulling && instance->IsOccluded())
-					continue;
+				const MeshDraw& draw = *(const MeshDraw*)entry.value;
+				Mesh* mesh = draw.mesh;
+				Material* material = draw.material;
 
-				float dither = instance->transparency;
-				if (impostorRequest != nullptr)
+				if (draw.tessF > 0 && draw.tessF != state.tessF)
 				{
-					// fade out to impostor...
-					const float impostorThreshold = instance->bounds.getRadius();
-					float dist = wiMath::Distance(eye, instance->bounds.getCenter());
-					if (mesh->hasImpostor())
-						dither = wiMath::SmoothStep(dither, 1.0f, wiMath::Clamp((dist - impostorThreshold - mesh->impostorDistance) / impostorThreshold, 0, 1));
+					TessellationCB tessCB;
+					tessCB.tessellationFactors = XMFLOAT4(draw.tessF, draw.tessF, draw.tessF, draw.tessF);
+					device->UpdateBuffer(constantBuffers[CBTYPE_TESSELLATION], &tessCB, threadID);
+					device->BindConstantBuffer(HS, constantBuffers[CBTYPE_TESSELLATION], CBSLOT_RENDERER_TESSELLATION, threadID);
+					state.tessF = draw.tessF;
+					stats.bindsIssued++;
 				}
-				if (dither > 1.0f - FLT_EPSILON)
-					continue;
-
-				forceAlphaTestForDithering = forceAlphaTestForDithering || (dither > 0);
-
-				if (mesh->softBody)
-					tempMat = __identityMat;
-				else
-					tempMat = instance->world;
 
-				if (advancedVBRequest || tessellatorRequested)
+				if (mesh != state.indexBufferMesh)
 				{
-					((volatile InstBuf*)instances)[k].instance.Create(tempMat, dither, instance->color);
-
-					if (mesh->softBody)
-						tempMat = __identityMat;
-					else
-						tempMat = instance->worldPrev;
-					((volatile InstBuf*)instances)[k].instancePrev.Create(tempMat);
+					device->BindIndexBuffer(mesh->indexBuffer, mesh->GetIndexFormat(), 0, threadID);
+					state.indexBufferMesh = mesh;
+					stats.bindsIssued++;
 				}
 				else
 				{
-					((volatile Instance*)instances)[k].Create(tempMat, dither, instance->color);
+					stats.bindsSaved++;
 				}
-						
-				++k;
-			}
 
-			device->InvalidateBufferAccess(dynamicVertexBufferPool, threadID);
-
-			if (k < 1)
+				if (mesh != state.vertexBufferMesh || draw.boundVBType != state.boundVBType || draw.instancesOffset != state.instancesOffset)
+				{
+					// Assemble the required vertex buffer:
+					switch (draw.boundVBType)
+					{
+					case BOUNDVERTEXBUFFERTYPE::POSITION:
+					{
+						GPUBuffer* vbs[] = {
+							mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_POS != nullptr ? mesh->streamoutBuffer_POS : mesh->vertexBuffer_POS),
+							dynamicVertexBufferPool
+						};
+						UINT strides[] = {
+							sizeof(Mesh::Vertex_POS),
+							sizeof(Instance)
+						};
+						UINT offsets[] = {
+							mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
+							draw.instancesOffset
+						};
+						device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
+					}
+					break;
+					case BOUNDVERTEXBUFFERTYPE::POSITION_TEXCOORD:
+					{
+						GPUBuffer* vbs[] = {
+							mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_POS != nullptr ? mesh->streamoutBuffer_POS : mesh->vertexBuffer_POS),
+							mesh->vertexBuffer_TEX,
+							dynamicVertexBufferPool
+						};
+						UINT strides[] = {
+							sizeof(Mesh::Vertex_POS),
+							sizeof(Mesh::Vertex_TEX),
+							sizeof(Instance)
+						};
+						UINT offsets[] = {
+							mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
+							0,
+							draw.instancesOffset
+						};
+						device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
+					}
+					break;
+					case BOUNDVERTEXBUFFERTYPE::EVERYTHING:
+					{
+						GPUBuffer* vbs[] = {
+							mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_POS != nullptr ? mesh->streamoutBuffer_POS : mesh->vertexBuffer_POS),
+							mesh->vertexBuffer_TEX,
+							mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_PRE != nullptr ? mesh->streamoutBuffer_PRE : mesh->vertexBuffer_POS),
+							dynamicVertexBufferPool
+						};
+						UINT strides[] = {
+							sizeof(Mesh::Vertex_POS),
+							sizeof(Mesh::Vertex_TEX),
+							sizeof(Mesh::Vertex_POS),
+							sizeof(InstBuf)
+						};
+						UINT offsets[] = {
+							mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
+							0,
+							mesh->hasDynamicVB() ? mesh->bufferOffset_PRE : 0,
+							draw.instancesOffset
+						};
+						device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
+					}
+					break;
+					default:
+						assert(0);
+						break;
+					}
+					state.vertexBufferMesh = mesh;
+					state.boundVBType = draw.boundVBType;
+					state.instancesOffset = draw.instancesOffset;
+					stats.bindsIssued++;
+				}
+				else
+				{
+					stats.bindsSaved++;
+				}
+
+				if (&material->constantBuffer != state.materialCB)
+				{
+					device->BindConstantBuffer(PS, &material->constantBuffer, CB_GETBINDSLOT(MaterialCB), threadID);
+					state.materialCB = &material->constantBuffer;
+					stats.bindsIssued++;
+				}
+				else
+				{
+					stats.bindsSaved++;
+				}
+
+				const UINT stencilRef = material->GetStencilRef();
+				if (stencilRef != state.stencilRef)
+				{
+					device->BindStencilRef(stencilRef, threadID);
+					state.stencilRef = stencilRef;
+					stats.bindsIssued++;
+				}
+				else
+				{
+					stats.bindsSaved++;
+				}
+
+				if (draw.pso != state.pso)
+				{
+					device->BindGraphicsPSO(draw.pso, threadID);
+					state.pso = draw.pso;
+					stats.bindsIssued++;
+				}
+				else
+				{
+					stats.bindsSaved++;
+				}
+
+				GPUResource* res[] = {
+					material->GetBaseColorMap(),
+					material->GetNormalMap(),
+					material->GetSurfaceMap(),
+					material->GetDisplacementMap(),
+				};
+				const int textureCount = easyTextureBind ? 2 : ARRAYSIZE(res);
+				bool texturesChanged = false;
+				for (int i = 0; i < textureCount; ++i)
+				{
+					texturesChanged = texturesChanged || res[i] != state.textures[i];
+					state.textures[i] = res[i];
+				}
+				if (texturesChanged)
+				{
+					device->BindResources(PS, res, TEXSLOT_ONDEMAND0, textureCount, threadID);
+					stats.bindsIssued++;
+				}
+				else
+				{
+					stats.bindsSaved++;
+				}
+
+				SetAlphaRef(material->alphaRef, threadID);
+
+				device->DrawIndexedInstanced((int)draw.subset->subsetIndices.size(), draw.instanceCount, draw.subset->indexBufferOffset, 0, 0, threadID);
+				stats.drawsIssued++;
+			}
+
+			draws.clear();
+			drawEntries.clear();
+		};
+
+		for (size_t batchIndex = 0; batchIndex < culledRenderer.batches.size(); ++batchIndex)
+		{
+			const CulledCollection::Batch& batch = culledRenderer.batches[batchIndex];
+			Mesh* mesh = batch.mesh;
+			if (!mesh->renderable || !(mesh->GetRenderTypes() & renderTypeFlags))
+			{
 				continue;
+			}
 
-			device->BindIndexBuffer(mesh->indexBuffer, mesh->GetIndexFormat(), 0, threadID);
+			const float tessF = mesh->getTessellationFactor();
+			const bool tessellatorRequested = tessF > 0 && tessellation;
+
+			bool forceAlphaTestForDithering = false;
+			float closestDistance = FLT_MAX;
 
-			enum class BOUNDVERTEXBUFFERTYPE
+			const size_t alloc_size = getInstanceDataSize(batch);
+			if (roundPosition + alloc_size > roundSize)
 			{
-				NOTHING,
-				POSITION,
-				POSITION_TEXCOORD,
-				EVERYTHING,
-			};
-			BOUNDVERTEXBUFFERTYPE boundVBType_Prev = BOUNDVERTEXBUFFERTYPE::NOTHING;
+				// The ring buffer can only be written again after the draws of the current round were submitted:
+				submitRound();
+				beginRound(batchIndex);
+			}
+			const UINT instancesOffset = roundOffset + (UINT)roundPosition;
+			void* instances = roundData + roundPosition;
+			roundPosition += alloc_size;
 
-			for (MeshSubset& subset : mesh->subsets)
+			int k = 0;
+			for (uint32_t i = 0; i < batch.count; ++i)
+			{
+				const Object* instance = culledRenderer.instances[batch.offset + i];
+				if (occlusionCulling && instance->IsOccluded())
+					continue;
+
+				float dither = instance->transparency;
+				if (impostorRequest != nullptr)
+				{
+					// fade out to impostor...
+					const float impostorThreshold = instance->bounds.getRadius();
+					float dist = wiMath::Distance(eye, instance->bounds.getCenter());
+					if (mesh->hasImpostor())
+						dither = wiMath::SmoothStep(dither, 1.0f, wiMath::Clamp((dist - impostorThreshold - mesh->impostorDistance) / impostorThreshold, 0, 1));
+				}
+				if (dither > 1.0f - FLT_EPSILON)
+					continue;
+
+				forceAlphaTestForDithering = forceAlphaTestForDithering || (dither > 0);
+				closestDistance = min(closestDistance, wiMath::DistanceSquared(eye, instance->bounds.getCenter()));
+
+				if (mesh->softBody)
+					tempMat = __identityMat;
+				else
+					tempMat = instance->world;
+
+				if (advancedVBRequest || tessellatorRequested)
+				{
+					((volatile InstBuf*)instances)[k].instance.Create(tempMat, dither, instance->color);
+
+					if (mesh->softBody)
+						tempMat = __identityMat;
+					else
+						tempMat = instance->worldPrev;
+					((volatile InstBuf*)instances)[k].instancePrev.Create(tempMat);
+				}
+				else
+				{
+					((volatile Instance*)instances)[k].Create(tempMat, dither, instance->color);
+				}
+						
+				++k;
+			}
+
+			if (k < 1)
+				continue;
+
+			// Logarithmic depth bucket from the upper bits of the (positive) float squared distance:
+			uint32_t depthBits;
+			memcpy(&depthBits, &closestDistance, sizeof(depthBits));
+			const uint64_t depth = (depthBits >> 19) & 0xFFF;
+
+			for (const MeshSubset& subset : mesh->subsets)
 			{
 				if (subset.subsetIndices.empty() || subset.material->isSky)
 				{
@@ -5349,102 +5685,49 @@ void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culle
 					boundVBType = BOUNDVERTEXBUFFERTYPE::POSITION_TEXCOORD;
 				}
 
-				// Only bind vertex buffers when the layout changes
-				if (boundVBType != boundVBType_Prev)
+				MeshDraw draw;
+				draw.mesh = mesh;
+				draw.subset = &subset;
+				draw.material = material;
+				draw.pso = pso;
+				draw.instancesOffset = instancesOffset;
+				draw.instanceCount = (UINT)k;
+				draw.boundVBType = boundVBType;
+				draw.tessF = tessellatorRequested ? tessF : 0;
+				draws.push_back(draw);
+
+				// Sort key layout:
+				//	opaque:			[63:60] pass | [59:46] PSO | [45:32] material | [31:12] mesh | [11:0] depth (front to back)
+				//	transparent:	[63:60] pass | [59:48] depth (back to front) | [47:34] PSO | [33:20] material | [19:0] mesh
+				const uint64_t pass = material->IsWater() ? 2 : (material->IsTransparent() ? 1 : 0);
+				const uint64_t psoID = getSortID(pso);
+				const uint64_t materialID = getSortID(material);
+				const uint64_t meshID = (uint64_t)batchIndex & 0xFFFFF;
+				uint64_t key = pass << 60;
+				if (pass == 0)
 				{
-					// Assemble the required vertex buffer:
-					switch (boundVBType)
-					{
-					case BOUNDVERTEXBUFFERTYPE::POSITION:
-					{
-						GPUBuffer* vbs[] = {
-							mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_POS != nullptr ? mesh->streamoutBuffer_POS : mesh->vertexBuffer_POS),
-							dynamicVertexBufferPool
-						};
-						UINT strides[] = {
-							sizeof(Mesh::Vertex_POS),
-							sizeof(Instance)
-						};
-						UINT offsets[] = {
-							mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
-							instancesOffset
-						};
-						device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
-					}
-					break;
-					case BOUNDVERTEXBUFFERTYPE::POSITION_TEXCOORD:
-					{
-						GPUBuffer* vbs[] = {
-							mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_POS != nullptr ? mesh->streamoutBuffer_POS : mesh->vertexBuffer_POS),
-							mesh->vertexBuffer_TEX,
-							dynamicVertexBufferPool
-						};
-						UINT strides[] = {
-							sizeof(Mesh::Vertex_POS),
-							sizeof(Mesh::Vertex_TEX),
-							sizeof(Instance)
-						};
-						UINT offsets[] = {
-							mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
-							0,
-							instancesOffset
-						};
-						device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
-					}
-					break;
-					case BOUNDVERTEXBUFFERTYPE::EVERYTHING:
-					{
-						GPUBuffer* vbs[] = {
-							mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_POS != nullptr ? mesh->streamoutBuffer_POS : mesh->vertexBuffer_POS),
-							mesh->vertexBuffer_TEX,
-							mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_PRE != nullptr ? mesh->streamoutBuffer_PRE : mesh->vertexBuffer_POS),
-							dynamicVertexBufferPool
-						};
-						UINT strides[] = {
-							sizeof(Mesh::Vertex_POS),
-							sizeof(Mesh::Vertex_TEX),
-							sizeof(Mesh::Vertex_POS),
-							sizeof(InstBuf)
-						};
-						UINT offsets[] = {
-							mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
-							0,
-							mesh->hasDynamicVB() ? mesh->bufferOffset_PRE : 0,
-							instancesOffset
-						};
-						device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
-					}
-					break;
-					default:
-						assert(0);
-						break;
-					}
+					key |= (psoID << 46) | (materialID << 32) | (meshID << 12) | depth;
+				}
+				else
+				{
+					key |= ((~depth & 0xFFF) << 48) | (psoID << 34) | (materialID << 20) | meshID;
 				}
-				boundVBType_Prev = boundVBType;
-
-				device->BindConstantBuffer(PS, &material->constantBuffer, CB_GETBINDSLOT(MaterialCB), threadID);
-
-				device->BindStencilRef(material->GetStencilRef(), threadID);
-
-				device->BindGraphicsPSO(pso, threadID);
-
-				GPUResource* res[] = {
-					material->GetBaseColorMap(),
-					material->GetNormalMap(),
-					material->GetSurfaceMap(),
-					material->GetDisplacementMap(),
-				};
-				device->BindResources(PS, res, TEXSLOT_ONDEMAND0, (easyTextureBind ? 2 : ARRAYSIZE(res)), threadID);
-
-				SetAlphaRef(material->alphaRef, threadID);
 
-				device->DrawIndexedInstanced((int)subset.subsetIndices.size(), k, subset.indexBufferOffset, 0, 0, threadID);
+				CulledCollection::SortEntry entry;
+				entry.key = key;
+				entry.value = nullptr;
+				drawEntries.push_back(entry);
 			}
-
 		}
 
+		submitRound();
+
 		ResetAlphaRef(threadID);
 
+		drawCallCounters[shaderType].drawsIssued.fetch_add(stats.drawsIssued);
+		drawCallCounters[shaderType].bindsIssued.fetch_add(stats.bindsIssued);
+		drawCallCounters[shaderType].bindsSaved.fetch_add(stats.bindsSaved);
+
 		device->EventEnd(threadID);
 	}
 }
@@ -5770,8 +6053,11 @@ void wiRenderer::RefreshEnvProbes(GRAPHICSTHREAD threadID)
 			GetDevice()->UpdateBuffer(constantBuffers[CBTYPE_CAMERA], &camcb, threadID);
 
 
-			CulledList culledObjects;
-			CulledCollection culledRenderer;
+			// Scratch lists, they keep their memory between frames:
+			static thread_local CulledList culledObjects;
+			static thread_local CulledCollection culledRenderer;
+			culledObjects.clear();
+			culledRenderer.Clear();
 
 			SPHERE culler = SPHERE(center, zFarP);
 			if (spTree != nullptr)
@@ -5780,8 +6066,9 @@ void wiRenderer::RefreshEnvProbes(GRAPHICSTHREAD threadID)
 
 				for (Cullable* object : culledObjects)
 				{
-					culledRenderer[((Object*)object)->mesh].push_front((Object*)object);
+					culledRenderer.Add((Object*)object, wiMath::DistanceSquared(center, object->bounds.getCenter()));
 				}
+				culledRenderer.Finalize();
 
 				RenderMeshes(center, culledRenderer, SHADERTYPE_ENVMAPCAPTURE, RENDERTYPE_OPAQUE, threadID);
 			}
@@ -5871,8 +6158,11 @@ void wiRenderer::VoxelRadiance(GRAPHICSTHREAD threadID)
 
 	Texture3D* result = (Texture3D*)textures[TEXTYPE_3D_VOXELRADIANCE];
 
-	CulledList culledObjects;
-	CulledCollection culledRenderer;
+	// Scratch lists, they keep their memory between frames:
+	static thread_local CulledList culledObjects;
+	static thread_local CulledCollection culledRenderer;
+	culledObjects.clear();
+	culledRenderer.Clear();
 
 	AABB bbox;
 	XMFLOAT3 extents = voxelSceneData.extents;
@@ -5884,8 +6174,9 @@ void wiRenderer::VoxelRadiance(GRAPHICSTHREAD threadID)
 
 		for (Cullable* object : culledObjects)
 		{
-			culledRenderer[((Object*)object)->mesh].push_front((Object*)object);
+			culledRenderer.Add((Object*)object, wiMath::DistanceSquared(center, object->bounds.getCenter()));
 		}
+		culledRenderer.Finalize();
 
 		ViewPort VP;
 		VP.TopLeftX = 0;
@@ -6331,88 +6622,311 @@ void wiRenderer::ManageDecalAtlas(GRAPHICSTHREAD threadID)
 {
 	GraphicsDevice* device = GetDevice();
 
+	// The atlas keeps its allocations between frames. New decal textures are inserted into free space,
+	//	textures that no visible decal used for a while are evicted (least recently used first),
+	//	and the atlas is only grown or defragmented when a texture can't be placed otherwise.
+	struct StoredTexture
+	{
+		wiAtlasAllocator::Rect rect; // in DECAL_ATLAS_GRANULARITY units
+		uint64_t lastUsedFrame;
+		// The textures are stored by address, these tell if the texture at the address is still the same one:
+		uint64_t textureID;
+		UINT width, height;
+	};
+	static unordered_map<Texture2D*, StoredTexture> storedTextures;
+	static wiAtlasAllocator allocator;
 	static Texture2D* atlasTexture = nullptr;
 
-	for (Model* model : GetScene().models)
-	{
-		if (model->decals.empty())
-			continue;
+	wiTimer timer;
+	DecalAtlasStats& stats = decalAtlasStats;
+	stats.uploads = 0;
+	stats.evictions = 0;
+	stats.defragmentations = 0;
+	stats.resizes = 0;
 
-		for (Decal* decal : model->decals)
+	const uint64_t frame = device->GetFrameCount();
+	const vector<Decal*>& culledDecals = frameCullings[getCamera()].culledDecals;
+
+	auto createAtlas = [&](int size) {
+		TextureDesc desc;
+		ZeroMemory(&desc, sizeof(desc));
+		desc.Width = (UINT)size;
+		desc.Height = (UINT)size;
+		desc.MipLevels = DECAL_ATLAS_MIPS;
+		desc.ArraySize = 1;
+		desc.Format = FORMAT_B8G8R8A8_UNORM; // png decals are loaded into this format! todo: DXT!
+		desc.SampleDesc.Count = 1;
+		desc.SampleDesc.Quality = 0;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = 0;
+		desc.MiscFlags = 0;
+
+		Texture2D* texture = nullptr;
+		device->CreateTexture2D(&desc, nullptr, &texture);
+
+		stats.memoryBytes = 0;
+		for (UINT mip = 0; mip < desc.MipLevels; ++mip)
 		{
-			if (decal->texture == nullptr)
+			stats.memoryBytes += (uint64_t)max(1u, desc.Width >> mip) * (uint64_t)max(1u, desc.Height >> mip) * 4;
+		}
+		return texture;
+	};
+	auto upload = [&](Texture2D* texture, const wiAtlasAllocator::Rect& rect) {
+		const UINT x = (UINT)rect.x * DECAL_ATLAS_GRANULARITY;
+		const UINT y = (UINT)rect.y * DECAL_ATLAS_GRANULARITY;
+		const UINT mipCount = min((UINT)DECAL_ATLAS_MIPS, texture->GetDesc().MipLevels);
+		for (UINT mip = 0; mip < mipCount; ++mip)
+		{
+			device->CopyTexture2D_Region(atlasTexture, mip, x >> mip, y >> mip, texture, mip, threadID);
+		}
+		stats.uploads++;
+	};
+
+	// Textures not used in this frame, least recently used first. Gathered when the first eviction is needed:
+	vector<pair<uint64_t, Texture2D*>> evictionOrder;
+	size_t evictionCursor = 0;
+	bool evictionOrderGathered = false;
+	auto evictLRU = [&](bool staleOnly) {
+		if (!evictionOrderGathered)
+		{
+			for (auto& it : storedTextures)
 			{
+				if (it.second.lastUsedFrame < frame)
+				{
+					evictionOrder.push_back(make_pair(it.second.lastUsedFrame, it.first));
+				}
+			}
+			sort(evictionOrder.begin(), evictionOrder.end());
+			evictionOrderGathered = true;
+		}
+		while (evictionCursor < evictionOrder.size())
+		{
+			auto it = storedTextures.find(evictionOrder[evictionCursor].second);
+			if (it == storedTextures.end() || it->second.lastUsedFrame == frame)
+			{
+				evictionCursor++;
 				continue;
 			}
+			if (staleOnly && it->second.lastUsedFrame + DECAL_ATLAS_STALE_FRAMES >= frame)
+			{
+				return false;
+			}
+			allocator.Free(it->second.rect);
+			storedTextures.erase(it);
+			evictionCursor++;
+			stats.evictions++;
+			return true;
+		}
+		return false;
+	};
 
-			using namespace wiRectPacker;
-			static std::map<Texture2D*, rect_xywhf> storedTextures;
+	// Repack the textures used in this frame from scratch, largest first. The rest are evicted instead of copied again,
+	//	because their source textures are not referenced by any visible decal and might not even exist any more.
+	auto defragment = [&]() {
+		vector<pair<Texture2D*, StoredTexture*>> repack;
+		for (auto it = storedTextures.begin(); it != storedTextures.end();)
+		{
+			if (it->second.lastUsedFrame == frame)
+			{
+				repack.push_back(make_pair(it->first, &it->second));
+				++it;
+			}
+			else
+			{
+				it = storedTextures.erase(it);
+				stats.evictions++;
+			}
+		}
+		sort(repack.begin(), repack.end(), [](const pair<Texture2D*, StoredTexture*>& a, const pair<Texture2D*, StoredTexture*>& b) {
+			return a.second->rect.area() > b.second->rect.area();
+		});
 
-			if (storedTextures.find(decal->texture) == storedTextures.end())
+		allocator.Reset(allocator.GetWidth(), allocator.GetHeight());
+		for (auto& x : repack)
+		{
+			wiAtlasAllocator::Rect& rect = x.second->rect;
+			if (allocator.Allocate(rect.w, rect.h, rect))
+			{
+				upload(x.first, rect);
+			}
+			else
 			{
-				// we need to pack this decal texture into the atlas
-				rect_xywhf newRect = rect_xywhf(0, 0, decal->texture->GetDesc().Width, decal->texture->GetDesc().Height);
-				storedTextures[decal->texture] = newRect;
+				storedTextures.erase(x.first);
+				stats.evictions++;
+			}
+		}
 
-				rect_xywhf** out_rects = new rect_xywhf*[storedTextures.size()];
-				int i = 0;
-				for (auto& it : storedTextures)
-				{
-					out_rects[i] = &it.second;
-					i++;
-				}
+		// everything that could be evicted is gone now:
+		evictionOrder.clear();
+		evictionCursor = 0;
+		stats.defragmentations++;
+	};
 
-				std::vector<bin> bins;
-				if (pack(out_rects, (int)storedTextures.size(), 16384, bins))
-				{
-					assert(bins.size() == 1 && "Decal atlas packing into single texture failed!");
-
-					SAFE_DELETE(atlasTexture);
-
-					TextureDesc desc;
-					ZeroMemory(&desc, sizeof(desc));
-					desc.Width = (UINT)bins[0].size.w;
-					desc.Height = (UINT)bins[0].size.h;
-					desc.MipLevels = 6;
-					desc.ArraySize = 1;
-					desc.Format = FORMAT_B8G8R8A8_UNORM; // png decals are loaded into this format! todo: DXT!
-					desc.SampleDesc.Count = 1;
-					desc.SampleDesc.Quality = 0;
-					desc.Usage = USAGE_DEFAULT;
-					desc.BindFlags = BIND_SHADER_RESOURCE;
-					desc.CPUAccessFlags = 0;
-					desc.MiscFlags = 0;
-
-					device->CreateTexture2D(&desc, nullptr, &atlasTexture);
-
-					for (UINT mip = 0; mip < atlasTexture->GetDesc().MipLevels; ++mip)
-					{
-						for (auto& it : storedTextures)
-						{
-							if (mip < it.first->GetDesc().MipLevels)
-							{
-								device->CopyTexture2D_Region(atlasTexture, mip, it.second.x >> mip, it.second.y >> mip, it.first, mip, threadID);
-							}
-						}
-					}
-				}
-				else
-				{
-					wiBackLog::post("Decal atlas packing failed!");
-				}
+	// Double the atlas size, the old contents are copied over in one piece so that the allocations stay where they are
+	auto grow = [&]() {
+		const int size = allocator.GetWidth() * DECAL_ATLAS_GRANULARITY;
+		if (size >= DECAL_ATLAS_MAX_SIZE)
+		{
+			return false;
+		}
+		Texture2D* newAtlas = createAtlas(size * 2);
+		for (UINT mip = 0; mip < DECAL_ATLAS_MIPS; ++mip)
+		{
+			device->CopyTexture2D_Region(newAtlas, mip, 0, 0, atlasTexture, mip, threadID);
+		}
+		SAFE_DELETE(atlasTexture);
+		atlasTexture = newAtlas;
+		allocator.Grow(allocator.GetWidth() * 2, allocator.GetHeight() * 2);
+		stats.resizes++;
+		return true;
+	};
+
+	auto insert = [&](Texture2D* texture) {
+		const TextureDesc& desc = texture->GetDesc();
+		if (desc.Format != FORMAT_B8G8R8A8_UNORM)
+		{
+			return false;
+		}
+		const int w = (int)(desc.Width + DECAL_ATLAS_GRANULARITY - 1) / DECAL_ATLAS_GRANULARITY;
+		const int h = (int)(desc.Height + DECAL_ATLAS_GRANULARITY - 1) / DECAL_ATLAS_GRANULARITY;
+
+		if (atlasTexture == nullptr)
+		{
+			atlasTexture = createAtlas(DECAL_ATLAS_INITIAL_SIZE);
+			allocator.Reset(DECAL_ATLAS_INITIAL_SIZE / DECAL_ATLAS_GRANULARITY, DECAL_ATLAS_INITIAL_SIZE / DECAL_ATLAS_GRANULARITY);
+		}
+
+		// A defragmentation only helps if enough area was freed since the previous one:
+		int usedAreaAtDefragment = INT_MAX;
+
+		StoredTexture stored;
+		while (!allocator.Allocate(w, h, stored.rect))
+		{
+			if (evictLRU(true))
+			{
+				continue;
 			}
-			
-			rect_xywhf rect = storedTextures[decal->texture];
-			TextureDesc desc = atlasTexture->GetDesc();
-			decal->atlasMulAdd = XMFLOAT4((float)rect.w / (float)desc.Width, (float)rect.h / (float)desc.Height, (float)rect.x / (float)desc.Width, (float)rect.y / (float)desc.Height);
+			if (allocator.GetFreeArea() >= w * h && allocator.GetUsedArea() + w * h <= usedAreaAtDefragment)
+			{
+				defragment();
+				usedAreaAtDefragment = allocator.GetUsedArea();
+				continue;
+			}
+			if (grow())
+			{
+				continue;
+			}
+			if (evictLRU(false))
+			{
+				continue;
+			}
+			return false;
 		}
 
+		stored.lastUsedFrame = frame;
+		stored.textureID = texture->GetUniqueID();
+		stored.width = desc.Width;
+		stored.height = desc.Height;
+		storedTextures[texture] = stored;
+		upload(texture, stored.rect);
+		return true;
+	};
+
+	// Free an entry and its area in the atlas:
+	auto evict = [&](unordered_map<Texture2D*, StoredTexture>::iterator it) {
+		allocator.Free(it->second.rect);
+		storedTextures.erase(it);
+		stats.evictions++;
+	};
+	// Find the entry of a texture. An entry of an other texture that was deleted and had the same address is evicted, that is a miss:
+	auto find = [&](Texture2D* texture) {
+		auto it = storedTextures.find(texture);
+		if (it != storedTextures.end())
+		{
+			const TextureDesc& desc = texture->GetDesc();
+			if (it->second.textureID != texture->GetUniqueID() || it->second.width != desc.Width || it->second.height != desc.Height)
+			{
+				evict(it);
+				return storedTextures.end();
+			}
+		}
+		return it;
+	};
+
+	// The textures of the removed decals:
+	for (auto& x : decalAtlasEvictions)
+	{
+		auto it = storedTextures.find(x.first);
+		if (it != storedTextures.end() && it->second.textureID == x.second)
+		{
+			evict(it);
+		}
+	}
+	decalAtlasEvictions.clear();
+
+	// Mark the textures of the visible decals first, so that no insertion evicts them:
+	for (Decal* decal : culledDecals)
+	{
+		if (decal->texture == nullptr)
+		{
+			continue;
+		}
+		auto it = find(decal->texture);
+		if (it != storedTextures.end())
+		{
+			it->second.lastUsedFrame = frame;
+		}
+	}
+	bool atlasFull = false;
+	for (Decal* decal : culledDecals)
+	{
+		if (decal->texture == nullptr || find(decal->texture) != storedTextures.end())
+		{
+			continue;
+		}
+		if (!insert(decal->texture))
+		{
+			atlasFull = true;
+		}
+	}
+	if (atlasFull)
+	{
+		wiBackLog::post("Decal atlas is full, some of the visible decals are not drawn!");
 	}
 
+	// The placements are only final after every texture of the frame was inserted (a defragmentation moves them):
 	if (atlasTexture != nullptr)
 	{
+		const TextureDesc& desc = atlasTexture->GetDesc();
+		for (Decal* decal : culledDecals)
+		{
+			if (decal->texture == nullptr)
+			{
+				continue;
+			}
+			auto it = find(decal->texture);
+			if (it == storedTextures.end())
+			{
+				// couldn't be placed, it won't be drawn
+				decal->atlasMulAdd = XMFLOAT4(0, 0, 0, 0);
+				continue;
+			}
+			const TextureDesc& texdesc = decal->texture->GetDesc();
+			const wiAtlasAllocator::Rect& rect = it->second.rect;
+			decal->atlasMulAdd = XMFLOAT4((float)texdesc.Width / (float)desc.Width, (float)texdesc.Height / (float)desc.Height,
+				(float)(rect.x * DECAL_ATLAS_GRANULARITY) / (float)desc.Width, (float)(rect.y * DECAL_ATLAS_GRANULARITY) / (float)desc.Height);
+		}
+
 		device->BindResource(PS, atlasTexture, TEXSLOT_DECALATLAS, threadID);
 	}
+
+	stats.textures = (uint32_t)storedTextures.size();
+	stats.updateMilliseconds = (float)timer.elapsed();
+
+	wiProfiler::GetInstance().SetCounter("Decal atlas textures", stats.textures);
+	wiProfiler::GetInstance().SetCounter("Decal atlas uploads", stats.uploads);
+	wiProfiler::GetInstance().SetCounter("Decal atlas KB", stats.memoryBytes / 1024);
 }
 
 void wiRenderer::UpdateWorldCB(GRAPHICSTHREAD threadID)
@@ -6702,7 +7216,6 @@ wiRenderer::Picked wiRenderer::Pick(RAY& ray, int pickType, const std::string& l
 	std::vector<Picked> pickPoints;
 
 	// pick meshes...
-	CulledCollection culledRenderer;
 	CulledList culledObjects;
 	wiSPTree* searchTree = spTree;
 	if (searchTree != nullptr)
@@ -6901,9 +7414,8 @@ void wiRenderer::RayIntersectMeshes(const RAY& ray, const CulledList& culledObje
 	XMVECTOR& rayOrigin = XMLoadFloat3(&ray.origin);
 	XMVECTOR& rayDirection = XMVector3Normalize(XMLoadFloat3(&ray.direction));
 
-	// pre allocate helper vector array:
-	static size_t _arraySize = 10000;
-	static XMVECTOR* _vertices = (XMVECTOR*)_mm_malloc(sizeof(XMVECTOR)*_arraySize, 16);
+	// helper vector array for deformed meshes, per thread because rays can be intersected in parallel:
+	static thread_local std::vector<XMVECTOR> _vertices;
 
 	for (Cullable* culled : culledObjects)
 	{
@@ -6938,13 +7450,6 @@ void wiRenderer::RayIntersectMeshes(const RAY& ray, const CulledList& culledObje
 		}
 
 		Mesh* mesh = object->mesh;
-		if (mesh->vertices_POS.size() >= _arraySize)
-		{
-			// grow preallocated vector helper array
-			_mm_free(_vertices);
-			_arraySize = (mesh->vertices_POS.size() + 1) * 2;
-			_vertices = (XMVECTOR*)_mm_malloc(sizeof(XMVECTOR)*_arraySize, 16);
-		}
 
 		XMMATRIX objectMat = object->getMatrix();
 		XMMATRIX objectMat_Inverse = XMMatrixInverse(nullptr, objectMat);
@@ -6952,52 +7457,122 @@ void wiRenderer::RayIntersectMeshes(const RAY& ray, const CulledList& culledObje
 		XMVECTOR rayOrigin_local = XMVector3Transform(rayOrigin, objectMat_Inverse);
 		XMVECTOR rayDirection_local = XMVector3Normalize(XMVector3TransformNormal(rayDirection, objectMat_Inverse));
 
-		Mesh::Vertex_FULL _tmpvert;
-
-		if (object->isArmatureDeformed() && !object->mesh->armature->boneCollection.empty())
-		{
-			for (size_t i = 0; i < mesh->vertices_POS.size(); ++i)
+		// Only the closest hit of the object is reported:
+		size_t hitIndex = ~0ull;
+		float hitDistance = FLT_MAX;
+		XMVECTOR p0, p1, p2;
+
+		const bool deformed = (object->isArmatureDeformed() && !mesh->armature->boneCollection.empty()) || mesh->hasDynamicVB();
+		// The hierarchy is only built for meshes that were static when their render data was created (a soft body can be turned off later):
+		if (!deformed && !mesh->bvh.IsEmpty())
+		{
+			// Static vertices are tested with the triangle hierarchy of the mesh:
+			XMFLOAT3 origin, direction;
+			XMStoreFloat3(&origin, rayOrigin_local);
+			XMStoreFloat3(&direction, rayDirection_local);
+			wiMeshBVH::Hit hit;
+			if (mesh->bvh.Intersects(origin, direction, hit))
 			{
-				_tmpvert = TransformVertex(mesh, (int)i);
-				_vertices[i] = XMLoadFloat4(&_tmpvert.pos);
+				hitIndex = hit.triangle * 3;
+				hitDistance = hit.distance;
+				p0 = mesh->vertices_POS[mesh->indices[hitIndex + 0]].LoadPOS();
+				p1 = mesh->vertices_POS[mesh->indices[hitIndex + 1]].LoadPOS();
+				p2 = mesh->vertices_POS[mesh->indices[hitIndex + 2]].LoadPOS();
 			}
 		}
-		else if (mesh->hasDynamicVB())
+		else
 		{
-			for (size_t i = 0; i < mesh->vertices_Transformed_POS.size(); ++i)
+			_vertices.resize(mesh->vertices_POS.size());
+
+			Mesh::Vertex_FULL _tmpvert;
+
+			if (object->isArmatureDeformed() && !object->mesh->armature->boneCollection.empty())
 			{
-				_vertices[i] = mesh->vertices_Transformed_POS[i].LoadPOS();
+				for (size_t i = 0; i < mesh->vertices_POS.size(); ++i)
+				{
+					_tmpvert = TransformVertex(mesh, (int)i);
+					_vertices[i] = XMLoadFloat4(&_tmpvert.pos);
+				}
 			}
-		}
-		else
-		{
-			for (size_t i = 0; i < mesh->vertices_POS.size(); ++i)
+			else if (mesh->hasDynamicVB())
 			{
-				_vertices[i] = mesh->vertices_POS[i].LoadPOS();
+				for (size_t i = 0; i < mesh->vertices_Transformed_POS.size(); ++i)
+				{
+					_vertices[i] = mesh->vertices_Transformed_POS[i].LoadPOS();
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < mesh->vertices_POS.size(); ++i)
+				{
+					_vertices[i] = mesh->vertices_POS[i].LoadPOS();
+				}
 			}
-		}
 
-		for (size_t i = 0; i < mesh->indices.size(); i += 3)
-		{
-			int i0 = mesh->indices[i], i1 = mesh->indices[i + 1], i2 = mesh->indices[i + 2];
-			float distance;
-			if (TriangleTests::Intersects(rayOrigin_local, rayDirection_local, _vertices[i0], _vertices[i1], _vertices[i2], distance))
+			for (size_t i = 0; i < mesh->indices.size(); i += 3)
+			{
+				int i0 = mesh->indices[i], i1 = mesh->indices[i + 1], i2 = mesh->indices[i + 2];
+				float distance;
+				if (TriangleTests::Intersects(rayOrigin_local, rayDirection_local, _vertices[i0], _vertices[i1], _vertices[i2], distance) && distance < hitDistance)
+				{
+					hitIndex = i;
+					hitDistance = distance;
+				}
+			}
+			if (hitIndex != ~0ull)
 			{
-				XMVECTOR& pos = XMVector3Transform(XMVectorAdd(rayOrigin_local, rayDirection_local*distance), objectMat);
-				XMVECTOR& nor = XMVector3TransformNormal(XMVector3Normalize(XMVector3Cross(XMVectorSubtract(_vertices[i2], _vertices[i1]), XMVectorSubtract(_vertices[i1], _vertices[i0]))), objectMat);
-				Picked picked = Picked();
-				picked.transform = object;
-				picked.object = object;
-				XMStoreFloat3(&picked.position, pos);
-				XMStoreFloat3(&picked.normal, nor);
-				picked.distance = wiMath::Distance(pos, rayOrigin);
-				picked.subsetIndex = (int)mesh->vertices_FULL[i0].tex.z;
-				points.push_back(picked);
+				p0 = _vertices[mesh->indices[hitIndex + 0]];
+				p1 = _vertices[mesh->indices[hitIndex + 1]];
+				p2 = _vertices[mesh->indices[hitIndex + 2]];
 			}
 		}
 
+		if (hitIndex != ~0ull)
+		{
+			XMVECTOR& pos = XMVector3Transform(XMVectorAdd(rayOrigin_local, rayDirection_local*hitDistance), objectMat);
+			XMVECTOR& nor = XMVector3TransformNormal(XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p2, p1), XMVectorSubtract(p1, p0))), objectMat);
+			Picked picked = Picked();
+			picked.transform = object;
+			picked.object = object;
+			XMStoreFloat3(&picked.position, pos);
+			XMStoreFloat3(&picked.normal, nor);
+			picked.distance = wiMath::Distance(pos, rayOrigin);
+			picked.subsetIndex = (int)mesh->vertices_FULL[mesh->indices[hitIndex]].tex.z;
+			points.push_back(picked);
+		}
+
 	}
 }
+void wiRenderer::RayIntersectMeshes(const RAY* rays, uint32_t rayCount, Picked* results,
+	int pickType, bool dynamicObjects, const std::string& layer, const std::string& layerDisable, bool onlyVisible)
+{
+	wiSPTree* searchTree = spTree;
+
+	wiJobSystem::context ctx;
+	wiJobSystem::Dispatch(ctx, rayCount, 16, [&](wiJobSystem::JobArgs args) {
+		Picked& result = results[args.jobIndex];
+		result = Picked();
+		if (searchTree == nullptr)
+		{
+			return;
+		}
+
+		RAY ray = rays[args.jobIndex];
+		CulledList culledObjects;
+		std::vector<Picked> points;
+		searchTree->getVisible(ray, culledObjects, wiSPTree::SP_TREE_SORT_NONE);
+		RayIntersectMeshes(ray, culledObjects, points, pickType, dynamicObjects, layer, layerDisable, onlyVisible);
+
+		for (auto& x : points)
+		{
+			if (result.object == nullptr || x.distance < result.distance)
+			{
+				result = x;
+			}
+		}
+	});
+	wiJobSystem::Wait(ctx);
+}
 
 void wiRenderer::CalculateVertexAO(Object* object)
 {
@@ -7112,11 +7687,11 @@ void wiRenderer::LoadDefaultLighting()
 	GetScene().models.push_back(model);
 
 	if (spTree_lights) {
-		spTree_lights->AddObjects(spTree_lights->root, std::vector<Cullable*>(model->lights.begin(), model->lights.end()));
+		spTree_lights->AddObjects(std::vector<Cullable*>(model->lights.begin(), model->lights.end()));
 	}
 	else
 	{
-		spTree_lights = new Octree(std::vector<Cullable*>(model->lights.begin(), model->lights.end()));
+		spTree_lights = new wiSPTree(std::vector<Cullable*>(model->lights.begin(), model->lights.end()));
 	}
 }
 Scene& wiRenderer::GetScene()
@@ -7130,79 +7705,129 @@ Scene& wiRenderer::GetScene()
 
 void wiRenderer::SynchronizeWithPhysicsEngine(float dt)
 {
-	if (physicsEngine && GetGameSpeed())
+	if (physicsEngine == nullptr)
 	{
-		physicsEngine->addWind(GetScene().wind.direction);
+		return;
+	}
 
-		// Update physics world data
+	// Register the objects with physics attributes that don't exist in the simulation.
+	//	The scene is only searched for them when it was requested, everything else visits only the registered objects:
+	if (physicsEngine->ConsumeRegistrationRequest())
+	{
 		for (Model* model : GetScene().models)
 		{
-			for (Object* object : model->objects) 
+			for (Object* object : model->objects)
 			{
-				Mesh* mesh = object->mesh;
-				int pI = object->physicsObjectID;
-
-				if (pI < 0 && (object->rigidBody || mesh->softBody))
+				if (object->physicsObjectID < 0 && (object->rigidBody || object->mesh->softBody))
 				{
-					// Register the objects with physics attributes that doesn't exist in the simulation
 					physicsEngine->registerObject(object);
 				}
+			}
+		}
+	}
+
+	if (physicsThreadEnabled && !physicsEngine->IsThreaded())
+	{
+		physicsEngine->StartThread();
+	}
 
-				if (pI >= 0) 
+	const vector<Object*>& physicsObjects = physicsEngine->GetObjects();
+
+	// Update physics world data
+	PHYSICS::Input input;
+	input.paused = GetGameSpeed() == 0;
+	input.wind = GetScene().wind.direction;
+	for (Object* object : physicsObjects)
+	{
+		if (object == nullptr)
+		{
+			continue;
+		}
+		Mesh* mesh = object->mesh;
+		int pI = object->physicsObjectID;
+
+		if (mesh->softBody) 
+		{
+			int gvg = mesh->goalVG;
+			if (gvg >= 0)
+			{
+				XMMATRIX worldMat = mesh->hasArmature() ? XMMatrixIdentity() : XMLoadFloat4x4(&object->world);
+				const VertexGroup& group = mesh->vertexGroups[gvg];
+				for (size_t j = 0; j < group.indices.size(); ++j)
 				{
-					if (mesh->softBody) 
-					{
-						int gvg = mesh->goalVG;
-						if (gvg >= 0)
-						{
-							XMMATRIX worldMat = mesh->hasArmature() ? XMMatrixIdentity() : XMLoadFloat4x4(&object->world);
-							int j = 0;
-							for (std::map<int, float>::iterator it = mesh->vertexGroups[gvg].vertices.begin(); it != mesh->vertexGroups[gvg].vertices.end(); ++it)
-							{
-								int vi = (*it).first;
-								Mesh::Vertex_FULL tvert = TransformVertex(mesh, vi, worldMat);
-								mesh->goalPositions[j] = XMFLOAT3(tvert.pos.x, tvert.pos.y, tvert.pos.z);
-								mesh->goalNormals[j] = XMFLOAT3(tvert.nor.x, tvert.nor.y, tvert.nor.z);
-								++j;
-							}
-						}
-						physicsEngine->connectSoftBodyToVertices(
-							object->mesh, pI
-							);
-					}
-					if (object->kinematic && object->rigidBody)
-					{
-						physicsEngine->transformBody(object->rotation, object->translation, pI);
-					}
+					Mesh::Vertex_FULL tvert = TransformVertex(mesh, group.indices[j], worldMat);
+					mesh->goalPositions[j] = XMFLOAT3(tvert.pos.x, tvert.pos.y, tvert.pos.z);
+					mesh->goalNormals[j] = XMFLOAT3(tvert.nor.x, tvert.nor.y, tvert.nor.z);
 				}
+				// the simulation gets a copy, the mesh can be updated again while it's stepping
+				input.softBodyGoals.push_back(make_pair(pI, mesh->goalPositions));
 			}
 		}
+		if (object->kinematic && object->rigidBody)
+		{
+			input.kinematicBodies.push_back(make_pair(pI, PHYSICS::PhysicsTransform(object->rotation, object->translation)));
+		}
+	}
+	physicsEngine->SetInput(move(input));
 
-		// Run physics simulation
-		physicsEngine->Update(dt);
+	// Run physics simulation
+	if (!physicsEngine->IsThreaded() && GetGameSpeed())
+	{
+		physicsEngine->Step(dt);
+	}
 
-		// Retrieve physics simulation data
-		for (Model* model : GetScene().models)
+	// Retrieve physics simulation data, interpolated between the last two simulation steps
+	physicsEngine->MarkForRead();
+	const float interpolation = physicsEngine->GetInterpolationFactor();
+	for (Object* object : physicsObjects)
+	{
+		if (object == nullptr || object->kinematic || !(object->rigidBody || object->mesh->softBody))
 		{
-			for (Object* object : model->objects) {
-				int pI = object->physicsObjectID;
-				if (pI >= 0 && !object->kinematic && (object->rigidBody || object->mesh->softBody)) {
-					PHYSICS::PhysicsTransform* transform(physicsEngine->getObject(pI));
-					object->translation_rest = transform->position;
-					object->rotation_rest = transform->rotation;
-
-					if (object->mesh->softBody) {
-						object->scale_rest = XMFLOAT3(1, 1, 1);
-						physicsEngine->connectVerticesToSoftBody(
-							object->mesh, pI
-							);
-					}
-				}
-			}
+			continue;
+		}
+		int pI = object->physicsObjectID;
+
+		PHYSICS::PhysicsTransform transform;
+		if (physicsEngine->GetInterpolatedTransform(pI, transform))
+		{
+			object->translation_rest = transform.position;
+			object->rotation_rest = transform.rotation;
 		}
 
+		Mesh* mesh = object->mesh;
+		const PHYSICS::SoftBodyState* previous;
+		const PHYSICS::SoftBodyState* latest;
+		if (mesh->softBody && physicsEngine->GetInterpolatedSoftBody(pI, previous, latest))
+		{
+			object->scale_rest = XMFLOAT3(1, 1, 1);
+			mesh->aabb.create(latest->aabbMin, latest->aabbMax);
 
-		physicsEngine->NextRunWorld();
+			for (size_t i = 0; i < mesh->vertices_POS.size(); ++i)
+			{
+				const int indexP = mesh->physicalmapGP[i];
+				if (indexP < 0 || indexP >= (int)latest->positions.size())
+				{
+					continue;
+				}
+				XMFLOAT3 pos, nor;
+				XMStoreFloat3(&pos, XMVectorLerp(XMLoadFloat3(&previous->positions[indexP]), XMLoadFloat3(&latest->positions[indexP]), interpolation));
+				XMStoreFloat3(&nor, XMVector3Normalize(XMVectorLerp(XMLoadFloat3(&previous->normals[indexP]), XMLoadFloat3(&latest->normals[indexP]), interpolation)));
+				mesh->vertices_Transformed_PRE[i].pos = mesh->vertices_Transformed_POS[i].pos;
+				mesh->vertices_Transformed_POS[i].pos.x = pos.x;
+				mesh->vertices_Transformed_POS[i].pos.y = pos.y;
+				mesh->vertices_Transformed_POS[i].pos.z = pos.z;
+				mesh->vertices_Transformed_POS[i].NORWINDFromFloat(nor, 0);
+			}
+		}
+	}
+	physicsEngine->UnMarkForRead();
+}
+void wiRenderer::SetPhysicsThreadEnabled(bool value)
+{
+	physicsThreadEnabled = value;
+	if (!value && physicsEngine != nullptr)
+	{
+		physicsEngine->StopThread();
 	}
 }
 
@@ -7389,6 +8014,11 @@ void wiRenderer::AddModel(Model* model)
 {
 	GetScene().AddModel(model);
 
+	if (physicsEngine != nullptr)
+	{
+		physicsEngine->RequestRegistration();
+	}
+
 	FixedUpdate();
 
 	// add object batch 
@@ -7396,11 +8026,11 @@ void wiRenderer::AddModel(Model* model)
 		vector<Cullable*> collection(model->objects.begin(), model->objects.end());
 		if (spTree != nullptr)
 		{
-			spTree->AddObjects(spTree->root, collection);
+			spTree->AddObjects(collection);
 		}
 		else
 		{
-			spTree = new Octree(collection);
+			spTree = new wiSPTree(collection);
 		}
 	}
 
@@ -7409,11 +8039,11 @@ void wiRenderer::AddModel(Model* model)
 		vector<Cullable*> collection(model->lights.begin(), model->lights.end());
 		if (spTree_lights != nullptr)
 		{
-			spTree_lights->AddObjects(spTree_lights->root, collection);
+			spTree_lights->AddObjects(collection);
 		}
 		else
 		{
-			spTree_lights = new Octree(collection);
+			spTree_lights = new wiSPTree(collection);
 		}
 	}
 
@@ -7429,15 +8059,20 @@ void wiRenderer::Add(Object* value)
 		value->attachTo(GetScene().GetWorldNode());
 	}
 
+	if (physicsEngine != nullptr)
+	{
+		physicsEngine->RequestRegistration();
+	}
+
 	vector<Cullable*> collection(0);
 	collection.push_back(value);
 	if (spTree != nullptr) 
 	{
-		spTree->AddObjects(spTree->root, collection);
+		spTree->AddObjects(collection);
 	}
 	else
 	{
-		spTree = new Octree(collection);
+		spTree = new wiSPTree(collection);
 	}
 }
 void wiRenderer::Add(Light* value)
@@ -7452,11 +8087,11 @@ void wiRenderer::Add(Light* value)
 	collection.push_back(value);
 	if (spTree_lights != nullptr) 
 	{
-		spTree_lights->AddObjects(spTree_lights->root, collection);
+		spTree_lights->AddObjects(collection);
 	}
 	else
 	{
-		spTree_lights = new Octree(collection);
+		spTree_lights = new wiSPTree(collection);
 	}
 }
 void wiRenderer::Add(ForceField* value)
@@ -7480,6 +8115,12 @@ void wiRenderer::Remove(Object* value)
 {
 	if (value != nullptr)
 	{
+		// The physics engine keeps a pointer to the registered objects, the object might be deleted after this:
+		if (physicsEngine != nullptr && value->physicsObjectID >= 0)
+		{
+			physicsEngine->removeObject(value);
+		}
+		GetScene().Unregister(value);
 		for (auto& x : GetScene().models)
 		{
 			x->objects.erase(value);
@@ -7492,6 +8133,7 @@ void wiRenderer::Remove(Light* value)
 {
 	if (value != nullptr)
 	{
+		GetScene().Unregister(value);
 		for (auto& x : GetScene().models)
 		{
 			x->lights.erase(value);
@@ -7504,6 +8146,12 @@ void wiRenderer::Remove(Decal* value)
 {
 	if (value != nullptr)
 	{
+		if (value->texture != nullptr)
+		{
+			// The texture might be deleted with the decal, and an other one created at its address:
+			decalAtlasEvictions.push_back(make_pair(value->texture, value->texture->GetUniqueID()));
+		}
+		GetScene().Unregister(value);
 		for (auto& x : GetScene().models)
 		{
 			x->decals.erase(value);
@@ -7515,6 +8163,7 @@ void wiRenderer::Remove(EnvironmentProbe* value)
 {
 	if (value != nullptr)
 	{
+		GetScene().Unregister(value);
 		for (auto& x : GetScene().models)
 		{
 			x->environmentProbes.remove(value);
@@ -7526,6 +8175,7 @@ void wiRenderer::Remove(ForceField* value)
 {
 	if (value != nullptr)
 	{
+		GetScene().Unregister(value);
 		for (auto& x : GetScene().models)
 		{
 			x->forces.erase(value);
@@ -7537,6 +8187,7 @@ void wiRenderer::Remove(Camera* value)
 {
 	if (value != nullptr)
 	{
+		GetScene().Unregister(value);
 		for (auto& x : GetScene().models)
 		{
 			x->cameras.remove(value);
@@ -7554,15 +8205,19 @@ void wiRenderer::SetOcclusionCullingEnabled(bool value)
 	{
 		initialized = true;
 
+		// The frame ring is managed by the renderer, so the queries themselves don't need latency:
 		GPUQueryDesc desc;
 		desc.Type = GPU_QUERY_TYPE_OCCLUSION_PREDICATE;
 		desc.MiscFlags = 0;
-		desc.async_latency = 1;
+		desc.async_latency = 0;
 
-		for (int i = 0; i < ARRAYSIZE(occlusionQueries); ++i)
+		for (int frame = 0; frame < ARRAYSIZE(occlusionQueryFrames); ++frame)
 		{
-			wiRenderer::GetDevice()->CreateQuery(&desc, &occlusionQueries[i]);
-			occlusionQueries[i].result_passed = TRUE;
+			for (int i = 0; i < OCCLUSION_QUERY_COUNT; ++i)
+			{
+				wiRenderer::GetDevice()->CreateQuery(&desc, &occlusionQueryFrames[frame].queries[i]);
+				occlusionQueryFrames[frame].queries[i].result_passed = TRUE;
+			}
 		}
 	}
 
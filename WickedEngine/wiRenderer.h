@@ -7,6 +7,7 @@
 #include "wiWindowRegistration.h"
 
 #include <unordered_set>
+#include <unordered_map>
 
 struct Transform;
 struct Vertex;
@@ -279,6 +280,7 @@ protected:
 	static bool occlusionCulling;
 	static bool temporalAA, temporalAADEBUG;
 	static bool freezeCullingCamera;
+	static bool physicsThreadEnabled;
 
 	struct VoxelizedSceneData
 	{
@@ -299,7 +301,18 @@ protected:
 		{}
 	} static voxelSceneData;
 
-	static wiGraphicsTypes::GPUQuery occlusionQueries[256];
+	// The occlusion queries are used as a ring of frames. The results of a frame are read OCCLUSION_QUERY_LATENCY frames after it was rendered,
+	//	when they are most likely available, so the CPU never has to wait for the GPU. Objects without a result are treated as visible.
+	static const int OCCLUSION_QUERY_LATENCY = 2;
+	static const int OCCLUSION_QUERY_COUNT = 256;
+	struct OcclusionQueryFrame
+	{
+		wiGraphicsTypes::GPUQuery queries[OCCLUSION_QUERY_COUNT];
+		const Object* owners[OCCLUSION_QUERY_COUNT]; // only compared, never dereferenced: the object could be deleted before the result arrives
+		int count = 0;
+	};
+	static OcclusionQueryFrame occlusionQueryFrames[OCCLUSION_QUERY_LATENCY + 1];
+	static int occlusionQueryFrame;
 
 	static UINT entityArrayOffset_Lights, entityArrayCount_Lights;
 	static UINT entityArrayOffset_Decals, entityArrayCount_Decals;
@@ -308,6 +321,8 @@ protected:
 
 public:
 	static std::string SHADERPATH;
+	// File of the persistent pipeline cache, it is loaded at startup and saved after the shaders were (re)loaded. Empty to disable.
+	static std::string PIPELINECACHEPATH;
 
 	wiRenderer();
 	void CleanUp();
@@ -418,19 +433,21 @@ public:
 	struct FrameCulling
 	{
 		Frustum frustum;
+		CulledList culledObjects;
 		CulledCollection culledRenderer;
 		CulledCollection culledRenderer_opaque;
 		CulledCollection culledRenderer_transparent;
 		std::vector<wiHairParticle*> culledHairParticleSystems;
 		CulledList culledLights;
-		std::list<Decal*> culledDecals;
-		std::list<EnvironmentProbe*> culledEnvProbes;
+		std::vector<Decal*> culledDecals;
+		std::vector<EnvironmentProbe*> culledEnvProbes;
 
 		void Clear()
 		{
-			culledRenderer.clear();
-			culledRenderer_opaque.clear();
-			culledRenderer_transparent.clear();
+			culledObjects.clear();
+			culledRenderer.Clear();
+			culledRenderer_opaque.Clear();
+			culledRenderer_transparent.Clear();
 			culledHairParticleSystems.clear();
 			culledLights.clear();
 			culledDecals.clear();
@@ -439,6 +456,31 @@ public:
 	};
 	static std::unordered_map<Camera*, FrameCulling> frameCullings;
 
+	// Draw submission statistics of RenderMeshes for one pass (SHADERTYPE)
+	struct DrawCallStats
+	{
+		uint32_t drawsIssued = 0;
+		uint32_t bindsIssued = 0;
+		uint32_t bindsSaved = 0; // state bindings skipped because the previous draw already set them
+	};
+	static DrawCallStats drawCallStats[SHADERTYPE_COUNT];
+	// Statistics of the last presented frame
+	static const DrawCallStats& GetDrawCallStats(SHADERTYPE shaderType) { return drawCallStats[shaderType]; }
+
+	// Work done by ManageDecalAtlas in the last frame
+	struct DecalAtlasStats
+	{
+		uint32_t textures = 0; // decal textures currently in the atlas
+		uint32_t uploads = 0; // textures copied into the atlas
+		uint32_t evictions = 0;
+		uint32_t defragmentations = 0;
+		uint32_t resizes = 0;
+		float updateMilliseconds = 0; // CPU time of ManageDecalAtlas
+		uint64_t memoryBytes = 0; // size of the atlas texture with all of its mips
+	};
+	static DecalAtlasStats decalAtlasStats;
+	static const DecalAtlasStats& GetDecalAtlasStats() { return decalAtlasStats; }
+
 	inline static XMUINT3 GetEntityCullingTileCount()
 	{
 		return XMUINT3(
@@ -459,6 +501,7 @@ public:
 	static void UpdateGBuffer(wiGraphicsTypes::Texture2D* slot0, wiGraphicsTypes::Texture2D* slot1, wiGraphicsTypes::Texture2D* slot2, wiGraphicsTypes::Texture2D* slot3, wiGraphicsTypes::Texture2D* slot4, GRAPHICSTHREAD threadID);
 	static void UpdateDepthBuffer(wiGraphicsTypes::Texture2D* depth, wiGraphicsTypes::Texture2D* linearDepth, GRAPHICSTHREAD threadID);
 	
+	// Draws the culled mesh batches. The subset draws are sorted by (pass, PSO, material, mesh, depth) keys, and state that the previous draw already bound is not bound again
 	static void RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culledRenderer, SHADERTYPE shaderType, UINT renderTypeFlags, GRAPHICSTHREAD threadID, bool tessellation = false, bool occlusionCulling = false);
 	static void DrawSky(GRAPHICSTHREAD threadID);
 	static void DrawSun(GRAPHICSTHREAD threadID);
@@ -510,6 +553,8 @@ public:
 	static void GenerateClouds(wiGraphicsTypes::Texture2D* dst, UINT refinementCount, float randomness, GRAPHICSTHREAD threadID);
 
 	static void ManageDecalAtlas(GRAPHICSTHREAD threadID);
+	// Textures of the removed decals with their unique IDs, they are evicted from the atlas in the next ManageDecalAtlas
+	static std::vector<std::pair<wiGraphicsTypes::Texture2D*, uint64_t>> decalAtlasEvictions;
 	
 	static XMVECTOR GetSunPosition();
 	static XMFLOAT4 GetSunColor();
@@ -600,10 +645,17 @@ public:
 	static RAY getPickRay(long cursorX, long cursorY);
 	static void RayIntersectMeshes(const RAY& ray, const CulledList& culledObjects, std::vector<Picked>& points,
 		int pickType = PICK_OPAQUE, bool dynamicObjects = true, const std::string& layer = "", const std::string& layerDisable = "", bool onlyVisible = false);
+	// Find the closest mesh hit for many rays at once, they are processed in parallel on the job system. Missed rays get an empty result (object is nullptr).
+	static void RayIntersectMeshes(const RAY* rays, uint32_t rayCount, Picked* results,
+		int pickType = PICK_OPAQUE, bool dynamicObjects = true, const std::string& layer = "", const std::string& layerDisable = "", bool onlyVisible = false);
 	static void CalculateVertexAO(Object* object);
 
 	static PHYSICS* physicsEngine;
+	// Exchange data with the physics engine. With the physics thread, the simulation runs at a fixed rate on its own thread (dt is not used then),
+	//	and the physics objects are interpolated between its last two states. Otherwise the simulation is stepped here with dt.
 	static void SynchronizeWithPhysicsEngine(float dt = 1.0f / 60.0f);
+	static void SetPhysicsThreadEnabled(bool value);
+	static bool GetPhysicsThreadEnabled() { return physicsThreadEnabled; }
 
 	static wiOcean* ocean;
 	static void SetOceanEnabled(bool enabled, const wiOceanParameter& params);
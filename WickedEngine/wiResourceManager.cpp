@@ -4,6 +4,7 @@
 #include "wiHelper.h"
 #include "wiTGATextureLoader.h"
 #include "wiTextureHelper.h"
+#include "wiJobSystem.h"
 
 using namespace std;
 using namespace wiGraphicsTypes;
@@ -63,180 +64,265 @@ const wiResourceManager::Resource* wiResourceManager::get(const wiHashString& na
 	return nullptr;
 }
 
-void* wiResourceManager::add(const wiHashString& name, Data_Type newType
-	, VertexLayoutDesc* vertexLayoutDesc, UINT elementCount)
+bool wiResourceManager::GetType(const std::string& nameStr, Data_Type newType, Data_Type& type)
 {
+	if (newType != Data_Type::DYNAMIC)
+	{
+		type = newType;
+		return true;
+	}
+
+	// dynamic type selection:
+	string ext = wiHelper::toUpper(nameStr.substr(nameStr.length() - 3, nameStr.length()));
+	bool found = false;
+
+	LOCK_STATIC();
 	if (types.empty())
+	{
 		SetUp();
-
-	const Resource* res = get(name,true);
-	if(!res)
+	}
+	filetypes::iterator it = types.find(ext);
+	if (it != types.end())
 	{
-		string nameStr = name.GetString();
-		string ext = wiHelper::toUpper(nameStr.substr(nameStr.length() - 3, nameStr.length()));
-		Data_Type type;
-
-		// dynamic type selection:
-		if(newType==Data_Type::DYNAMIC){
-			filetypes::iterator it = types.find(ext);
-			if(it!=types.end())
-				type = it->second;
-			else 
-				return nullptr;
-		}
-		else 
-			type = newType;
+		type = it->second;
+		found = true;
+	}
+	UNLOCK_STATIC();
 
-		void* success = nullptr;
+	return found;
+}
 
-		LOCK();
+void* wiResourceManager::Load(const std::string& nameStr, Data_Type type
+	, VertexLayoutDesc* vertexLayoutDesc, UINT elementCount)
+{
+	string ext = wiHelper::toUpper(nameStr.substr(nameStr.length() - 3, nameStr.length()));
+	void* success = nullptr;
 
-		switch(type){
-		case Data_Type::IMAGE:
-		{
-			Texture2D* image = nullptr;
+	switch(type){
+	case Data_Type::IMAGE:
+	{
+		Texture2D* image = nullptr;
 
-			if (ext.compare("TGA") == 0)
-			{
-				wiTGATextureLoader loader;
-				loader.load(nameStr);
-				image = new Texture2D;
-				HRESULT hr = wiTextureHelper::CreateTexture(image, loader.texels, (UINT)loader.header.width, (UINT)loader.header.height, 4);
-				if (FAILED(hr))
-				{
-					SAFE_DELETE(image);
-				}
-			}
-			else
+		if (ext.compare("TGA") == 0)
+		{
+			wiTGATextureLoader loader;
+			loader.load(nameStr);
+			image = new Texture2D;
+			HRESULT hr = wiTextureHelper::CreateTexture(image, loader.texels, (UINT)loader.header.width, (UINT)loader.header.height, 4);
+			if (FAILED(hr))
 			{
-				wiRenderer::GetDevice()->CreateTextureFromFile(nameStr.c_str(), &image, true, GRAPHICSTHREAD_IMMEDIATE);
+				SAFE_DELETE(image);
 			}
-
-			success = image;
 		}
-		break;
-		case Data_Type::SOUND:
-		{
-			success = new wiSoundEffect(name.GetString());
-		}
-		break;
-		case Data_Type::MUSIC:
+		else
 		{
-			success = new wiMusic(name.GetString());
+			wiRenderer::GetDevice()->CreateTextureFromFile(nameStr.c_str(), &image, true, GRAPHICSTHREAD_IMMEDIATE);
 		}
-		break;
-		case Data_Type::VERTEXSHADER:
+
+		success = image;
+	}
+	break;
+	case Data_Type::SOUND:
+	{
+		success = new wiSoundEffect(nameStr);
+	}
+	break;
+	case Data_Type::MUSIC:
+	{
+		success = new wiMusic(nameStr);
+	}
+	break;
+	case Data_Type::VERTEXSHADER:
+	{
+		BYTE* buffer;
+		size_t bufferSize;
+		if (wiHelper::readByteData(nameStr, &buffer, bufferSize))
 		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(name.GetString(), &buffer, bufferSize))
-			{
-				VertexShaderInfo* vertexShaderInfo = new VertexShaderInfo;
-				vertexShaderInfo->vertexShader = new VertexShader;
-				vertexShaderInfo->vertexLayout = new VertexLayout;
-				wiRenderer::GetDevice()->CreateVertexShader(buffer, bufferSize, vertexShaderInfo->vertexShader);
-				if (vertexLayoutDesc != nullptr && elementCount > 0)
-				{
-					wiRenderer::GetDevice()->CreateInputLayout(vertexLayoutDesc, elementCount, buffer, bufferSize, vertexShaderInfo->vertexLayout);
-				}
-				success = vertexShaderInfo;
-				delete[] buffer;
-			}
-			else
+			VertexShaderInfo* vertexShaderInfo = new VertexShaderInfo;
+			vertexShaderInfo->vertexShader = new VertexShader;
+			vertexShaderInfo->vertexLayout = new VertexLayout;
+			wiRenderer::GetDevice()->CreateVertexShader(buffer, bufferSize, vertexShaderInfo->vertexShader);
+			if (vertexLayoutDesc != nullptr && elementCount > 0)
 			{
-				success = nullptr;
+				wiRenderer::GetDevice()->CreateInputLayout(vertexLayoutDesc, elementCount, buffer, bufferSize, vertexShaderInfo->vertexLayout);
 			}
+			success = vertexShaderInfo;
+			delete[] buffer;
 		}
-		break;
-		case Data_Type::PIXELSHADER:
+		else
 		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
-				PixelShader* shader = new PixelShader;
-				wiRenderer::GetDevice()->CreatePixelShader(buffer, bufferSize, shader);
-				delete[] buffer;
-				success = shader;
-			}
-			else{
-				success = nullptr;
-			}
+			success = nullptr;
 		}
-		break;
-		case Data_Type::GEOMETRYSHADER:
-		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
-				GeometryShader* shader = new GeometryShader;
-				wiRenderer::GetDevice()->CreateGeometryShader(buffer, bufferSize, shader);
-				delete[] buffer;
-				success = shader;
-			}
-			else{
-				success = nullptr;
-			}
+	}
+	break;
+	case Data_Type::PIXELSHADER:
+	{
+		BYTE* buffer;
+		size_t bufferSize;
+		if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
+			PixelShader* shader = new PixelShader;
+			wiRenderer::GetDevice()->CreatePixelShader(buffer, bufferSize, shader);
+			delete[] buffer;
+			success = shader;
 		}
-		break;
-		case Data_Type::HULLSHADER:
-		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
-				HullShader* shader = new HullShader;
-				wiRenderer::GetDevice()->CreateHullShader(buffer, bufferSize, shader);
-				delete[] buffer;
-				success = shader;
-			}
-			else{
-				success = nullptr;
-			}
+		else{
+			success = nullptr;
 		}
-		break;
-		case Data_Type::DOMAINSHADER:
-		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
-				DomainShader* shader = new DomainShader;
-				wiRenderer::GetDevice()->CreateDomainShader(buffer, bufferSize, shader);
-				delete[] buffer;
-				success = shader;
-			}
-			else{
-				success = nullptr;
-			}
+	}
+	break;
+	case Data_Type::GEOMETRYSHADER:
+	{
+		BYTE* buffer;
+		size_t bufferSize;
+		if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
+			GeometryShader* shader = new GeometryShader;
+			wiRenderer::GetDevice()->CreateGeometryShader(buffer, bufferSize, shader);
+			delete[] buffer;
+			success = shader;
 		}
-		break;
-		case Data_Type::COMPUTESHADER:
-		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(nameStr, &buffer, bufferSize)) {
-				ComputeShader* shader = new ComputeShader;
-				wiRenderer::GetDevice()->CreateComputeShader(buffer, bufferSize, shader);
-				delete[] buffer;
-				success = shader;
-			}
-			else {
-				success = nullptr;
-			}
+		else{
+			success = nullptr;
+		}
+	}
+	break;
+	case Data_Type::HULLSHADER:
+	{
+		BYTE* buffer;
+		size_t bufferSize;
+		if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
+			HullShader* shader = new HullShader;
+			wiRenderer::GetDevice()->CreateHullShader(buffer, bufferSize, shader);
+			delete[] buffer;
+			success = shader;
+		}
+		else{
+			success = nullptr;
+		}
+	}
+	break;
+	case Data_Type::DOMAINSHADER:
+	{
+		BYTE* buffer;
+		size_t bufferSize;
+		if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
+			DomainShader* shader = new DomainShader;
+			wiRenderer::GetDevice()->CreateDomainShader(buffer, bufferSize, shader);
+			delete[] buffer;
+			success = shader;
+		}
+		else{
+			success = nullptr;
+		}
+	}
+	break;
+	case Data_Type::COMPUTESHADER:
+	{
+		BYTE* buffer;
+		size_t bufferSize;
+		if (wiHelper::readByteData(nameStr, &buffer, bufferSize)) {
+			ComputeShader* shader = new ComputeShader;
+			wiRenderer::GetDevice()->CreateComputeShader(buffer, bufferSize, shader);
+			delete[] buffer;
+			success = shader;
+		}
+		else {
+			success = nullptr;
 		}
+	}
+	break;
+	default:
+		success=nullptr;
 		break;
-		default:
-			success=nullptr;
-			break;
-		};
+	};
+
+	return success;
+}
+
+void* wiResourceManager::add(const wiHashString& name, Data_Type newType
+	, VertexLayoutDesc* vertexLayoutDesc, UINT elementCount)
+{
+	// The load job is started on the calling thread's queue, so waiting for it will usually execute it right here:
+	return addAsync(name, newType, vertexLayoutDesc, elementCount).Get();
+}
 
-		if (success)
-			resources.insert(pair<wiHashString, Resource*>(name, new Resource(success, type)));
+wiResourceManager::LoadHandle wiResourceManager::addAsync(const wiHashString& name, Data_Type newType
+	, VertexLayoutDesc* vertexLayoutDesc, UINT elementCount)
+{
+	LoadHandle handle;
 
+	Data_Type type;
+	if (!GetType(name.GetString(), newType, type))
+	{
+		return handle;
+	}
+
+	LOCK();
+
+	container::iterator it = resources.find(name);
+	if (it != resources.end())
+	{
+		it->second->refCount++;
+		handle.request = make_shared<LoadRequest>();
+		handle.request->data = it->second->data;
 		UNLOCK();
+		return handle;
+	}
 
-		return success;
+	auto pending = loading.find(name);
+	if (pending != loading.end())
+	{
+		// An other request is already loading this resource, share its result instead of loading it again:
+		pending->second->refCount++;
+		handle.request = pending->second;
+		UNLOCK();
+		return handle;
 	}
 
-	return res->data;
+	shared_ptr<LoadRequest> request = make_shared<LoadRequest>();
+	loading.insert(make_pair(name, request));
+	handle.request = request;
+
+	// The vertex layout is only valid for the duration of this call, so it is copied for the job:
+	vector<VertexLayoutDesc> layout;
+	if (vertexLayoutDesc != nullptr)
+	{
+		layout.assign(vertexLayoutDesc, vertexLayoutDesc + elementCount);
+	}
+
+	// The job is started while the lock is still held, so requests arriving after the unlock always find it in progress:
+	wiJobSystem::Execute(request->ctx, [this, name, type, request, layout](wiJobSystem::JobArgs args) {
+		void* data = Load(name.GetString(), type, layout.empty() ? nullptr : (VertexLayoutDesc*)layout.data(), (UINT)layout.size());
+
+		// Only publishing the finished resource needs the lock:
+		LOCK();
+		if (data != nullptr)
+		{
+			Resource* resource = new Resource(data, type);
+			resource->refCount = request->refCount;
+			resources.insert(pair<wiHashString, Resource*>(name, resource));
+		}
+		request->data = data;
+		loading.erase(name);
+		UNLOCK();
+	});
+
+	UNLOCK();
+
+	return handle;
+}
+
+bool wiResourceManager::LoadHandle::IsReady() const
+{
+	return request == nullptr || !wiJobSystem::IsBusy(request->ctx);
+}
+void* wiResourceManager::LoadHandle::Get() const
+{
+	if (request == nullptr)
+	{
+		return nullptr;
+	}
+	wiJobSystem::Wait(request->ctx);
+	return request->data;
 }
 
 bool wiResourceManager::del(const wiHashString& name, bool forceDelete)
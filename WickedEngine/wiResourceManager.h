@@ -3,9 +3,11 @@
 #include "wiThreadSafeManager.h"
 #include "wiGraphicsAPI.h"
 #include "wiHashString.h"
+#include "wiJobSystem.h"
 
 #include <map>
 #include <unordered_map>
+#include <memory>
 
 class wiSound;
 
@@ -38,12 +40,37 @@ public:
 	typedef std::unordered_map<wiHashString, Resource*> container;
 	container resources;
 
+	// State of a resource load, shared by all requests of the same resource
+	struct LoadRequest
+	{
+		wiJobSystem::context ctx;
+		void* data = nullptr;
+		long refCount = 1; // number of requests while loading, becomes the refCount of the resource
+	};
+
+	// Returned by addAsync, refers to a resource that might still be loading
+	class LoadHandle
+	{
+		friend class wiResourceManager;
+		std::shared_ptr<LoadRequest> request;
+	public:
+		bool IsReady() const;
+		// Wait until the resource is loaded (the waiting thread helps executing jobs). Returns nullptr if it failed to load.
+		void* Get() const;
+	};
+
 protected:
 typedef std::map<std::string,Data_Type> filetypes;
 static filetypes types;
 static wiResourceManager* globalResources;
 static void SetUp();
 
+// resources that are currently loading
+std::unordered_map<wiHashString, std::shared_ptr<LoadRequest>> loading;
+
+static bool GetType(const std::string& nameStr, Data_Type newType, Data_Type& type);
+static void* Load(const std::string& nameStr, Data_Type type, wiGraphicsTypes::VertexLayoutDesc* vertexLayoutDesc, UINT elementCount);
+
 
 public:
 	wiResourceManager();
@@ -55,6 +82,9 @@ public:
 	//specify datatype for shaders
 	void* add(const wiHashString& name, Data_Type newType = Data_Type::DYNAMIC
 		, wiGraphicsTypes::VertexLayoutDesc* vertexLayoutDesc = nullptr, UINT elementCount = 0);
+	// Start loading the resource on the job system and return immediately. Concurrent requests of the same resource are served by a single load.
+	LoadHandle addAsync(const wiHashString& name, Data_Type newType = Data_Type::DYNAMIC
+		, wiGraphicsTypes::VertexLayoutDesc* vertexLayoutDesc = nullptr, UINT elementCount = 0);
 	bool del(const wiHashString& name, bool forceDelete = false);
 	bool CleanUp();
 };
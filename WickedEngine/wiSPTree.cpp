@@ -3,372 +3,736 @@
 #include "wiLoader.h"
 #include "wiFrustum.h"
 
-#define SP_TREE_MAX_DEPTH 12
-#define SP_TREE_OBJECT_PER_NODE 6
-#define SP_TREE_BOX_CONTAIN
+#include <algorithm>
 
+#define SP_TREE_SAH_BINS 16
+#define SP_TREE_MAX_SAH_DEPTH 20
+#define SP_TREE_STACK_SIZE 128
+#define SP_TREE_REBUILD_RATIO 2.0f
 
-wiSPTree::wiSPTree()
+using namespace std;
+
+namespace wiSPTree_Internal
 {
-	childCount = 0;
-	root=nullptr;
+	inline float HalfArea(const XMFLOAT3& _min, const XMFLOAT3& _max)
+	{
+		if (_min.x > _max.x || _min.y > _max.y || _min.z > _max.z)
+		{
+			return 0;
+		}
+		const float x = _max.x - _min.x;
+		const float y = _max.y - _min.y;
+		const float z = _max.z - _min.z;
+		return x * y + y * z + z * x;
+	}
+	inline float GetAxis(const XMFLOAT3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+	inline float GetLane(const XMFLOAT4A& v, int lane)
+	{
+		return (&v.x)[lane];
+	}
+	inline void SetLane(XMFLOAT4A& v, int lane, float value)
+	{
+		(&v.x)[lane] = value;
+	}
+	// Non-negative floats keep their order when compared as unsigned integers
+	inline uint32_t FloatToSortKey(float value)
+	{
+		value = max(0.0f, value);
+		uint32_t key;
+		memcpy(&key, &value, sizeof(key));
+		return key;
+	}
+	inline float HorizontalMin(FXMVECTOR v)
+	{
+		const XMVECTOR m = XMVectorMin(v, XMVectorSwizzle<1, 0, 3, 2>(v));
+		return XMVectorGetX(XMVectorMin(m, XMVectorSwizzle<2, 3, 0, 1>(m)));
+	}
+	inline float HorizontalMax(FXMVECTOR v)
+	{
+		const XMVECTOR m = XMVectorMax(v, XMVectorSwizzle<1, 0, 3, 2>(v));
+		return XMVectorGetX(XMVectorMax(m, XMVectorSwizzle<2, 3, 0, 1>(m)));
+	}
+}
+using namespace wiSPTree_Internal;
+
+
+wiSPTree::wiSPTree(const std::vector<Cullable*>& objects) :objects(objects)
+{
+	Build();
 }
 
 wiSPTree::~wiSPTree()
 {
-	SAFE_DELETE(root);
 }
 
-void wiSPTree::initialize(const std::vector<Cullable*>& objects, const XMFLOAT3& newMin, const XMFLOAT3& newMax) {
-	XMFLOAT3 min = newMin;
-	XMFLOAT3 max = newMax;
+void wiSPTree::Build()
+{
+	nodes.clear();
+	objects.erase(std::remove(objects.begin(), objects.end(), nullptr), objects.end());
 
-	for (Cullable* object : objects)
+	if (objects.empty())
 	{
-		XMFLOAT3 gMin = object->bounds.getMin();
-		XMFLOAT3 gMax = object->bounds.getMax();
-		min = wiMath::Min(gMin, min);
-		max = wiMath::Max(gMax, max);
+		bounds = AABB();
+		buildCost = 0;
+		return;
 	}
 
-	this->root = new wiSPTree::Node(nullptr, AABB(min, max));
-	AddObjects(this->root, objects);
-}
+	const uint32_t count = (uint32_t)objects.size();
+	std::vector<AABB> objectBounds(count);
+	std::vector<XMFLOAT3> centers(count);
+	std::vector<uint32_t> indices(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		objectBounds[i] = objects[i]->bounds;
+		centers[i] = objectBounds[i].getCenter();
+		indices[i] = i;
+	}
 
-void wiSPTree::AddObjects(Node* node, const std::vector<Cullable*>& newObjects)
-{
-	for (Cullable* object : newObjects)
+	nodes.reserve(count / 2 + 1);
+	BuildNode(indices, objectBounds, centers, 0, count, 0);
+
+	// Leaves are referencing positions in the index list, so reorder the objects to match it.
+	//	This also places objects which are close to each other in the tree close in memory.
+	std::vector<Cullable*> ordered(count);
+	for (uint32_t i = 0; i < count; ++i)
 	{
-		node->objects.push_back(object);
+		ordered[i] = objects[indices[i]];
 	}
+	objects.swap(ordered);
 
-	if (newObjects.size() > SP_TREE_OBJECT_PER_NODE && node->depth < SP_TREE_MAX_DEPTH) 
+	buildCost = Refit();
+}
+
+uint32_t wiSPTree::BuildNode(std::vector<uint32_t>& indices, const std::vector<AABB>& objectBounds, const std::vector<XMFLOAT3>& centers, uint32_t first, uint32_t count, int depth)
+{
+	const uint32_t nodeIndex = (uint32_t)nodes.size();
+	nodes.emplace_back();
+
+	// Split the range into up to 4 groups, one for each child:
+	uint32_t groupFirst[4];
+	uint32_t groupCount[4];
+	int groupNum = 0;
+	if (count <= 4)
 	{
-		node->count = childCount;
-		node->children.reserve(node->count);
-		XMFLOAT3 min = node->box.getMin();
-		XMFLOAT3 max = node->box.getMax();
-		AABB* boxes = new AABB[node->count];
-		if (node->count == 8) 
+		for (uint32_t i = 0; i < count; ++i)
 		{
-			boxes[0] = AABB(XMFLOAT3(min.x, (min.y + max.y)*0.5f, (min.z + max.z)*0.5f), XMFLOAT3((min.x + max.x)*0.5f, max.y, max.z));
-			boxes[1] = AABB(XMFLOAT3((min.x + max.x)*0.5f, (min.y + max.y)*0.5f, (min.z + max.z)*0.5f), max);
-			boxes[2] = AABB(XMFLOAT3(min.x, (min.y + max.y)*0.5f, min.z), XMFLOAT3((min.x + max.x)*0.5f, max.y, (min.z + max.z)*0.5f));
-			boxes[3] = AABB(XMFLOAT3((min.x + max.x)*0.5f, (min.y + max.y)*0.5f, min.z), XMFLOAT3(max.x, max.y, (min.z + max.z)*0.5f));
-
-			boxes[4] = AABB(XMFLOAT3(min.x, min.y, (min.z + max.z)*0.5f), XMFLOAT3((min.x + max.x)*0.5f, (min.y + max.y)*0.5f, max.z));
-			boxes[5] = AABB(XMFLOAT3((min.x + max.x)*0.5f, min.y, (min.z + max.z)*0.5f), XMFLOAT3(max.x, (min.y + max.y)*0.5f, max.z));
-			boxes[6] = AABB(min, XMFLOAT3((min.x + max.x)*0.5f, (min.y + max.y)*0.5f, (min.z + max.z)*0.5f));
-			boxes[7] = AABB(XMFLOAT3((min.x + max.x)*0.5f, min.y, min.z), XMFLOAT3(max.x, (min.y + max.y)*0.5f, (min.z + max.z)*0.5f));
+			groupFirst[groupNum] = first + i;
+			groupCount[groupNum] = 1;
+			groupNum++;
 		}
-		else 
-		{
-			boxes[0] = AABB(XMFLOAT3(min.x, min.y, (min.z + max.z)*0.5f), XMFLOAT3((min.x + max.x)*0.5f, max.y, max.z));
-			boxes[1] = AABB(XMFLOAT3((min.x + max.x)*0.5f, min.y, (min.z + max.z)*0.5f), max);
-			boxes[2] = AABB(min, XMFLOAT3((min.x + max.x)*0.5f, max.y, (min.z + max.z)*0.5f));
-			boxes[3] = AABB(XMFLOAT3((min.x + max.x)*0.5f, min.y, min.z), XMFLOAT3(max.x, max.y, (min.z + max.z)*0.5f));
-		}
-		for (int i = 0; i < node->count; ++i)
+	}
+	else
+	{
+		const uint32_t left = Split(indices, objectBounds, centers, first, count, depth);
+		const uint32_t halfFirst[2] = { first, first + left };
+		const uint32_t halfCount[2] = { left, count - left };
+		for (int i = 0; i < 2; ++i)
 		{
-			std::vector<Cullable*> o(0);
-			o.reserve(newObjects.size());
-			for (Cullable* object : newObjects)
+			if (halfCount[i] > 1)
 			{
-#ifdef SP_TREE_BOX_CONTAIN
-				if (boxes[i].intersects(object->bounds) == AABB::INSIDE)
-#else
-				if ((*boxes[i]).intersects(object->translation))
-#endif
-				{
-					o.push_back(object);
-					node->objects.remove(object);
-				}
+				const uint32_t quarter = Split(indices, objectBounds, centers, halfFirst[i], halfCount[i], depth);
+				groupFirst[groupNum] = halfFirst[i];
+				groupCount[groupNum] = quarter;
+				groupNum++;
+				groupFirst[groupNum] = halfFirst[i] + quarter;
+				groupCount[groupNum] = halfCount[i] - quarter;
+				groupNum++;
 			}
-			if (!o.empty())
+			else
 			{
-				node->children.push_back(new Node(node, boxes[i], node->depth + 1));
-				AddObjects(node->children.back(), o);
+				groupFirst[groupNum] = halfFirst[i];
+				groupCount[groupNum] = halfCount[i];
+				groupNum++;
 			}
 		}
-		delete[] boxes;
 	}
 
-}
+	uint32_t children[4] = { CHILD_INVALID, CHILD_INVALID, CHILD_INVALID, CHILD_INVALID };
+	for (int i = 0; i < groupNum; ++i)
+	{
+		if (groupCount[i] == 1)
+		{
+			children[i] = CHILD_LEAF | groupFirst[i];
+		}
+		else
+		{
+			children[i] = BuildNode(indices, objectBounds, centers, groupFirst[i], groupCount[i], depth + 1);
+		}
+	}
 
-void wiSPTree::Sort(const XMFLOAT3& origin, CulledList& objects, SortType sortType)
-{
-	switch (sortType)
-	{
-	case wiSPTree::SP_TREE_SORT_NONE:
-		break;
-	case wiSPTree::SP_TREE_SORT_UNIQUE:
-		// Unique must only be called on a sorted forward_list!
-		// And we cannot rely on the by distance sort for this because culled objects could have been gathered by different cullers, so sort by pointers!
-		objects.sort([&](const void* a, const void* b) {
-			return a < b;
-		});
-		objects.unique();
-		break;
-	case wiSPTree::SP_TREE_SORT_BACK_TO_FRONT:
-		Sort(origin, objects, wiSPTree::SP_TREE_SORT_UNIQUE);
-		objects.sort([&](const Cullable* a, const Cullable* b) {
-			return wiMath::DistanceSquared(origin, a->bounds.getCenter()) > wiMath::DistanceSquared(origin, b->bounds.getCenter());
-		});
-		break;
-	case wiSPTree::SP_TREE_SORT_FRONT_TO_BACK:
-		Sort(origin, objects, wiSPTree::SP_TREE_SORT_UNIQUE);
-		objects.sort([&](const Cullable* a, const Cullable* b) {
-			return wiMath::DistanceSquared(origin, a->bounds.getCenter()) < wiMath::DistanceSquared(origin, b->bounds.getCenter());
-		});
-		break;
-	default:
-		break;
+	// The node array could have been reallocated by the recursion, so only write the node now:
+	Node& node = nodes[nodeIndex];
+	for (int i = 0; i < 4; ++i)
+	{
+		node.children[i] = children[i];
 	}
+
+	return nodeIndex;
 }
 
-void wiSPTree::getVisible(Frustum& frustum, CulledList& objects, SortType sortType, CullStrictness type, Node* node)
+uint32_t wiSPTree::Split(std::vector<uint32_t>& indices, const std::vector<AABB>& objectBounds, const std::vector<XMFLOAT3>& centers, uint32_t first, uint32_t count, int depth)
 {
-	if (node == nullptr)
+	assert(count > 1);
+
+	XMFLOAT3 centerMin = XMFLOAT3(FLOAT32_MAX, FLOAT32_MAX, FLOAT32_MAX);
+	XMFLOAT3 centerMax = XMFLOAT3(-FLOAT32_MAX, -FLOAT32_MAX, -FLOAT32_MAX);
+	for (uint32_t i = first; i < first + count; ++i)
 	{
-		node = root;
+		centerMin = wiMath::Min(centerMin, centers[indices[i]]);
+		centerMax = wiMath::Max(centerMax, centers[indices[i]]);
 	}
 
-	int contain_type = frustum.CheckBox(node->box);
+	int axis = 0;
+	XMFLOAT3 extent = XMFLOAT3(centerMax.x - centerMin.x, centerMax.y - centerMin.y, centerMax.z - centerMin.z);
+	if (extent.y > extent.x && extent.y > extent.z)
+	{
+		axis = 1;
+	}
+	else if (extent.z > extent.x && extent.z > extent.y)
+	{
+		axis = 2;
+	}
+	const float axisMin = GetAxis(centerMin, axis);
+	const float axisExtent = GetAxis(extent, axis);
+
+	auto median = [&]() {
+		const uint32_t half = count / 2;
+		std::nth_element(indices.begin() + first, indices.begin() + first + half, indices.begin() + first + count, [&](uint32_t a, uint32_t b) {
+			return GetAxis(centers[a], axis) < GetAxis(centers[b], axis);
+		});
+		return half;
+	};
 
-	if (!contain_type)
+	// Deep trees are finished with median splits to keep the traversal stack bounded:
+	if (axisExtent <= 0 || depth > SP_TREE_MAX_SAH_DEPTH)
 	{
-		return;
+		return median();
 	}
-	else
+
+	// Binned surface area heuristic:
+	struct Bin
 	{
-		for (Cullable* object : node->objects)
+		XMFLOAT3 _min = XMFLOAT3(FLOAT32_MAX, FLOAT32_MAX, FLOAT32_MAX);
+		XMFLOAT3 _max = XMFLOAT3(-FLOAT32_MAX, -FLOAT32_MAX, -FLOAT32_MAX);
+		uint32_t count = 0;
+	};
+	Bin bins[SP_TREE_SAH_BINS];
+	const float binScale = SP_TREE_SAH_BINS / axisExtent;
+	auto binOf = [&](uint32_t index) {
+		int bin = (int)((GetAxis(centers[index], axis) - axisMin) * binScale);
+		return max(0, min(SP_TREE_SAH_BINS - 1, bin));
+	};
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		Bin& bin = bins[binOf(indices[i])];
+		bin._min = wiMath::Min(bin._min, objectBounds[indices[i]].getMin());
+		bin._max = wiMath::Max(bin._max, objectBounds[indices[i]].getMax());
+		bin.count++;
+	}
+
+	// Sweep from the right to gather the right side costs, then from the left to evaluate the split planes:
+	float rightCost[SP_TREE_SAH_BINS];
+	{
+		Bin acc;
+		for (int i = SP_TREE_SAH_BINS - 1; i > 0; --i)
 		{
-			if (
-				type == SP_TREE_LOOSE_CULL ||
-				(type == SP_TREE_STRICT_CULL &&
-					contain_type == BOX_FRUSTUM_INSIDE ||
-					(contain_type == BOX_FRUSTUM_INTERSECTS && frustum.CheckBox(object->bounds))
-					)
-				)
-			{
-				objects.push_front(object);
-			}
+			acc._min = wiMath::Min(acc._min, bins[i]._min);
+			acc._max = wiMath::Max(acc._max, bins[i]._max);
+			acc.count += bins[i].count;
+			rightCost[i] = HalfArea(acc._min, acc._max) * acc.count;
 		}
-		if(node->count)
+	}
+	int bestSplit = -1;
+	float bestCost = FLOAT32_MAX;
+	{
+		Bin acc;
+		for (int i = 0; i < SP_TREE_SAH_BINS - 1; ++i)
 		{
-			for (unsigned int i = 0; i < node->children.size(); ++i)
+			acc._min = wiMath::Min(acc._min, bins[i]._min);
+			acc._max = wiMath::Max(acc._max, bins[i]._max);
+			acc.count += bins[i].count;
+			const float cost = HalfArea(acc._min, acc._max) * acc.count + rightCost[i + 1];
+			if (acc.count > 0 && acc.count < count && cost < bestCost)
 			{
-				getVisible(frustum, objects, sortType, type, node->children[i]);
+				bestCost = cost;
+				bestSplit = i;
 			}
 		}
 	}
-
-	if (node == root)
+	if (bestSplit < 0)
 	{
-		Sort(frustum.getCamPos(), objects, sortType);
+		return median();
 	}
+
+	auto it = std::partition(indices.begin() + first, indices.begin() + first + count, [&](uint32_t index) {
+		return binOf(index) <= bestSplit;
+	});
+	return (uint32_t)(it - (indices.begin() + first));
 }
-void wiSPTree::getVisible(AABB& frustum, CulledList& objects, SortType sortType, CullStrictness type, Node* node)
+
+float wiSPTree::Refit()
 {
-	if (node == nullptr)
-	{
-		node = root;
-	}
+	float cost = 0;
 
-	int contain_type = frustum.intersects(node->box);
-	if (!contain_type)
+	// Children are always placed after their parents, so a reverse iteration processes them bottom-up:
+	for (size_t i = nodes.size(); i > 0; --i)
 	{
-		return;
-	}
-	else
-	{
-		for (Cullable* object : node->objects)
+		Node& node = nodes[i - 1];
+		for (int lane = 0; lane < 4; ++lane)
 		{
-			if (
-				type == SP_TREE_LOOSE_CULL ||
-				(type == SP_TREE_STRICT_CULL &&
-					contain_type == AABB::INSIDE ||
-					(contain_type == AABB::INTERSECTS && frustum.intersects(object->bounds))
-					)
-				) 
+			XMFLOAT3 _min = XMFLOAT3(FLOAT32_MAX, FLOAT32_MAX, FLOAT32_MAX);
+			XMFLOAT3 _max = XMFLOAT3(-FLOAT32_MAX, -FLOAT32_MAX, -FLOAT32_MAX);
+
+			const uint32_t child = node.children[lane];
+			if (child == CHILD_INVALID)
 			{
-				objects.push_front(object);
+				// empty lane
 			}
-		}
-		if(node->count)
-		{
-			for (unsigned int i = 0; i < node->children.size(); ++i)
+			else if (child & CHILD_LEAF)
+			{
+				const Cullable* object = objects[child & ~CHILD_LEAF];
+				if (object != nullptr)
+				{
+					_min = object->bounds.getMin();
+					_max = object->bounds.getMax();
+				}
+			}
+			else
 			{
-				getVisible(frustum, objects, sortType, type, node->children[i]);
+				const Node& childNode = nodes[child];
+				_min.x = HorizontalMin(XMLoadFloat4A(&childNode.minX));
+				_min.y = HorizontalMin(XMLoadFloat4A(&childNode.minY));
+				_min.z = HorizontalMin(XMLoadFloat4A(&childNode.minZ));
+				_max.x = HorizontalMax(XMLoadFloat4A(&childNode.maxX));
+				_max.y = HorizontalMax(XMLoadFloat4A(&childNode.maxY));
+				_max.z = HorizontalMax(XMLoadFloat4A(&childNode.maxZ));
+
+				cost += HalfArea(_min, _max);
 			}
+
+			SetLane(node.minX, lane, _min.x);
+			SetLane(node.minY, lane, _min.y);
+			SetLane(node.minZ, lane, _min.z);
+			SetLane(node.maxX, lane, _max.x);
+			SetLane(node.maxY, lane, _max.y);
+			SetLane(node.maxZ, lane, _max.z);
 		}
 	}
 
-	if (node == root)
+	if (!nodes.empty())
 	{
-		Sort(frustum.getCenter(), objects, sortType);
+		const Node& root = nodes[0];
+		XMFLOAT3 _min = XMFLOAT3(FLOAT32_MAX, FLOAT32_MAX, FLOAT32_MAX);
+		XMFLOAT3 _max = XMFLOAT3(-FLOAT32_MAX, -FLOAT32_MAX, -FLOAT32_MAX);
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			if (root.children[lane] != CHILD_INVALID)
+			{
+				_min = wiMath::Min(_min, XMFLOAT3(GetLane(root.minX, lane), GetLane(root.minY, lane), GetLane(root.minZ, lane)));
+				_max = wiMath::Max(_max, XMFLOAT3(GetLane(root.maxX, lane), GetLane(root.maxY, lane), GetLane(root.maxZ, lane)));
+			}
+		}
+		bounds = AABB(_min, _max);
 	}
+
+	return cost;
 }
-void wiSPTree::getVisible(SPHERE& frustum, CulledList& objects, SortType sortType, CullStrictness type, Node* node)
+
+void wiSPTree::AddObjects(const std::vector<Cullable*>& newObjects)
+{
+	objects.insert(objects.end(), newObjects.begin(), newObjects.end());
+	Build();
+}
+
+void wiSPTree::Sort(const XMFLOAT3& origin, CulledList& objects, SortType sortType)
 {
-	if (node == nullptr)
+	if (sortType == SP_TREE_SORT_NONE || objects.empty())
 	{
-		node = root;
+		return;
 	}
 
-	int contain_type = frustum.intersects(node->box);
+	// Culled objects could have been gathered by different cullers, so remove the duplicates first by sorting them by pointers:
+	std::sort(objects.begin(), objects.end());
+	objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
 
-	if (!contain_type)
+	if (sortType == SP_TREE_SORT_UNIQUE)
 	{
 		return;
 	}
-	else 
+
+	static thread_local std::vector<CulledCollection::SortEntry> entries;
+	static thread_local std::vector<CulledCollection::SortEntry> temp;
+	entries.resize(objects.size());
+	for (size_t i = 0; i < objects.size(); ++i)
 	{
-		for (Cullable* object : node->objects)
+		uint32_t depth = FloatToSortKey(wiMath::DistanceSquared(origin, objects[i]->bounds.getCenter()));
+		if (sortType == SP_TREE_SORT_BACK_TO_FRONT)
 		{
-			if (frustum.intersects(object->bounds))
-			{
-				objects.push_front(object);
-			}
-		}
-		if(node->count)
-		{
-			for (unsigned int i = 0; i < node->children.size(); ++i)
-			{
-				getVisible(frustum, objects, sortType, type, node->children[i]);
-			}
+			depth = ~depth;
 		}
+		entries[i].key = depth;
+		entries[i].value = objects[i];
 	}
-
-	if (node == root)
+	CulledCollection::RadixSort(entries, temp);
+	for (size_t i = 0; i < objects.size(); ++i)
 	{
-		Sort(frustum.center, objects, sortType);
+		objects[i] = (Cullable*)entries[i].value;
 	}
 }
-void wiSPTree::getVisible(RAY& frustum, CulledList& objects, SortType sortType, CullStrictness type, Node* node)
+
+void wiSPTree::GatherSubtree(uint32_t nodeIndex, CulledList& culled)
 {
-	if (node == nullptr)
+	const Node& node = nodes[nodeIndex];
+	for (int lane = 0; lane < 4; ++lane)
 	{
-		node = root;
+		const uint32_t child = node.children[lane];
+		if (child == CHILD_INVALID)
+		{
+			continue;
+		}
+		if (child & CHILD_LEAF)
+		{
+			Cullable* object = objects[child & ~CHILD_LEAF];
+			if (object != nullptr)
+			{
+				culled.push_back(object);
+			}
+		}
+		else
+		{
+			GatherSubtree(child, culled);
+		}
 	}
+}
 
-	int contain_type = frustum.intersects(node->box);
-
-	if (!contain_type)
+// Traverses the tree with a query that computes an outside and inside mask for the 4 child boxes of a node at once.
+//	Lanes of the outside mask are culled, lanes of the inside mask have their whole subtree accepted without further tests.
+template<typename NodeTest>
+void wiSPTree::Traverse(CulledList& culled, CullStrictness type, NodeTest test, uint32_t rootIndex)
+{
+	if (IsEmpty())
 	{
 		return;
 	}
-	else 
+
+	uint32_t stack[SP_TREE_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = rootIndex;
+
+	while (stackSize > 0)
 	{
-		for (Cullable* object : node->objects)
+		const Node& node = nodes[stack[--stackSize]];
+
+		uint32_t outside[4];
+		uint32_t inside[4];
+		test(node, outside, inside);
+
+		for (int lane = 0; lane < 4; ++lane)
 		{
-			if (frustum.intersects(object->bounds))
+			const uint32_t child = node.children[lane];
+			if (child == CHILD_INVALID)
 			{
-				objects.push_front(object);
+				continue;
 			}
-		}
-		if(node->count)
-		{
-			for (unsigned int i = 0; i < node->children.size(); ++i)
+			if (child & CHILD_LEAF)
 			{
-				getVisible(frustum, objects, sortType, type, node->children[i]);
+				if (outside[lane] && type == SP_TREE_STRICT_CULL)
+				{
+					continue;
+				}
+				Cullable* object = objects[child & ~CHILD_LEAF];
+				if (object != nullptr)
+				{
+					culled.push_back(object);
+				}
+			}
+			else if (!outside[lane])
+			{
+				if (inside[lane])
+				{
+					GatherSubtree(child, culled);
+				}
+				else if (stackSize < SP_TREE_STACK_SIZE)
+				{
+					stack[stackSize++] = child;
+				}
+				else
+				{
+					// Only a degenerate tree can fill the stack, its deepest subtrees are traversed with a stack of their own:
+					Traverse(culled, type, test, child);
+				}
 			}
 		}
 	}
+}
+
+void wiSPTree::getVisible(Frustum& frustum, CulledList& culled, SortType sortType, CullStrictness type)
+{
+	const XMFLOAT4 planes[6] = {
+		frustum.getNearPlane(),
+		frustum.getFarPlane(),
+		frustum.getLeftPlane(),
+		frustum.getRightPlane(),
+		frustum.getTopPlane(),
+		frustum.getBottomPlane(),
+	};
+
+	Traverse(culled, type, [&](const Node& node, uint32_t* outside, uint32_t* inside) {
+		const XMVECTOR minX = XMLoadFloat4A(&node.minX);
+		const XMVECTOR minY = XMLoadFloat4A(&node.minY);
+		const XMVECTOR minZ = XMLoadFloat4A(&node.minZ);
+		const XMVECTOR maxX = XMLoadFloat4A(&node.maxX);
+		const XMVECTOR maxY = XMLoadFloat4A(&node.maxY);
+		const XMVECTOR maxZ = XMLoadFloat4A(&node.maxZ);
+		const XMVECTOR zero = XMVectorZero();
+
+		XMVECTOR out = XMVectorFalseInt();
+		XMVECTOR in = XMVectorTrueInt();
+		for (int p = 0; p < 6; ++p)
+		{
+			const XMFLOAT4& plane = planes[p];
+
+			// The positive vertex is the box corner furthest along the plane normal, the negative vertex is the nearest.
+			//	If the positive vertex is behind a plane, the box is outside. If the negative vertex is in front of all planes, the box is inside.
+			XMVECTOR dp = XMVectorReplicate(plane.w);
+			dp = XMVectorMultiplyAdd(plane.x > 0 ? maxX : minX, XMVectorReplicate(plane.x), dp);
+			dp = XMVectorMultiplyAdd(plane.y > 0 ? maxY : minY, XMVectorReplicate(plane.y), dp);
+			dp = XMVectorMultiplyAdd(plane.z > 0 ? maxZ : minZ, XMVectorReplicate(plane.z), dp);
+
+			XMVECTOR dn = XMVectorReplicate(plane.w);
+			dn = XMVectorMultiplyAdd(plane.x > 0 ? minX : maxX, XMVectorReplicate(plane.x), dn);
+			dn = XMVectorMultiplyAdd(plane.y > 0 ? minY : maxY, XMVectorReplicate(plane.y), dn);
+			dn = XMVectorMultiplyAdd(plane.z > 0 ? minZ : maxZ, XMVectorReplicate(plane.z), dn);
+
+			out = XMVectorOrInt(out, XMVectorLess(dp, zero));
+			in = XMVectorAndInt(in, XMVectorGreaterOrEqual(dn, zero));
+		}
+		XMStoreInt4(outside, out);
+		XMStoreInt4(inside, in);
+	});
 
-	if (node == root)
+	Sort(frustum.getCamPos(), culled, sortType);
+}
+void wiSPTree::getVisible(AABB& frustum, CulledList& culled, SortType sortType, CullStrictness type)
+{
+	const XMFLOAT3 qmin = frustum.getMin();
+	const XMFLOAT3 qmax = frustum.getMax();
+	const XMVECTOR qminX = XMVectorReplicate(qmin.x);
+	const XMVECTOR qminY = XMVectorReplicate(qmin.y);
+	const XMVECTOR qminZ = XMVectorReplicate(qmin.z);
+	const XMVECTOR qmaxX = XMVectorReplicate(qmax.x);
+	const XMVECTOR qmaxY = XMVectorReplicate(qmax.y);
+	const XMVECTOR qmaxZ = XMVectorReplicate(qmax.z);
+
+	Traverse(culled, type, [&](const Node& node, uint32_t* outside, uint32_t* inside) {
+		const XMVECTOR minX = XMLoadFloat4A(&node.minX);
+		const XMVECTOR minY = XMLoadFloat4A(&node.minY);
+		const XMVECTOR minZ = XMLoadFloat4A(&node.minZ);
+		const XMVECTOR maxX = XMLoadFloat4A(&node.maxX);
+		const XMVECTOR maxY = XMLoadFloat4A(&node.maxY);
+		const XMVECTOR maxZ = XMLoadFloat4A(&node.maxZ);
+
+		XMVECTOR out = XMVectorOrInt(XMVectorLess(maxX, qminX), XMVectorGreater(minX, qmaxX));
+		out = XMVectorOrInt(out, XMVectorOrInt(XMVectorLess(maxY, qminY), XMVectorGreater(minY, qmaxY)));
+		out = XMVectorOrInt(out, XMVectorOrInt(XMVectorLess(maxZ, qminZ), XMVectorGreater(minZ, qmaxZ)));
+
+		XMVECTOR in = XMVectorAndInt(XMVectorGreaterOrEqual(minX, qminX), XMVectorLessOrEqual(maxX, qmaxX));
+		in = XMVectorAndInt(in, XMVectorAndInt(XMVectorGreaterOrEqual(minY, qminY), XMVectorLessOrEqual(maxY, qmaxY)));
+		in = XMVectorAndInt(in, XMVectorAndInt(XMVectorGreaterOrEqual(minZ, qminZ), XMVectorLessOrEqual(maxZ, qmaxZ)));
+
+		XMStoreInt4(outside, out);
+		XMStoreInt4(inside, in);
+	});
+
+	Sort(frustum.getCenter(), culled, sortType);
+}
+void wiSPTree::getVisible(SPHERE& frustum, CulledList& culled, SortType sortType, CullStrictness type)
+{
+	const XMVECTOR cX = XMVectorReplicate(frustum.center.x);
+	const XMVECTOR cY = XMVectorReplicate(frustum.center.y);
+	const XMVECTOR cZ = XMVectorReplicate(frustum.center.z);
+	const XMVECTOR radiusSq = XMVectorReplicate(frustum.radius * frustum.radius);
+
+	Traverse(culled, type, [&](const Node& node, uint32_t* outside, uint32_t* inside) {
+		// Distance from the closest point of the boxes:
+		const XMVECTOR dX = XMVectorSubtract(XMVectorClamp(cX, XMLoadFloat4A(&node.minX), XMLoadFloat4A(&node.maxX)), cX);
+		const XMVECTOR dY = XMVectorSubtract(XMVectorClamp(cY, XMLoadFloat4A(&node.minY), XMLoadFloat4A(&node.maxY)), cY);
+		const XMVECTOR dZ = XMVectorSubtract(XMVectorClamp(cZ, XMLoadFloat4A(&node.minZ), XMLoadFloat4A(&node.maxZ)), cZ);
+		const XMVECTOR distSq = XMVectorMultiplyAdd(dZ, dZ, XMVectorMultiplyAdd(dY, dY, XMVectorMultiply(dX, dX)));
+
+		XMStoreInt4(outside, XMVectorGreaterOrEqual(distSq, radiusSq));
+		XMStoreInt4(inside, XMVectorFalseInt());
+	});
+
+	Sort(frustum.center, culled, sortType);
+}
+// Slab test of a ray against 4 boxes along one axis: narrows the [tmin, tmax] ray parameter range to the slabs of the boxes.
+//	A ray that is parallel to the slabs doesn't narrow the range (1/0 would give 0*inf = NaN for boxes that touch the origin),
+//	it misses the boxes whose slab doesn't contain the origin.
+static inline void ClipRaySlab(XMVECTOR boxMin, XMVECTOR boxMax, float origin, float direction, XMVECTOR& tmin, XMVECTOR& tmax, XMVECTOR& outside)
+{
+	const XMVECTOR o = XMVectorReplicate(origin);
+	if (direction == 0)
 	{
-		Sort(frustum.origin, objects, sortType);
+		outside = XMVectorOrInt(outside, XMVectorOrInt(XMVectorLess(o, boxMin), XMVectorGreater(o, boxMax)));
+		return;
 	}
+	const XMVECTOR inv = XMVectorReplicate(1.0f / direction);
+	const XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(boxMin, o), inv);
+	const XMVECTOR t2 = XMVectorMultiply(XMVectorSubtract(boxMax, o), inv);
+	tmin = XMVectorMax(tmin, XMVectorMin(t1, t2));
+	tmax = XMVectorMin(tmax, XMVectorMax(t1, t2));
+}
+void wiSPTree::getVisible(RAY& frustum, CulledList& culled, SortType sortType, CullStrictness type)
+{
+	const XMFLOAT3 origin = frustum.origin;
+	const XMFLOAT3 direction = frustum.direction;
+
+	Traverse(culled, type, [&](const Node& node, uint32_t* outside, uint32_t* inside) {
+		// The ray starts at its origin, so the range starts at 0, and boxes that are entirely behind the origin (tmax < 0) are rejected too:
+		XMVECTOR tmin = XMVectorZero();
+		XMVECTOR tmax = XMVectorReplicate(FLT_MAX);
+		XMVECTOR out = XMVectorFalseInt();
+		ClipRaySlab(XMLoadFloat4A(&node.minX), XMLoadFloat4A(&node.maxX), origin.x, direction.x, tmin, tmax, out);
+		ClipRaySlab(XMLoadFloat4A(&node.minY), XMLoadFloat4A(&node.maxY), origin.y, direction.y, tmin, tmax, out);
+		ClipRaySlab(XMLoadFloat4A(&node.minZ), XMLoadFloat4A(&node.maxZ), origin.z, direction.z, tmin, tmax, out);
+
+		XMStoreInt4(outside, XMVectorOrInt(out, XMVectorLess(tmax, tmin)));
+		XMStoreInt4(inside, XMVectorFalseInt());
+	});
+
+	Sort(frustum.origin, culled, sortType);
 }
-void wiSPTree::getAll(CulledList& objects, Node* node)
+void wiSPTree::getAll(CulledList& culled)
 {
-	if (node == nullptr)
+	if (!IsEmpty())
 	{
-		node = root;
+		GatherSubtree(0, culled);
 	}
-
-	objects.insert(objects.end(), node->objects.begin(),node->objects.end());
-	if(node->count)
+}
+void wiSPTree::Remove(Cullable* value)
+{
+	// The leaf is kept, but it will be empty, and the object is removed from the hierarchy on the next rebuild
+	auto it = std::find(objects.begin(), objects.end(), value);
+	if (it != objects.end())
 	{
-		for (unsigned int i = 0; i < node->children.size(); ++i)
-		{
-			getAll(objects, node->children[i]);
-		}
+		*it = nullptr;
 	}
 }
-void wiSPTree::Remove(Cullable* value, Node* node)
+
+void wiSPTree::updateTree()
 {
-	if (node == nullptr)
+	if (IsEmpty())
 	{
-		node = root;
+		return;
 	}
-	node->objects.remove(value);
-	for (auto& child : node->children)
+
+	const float cost = Refit();
+	if (cost > buildCost * SP_TREE_REBUILD_RATIO)
 	{
-		Remove(value, child);
+		Build();
 	}
 }
 
-wiSPTree* wiSPTree::updateTree(Node* node)
+
+void CulledCollection::Add(Object* object, float distance)
 {
-	if (node == nullptr)
+	SortEntry entry;
+	entry.key = FloatToSortKey(distance);
+	entry.value = object;
+	entries.push_back(entry);
+}
+void CulledCollection::Finalize(bool backToFront)
+{
+	batches.clear();
+	instances.clear();
+
+	for (SortEntry& entry : entries)
 	{
-		node = root;
+		uint32_t depth = (uint32_t)entry.key;
+		if (backToFront)
+		{
+			depth = ~depth;
+		}
+		entry.key = ((uint64_t)((Object*)entry.value)->mesh->sortID << 32) | depth;
 	}
+	RadixSort(entries, entries_temp);
 
-	if (node)
+	instances.reserve(entries.size());
+	for (const SortEntry& entry : entries)
 	{
-
-		std::vector<Cullable*> bad(0);
-		for (Cullable* object : node->objects)
+		Object* object = (Object*)entry.value;
+		if (batches.empty() || batches.back().mesh != object->mesh)
 		{
-#ifdef SP_TREE_BOX_CONTAIN
-			if (node->box.intersects(object->bounds) != AABB::INSIDE)
-#else
-			if (!node->box.intersects(object->translation))
-#endif
-				bad.push_back(object);
+			Batch batch;
+			batch.mesh = object->mesh;
+			batch.offset = (uint32_t)instances.size();
+			batch.count = 0;
+			batches.push_back(batch);
 		}
+		batches.back().count++;
+		instances.push_back(object);
+	}
+	entries.clear();
+}
+void CulledCollection::Clear()
+{
+	batches.clear();
+	instances.clear();
+	entries.clear();
+}
+void CulledCollection::RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& temp)
+{
+	const size_t count = entries.size();
+	if (count < 2)
+	{
+		return;
+	}
+	temp.resize(count);
 
-		if (!bad.empty()) {
-
-			for (Cullable* object : bad)
-			{
-				node->objects.remove(object);
-			}
+	// Gather the histograms of all 8 bytes in a single pass:
+	uint32_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint64_t key = entries[i].key;
+		for (int pass = 0; pass < 8; ++pass)
+		{
+			histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+		}
+	}
 
-			if (node->parent)
-			{
-				AddObjects(node->parent, bad);
-			}
-			else
-			{
-				CulledList culledItems;
-				getVisible(node->box, culledItems, SP_TREE_SORT_UNIQUE, SP_TREE_STRICT_CULL, node);
-				for (Cullable* item : culledItems)
-				{
-					bad.push_back(item);
-				}
+	SortEntry* src = entries.data();
+	SortEntry* dst = temp.data();
+	for (int pass = 0; pass < 8; ++pass)
+	{
+		const int shift = pass * 8;
+		uint32_t* histogram = histograms[pass];
 
-				AABB nbb = node->box*1.5;
-				wiSPTree* tree;
-				if (childCount == 8)
-					tree = new Octree(bad, nbb.getMin(), nbb.getMax());
-				else
-					tree = new QuadTree(bad, nbb.getMin(), nbb.getMax());
+		// Every key has the same value in this byte, so the pass wouldn't change anything:
+		if (histogram[(src[0].key >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
 
-				return tree;
-			}
+		uint32_t offset = 0;
+		for (int i = 0; i < 256; ++i)
+		{
+			const uint32_t bucketCount = histogram[i];
+			histogram[i] = offset;
+			offset += bucketCount;
 		}
-		if (!node->children.empty())
+		for (size_t i = 0; i < count; ++i)
 		{
-			for (unsigned int i = 0; i < node->children.size(); ++i)
-			{
-				updateTree(node->children[i]);
-			}
+			dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
 		}
+		std::swap(src, dst);
+	}
 
+	if (src != entries.data())
+	{
+		entries.swap(temp);
 	}
-	return nullptr;
 }
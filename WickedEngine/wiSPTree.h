@@ -2,50 +2,76 @@
 #include "CommonInclude.h"
 #include "wiLoader.h"
 
-#include <unordered_map>
-#include <list>
+#include <vector>
 
 class Frustum;
 
-typedef std::list<Cullable*> CulledList;
+typedef std::vector<Cullable*> CulledList;
 
-typedef std::list<Object*> CulledObjectList;
-typedef std::unordered_map<Mesh*,CulledObjectList> CulledCollection;
+// Culled objects grouped into per-mesh instance batches.
+//	Objects are added with their distance to the viewer, then Finalize() radix sorts them by a (mesh, distance) key.
+//	The arrays keep their memory when cleared, so refilling the collection every frame doesn't allocate once it is warmed up.
+struct CulledCollection
+{
+	struct Batch
+	{
+		Mesh* mesh;
+		uint32_t offset; // first instance of the batch in the instances array
+		uint32_t count;
+	};
+	std::vector<Batch> batches;
+	std::vector<Object*> instances;
+
+	// Add an object with its (squared) distance to the viewer
+	void Add(Object* object, float distance);
+	// Sort the added objects into the batches. Instances inside a batch are ordered front to back, or back to front if requested.
+	void Finalize(bool backToFront = false);
+	void Clear();
+	bool empty() const { return instances.empty(); }
+
+	struct SortEntry
+	{
+		uint64_t key;
+		void* value;
+	};
+	// Stable LSD radix sort by the 64-bit keys. Byte passes that wouldn't change the order are skipped.
+	static void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& temp);
 
+private:
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> entries_temp;
+};
+
+// Bounding volume hierarchy of Cullables with 4-wide nodes.
+//	The nodes are stored in a flat array, and every node holds the bounds of its 4 children in SoA layout,
+//	so a single traversal step tests 4 boxes at once against the query primitive.
+//	A child can either be an other node, or directly reference a single object (leaf).
 class wiSPTree
 {
-protected:
-	int childCount;
-	wiSPTree();
 public:
+	wiSPTree(const std::vector<Cullable*>& objects = std::vector<Cullable*>());
 	~wiSPTree();
-	void initialize(const std::vector<Cullable*>& objects, const XMFLOAT3& newMin = XMFLOAT3(FLOAT32_MAX, FLOAT32_MAX, FLOAT32_MAX), const XMFLOAT3& newMax = XMFLOAT3(-FLOAT32_MAX, -FLOAT32_MAX, -FLOAT32_MAX));
+
+	static const uint32_t CHILD_INVALID = 0xFFFFFFFF;
+	static const uint32_t CHILD_LEAF = 0x80000000;
 
 	struct Node
 	{
-		int depth;
-		AABB box;
-		std::vector<Node*> children;
-		Node* parent;
-		int count;
-		CulledList objects;
-
-		Node(Node* newParent, const AABB& newBox = AABB(), int newDepth = 0) :parent(newParent), box(newBox), depth(newDepth)
-		{
-			count = 0;
-		}
-		~Node()
-		{
-			for (Node* x : children)
-			{
-				SAFE_DELETE(x);
-			}
-		}
+		// Child bounds in SoA layout: lane i holds the bounds of child i
+		XMFLOAT4A minX, minY, minZ;
+		XMFLOAT4A maxX, maxY, maxZ;
+		// Child references: CHILD_INVALID for empty lane, CHILD_LEAF flag set for object index, otherwise node index
+		uint32_t children[4];
 	};
-	Node* root;
+	std::vector<Node> nodes; // nodes[0] is the root, children are always placed after their parent
+	std::vector<Cullable*> objects; // referenced by leaves, removed objects are left as nullptr until the next build
+	AABB bounds; // bounds of the whole tree
+
 	enum CullStrictness
 	{
+		// Test every object's bounds against the query
 		SP_TREE_STRICT_CULL,
+		// Only test the nodes, objects in intersected nodes are all accepted
 		SP_TREE_LOOSE_CULL
 	};
 	enum SortType
@@ -63,32 +89,28 @@ public:
 	// Sort culled list by their distance to the origin point
 	static void Sort(const XMFLOAT3& origin, CulledList& objects, SortType sortType = SP_TREE_SORT_UNIQUE);
 
-	void AddObjects(Node* node, const std::vector<Cullable*>& newObjects);
-	void getVisible(Frustum& frustum, CulledList& objects, SortType sortType = SP_TREE_SORT_UNIQUE, CullStrictness type = SP_TREE_STRICT_CULL, Node* node = nullptr);
-	void getVisible(AABB& frustum, CulledList& objects, SortType sortType = SP_TREE_SORT_UNIQUE, CullStrictness type = SP_TREE_STRICT_CULL, Node* node = nullptr);
-	void getVisible(SPHERE& frustum, CulledList& objects, SortType sortType = SP_TREE_SORT_UNIQUE, CullStrictness type = SP_TREE_STRICT_CULL, Node* node = nullptr);
-	void getVisible(RAY& frustum, CulledList& objects, SortType sortType = SP_TREE_SORT_UNIQUE, CullStrictness type = SP_TREE_STRICT_CULL, Node* node = nullptr);
-	void getAll(CulledList& objects, Node* node = nullptr);
-	// Updates the tree. Returns null if successful, returns a new tree if the tree is resized. The old tree can be thrown away then.
-	wiSPTree* updateTree(Node* node = nullptr);
-	void Remove(Cullable* value, Node* node = nullptr);
-};
+	bool IsEmpty() const { return nodes.empty(); }
 
-class Octree : public wiSPTree
-{
-public:
-	Octree(const std::vector<Cullable*>& objects, const XMFLOAT3& newMin = XMFLOAT3(FLOAT32_MAX, FLOAT32_MAX, FLOAT32_MAX), const XMFLOAT3& newMax = XMFLOAT3(-FLOAT32_MAX, -FLOAT32_MAX, -FLOAT32_MAX))
-	{
-		childCount=8;
-		initialize(objects, newMin, newMax);
-	}
+	// Rebuild the whole hierarchy from the current objects
+	void Build();
+	// Add objects and rebuild the hierarchy
+	void AddObjects(const std::vector<Cullable*>& newObjects);
+	void getVisible(Frustum& frustum, CulledList& culled, SortType sortType = SP_TREE_SORT_UNIQUE, CullStrictness type = SP_TREE_STRICT_CULL);
+	void getVisible(AABB& frustum, CulledList& culled, SortType sortType = SP_TREE_SORT_UNIQUE, CullStrictness type = SP_TREE_STRICT_CULL);
+	void getVisible(SPHERE& frustum, CulledList& culled, SortType sortType = SP_TREE_SORT_UNIQUE, CullStrictness type = SP_TREE_STRICT_CULL);
+	void getVisible(RAY& frustum, CulledList& culled, SortType sortType = SP_TREE_SORT_UNIQUE, CullStrictness type = SP_TREE_STRICT_CULL);
+	void getAll(CulledList& culled);
+	// Refit the node bounds to the moved objects. The hierarchy is only rebuilt if it degraded too much.
+	void updateTree();
+	void Remove(Cullable* value);
+
+private:
+	float buildCost = 0; // surface area sum of the nodes right after the last build
+
+	uint32_t BuildNode(std::vector<uint32_t>& indices, const std::vector<AABB>& objectBounds, const std::vector<XMFLOAT3>& centers, uint32_t first, uint32_t count, int depth);
+	uint32_t Split(std::vector<uint32_t>& indices, const std::vector<AABB>& objectBounds, const std::vector<XMFLOAT3>& centers, uint32_t first, uint32_t count, int depth);
+	float Refit();
+	void GatherSubtree(uint32_t nodeIndex, CulledList& culled);
+	template<typename NodeTest>
+	void Traverse(CulledList& culled, CullStrictness type, NodeTest test, uint32_t rootIndex = 0);
 };
-class QuadTree : public wiSPTree
-{
-public:
-	QuadTree(const std::vector<Cullable*>& objects, const XMFLOAT3& newMin = XMFLOAT3(FLOAT32_MAX, FLOAT32_MAX, FLOAT32_MAX), const XMFLOAT3& newMax = XMFLOAT3(-FLOAT32_MAX, -FLOAT32_MAX, -FLOAT32_MAX))
-	{
-		childCount = 4;
-		initialize(objects, newMin, newMax);
-	}
-};
\ No newline at end of file
@@ -36,6 +36,7 @@ void wiSprite::Init(){
 	normal="";
 	name="";
 	texturePointer=maskPointer=normalPointer=nullptr;
+	atlas=nullptr;
 	effects=wiImageEffects();
 	anim=Anim();
 }
@@ -64,7 +65,23 @@ void wiSprite::CleanUp(){
 void wiSprite::Draw(Texture2D* refracRes, GRAPHICSTHREAD threadID){
 	if(effects.opacity>0 && ((effects.blendFlag==BLENDMODE_ADDITIVE && effects.fade<1) || effects.blendFlag!=BLENDMODE_ADDITIVE) ){
 		effects.setRefractionSource(refracRes);
-		wiImage::Draw(texturePointer,effects,threadID);
+
+		// drawing from the atlas lets sprites with different textures share an image batch:
+		Texture2D* tex = texturePointer;
+		effects.atlasMulAdd = XMFLOAT4(1, 1, 0, 0);
+		// but wrapping, mirroring or scrolling would sample the neighbours in the atlas, and it has no lower mips:
+		const bool atlasCompatible = effects.sampleFlag == SAMPLEMODE_CLAMP && effects.quality != QUALITY_ANISOTROPIC && effects.mipLevel == 0 &&
+			effects.texOffset.x == 0 && effects.texOffset.y == 0 && anim.movingTexAnim.speedX == 0 && anim.movingTexAnim.speedY == 0;
+		if (atlas != nullptr && atlasCompatible)
+		{
+			auto it = atlas->mulAdds.find(texturePointer);
+			if (it != atlas->mulAdds.end())
+			{
+				tex = atlas->texture;
+				effects.atlasMulAdd = it->second;
+			}
+		}
+		wiImage::Draw(tex,effects,threadID);
 	}
 }
 void wiSprite::Draw(GRAPHICSTHREAD threadID){
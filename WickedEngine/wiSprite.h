@@ -10,6 +10,7 @@ class wiSprite : public wiImage
 private:
 	std::string texture, mask, normal;
 	wiGraphicsTypes::Texture2D* texturePointer,*normalPointer,*maskPointer;
+	const Atlas* atlas;
 	wiResourceManager* ContentHolder;
 public:
 	wiSprite(wiResourceManager* contentHolder = nullptr);
@@ -68,5 +69,9 @@ public:
 	
 	wiGraphicsTypes::Texture2D* getTexture(){return texturePointer;}
 	void setTexture(wiGraphicsTypes::Texture2D* value){texturePointer=value;}
+
+	// If the texture of the sprite is packed into the atlas, the sprite is drawn from the atlas texture instead.
+	//	The atlas has no mipmaps and no replicated borders, so it is only used while the sprite clamps, samples mip 0 without anisotropy and has no texture offset
+	void setAtlas(const Atlas* value){atlas=value;}
 };
 
@@ -5,6 +5,7 @@
 #include <vector>
 
 std::atomic<uint64_t> Node::__Unique_ID_Counter = 0;
+std::atomic<uint32_t> Transform::hierarchyVersion = 0;
 
 Node::Node() {
 	name = "";
@@ -45,6 +46,7 @@ Transform::~Transform()
 {
 	detach();
 	detachChild();
+	hierarchyVersion.fetch_add(1);
 }
 
 
@@ -100,6 +102,8 @@ void Transform::attachTo(Transform* newParent, int copyTranslation, int copyRota
 		copyParentS = copyScale;
 		XMStoreFloat4x4(&parent_inv_rest, XMMatrixInverse(nullptr, parent->getMatrix(copyParentT, copyParentR, copyParentS)));
 		parent->children.insert(this);
+		dirty = true;
+		hierarchyVersion.fetch_add(1);
 	}
 }
 Transform* Transform::find(const std::string& findname)
@@ -168,6 +172,8 @@ void Transform::detach() {
 			parent->children.erase(this);
 		}
 		applyTransform(copyParentT, copyParentR, copyParentS);
+		dirty = true;
+		hierarchyVersion.fetch_add(1);
 	}
 	parent = nullptr;
 }
@@ -205,10 +211,16 @@ void Transform::transform(const XMMATRIX& m) {
 }
 void Transform::UpdateTransform()
 {
-	worldPrev = world;
-	translationPrev = translation;
-	scalePrev = scale;
-	rotationPrev = rotation;
+	UpdateWorld();
+
+	for (Transform* child : children)
+	{
+		child->UpdateTransform();
+	}
+}
+void Transform::UpdateWorld()
+{
+	UpdatePrev();
 
 	XMVECTOR s = XMLoadFloat3(&scale_rest);
 	XMVECTOR r = XMLoadFloat4(&rotation_rest);
@@ -238,10 +250,25 @@ void Transform::UpdateTransform()
 		scale = scale_rest;
 	}
 
-	for (Transform* child : children)
-	{
-		child->UpdateTransform();
-	}
+	translation_cache = translation_rest;
+	rotation_cache = rotation_rest;
+	scale_cache = scale_rest;
+	dirty = false;
+	changed = true;
+}
+bool Transform::IsDirty() const
+{
+	return dirty ||
+		translation_cache.x != translation_rest.x || translation_cache.y != translation_rest.y || translation_cache.z != translation_rest.z ||
+		rotation_cache.x != rotation_rest.x || rotation_cache.y != rotation_rest.y || rotation_cache.z != rotation_rest.z || rotation_cache.w != rotation_rest.w ||
+		scale_cache.x != scale_rest.x || scale_cache.y != scale_rest.y || scale_cache.z != scale_rest.z;
+}
+void Transform::UpdatePrev()
+{
+	worldPrev = world;
+	translationPrev = translation;
+	scalePrev = scale;
+	rotationPrev = rotation;
 }
 void Transform::Translate(const XMFLOAT3& value)
 {
@@ -42,6 +42,13 @@ struct Transform : public Node
 	XMFLOAT4X4 parent_inv_rest;
 	int copyParentT, copyParentR, copyParentS;
 
+	// Set when the world state needs to be recomputed by the next hierarchy update
+	bool dirty;
+	// The world state was recomputed by the last hierarchy update, so the children must be recomputed too
+	bool changed;
+	// Incremented on every attach and detach, so flattened copies of the hierarchy know when to rebuild
+	static std::atomic<uint32_t> hierarchyVersion;
+
 	Transform();
 	virtual ~Transform();
 	void Clear()
@@ -51,6 +58,8 @@ struct Transform : public Node
 		scale_rest = scale = scalePrev = XMFLOAT3(1, 1, 1);
 		rotation_rest = rotation = rotationPrev = XMFLOAT4(0, 0, 0, 1);
 		world_rest = world = worldPrev = parent_inv_rest = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
+		dirty = true;
+		changed = false;
 	}
 
 	virtual XMMATRIX getMatrix(int getTranslation = 1, int getRotation = 1, int getScale = 1);
@@ -74,9 +83,23 @@ struct Transform : public Node
 	void CatmullRom(const Transform* a, const Transform* b, const Transform* c, const Transform* d, float t);
 	// Update this transform and children recursively
 	virtual void UpdateTransform();
+	// Update only the world state of this transform from the rest state and the parent
+	virtual void UpdateWorld();
+	// Check if the world state is outdated. The rest state is compared with the one that the world was computed from,
+	//	so the rest values can also be written directly, without calling SetDirty().
+	virtual bool IsDirty() const;
+	void SetDirty() { dirty = true; }
+	// Copy the current world state to the previous frame state
+	void UpdatePrev();
 	// Get the root of the tree
 	Transform* GetRoot();
 	void Serialize(wiArchive& archive);
+
+private:
+	// Rest state that the world state was last computed from
+	XMFLOAT3 translation_cache;
+	XMFLOAT4 rotation_cache;
+	XMFLOAT3 scale_cache;
 };
 
 #endif // _TRANSFORM_H_
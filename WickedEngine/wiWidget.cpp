@@ -356,6 +356,8 @@ void wiButton::Render(wiGUI* gui)
 	scissorRect.left = (LONG)(translation.x);
 	scissorRect.right = (LONG)(translation.x + scale.x);
 	scissorRect.top = (LONG)(translation.y);
+	wiFont::Flush(gui->GetGraphicsThread());
+	wiImage::Flush(gui->GetGraphicsThread());
 	wiRenderer::GetDevice()->SetScissorRects(1, &scissorRect, gui->GetGraphicsThread());
 	wiFont(text, wiFontProps((int)(translation.x + scale.x*0.5f), (int)(translation.y + scale.y*0.5f), -1, WIFALIGN_CENTER, WIFALIGN_CENTER, 2, 1, 
 		textColor, textShadowColor)).Draw(gui->GetGraphicsThread());
@@ -426,6 +428,8 @@ void wiLabel::Render(wiGUI* gui)
 	scissorRect.left = (LONG)(translation.x);
 	scissorRect.right = (LONG)(translation.x + scale.x);
 	scissorRect.top = (LONG)(translation.y);
+	wiFont::Flush(gui->GetGraphicsThread());
+	wiImage::Flush(gui->GetGraphicsThread());
 	wiRenderer::GetDevice()->SetScissorRects(1, &scissorRect, gui->GetGraphicsThread());
 	wiFont(text, wiFontProps((int)translation.x + 2, (int)translation.y + 2, -1, WIFALIGN_LEFT, WIFALIGN_TOP, 2, 1, 
 		textColor, textShadowColor)).Draw(gui->GetGraphicsThread());
@@ -583,6 +587,8 @@ void wiTextInputField::Render(wiGUI* gui)
 	scissorRect.left = (LONG)(translation.x);
 	scissorRect.right = (LONG)(translation.x + scale.x);
 	scissorRect.top = (LONG)(translation.y);
+	wiFont::Flush(gui->GetGraphicsThread());
+	wiImage::Flush(gui->GetGraphicsThread());
 	wiRenderer::GetDevice()->SetScissorRects(1, &scissorRect, gui->GetGraphicsThread());
 
 	string activeText = text;
@@ -771,6 +777,8 @@ void wiSlider::Render(wiGUI* gui)
 
 	if (parent != nullptr)
 	{
+		wiFont::Flush(gui->GetGraphicsThread());
+		wiImage::Flush(gui->GetGraphicsThread());
 		wiRenderer::GetDevice()->SetScissorRects(1, &scissorRect, gui->GetGraphicsThread());
 	}
 	// text
@@ -908,6 +916,8 @@ void wiCheckBox::Render(wiGUI* gui)
 
 	if (parent != nullptr)
 	{
+		wiFont::Flush(gui->GetGraphicsThread());
+		wiImage::Flush(gui->GetGraphicsThread());
 		wiRenderer::GetDevice()->SetScissorRects(1, &scissorRect, gui->GetGraphicsThread());
 	}
 	wiFont(text, wiFontProps((int)(translation.x), (int)(translation.y + scale.y*0.5f), -1, WIFALIGN_RIGHT, WIFALIGN_CENTER, 2, 1,
@@ -1096,6 +1106,8 @@ void wiComboBox::Render(wiGUI* gui)
 
 	if (parent != nullptr)
 	{
+		wiFont::Flush(gui->GetGraphicsThread());
+		wiImage::Flush(gui->GetGraphicsThread());
 		wiRenderer::GetDevice()->SetScissorRects(1, &scissorRect, gui->GetGraphicsThread());
 	}
 	wiFont(text, wiFontProps((int)(translation.x), (int)(translation.y + scale.y*0.5f), -1, WIFALIGN_RIGHT, WIFALIGN_CENTER, 2, 1,
@@ -1418,6 +1430,8 @@ void wiWindow::Render(wiGUI* gui)
 	scissorRect.left = (LONG)(translation.x);
 	scissorRect.right = (LONG)(translation.x + scale.x);
 	scissorRect.top = (LONG)(translation.y);
+	wiFont::Flush(gui->GetGraphicsThread());
+	wiImage::Flush(gui->GetGraphicsThread());
 	wiRenderer::GetDevice()->SetScissorRects(1, &scissorRect, gui->GetGraphicsThread());
 	wiFont(text, wiFontProps((int)(translation.x + resizeDragger_UpperLeft->scale.x + 2), (int)(translation.y), -1, WIFALIGN_LEFT, WIFALIGN_TOP, 2, 1,
 		textColor, textShadowColor)).Draw(gui->GetGraphicsThread());
@@ -1730,6 +1744,10 @@ void wiColorPicker::Render(wiGUI* gui)
 
 	}
 
+	// the window texts and images must be drawn before the picker geometry:
+	wiFont::Flush(threadID);
+	wiImage::Flush(threadID);
+
 	XMMATRIX __cam = wiRenderer::GetDevice()->GetScreenProjection();
 
 	wiRenderer::GetDevice()->BindConstantBuffer(VS, wiRenderer::constantBuffers[CBTYPE_MISC], CBSLOT_RENDERER_MISC, threadID);